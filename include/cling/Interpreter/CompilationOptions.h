@@ -62,6 +62,13 @@ namespace cling {
     ///
     unsigned CheckPointerValidity : 1;
 
+    ///\brief The input is a probe whose diagnostics nobody looks at: they
+    /// are counted but not emitted, typo correction is disabled, overload
+    /// candidate notes are limited to the best ones and compilation gives up
+    /// after the first error.
+    ///
+    unsigned SilentProbe : 1;
+
     ///\brief Offset into the input line to enable the setting of the
     /// code completion point.
     /// -1 diasables code completion.
@@ -78,6 +85,7 @@ namespace cling {
       CodeGenerationForModule = 0;
       IgnorePromptDiags = 0;
       CheckPointerValidity = 1;
+      SilentProbe = 0;
     }
 
     bool operator==(CompilationOptions Other) const {
@@ -91,6 +99,7 @@ namespace cling {
         CodeGenerationForModule == Other.CodeGenerationForModule &&
         IgnorePromptDiags     == Other.IgnorePromptDiags &&
         CheckPointerValidity  == Other.CheckPointerValidity &&
+        SilentProbe           == Other.SilentProbe &&
         CodeCompletionOffset  == Other.CodeCompletionOffset;
     }
 
@@ -105,6 +114,7 @@ namespace cling {
         CodeGenerationForModule != Other.CodeGenerationForModule ||
         IgnorePromptDiags     != Other.IgnorePromptDiags ||
         CheckPointerValidity  != Other.CheckPointerValidity ||
+        SilentProbe           != Other.SilentProbe ||
         CodeCompletionOffset  != Other.CodeCompletionOffset;
     }
   };
@@ -17,8 +17,10 @@
 #include "llvm/Support/Path.h"
 
 namespace cling {
+  class ExecutorProcess;
   class InterpreterCallbacks;
   class InvocationOptions;
+  class StatCache;
 
   ///\brief A helper class managing dynamic shared objects.
   ///
@@ -52,6 +54,14 @@ namespace cling {
 
     InterpreterCallbacks* m_Callbacks;
 
+    ///\brief Missing files known from previous sessions, if any.
+    ///
+    StatCache* m_StatCache;
+
+    ///\brief The process running the JITted code, if it is not this one.
+    ///
+    ExecutorProcess* m_ExecutorProcess;
+
     ///\brief Concatenates current include paths and the system include paths
     /// and performs a lookup for the filename.
     ///\param[in] libStem - The filename being looked up
@@ -76,6 +86,8 @@ namespace cling {
     InterpreterCallbacks* getCallbacks() { return m_Callbacks; }
     const InterpreterCallbacks* getCallbacks() const { return m_Callbacks; }
     void setCallbacks(InterpreterCallbacks* C) { m_Callbacks = C; }
+    void setStatCache(StatCache* SC) { m_StatCache = SC; }
+    void setExecutorProcess(ExecutorProcess* EP) { m_ExecutorProcess = EP; }
 
     ///\brief Looks up a library taking into account the current include paths
     /// and the system include paths.
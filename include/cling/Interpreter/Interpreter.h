@@ -13,8 +13,10 @@
 #include "cling/Interpreter/InvocationOptions.h"
 
 #include "llvm/ADT/StringRef.h"
+#include "llvm/ADT/iterator_range.h"
 
 #include <cstdlib>
+#include <deque>
 #include <memory>
 #include <string>
 #include <unordered_map>
@@ -26,6 +28,7 @@ namespace llvm {
   class LLVMContext;
   class Module;
   class Type;
+  template <typename T> class ArrayRef;
   template <typename T> class SmallVectorImpl;
 }
 
@@ -35,6 +38,7 @@ namespace clang {
   class CompilerInstance;
   class Decl;
   class DeclContext;
+  class FileID;
   class FunctionDecl;
   class GlobalDecl;
   class NamedDecl;
@@ -59,10 +63,20 @@ namespace cling {
   class ClangInternalState;
   class CompilationOptions;
   class DynamicLibraryManager;
+  class HeaderPrefetcher;
   class IncrementalExecutor;
   class IncrementalParser;
   class InterpreterCallbacks;
+  class JITProfile;
+  class LazyCodeGen;
+  class LazyDebugInfo;
   class LookupHelper;
+  class MemProfiler;
+  class PerfStat;
+  class SamplingProfiler;
+  class StartupProfile;
+  class StatCache;
+  class TransactionHeap;
   class Value;
   class Transaction;
 
@@ -124,6 +138,8 @@ namespace cling {
       kExeCompilationError,
       ///\brief The function is not known.
       kExeUnkownFunction,
+      ///\brief The executor process died running the function.
+      kExeExecutorCrashed,
 
       ///\brief Number of possible results.
       kNumExeResults
@@ -154,17 +170,33 @@ namespace cling {
     ///\brief Cache of compiled destructors wrappers.
     std::unordered_map<const clang::RecordDecl*, void*> m_DtorWrappers;
 
+    ///\brief Records whose destructor wrappers are needed but not compiled
+    /// yet, see requestDtorCallFor().
+    std::vector<const clang::RecordDecl*> m_PendingDtorWrappers;
+
+    ///\brief How many wrappers are running, one inside the other.
+    unsigned m_NumRunningWrappers;
+
     ///\brief Counter used when we need unique names.
     ///
     mutable unsigned long long m_UniqueCounter;
 
+    ///\brief Whether this interpreter was created without a parent; only
+    /// such an interpreter writes the trace file.
+    ///
+    bool m_IsTopLevel;
+
+    ///\brief Number of reusable wrapper names, see setWrapperSlots().
+    ///
+    unsigned m_WrapperSlots;
+
     ///\brief Flag toggling the Debug printing on or off.
     ///
     bool m_PrintDebug;
 
-    ///\brief Whether DynamicLookupRuntimeUniverse.h has been parsed.
+    ///\brief Bitmask of the RuntimeTier-s that have already been parsed.
     ///
-    bool m_DynamicLookupDeclared;
+    mutable unsigned m_DeclaredRuntimeTiers;
 
     ///\brief Flag toggling the dynamic scopes on or off.
     ///
@@ -186,6 +218,60 @@ namespace cling {
     ///
     mutable std::vector<ClangInternalState*> m_StoredStates;
 
+    ///\brief Phases of the construction of the interpreter, if requested
+    /// through InvocationOptions::StartupProfile.
+    ///
+    std::unique_ptr<StartupProfile> m_StartupProfile;
+
+    ///\brief Reads included headers ahead of the parser, if requested
+    /// through InvocationOptions::PrefetchHeaders.
+    ///
+    std::unique_ptr<HeaderPrefetcher> m_HeaderPrefetcher;
+
+    ///\brief Missing headers and libraries remembered across sessions, if
+    /// requested through InvocationOptions::StatCache.
+    ///
+    std::unique_ptr<StatCache> m_StatCache;
+
+    ///\brief Profile of the JITted code, if requested through
+    /// InvocationOptions::ProfileGenerate or ProfileUse.
+    ///
+    std::unique_ptr<JITProfile> m_JITProfile;
+
+    ///\brief Generates the debug info of the JITted code when needed, if
+    /// requested through InvocationOptions::LazyDebugInfo.
+    ///
+    std::unique_ptr<LazyDebugInfo> m_LazyDebugInfo;
+
+    ///\brief Generates the code of the inline functions deserialized from
+    /// the PCH when the JIT needs them, if requested through
+    /// InvocationOptions::LazyPCHCodeGen.
+    ///
+    std::unique_ptr<LazyCodeGen> m_LazyCodeGen;
+
+    ///\brief Samples the interpreter's thread, see startProfiling().
+    ///
+    std::unique_ptr<SamplingProfiler> m_SamplingProfiler;
+
+    ///\brief Records the allocations of the JITted code, see
+    /// startMemoryProfiling().
+    ///
+    std::unique_ptr<MemProfiler> m_MemProfiler;
+
+    ///\brief Heaps of the transactions entered in the session, if requested
+    /// through InvocationOptions::TransactionHeap.
+    ///
+    std::unique_ptr<TransactionHeap> m_TransactionHeap;
+
+    ///\brief Measures the input of the ongoing perfstat() call, if any.
+    ///
+    PerfStat* m_PerfStat;
+
+    ///\brief The last transaction of the interpreter's own setup; the ones
+    /// after it were entered in the session.
+    ///
+    const Transaction* m_LastStartupTransaction;
+
     ///\brief Processes the invocation options.
     ///
     void handleFrontendOptions();
@@ -203,6 +289,25 @@ namespace cling {
                                       const CompilationOptions& CO,
                                       Transaction** T = 0) const;
 
+    ///\brief Hands the headers included by input to the HeaderPrefetcher.
+    ///
+    void prefetchHeaders(const std::string& input) const;
+
+    ///\brief Frees the slot of a wrapper that has been run. The transaction
+    /// is unloaded if it holds nothing but the wrapper; else the wrapper is
+    /// removed from the AST and CodeGen, and its code stays with the
+    /// transaction, renamed in the module and the JIT.
+    ///
+    ///\param [in] T - The last transaction, whose wrapper has been run.
+    ///\param [in] V - The value the wrapper produced.
+    ///
+    void reclaimWrapperSlot(Transaction& T, const Value& V);
+
+    ///\brief Checks whether unloading a transaction together with its
+    /// wrapper loses nothing but the wrapper.
+    ///
+    bool canUnloadWithWrapper(const Transaction& T, const Value& V) const;
+
     ///\brief Worker function, building block for interpreter's public
     /// interfaces.
     ///
@@ -254,11 +359,17 @@ namespace cling {
     ///\param [in,out] res - The return result of the run function. Must be
     ///       initialized to point to the return value's location if the
     ///       expression result is an aggregate.
+    ///\param [in] directResult - The wrapper stores its builtin result
+    ///       directly into the storage of res, which the caller types
+    ///       once it returned.
+    ///\param [in] T - The transaction defining the function, if known; the
+    ///       function is then looked up in its code only.
     ///
     ///\returns The result of the execution.
     ///
     ExecutionResult RunFunction(const clang::FunctionDecl* FD,
-                                Value* res = 0);
+                                Value* res = 0, bool directResult = false,
+                                const Transaction* T = 0);
 
     ///\brief Forwards to cling::IncrementalExecutor::addSymbol.
     ///
@@ -315,6 +426,13 @@ namespace cling {
     const InvocationOptions& getOptions() const { return m_Opts; }
     InvocationOptions& getOptions() { return m_Opts; }
 
+    ///\brief Returns the profile of the construction of the interpreter, or
+    /// null if it was not requested.
+    ///
+    const StartupProfile* getStartupProfile() const {
+      return m_StartupProfile.get();
+    }
+
     const llvm::LLVMContext* getLLVMContext() const {
       return m_LLVMContext.get();
     }
@@ -371,6 +489,26 @@ namespace cling {
     ///
     bool isUniqueWrapper(llvm::StringRef name);
 
+    ///\brief Names the statement wrappers from a fixed set of slots instead
+    /// of a new unique name per input.
+    ///
+    /// A slot is busy while its wrapper runs. Afterwards its transaction is
+    /// unloaded - removing the declaration and its JIT module - if it
+    /// declared nothing else and its result does not refer to it; otherwise
+    /// only the declaration is removed, and its code stays with the rest of
+    /// the transaction under a name of its own, such that the JIT never
+    /// defines a slot's name twice. The next input then reuses the name,
+    /// which keeps the
+    /// identifier and symbol tables from growing without bound for hosts that
+    /// execute a stream of statements. Wrappers are looked up in their own
+    /// transaction's code. Inputs that find all slots busy get a unique name,
+    /// as usual.
+    ///
+    ///\param[in] N - The number of slots; 0 disables the reuse.
+    ///
+    void setWrapperSlots(unsigned N) { m_WrapperSlots = N; }
+    unsigned getWrapperSlots() const { return m_WrapperSlots; }
+
     ///\brief Adds multiple include paths separated by a delimter.
     ///
     ///\param[in] PathsStr - Path(s)
@@ -426,6 +564,98 @@ namespace cling {
     ///
     void printIncludedFiles (llvm::raw_ostream& out) const;
 
+    ///\brief Print how the transactions and their metadata were allocated.
+    ///
+    ///\param[in] out - The output stream to be printed into.
+    ///
+    void printTransactionStats(llvm::raw_ostream& out) const;
+
+    ///\brief Print how many file system lookups the stat cache spared.
+    ///
+    ///\param[in] out - The output stream to be printed into.
+    ///
+    void printStatCacheStats(llvm::raw_ostream& out) const;
+
+    ///\brief Print how many modules the JIT found in its object cache.
+    ///
+    ///\param[in] out - The output stream to be printed into.
+    ///
+    void printJITCacheStats(llvm::raw_ostream& out) const;
+
+    ///\brief Print how many deserialized inline functions were kept back
+    /// from CodeGen and how many of them the JIT needed.
+    ///
+    ///\param[in] out - The output stream to be printed into.
+    ///
+    void printLazyCodeGenStats(llvm::raw_ostream& out) const;
+
+    ///\brief Print how many headers were read ahead, once the reading
+    /// finished.
+    ///
+    ///\param[in] out - The output stream to be printed into.
+    ///
+    void printPrefetchStats(llvm::raw_ostream& out) const;
+
+    ///\brief Starts sampling where the calling thread spends its CPU time,
+    /// discarding earlier samples.
+    ///
+    ///\returns false if sampling is running already or not supported.
+    ///
+    bool startProfiling();
+
+    ///\brief Stops the sampling started by startProfiling().
+    ///
+    ///\returns false if no sampling was running.
+    ///
+    bool stopProfiling();
+
+    ///\brief Print the functions and source lines the samples hit most.
+    /// Generates the debug info needed for the lines, see loadDebugInfo().
+    ///
+    ///\param[in] out - The output stream to be printed into.
+    ///
+    void printProfile(llvm::raw_ostream& out);
+
+    ///\brief Starts recording the heap allocations of the code compiled from
+    /// now on, discarding earlier records.
+    ///
+    /// Allocations are attributed to their call site and to the transaction
+    /// whose code ran; unloading a transaction reports the blocks it leaves
+    /// allocated.
+    ///
+    ///\returns false if recording is running already or not supported, e.g.
+    /// when the code runs in an executor process.
+    ///
+    bool startMemoryProfiling();
+
+    ///\brief Stops recording the allocations; releases are still tracked.
+    ///
+    ///\returns false if no recording was running.
+    ///
+    bool stopMemoryProfiling();
+
+    ///\brief Print the call sites and transactions that allocated most.
+    ///
+    ///\param[in] out - The output stream to be printed into.
+    ///
+    void printMemoryProfile(llvm::raw_ostream& out) const;
+
+    ///\brief Whether the debug info of the JITted code is generated only
+    /// when needed, see loadDebugInfo().
+    ///
+    bool hasLazyDebugInfo() const { return (bool)m_LazyDebugInfo; }
+
+    ///\brief Generates the debug info of the code compiled so far, if it is
+    /// generated only when needed, and lists the JITted functions in
+    /// /tmp/perf-<pid>.map for perf.
+    ///
+    /// Called when debug info is needed: on .debug, for a profile report
+    /// and when an exception from the JITted code reaches the prompt.
+    ///
+    ///\returns the number of JITted functions that gained line tables.
+    ///
+    unsigned loadDebugInfo();
+
     ///\brief Compiles the given input.
     ///
     /// This interface helps to run everything that cling can run. From
@@ -446,6 +676,23 @@ namespace cling {
     CompilationResult process(const std::string& input, Value* V = 0,
                               Transaction** T = 0);
 
+    ///\brief Processes input like process(), measuring its compilation and
+    /// its execution.
+    ///
+    /// The execution is measured with the hardware performance counters
+    /// (cycles, instructions, cache references and misses, branch misses and
+    /// page faults) where the system grants them, and by the growth of the
+    /// peak resident set size; both phases are timed.
+    ///
+    ///\param[in] input - The input to process.
+    ///\param[in] out - The stream the measurement is printed to.
+    ///\param[out] V - The result of the evaluation of the input.
+    ///
+    ///\returns Whether the operation was fully successful.
+    ///
+    CompilationResult perfstat(const std::string& input,
+                               llvm::raw_ostream& out, Value* V = 0);
+
     ///\brief Parses input line, which doesn't contain statements. No code
     /// generation is done.
     ///
@@ -524,6 +771,39 @@ namespace cling {
     ///
     CompilationResult evaluate(const std::string& input, Value& V);
 
+    ///\brief Evaluates an input whose failure is expected and not worth
+    /// reporting, e.g. to find out whether an expression is valid.
+    ///
+    /// Compiles with CompilationOptions::SilentProbe: nothing is diagnosed
+    /// and compilation stops at the first error, so that failing is cheap.
+    /// Dynamic scopes and debug info follow the interpreter's settings.
+    ///
+    /// @param[in] input - The input containing only expressions
+    /// @param[out] V - The value of the executed input, if requested.
+    ///
+    ///\returns Whether the operation was fully successful.
+    ///
+    CompilationResult probe(const std::string& input, Value* V = 0);
+
+    ///\brief Whether the statements entered now run in an executor process,
+    /// see InvocationOptions::ExecutorProcess.
+    ///
+    bool isRunningInExecutorProcess() const;
+
+    ///\brief Evaluates an expression of type std::string in the executor
+    /// process, e.g. a printer reading the executor's heap; only the string
+    /// comes back.
+    ///
+    /// @param[in] input - The expression; access control is disabled.
+    /// @param[out] result - Its value.
+    ///
+    ///\returns kExeFunctionNotCompiled if the statements do not run in an
+    /// executor process, kExeCompilationError if the expression is invalid,
+    /// kExeExecutorCrashed if the executor died evaluating it.
+    ///
+    ExecutionResult evaluateStringInExecutor(const std::string& input,
+                                             std::string& result);
+
     ///\brief Compiles input line, which contains only expressions and prints
     /// out the result of its execution.
     ///
@@ -604,7 +884,31 @@ namespace cling {
     bool isPrintingDebug() const { return m_PrintDebug; }
     void enablePrintDebug(bool print = true) { m_PrintDebug = print; }
 
-    void enableDynamicLookup(bool value = true);
+    ///\brief Parts of the runtime universe that are not needed by every
+    /// session and are thus only parsed on first use.
+    ///
+    enum RuntimeTier {
+      ///\brief RuntimePrintValue.h, needed when a value is printed.
+      kRuntimeValuePrinting = 0x1,
+      ///\brief DynamicLookupRuntimeUniverse.h, needed by EvaluateT.
+      kRuntimeDynamicLookup = 0x2
+    };
+
+    ///\brief Makes sure the headers of the given runtime tier are declared
+    /// in this interpreter. Only the first call for a tier parses anything.
+    ///
+    ///\param[in] Tier - the tier that is about to be used.
+    ///
+    ///\returns kSuccess if the tier is available.
+    ///
+    CompilationResult declareRuntimeTier(RuntimeTier Tier) const;
+
+    ///\brief Toggles the dynamic scopes. The runtime they need is declared
+    /// by the first transaction that is compiled with dynamic scoping.
+    ///
+    void enableDynamicLookup(bool value = true) {
+      m_DynamicLookupEnabled = value;
+    }
     bool isDynamicLookupEnabled() const { return m_DynamicLookupEnabled; }
 
     bool isRawInputEnabled() const { return m_RawInputEnabled; }
@@ -646,10 +950,41 @@ namespace cling {
       return m_DyLibManager.get();
     }
 
+    ///\brief Returns the profile the JITted code is instrumented for or
+    /// optimized with; null if neither was requested.
+    ///
+    JITProfile* getJITProfile() const { return m_JITProfile.get(); }
+
+    ///\brief Returns what keeps the deserialized inline functions back
+    /// from CodeGen; null unless requested.
+    ///
+    LazyCodeGen* getLazyCodeGen() const { return m_LazyCodeGen.get(); }
+
     const Transaction* getFirstTransaction() const;
     const Transaction* getLastTransaction() const;
     const Transaction* getCurrentTransaction() const;
 
+    typedef llvm::iterator_range<std::deque<Transaction*>::const_iterator>
+      transaction_range;
+
+    ///\brief Iterates over the top-level transactions, oldest first.
+    ///
+    transaction_range transactions() const;
+
+    ///\brief Returns the committed transaction that holds the declaration,
+    /// or 0 if it was not seen by the interpreter.
+    ///
+    const Transaction* getTransactionFor(const clang::Decl* D) const;
+
+    ///\brief Returns the first committed transaction that parsed the file or
+    /// declared something in it, or 0 if there is none.
+    ///
+    const Transaction* getTransactionFor(clang::FileID FID) const;
+
+    ///\brief Returns whether the transaction is committed and not unloaded.
+    ///
+    bool isCommitted(const Transaction* T) const;
+
     ///\brief Compile extern "C" function and return its address.
     ///
     ///\param[in] name - function name
@@ -663,9 +998,30 @@ namespace cling {
                           bool ifUniq = true, bool withAccessControl = true);
 
     ///\brief Compile (and cache) destructor calls for a record decl. Used by ~Value.
-    /// They are of type extern "C" void()(void* pObj).
+    /// They are of type extern "C" void()(void* pObj); returns 0 if the
+    /// destructor is trivial. The calls requested so far are compiled along.
     void* compileDtorCallFor(const clang::RecordDecl* RD);
 
+    ///\brief Compile (and cache) destructor calls for several record decls at
+    /// once, synthesizing them in a single transaction and module.
+    ///
+    ///\param[in] RDs - The records whose destructor calls are needed.
+    ///\param[out] Addrs - One address per record, as by compileDtorCallFor().
+    void compileDtorCallsFor(llvm::ArrayRef<const clang::RecordDecl*> RDs,
+                             llvm::SmallVectorImpl<void*>& Addrs);
+
+    ///\brief Announces that the destructor call for a record decl will be
+    /// needed. The calls requested meanwhile are compiled together, before
+    /// the next execution or by the first compileDtorCallFor(). Used by Value.
+    ///
+    ///\returns the cached call, or 0 if it is not compiled yet or the
+    /// destructor is trivial.
+    void* requestDtorCallFor(const clang::RecordDecl* RD);
+
+    ///\brief Compiles the destructor calls requested so far, in one
+    /// transaction and module.
+    void compileRequestedDtorCalls();
+
     ///\brief Gets the address of an existing global and whether it was JITted.
     ///
     /// JIT symbols might not be immediately convertible to e.g. a function
@@ -700,6 +1056,17 @@ namespace cling {
     void GenerateAutoloadingMap(llvm::StringRef inFile, llvm::StringRef outFile,
                                 bool enableMacros = false, bool enableLogs = true);
 
+    ///\brief Compiles the declarations entered in the session into a shared
+    /// library, optimized for the host. A header declaring its content and
+    /// the header's autoload declarations are written next to it; loading
+    /// the library with loadFile() also loads the latter.
+    ///
+    ///\param[in] libPath - The library to write.
+    ///
+    ///\returns Whether the library could be written.
+    ///
+    CompilationResult exportSession(llvm::StringRef libPath);
+
     void forwardDeclare(Transaction& T, clang::Sema& S,
                         llvm::raw_ostream& out,
                         bool enableMacros = false,
@@ -158,6 +158,22 @@ namespace cling {
     virtual void LibraryLoaded(const void*, llvm::StringRef) {}
     virtual void LibraryUnloaded(const void*, llvm::StringRef) {}
 
+    ///\brief Invoked when declare(), process(), evaluate(), echo() or
+    /// execute() starts handling an input, also when called from code the
+    /// interpreter runs.
+    ///
+    ///\param[in] - The name of the interpreter's function.
+    ///\param[in] - The input.
+    ///
+    virtual void InputStarted(llvm::StringRef, llvm::StringRef) {}
+
+    ///\brief Invoked when the input of the latest unfinished InputStarted()
+    /// is handled.
+    ///
+    ///\param[in] - The Interpreter::CompilationResult.
+    ///
+    virtual void InputFinished(int) {}
+
     ///\brief Cling calls this is printing a stack trace can be beneficial,
     /// for instance when throwing interpreter exceptions.
     virtual void PrintStackTrace() {}
@@ -63,8 +63,45 @@ namespace cling {
     std::vector<std::string> Inputs;
     CompilerOptions CompilerOpts;
 
+    ///\brief Where to report the startup phases: "-" prints the JSON report
+    /// to stderr, anything else is the file the Chrome trace goes to. Empty
+    /// if the startup is not profiled.
+    std::string StartupProfile;
+
+    ///\brief Indexed profile the execution counts of JITted code are merged
+    /// into at shutdown.
+    std::string ProfileGenerate;
+
+    ///\brief Indexed profile JITted code is optimized with.
+    std::string ProfileUse;
+
+    ///\brief File to log the session's inputs and their costs to.
+    std::string RecordSession;
+
+    ///\brief Session log to replay instead of reading inputs.
+    std::string ReplaySession;
+
+    ///\brief File remembering missing headers and libraries across sessions.
+    std::string StatCache;
+    ///\brief Directory of the JITObjectCache, if any.
+    std::string JITCache;
+
     bool ErrorOut;
+    ///\brief Whether JITted code runs in an ExecutorProcess.
+    bool ExecutorProcess;
+    ///\brief Whether debug info is generated on demand, see
+    /// Interpreter::loadDebugInfo().
+    bool LazyDebugInfo;
+    ///\brief Whether the code of deserialized inline functions is generated
+    /// on demand, see LazyCodeGen.
+    bool LazyPCHCodeGen;
     bool NoLogo;
+    ///\brief Whether headers get read ahead by a HeaderPrefetcher.
+    bool PrefetchHeaders;
+    ///\brief Whether JITted code allocates from a TransactionHeap.
+    bool TransactionHeap;
+    ///\brief Whether the TransactionHeap catches uses of released memory.
+    bool TransactionHeapDebug;
     bool ShowVersion;
     bool Help;
     bool Verbose() const { return CompilerOpts.Verbose; }
@@ -0,0 +1,137 @@
+//--------------------------------------------------------------------*- C++ -*-
+// CLING - the C++ LLVM-based InterpreterG :)
+//
+// This file is dual-licensed: you can choose to license it under the University
+// of Illinois Open Source License or the GNU Lesser General Public License. See
+// LICENSE.TXT for details.
+//------------------------------------------------------------------------------
+
+#ifndef CLING_STARTUP_PROFILE_H
+#define CLING_STARTUP_PROFILE_H
+
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/Support/Timer.h"
+
+#include <memory>
+#include <string>
+
+namespace clang {
+  class FileSystemStatCache;
+}
+
+namespace llvm {
+  class raw_ostream;
+}
+
+namespace cling {
+
+  ///\brief Records where the time of constructing an Interpreter goes.
+  ///
+  /// Phases are nested scopes, each keeping its wall and CPU time and the
+  /// number of stat calls and opened files that went through the FileManager
+  /// while it was open. Only the profile activated on the current thread
+  /// records anything; without one, phases cost a thread-local load.
+  ///
+  class StartupProfile {
+  public:
+    struct PhaseRecord {
+      ///\brief Name of the phase, e.g. "createCI".
+      std::string Name;
+      ///\brief Nesting level, 0 for the outermost phase.
+      unsigned Depth;
+      ///\brief Time at which the phase started.
+      llvm::TimeRecord Start;
+      ///\brief Time spent in the phase, including nested phases.
+      llvm::TimeRecord Elapsed;
+      ///\brief Number of stat calls issued by the phase.
+      unsigned StatCalls;
+      ///\brief Number of files opened by the phase.
+      unsigned FilesOpened;
+    };
+
+    ///\brief Makes a profile the one being recorded into by this thread,
+    /// for the lifetime of the Activation. A null profile records nothing.
+    ///
+    class Activation {
+    private:
+      StartupProfile* m_Prev;
+    public:
+      Activation(StartupProfile* Profile);
+      ~Activation();
+    };
+
+    ///\brief Times the enclosing scope as a phase of the active profile.
+    ///
+    class Phase {
+    private:
+      StartupProfile* m_Profile;
+      size_t m_Index;
+    public:
+      Phase(const char* Name);
+      ~Phase();
+    };
+
+  private:
+    ///\brief The recorded phases, in the order they were started.
+    ///
+    llvm::SmallVector<PhaseRecord, 16> m_Phases;
+
+    ///\brief Time of the creation of the profile; phases are relative to it.
+    ///
+    llvm::TimeRecord m_Origin;
+
+    ///\brief Number of currently open phases.
+    ///
+    unsigned m_Depth;
+
+    ///\brief Total number of stat calls so far.
+    ///
+    unsigned m_StatCalls;
+
+    ///\brief Total number of opened files so far.
+    ///
+    unsigned m_FilesOpened;
+
+    size_t beginPhase(const char* Name);
+    void endPhase(size_t Index);
+
+  public:
+    StartupProfile();
+
+    ///\brief Returns the profile active on this thread, if any.
+    ///
+    static StartupProfile* getActive();
+
+    ///\brief Creates a stat cache counting the stat calls and opened files
+    /// into the profile active at the time of the call, if any. To be added
+    /// to a FileManager with addStatCache().
+    ///
+    static std::unique_ptr<clang::FileSystemStatCache> createStatCounter();
+
+    ///\brief Notifies the profile about a stat call.
+    ///
+    ///\param[in] Opened - whether the call also opened the file.
+    ///
+    void countStat(bool Opened) {
+      ++m_StatCalls;
+      if (Opened)
+        ++m_FilesOpened;
+    }
+
+    const llvm::SmallVectorImpl<PhaseRecord>& getPhases() const {
+      return m_Phases;
+    }
+
+    ///\brief Prints the phases as a JSON array of objects with times in
+    /// seconds.
+    ///
+    void printJSON(llvm::raw_ostream& Out) const;
+
+    ///\brief Prints the phases in the Chrome trace event format, viewable
+    /// with chrome://tracing or Perfetto.
+    ///
+    void printChromeTrace(llvm::raw_ostream& Out) const;
+  };
+} // namespace cling
+
+#endif // CLING_STARTUP_PROFILE_H
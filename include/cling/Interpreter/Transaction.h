@@ -18,8 +18,14 @@
 #include "llvm/ADT/SmallVector.h"
 #include "llvm/ADT/StringRef.h"
 #include "llvm/IR/Module.h"
+#include "llvm/Support/Allocator.h"
 
+#include <algorithm>
+#include <cstdlib>
+#include <iterator>
 #include <memory>
+#include <new>
+#include <type_traits>
 
 namespace clang {
   class ASTContext;
@@ -114,10 +120,91 @@ namespace cling {
       void print(llvm::raw_ostream& Out, const clang::Preprocessor& PP) const;
     };
 
+    ///\brief Allocation counters of all transactions, see .stats.
+    ///
+    struct AllocationStats {
+      size_t m_HeapTransactions; // allocated with operator new
+      size_t m_PooledTransactions; // reused from the TransactionPool
+      size_t m_ArenaTransactions; // nested, allocated in the topmost's arena
+      size_t m_ArenaReusedTransactions; // nested, reused in that arena
+      size_t m_QueueHeapAllocations; // decl queue buffers grown on the heap
+      size_t m_QueueCompactions; // decl queues moved into an arena
+    };
+
+    static AllocationStats& getAllocationStats();
+
   private:
-    // Intentionally use struct instead of pair because we don't need default
-    // init.
-    typedef llvm::SmallVector<DelayCallInfo, 64> DeclQueue;
+    ///\brief Queue of DelayCallInfo in one flat buffer. Small queues are kept
+    /// inline, bigger ones grow on the heap while the transaction collects
+    /// and are moved into an exact-size buffer of the arena once committed.
+    ///
+    class DeclQueue {
+    public:
+      typedef DelayCallInfo* iterator;
+      typedef const DelayCallInfo* const_iterator;
+      typedef std::reverse_iterator<const_iterator> const_reverse_iterator;
+
+    private:
+      enum { kInlineSize = 4 };
+      DelayCallInfo* m_Begin;
+      unsigned m_Size;
+      unsigned m_Capacity;
+      bool m_OnHeap;
+      // DelayCallInfo has no default constructor, it is trivially copyable.
+      typename std::aligned_storage<sizeof(DelayCallInfo) * kInlineSize,
+                                    alignof(DelayCallInfo)>::type m_Inline;
+
+      DelayCallInfo* getInline() {
+        return reinterpret_cast<DelayCallInfo*>(&m_Inline);
+      }
+      void grow();
+
+      DeclQueue(const DeclQueue&) = delete;
+      DeclQueue& operator=(const DeclQueue&) = delete;
+
+    public:
+      DeclQueue(): m_Begin(getInline()), m_Size(0), m_Capacity(kInlineSize),
+                   m_OnHeap(false) {}
+      ~DeclQueue() { if (m_OnHeap) free(m_Begin); }
+
+      iterator begin() { return m_Begin; }
+      iterator end() { return m_Begin + m_Size; }
+      const_iterator begin() const { return m_Begin; }
+      const_iterator end() const { return m_Begin + m_Size; }
+      const_reverse_iterator rbegin() const {
+        return const_reverse_iterator(end());
+      }
+      const_reverse_iterator rend() const {
+        return const_reverse_iterator(begin());
+      }
+
+      size_t size() const { return m_Size; }
+      bool empty() const { return !m_Size; }
+      DelayCallInfo& operator[](size_t I) { return m_Begin[I]; }
+      DelayCallInfo& front() { return m_Begin[0]; }
+      DelayCallInfo& back() { return m_Begin[m_Size - 1]; }
+      const DelayCallInfo& front() const { return m_Begin[0]; }
+      const DelayCallInfo& back() const { return m_Begin[m_Size - 1]; }
+
+      void push_back(const DelayCallInfo& DCI) {
+        if (m_Size == m_Capacity)
+          grow();
+        new (m_Begin + m_Size++) DelayCallInfo(DCI);
+      }
+      iterator erase(iterator I) {
+        std::copy(I + 1, end(), I);
+        --m_Size;
+        return I;
+      }
+      void clear() { m_Size = 0; }
+
+      bool isOnHeap() const { return m_OnHeap; }
+
+      ///\brief Moves a heap buffer into an exact-size buffer of Arena.
+      ///
+      void compact(llvm::BumpPtrAllocator& Arena);
+    };
+
     typedef llvm::SmallVector<Transaction*, 2> NestedTransactions;
 
     ///\brief All seen declarations, except the deserialized ones.
@@ -139,6 +226,21 @@ namespace cling {
     ///
     Transaction* m_Parent;
 
+    ///\brief Memory for the metadata of this transaction and all its nested
+    /// ones, created lazily and owned by the topmost transaction.
+    ///
+    std::unique_ptr<llvm::BumpPtrAllocator> m_Arena;
+
+    ///\brief The topmost transaction whose arena holds this nested
+    /// transaction, if it was allocated there.
+    ///
+    Transaction* m_ArenaOwner;
+
+    ///\brief Released nested transactions, available for reuse within the
+    /// arena of this topmost transaction.
+    ///
+    llvm::SmallVector<Transaction*, 4> m_FreeNested;
+
     unsigned m_State : 3;
 
     unsigned m_IssuedDiags : 2;
@@ -163,6 +265,11 @@ namespace cling {
     ///
     clang::FunctionDecl* m_WrapperFD;
 
+    ///\brief The type (as opaque clang::QualType) of the builtin result that
+    /// the wrapper stores directly into its Value's storage, if any.
+    ///
+    void* m_DirectResultType;
+
     ///\brief Next transaction in if any.
     ///
     const Transaction* m_Next;
@@ -190,6 +297,15 @@ namespace cling {
 
     void Initialize(clang::Sema& S);
 
+    ///\brief The arena of the topmost transaction, created if needed.
+    ///
+    llvm::BumpPtrAllocator& getArena();
+
+    ///\brief Destroys a nested transaction, returning its memory to the
+    /// arena of its owner or to the heap.
+    ///
+    static void destroyNested(Transaction* T);
+
   public:
     enum State {
       kCollecting,
@@ -455,6 +571,18 @@ namespace cling {
     ///\brief Appends the declaration of a macro.
     void append(MacroDirectiveInfo MDE);
 
+    ///\brief Moves the decl queues of a committed transaction into its
+    /// arena, in exact-size buffers.
+    ///
+    void compact();
+
+    ///\brief Returns the memory allocated by the arena of this topmost
+    /// transaction.
+    ///
+    size_t getArenaMemory() const {
+      return m_Arena ? m_Arena->getTotalMemory() : 0;
+    }
+
     ///\brief Clears all declarations in the transaction.
     ///
     void clear() {
@@ -475,6 +603,9 @@ namespace cling {
 
     clang::FunctionDecl* getWrapperFD() const { return m_WrapperFD; }
 
+    void* getDirectResultType() const { return m_DirectResultType; }
+    void setDirectResultType(void* QT) { m_DirectResultType = QT; }
+
     const Transaction* getNext() const { return m_Next; }
     void setNext(Transaction* T) { m_Next = T; }
 
@@ -25,6 +25,7 @@ namespace cling {
   class Interpreter;
   class InputValidator;
   class MetaParser;
+  class SessionRecorder;
   class Value;
 
   ///\brief Class that helps processing meta commands, which add extra
@@ -73,6 +74,10 @@ namespace cling {
     //Counter to handle more than one redirection RAAI's
     int m_RedirectionRAIILevel = 0;
 
+    ///\brief Logs the processed inputs, if requested.
+    ///
+    std::unique_ptr<SessionRecorder> m_SessionRecorder;
+
   public:
     enum RedirectionScope {
       kSTDOUT = 1,
@@ -110,6 +115,7 @@ namespace cling {
     ~MetaProcessor();
 
     const Interpreter& getInterpreter() const { return m_Interp; }
+    Interpreter& getInterpreter() { return m_Interp; }
 
     ///\brief Get the output stream used by the MetaProcessor for its output.
     /// (in contrast to the interpreter's output which is redirected using
@@ -147,6 +153,15 @@ namespace cling {
                 Interpreter::CompilationResult& compRes,
                 cling::Value* result);
 
+    ///\brief Logs all further inputs passed to process() or directly to the
+    /// interpreter with their costs, see SessionRecorder.
+    ///
+    ///\param[in] filename - The log file; truncated.
+    ///
+    ///\returns false if the file cannot be opened.
+    ///
+    bool recordSession(llvm::StringRef filename);
+
     ///\brief When continuation is requested, this cancels and ignores previous
     /// input, resetting the continuation to a new line.
     void cancelContinuation() const;
@@ -186,6 +201,12 @@ namespace cling {
     void registerUnloadPoint(const Transaction* T, llvm::StringRef filename);
 
   private:
+    ///\brief Worker function of process().
+    ///
+    int processInternal(const char* input_line,
+                        Interpreter::CompilationResult& compRes,
+                        cling::Value* result);
+
     ///\brief Set a stream to a file
     ///
     ///\param [in] file - The file for the redirection.
@@ -0,0 +1,167 @@
+//--------------------------------------------------------------------*- C++ -*-
+// CLING - the C++ LLVM-based InterpreterG :)
+//
+// This file is dual-licensed: you can choose to license it under the University
+// of Illinois Open Source License or the GNU Lesser General Public License. See
+// LICENSE.TXT for details.
+//------------------------------------------------------------------------------
+
+#ifndef CLING_SESSION_RECORDER_H
+#define CLING_SESSION_RECORDER_H
+
+#include "cling/Utils/Trace.h"
+
+#include "llvm/ADT/StringRef.h"
+#include "llvm/Support/Timer.h"
+
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace llvm {
+  class raw_ostream;
+}
+
+namespace cling {
+  class Interpreter;
+  class MetaProcessor;
+
+  ///\brief Logs the inputs of a session together with what they cost, such
+  /// that the session can be replayed against another build of cling and
+  /// the costs compared.
+  ///
+  /// The log is a text file with one input per line:
+  ///   <start> <wall> <cpu> <rss> <result> <phases> <origin> <input>
+  /// Times are in microseconds since the start of the recording, <rss> is
+  /// the growth of the peak resident set size in kB (-1 if unknown),
+  /// <result> the CompilationResult (or -1 for a quit request), <phases> a
+  /// comma separated list of <name>=<microseconds> or '-', <origin> either
+  /// 'prompt' or the Interpreter function the input was passed to, and
+  /// <input> the escaped input line.
+  ///
+  /// Inputs passed to the Interpreter while another one is handled, e.g. by
+  /// the code of a prompt input, have their origin prefixed with '+'; they
+  /// are part of the enclosing input's cost, and are not replayed. What the
+  /// MetaProcessor passes on to the Interpreter is not logged separately.
+  ///
+  class SessionRecorder {
+  public:
+    struct Entry {
+      unsigned long long Start;
+      unsigned long long Wall;
+      unsigned long long CPU;
+      long long MaxRSS;
+      int Result;
+      std::vector<std::pair<std::string, unsigned long long>> Phases;
+      std::string Origin;
+      bool Nested;
+      std::string Input;
+
+      Entry(): Start(0), Wall(0), CPU(0), MaxRSS(-1), Result(0),
+               Nested(false) {}
+    };
+
+    ///\brief Measures the processing of one input, from its construction
+    /// until done() is called.
+    ///
+    class Measurement {
+    private:
+      SessionRecorder& m_Recorder;
+      std::string m_Input;
+      std::string m_Origin;
+      bool m_Nested;
+      llvm::TimeRecord m_Begin;
+      long m_BeginMaxRSS;
+      utils::Trace::Summary m_Phases;
+    public:
+      ///\param[in] Origin - 'prompt' or the Interpreter function handling
+      ///   the input.
+      ///
+      Measurement(SessionRecorder& Recorder, llvm::StringRef Input,
+                  llvm::StringRef Origin = "prompt");
+
+      ///\brief Logs the input.
+      ///
+      ///\param[in] Result - the outcome of the input.
+      ///
+      void done(int Result);
+    };
+
+  private:
+    class Callbacks;
+
+    std::unique_ptr<llvm::raw_ostream> m_Out;
+    llvm::TimeRecord m_Origin;
+
+    ///\brief Number of inputs being measured.
+    ///
+    unsigned m_Depth;
+
+    ///\brief Whether a prompt input is being measured.
+    ///
+    bool m_InPrompt;
+
+    ///\brief The inputs passed to the Interpreter being handled, innermost
+    /// last; null for those the MetaProcessor passed on.
+    ///
+    std::vector<std::unique_ptr<Measurement>> m_APIInputs;
+
+    ///\brief The interpreter callbacks feeding m_APIInputs, if attached.
+    ///
+    Callbacks* m_Callbacks;
+
+    ///\brief Hands an input to what handled it when it was recorded.
+    ///
+    ///\param[out] Result - the outcome of the input.
+    ///
+    ///\returns false if the input's origin is unknown.
+    ///
+    static bool replayInput(MetaProcessor& MP, const Entry& E, int& Result);
+
+  public:
+    SessionRecorder();
+    ~SessionRecorder();
+
+    ///\brief Also logs the inputs passed to the Interpreter directly; the
+    /// interpreter must outlive the recorder.
+    ///
+    void attach(Interpreter& Interp);
+
+    ///\brief Starts logging to the given file, truncating it.
+    ///
+    ///\returns false if the file cannot be opened.
+    ///
+    bool open(llvm::StringRef FileName);
+
+    ///\brief Appends an entry to the log.
+    ///
+    void record(const Entry& E);
+
+    ///\brief Prints an entry in the log format.
+    ///
+    static void print(llvm::raw_ostream& Out, const Entry& E);
+
+    ///\brief Reads all entries of a log.
+    ///
+    ///\returns false if the file cannot be read or is malformed.
+    ///
+    static bool read(llvm::StringRef FileName, std::vector<Entry>& Entries);
+
+    ///\brief Feeds the inputs of a log into a MetaProcessor, or its
+    /// Interpreter for those passed to it directly, and reports the recorded
+    /// and the new costs of each input.
+    ///
+    ///\param[in] MP - the MetaProcessor to replay the inputs with.
+    ///\param[in] FileName - the log to replay.
+    ///\param[in] Report - where the comparison goes.
+    ///
+    ///\returns false if the log cannot be read or if an input's result
+    /// differs from the recorded one.
+    ///
+    static bool replay(MetaProcessor& MP, llvm::StringRef FileName,
+                       llvm::raw_ostream& Report);
+  };
+} // end namespace cling
+
+#endif // CLING_SESSION_RECORDER_H
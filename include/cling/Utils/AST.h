@@ -16,6 +16,7 @@
 
 namespace clang {
   class ASTContext;
+  class CXXRecordDecl;
   class Expr;
   class Decl;
   class DeclContext;
@@ -130,6 +131,21 @@ namespace utils {
     clang::IntegerLiteral* IntegerLiteralExpr(clang::ASTContext& C,
                                               uintptr_t Ptr);
 
+    ///\brief Synthesizes the definition of
+    /// extern "C" void Name(void* obj) { ((RD*)obj)->~RD(); }
+    /// directly in the AST, without spelling the (possibly unnameable) type.
+    /// The function is declared in a LinkageSpecDecl in the global namespace;
+    /// the destructor might need to be instantiated.
+    ///
+    ///\param[in] S - The semantic analysis object.
+    ///\param[in] RD - The class whose destructor should be called.
+    ///\param[in] Name - The name of the function.
+    ///
+    ///\returns the function definition, or 0 if RD cannot be destructed.
+    clang::FunctionDecl* DestructorThunk(clang::Sema* S,
+                                         clang::CXXRecordDecl* RD,
+                                         llvm::StringRef Name);
+
   }
 
   ///\brief Class containing static utility functions transforming AST nodes or
@@ -0,0 +1,148 @@
+//--------------------------------------------------------------------*- C++ -*-
+// CLING - the C++ LLVM-based InterpreterG :)
+//
+// This file is dual-licensed: you can choose to license it under the University
+// of Illinois Open Source License or the GNU Lesser General Public License. See
+// LICENSE.TXT for details.
+//------------------------------------------------------------------------------
+
+#ifndef CLING_UTILS_TRACE_H
+#define CLING_UTILS_TRACE_H
+
+#include "llvm/ADT/StringMap.h"
+#include "llvm/ADT/StringRef.h"
+
+#include <atomic>
+#include <string>
+
+namespace llvm {
+  class raw_ostream;
+}
+
+namespace cling {
+  namespace utils {
+    ///\brief Timeline of what the interpreter spends its time on, in the
+    /// Chrome trace event format (chrome://tracing, Perfetto).
+    ///
+    /// Spans are appended to a buffer owned by the recording thread, without
+    /// locks. When tracing is disabled a Span only checks a flag.
+    ///
+    namespace Trace {
+      namespace internal {
+        ///\brief Number of consumers of spans: the Chrome trace, if
+        /// enabled, and each live Summary.
+        extern std::atomic<unsigned> gNumConsumers;
+
+        inline bool isActive() {
+          return gNumConsumers.load(std::memory_order_relaxed);
+        }
+      }
+
+      ///\brief Whether spans are currently being recorded into the Chrome
+      /// trace.
+      ///
+      bool isEnabled();
+
+      ///\brief Starts or stops recording spans into the Chrome trace.
+      /// Already recorded spans are kept.
+      ///
+      void setEnabled(bool Enabled);
+
+      ///\brief Enables tracing if the environment variable CLING_TRACE is
+      /// set; its value is the file written by writeOutputFile().
+      ///
+      void initFromEnvironment();
+
+      ///\brief Writes all recorded spans to the file named by CLING_TRACE,
+      /// if any.
+      ///
+      void writeOutputFile();
+
+      ///\brief Writes all recorded spans as Chrome trace JSON.
+      ///
+      void writeChromeTrace(llvm::raw_ostream& Out);
+
+      ///\brief Writes all recorded spans as Chrome trace JSON to a file.
+      ///
+      ///\returns false if the file could not be written.
+      ///
+      bool writeChromeTrace(llvm::StringRef FileName);
+
+      ///\brief Prints Str as a quoted and escaped JSON string.
+      ///
+      void printJSONString(llvm::raw_ostream& Out, llvm::StringRef Str);
+
+      ///\brief Records the lifetime of the object as a span, if tracing is
+      /// enabled at construction time.
+      ///
+      class Span {
+      private:
+        const char* m_Name;
+        const char* m_Category;
+        unsigned long long m_Start;
+        unsigned m_TransactionID;
+        bool m_Recording;
+        std::string m_Detail;
+
+        void begin(llvm::StringRef Detail);
+        void end();
+
+      public:
+        ///\param[in] Name - what is being done, e.g. "parse"; must outlive
+        ///                  the trace.
+        ///\param[in] Category - the subsystem, e.g. "transaction"; must
+        ///                      outlive the trace.
+        ///\param[in] Detail - additional text, e.g. the input; truncated.
+        ///
+        Span(const char* Name, const char* Category,
+             llvm::StringRef Detail = llvm::StringRef()):
+          m_Name(Name), m_Category(Category), m_Start(0), m_TransactionID(0),
+          m_Recording(false) {
+          if (internal::isActive())
+            begin(Detail);
+        }
+
+        ~Span() {
+          if (m_Recording)
+            end();
+        }
+
+        ///\brief Tags the span with the Transaction::getUniqueID() it
+        /// belongs to.
+        ///
+        void setTransactionID(unsigned ID) { m_TransactionID = ID; }
+      };
+
+      ///\brief Sums up, by name, the durations of the spans ending on the
+      /// current thread during the lifetime of the object. Summaries nest;
+      /// the enclosing ones see the spans of the inner ones too.
+      ///
+      class Summary {
+      private:
+        Summary* m_Prev;
+        llvm::StringMap<unsigned long long> m_Durations;
+
+      public:
+        Summary();
+        ~Summary();
+
+        ///\brief Adds the duration in microseconds of a span, also to the
+        /// enclosing summaries.
+        ///
+        void add(llvm::StringRef Name, unsigned long long Duration) {
+          m_Durations[Name] += Duration;
+          if (m_Prev)
+            m_Prev->add(Name, Duration);
+        }
+
+        ///\brief Returns the total duration in microseconds by span name.
+        ///
+        const llvm::StringMap<unsigned long long>& getDurations() const {
+          return m_Durations;
+        }
+      };
+    } // end namespace Trace
+  } // end namespace utils
+} // end namespace cling
+
+#endif // CLING_UTILS_TRACE_H
@@ -54,6 +54,10 @@ namespace cling {
     ///
     clang::Sema* getSemaPtr() const { return m_Sema; }
 
+    ///\brief The name of the transformer, e.g. for the trace.
+    ///
+    virtual const char* getName() const { return "ASTTransformer"; }
+
     ///\brief Set the ASTConsumer.
     void SetConsumer(clang::ASTConsumer* Consumer) { m_Consumer = Consumer; }
 
@@ -0,0 +1,70 @@
+//--------------------------------------------------------------------*- C++ -*-
+// CLING - the C++ LLVM-based InterpreterG :)
+//
+// This file is dual-licensed: you can choose to license it under the University
+// of Illinois Open Source License or the GNU Lesser General Public License. See
+// LICENSE.TXT for details.
+//------------------------------------------------------------------------------
+
+#ifndef CLING_ALLOCATION_FUNCTIONS_H
+#define CLING_ALLOCATION_FUNCTIONS_H
+
+#include "llvm/ADT/StringRef.h"
+
+namespace cling {
+
+  ///\brief The C and C++ runtime functions managing the heap, which the
+  /// IncrementalJIT can resolve to hooks for the code it links.
+  ///
+  enum AllocationFunction {
+    kMalloc,
+    kCalloc,
+    kRealloc,
+    kFree,
+    kNew,
+    kNewArray,
+    kNewNothrow,
+    kNewArrayNothrow,
+    kDelete,
+    kDeleteArray,
+    kDeleteSized,
+    kDeleteArraySized,
+    kNumAllocationFunctions
+  };
+
+  ///\brief Returns which allocation function a linkage name, without the
+  /// platform's global prefix, refers to; kNumAllocationFunctions if none.
+  /// Only Itanium manglings are known.
+  ///
+  inline AllocationFunction getAllocationFunction(llvm::StringRef Name) {
+#ifndef LLVM_ON_WIN32
+    // size_t is 'm' on LP64 and 'j' on ILP32 targets.
+#if __SIZEOF_SIZE_T__ == 8
+#define CLING_SIZE_T "m"
+#else
+#define CLING_SIZE_T "j"
+#endif
+    static const char* const kNames[kNumAllocationFunctions] = {
+      "malloc",
+      "calloc",
+      "realloc",
+      "free",
+      "_Znw" CLING_SIZE_T,
+      "_Zna" CLING_SIZE_T,
+      "_Znw" CLING_SIZE_T "RKSt9nothrow_t",
+      "_Zna" CLING_SIZE_T "RKSt9nothrow_t",
+      "_ZdlPv",
+      "_ZdaPv",
+      "_ZdlPv" CLING_SIZE_T,
+      "_ZdaPv" CLING_SIZE_T
+    };
+#undef CLING_SIZE_T
+    for (unsigned I = 0; I < kNumAllocationFunctions; ++I)
+      if (Name == kNames[I])
+        return AllocationFunction(I);
+#endif
+    return kNumAllocationFunctions;
+  }
+} // namespace cling
+
+#endif // CLING_ALLOCATION_FUNCTIONS_H
@@ -35,6 +35,7 @@ namespace cling {
 
     virtual ~AutoSynthesizer();
 
+    const char* getName() const override { return "AutoSynthesizer"; }
     Result Transform(clang::Decl*) override;
   };
 
@@ -9,13 +9,20 @@
 
 #include "BackendPasses.h"
 
+#include "JITProfile.h"
+
 #include "llvm/Analysis/InlineCost.h"
+#include "llvm/IR/DiagnosticInfo.h"
+#include "llvm/IR/DiagnosticPrinter.h"
+#include "llvm/IR/LLVMContext.h"
 #include "llvm/IR/LegacyPassManager.h"
 #include "llvm/IR/Module.h"
 #include "llvm/IR/Verifier.h"
+#include "llvm/Support/raw_ostream.h"
 #include "llvm/Transforms/IPO.h"
 #include "llvm/Transforms/IPO/InlinerPass.h"
 #include "llvm/Transforms/IPO/PassManagerBuilder.h"
+#include "llvm/Transforms/Instrumentation.h"
 
 #include "clang/Basic/LangOptions.h"
 #include "clang/Basic/TargetOptions.h"
@@ -62,6 +69,67 @@ namespace {
       return false;
     }
   };
+
+  ///\brief Presents a module to the PGO passes under names that do not
+  /// depend on the order of the inputs, restoring the names afterwards.
+  ///
+  class StableProfileNamesRAII {
+    Module& m_Module;
+    std::string m_ModuleID;
+    std::string m_SourceFileName;
+    std::vector<std::pair<Function*, std::string>> m_Renamed;
+    LLVMContext::DiagnosticHandlerTy m_OldHandler;
+    void* m_OldContext;
+
+    ///\brief Drops the PGO passes' complaints about functions missing from
+    /// the profile or changed since: new inputs are the normal case here.
+    ///
+    static void handleDiagnostic(const DiagnosticInfo& DI, void* Context) {
+      const StableProfileNamesRAII* This
+        = static_cast<const StableProfileNamesRAII*>(Context);
+      if (DI.getKind() == DK_PGOProfile && DI.getSeverity() != DS_Error)
+        return;
+      if (This->m_OldHandler) {
+        This->m_OldHandler(DI, This->m_OldContext);
+        return;
+      }
+      DiagnosticPrinterRawOStream DP(errs());
+      errs() << LLVMContext::getDiagnosticMessagePrefix(DI.getSeverity())
+             << ": ";
+      DI.print(DP);
+      errs() << '\n';
+    }
+
+  public:
+    StableProfileNamesRAII(Module& M):
+      m_Module(M), m_ModuleID(M.getModuleIdentifier()),
+      m_SourceFileName(M.getSourceFileName()) {
+      // Names of local functions are qualified by the module's.
+      M.setModuleIdentifier("cling");
+      M.setSourceFileName("cling");
+      for (Function& F: M) {
+        if (F.isDeclaration())
+          continue;
+        std::string Stable = cling::JITProfile::getStableName(F);
+        if (Stable != F.getName()) {
+          m_Renamed.push_back(std::make_pair(&F, F.getName().str()));
+          F.setName(Stable);
+        }
+      }
+      LLVMContext& Ctx = M.getContext();
+      m_OldHandler = Ctx.getDiagnosticHandler();
+      m_OldContext = Ctx.getDiagnosticContext();
+      Ctx.setDiagnosticHandler(handleDiagnostic, this);
+    }
+
+    ~StableProfileNamesRAII() {
+      m_Module.getContext().setDiagnosticHandler(m_OldHandler, m_OldContext);
+      for (auto&& R: m_Renamed)
+        R.first->setName(R.second);
+      m_Module.setModuleIdentifier(m_ModuleID);
+      m_Module.setSourceFileName(m_SourceFileName);
+    }
+  };
 } // end anonymous namespace
 
 // Pass registration. Luckily all known inliners depend on the same set
@@ -71,8 +139,9 @@ char InlinerKeepDeadFunc::ID = 0;
 
 BackendPasses::BackendPasses(const CodeGenOptions &CGOpts,
                              const clang::TargetOptions &TOpts,
-                             const LangOptions &LOpts):
-  m_CodeGenOptsVerifyModule(CGOpts.VerifyModule)
+                             const LangOptions &LOpts,
+                             JITProfile* Profile /*= 0*/):
+  m_Profile(Profile), m_CodeGenOptsVerifyModule(CGOpts.VerifyModule)
 {
   CreatePasses(CGOpts, TOpts, LOpts);
 }
@@ -149,9 +218,28 @@ void BackendPasses::CreatePasses(const CodeGenOptions &CGOpts,
   //  addSymbolRewriterPass(CGOpts, m_MPM);
 
   m_PMBuilder->populateModulePassManager(*m_MPM);
+
+  // PassManagerBuilder only adds the PGO passes above -O0. The annotations of
+  // a profile still steer the inliner and the code generator's block layout.
+  if (m_Profile) {
+    m_PGOPasses.reset(new legacy::PassManager());
+    if (m_Profile->isGenerating())
+      m_PGOPasses->add(createPGOInstrumentationGenLegacyPass());
+    if (!m_Profile->getUseFile().empty())
+      m_PGOPasses->add(
+             createPGOInstrumentationUseLegacyPass(m_Profile->getUseFile()));
+  }
 }
 
 void BackendPasses::runOnModule(Module& M) {
+  if (m_PGOPasses) {
+    {
+      StableProfileNamesRAII StableNames(M);
+      m_PGOPasses->run(M);
+    }
+    if (m_Profile->isGenerating())
+      m_Profile->lowerCounters(M);
+  }
 
   // Set up the per-function pass manager.
   legacy::FunctionPassManager FPM(&M);
@@ -28,11 +28,20 @@ namespace clang{
 }
 
 namespace cling {
+  class JITProfile;
+
   ///\brief Runs passes on IR. Remove once we can migrate from ModuleBuilder to
   /// what's in clang's CodeGen/BackendUtil.
   class BackendPasses {
     std::unique_ptr<llvm::legacy::PassManager> m_MPM;
     std::unique_ptr<llvm::PassManagerBuilder> m_PMBuilder;
+
+    ///\brief Instruments or annotates the modules for m_Profile; runs
+    /// before anything else.
+    ///
+    std::unique_ptr<llvm::legacy::PassManager> m_PGOPasses;
+
+    JITProfile* m_Profile;
     bool m_CodeGenOptsVerifyModule;
 
     void CreatePasses(const clang::CodeGenOptions &CGOpts,
@@ -40,9 +49,13 @@ namespace cling {
                       const clang::LangOptions &LOpts);
 
   public:
+    ///\param [in] Profile - If set, the modules are instrumented for it or
+    ///   optimized with the profile it reads.
+    ///
     BackendPasses(const clang::CodeGenOptions &CGOpts,
                   const clang::TargetOptions &TOpts,
-                  const clang::LangOptions &LOpts);
+                  const clang::LangOptions &LOpts,
+                  JITProfile* Profile = 0);
     ~BackendPasses();
 
     void runOnModule(llvm::Module& M);
@@ -9,10 +9,12 @@
 
 #include "ClingUtils.h"
 #include "DeclCollector.h"
+#include "EmbeddedHeaders.h"
 #include "cling-compiledata.h"
 
 #include "cling/Interpreter/CIFactory.h"
 #include "cling/Interpreter/InvocationOptions.h"
+#include "cling/Interpreter/StartupProfile.h"
 #include "cling/Utils/Paths.h"
 #include "cling/Utils/Platform.h"
 
@@ -292,7 +294,12 @@ namespace {
 
 #endif // _MSC_VER
 
-      if (!opts.ResourceDir && !opts.NoBuiltinInc) {
+      if (!opts.ResourceDir && !opts.NoBuiltinInc
+          && EmbeddedHeaders::isAvailable()) {
+        // The resource headers are compiled in; see createCIImpl().
+        sArguments.addArgument("-resource-dir",
+                               EmbeddedHeaders::getResourceDir());
+      } else if (!opts.ResourceDir && !opts.NoBuiltinInc) {
         std::string resourcePath;
         if (!llvmdir) {
           // FIXME: The first arg really does need to be argv[0] on FreeBSD.
@@ -513,6 +520,13 @@ namespace {
                                      clang::HeaderSearchOptions& HOpts) {
     if (HOpts.Verbose)
       llvm::errs() << "Adding runtime include paths:\n";
+    // The compiled-in headers come first, so they win over stale copies
+    // on disk.
+    if (EmbeddedHeaders::isAvailable()) {
+      if (HOpts.Verbose)
+        llvm::errs() << "  \"" << EmbeddedHeaders::getIncludeDir() << "\"\n";
+      utils::AddIncludePaths(EmbeddedHeaders::getIncludeDir(), HOpts, nullptr);
+    }
     // Add configuration paths to interpreter's include files.
 #ifdef CLING_INCLUDE_PATHS
     if (HOpts.Verbose)
@@ -537,6 +551,8 @@ namespace {
   createCIImpl(std::unique_ptr<llvm::MemoryBuffer> Buffer,
                const CompilerOptions& COpts, const char* LLVMDir,
                bool OnlyLex) {
+    StartupProfile::Phase CIPhase("createCI");
+
     // Follow clang -v convention of printing version on first line
     if (COpts.Verbose)
       llvm::errs() << "cling version " << ClingStringify(CLING_VERSION) << '\n';
@@ -566,7 +582,10 @@ namespace {
 
     // Add host specific includes, -resource-dir if necessary, and -isysroot
     std::string ClingBin = GetExecutablePath(argv[0]);
-    AddHostArguments(ClingBin, argvCompile, LLVMDir, COpts);
+    {
+      StartupProfile::Phase P("AddHostArguments");
+      AddHostArguments(ClingBin, argvCompile, LLVMDir, COpts);
+    }
 
     // Be explicit about the stdlib on OS X
     // Would be nice on Linux but will warn 'argument unused during compilation'
@@ -595,23 +614,27 @@ namespace {
     llvm::IntrusiveRefCntPtr<DiagnosticsEngine>
       Diags(new DiagnosticsEngine(DiagIDs, &DiagOpts,
                                   DiagnosticPrinter, /*Owns it*/ true));
-    clang::driver::Driver Driver(argv[0], llvm::sys::getDefaultTargetTriple(),
-                                 *Diags);
-    //Driver.setWarnMissingInput(false);
-    Driver.setCheckInputsExist(false); // think foo.C(12)
-    llvm::ArrayRef<const char*>RF(&(argvCompile[0]), argvCompile.size());
-    std::unique_ptr<clang::driver::Compilation>
-      Compilation(Driver.BuildCompilation(RF));
-    const clang::driver::ArgStringList* CC1Args
-      = GetCC1Arguments(Diags.get(), Compilation.get());
-    if (CC1Args == NULL) {
-      delete Invocation;
-      return 0;
-    }
+    {
+      StartupProfile::Phase P("BuildCompilation");
+      clang::driver::Driver Driver(argv[0], llvm::sys::getDefaultTargetTriple(),
+                                   *Diags);
+      //Driver.setWarnMissingInput(false);
+      Driver.setCheckInputsExist(false); // think foo.C(12)
+      llvm::ArrayRef<const char*>RF(&(argvCompile[0]), argvCompile.size());
+      std::unique_ptr<clang::driver::Compilation>
+        Compilation(Driver.BuildCompilation(RF));
+      const clang::driver::ArgStringList* CC1Args
+        = GetCC1Arguments(Diags.get(), Compilation.get());
+      if (CC1Args == NULL) {
+        delete Invocation;
+        return 0;
+      }
 
-    clang::CompilerInvocation::CreateFromArgs(*Invocation, CC1Args->data() + 1,
-                                              CC1Args->data() + CC1Args->size(),
-                                              *Diags);
+      clang::CompilerInvocation::CreateFromArgs(*Invocation,
+                                                CC1Args->data() + 1,
+                                                CC1Args->data() + CC1Args->size(),
+                                                *Diags);
+    }
     // We appreciate the error message about an unknown flag (or do we? if not
     // we should switch to a different DiagEngine for parsing the flags).
     // But in general we'll happily go on.
@@ -619,7 +642,13 @@ namespace {
 
     // Create and setup a compiler instance.
     std::unique_ptr<CompilerInstance> CI(new CompilerInstance());
+    // Serve the compiled-in runtime headers from memory, in front of the disk.
+    if (EmbeddedHeaders::isAvailable())
+      CI->setVirtualFileSystem(
+                 EmbeddedHeaders::createOverlay(vfs::getRealFileSystem()));
     CI->createFileManager();
+    if (StartupProfile::getActive())
+      CI->getFileManager().addStatCache(StartupProfile::createStatCounter());
 
     llvm::StringRef PCHFileName
       = Invocation->getPreprocessorOpts().ImplicitPCHInclude;
@@ -653,6 +682,7 @@ namespace {
           return true;
         }
       };
+      StartupProfile::Phase P("ReadPCHOptions");
       PCHListener listener(*Invocation);
       ASTReader::readASTFileControlBlock(PCHFileName,
                                          CI->getFileManager(),
@@ -23,6 +23,9 @@ namespace cling {
   public:
     CheckEmptyTransactionTransformer(clang::Sema* S)
       : WrapperTransformer(S) { }
+    const char* getName() const override {
+      return "CheckEmptyTransactionTransformer";
+    }
     Result Transform(clang::Decl* D) override;
   };
 } // end namespace cling
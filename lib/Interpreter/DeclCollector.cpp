@@ -10,8 +10,10 @@
 #include "DeclCollector.h"
 
 #include "IncrementalParser.h"
+#include "LazyCodeGen.h"
 #include "cling/Interpreter/Transaction.h"
 #include "cling/Utils/AST.h"
+#include "cling/Utils/Trace.h"
 
 #include "clang/AST/ASTContext.h"
 #include "clang/AST/Decl.h"
@@ -70,6 +72,10 @@ namespace cling {
     return comesFromASTReader(DeclGroupRef(const_cast<Decl*>(D)));
   }
 
+  bool DeclCollector::deferCodeGen(const Decl* D) const {
+    return m_LazyCodeGen && m_LazyCodeGen->defer(D);
+  }
+
   // pin the vtable here.
   DeclCollector::~DeclCollector() { }
 
@@ -87,6 +93,9 @@ namespace cling {
     // We are sure it's safe to pipe it through the transformers
     // Consume late transformers init
     for (size_t i = 0; D && i < m_TransactionTransformers.size(); ++i) {
+      utils::Trace::Span S("ASTTransformer", "transformer",
+                           m_TransactionTransformers[i]->getName());
+      S.setTransactionID(m_CurTransaction->getUniqueID());
       ASTTransformer::Result NewDecl
         = m_TransactionTransformers[i]->Transform(D, m_CurTransaction);
       if (!NewDecl.getInt()) {
@@ -98,6 +107,9 @@ namespace cling {
     if (FunctionDecl* FD = dyn_cast_or_null<FunctionDecl>(D)) {
       if (utils::Analyze::IsWrapper(FD)) {
         for (size_t i = 0; D && i < m_WrapperTransformers.size(); ++i) {
+          utils::Trace::Span S("WrapperTransformer", "transformer",
+                               m_WrapperTransformers[i]->getName());
+          S.setTransactionID(m_CurTransaction->getUniqueID());
           ASTTransformer::Result NewDecl
            = m_WrapperTransformers[i]->Transform(D, m_CurTransaction);
           if (!NewDecl.getInt()) {
@@ -171,10 +183,10 @@ namespace cling {
                EN = ND->decls_end(); NDI != EN; ++NDI) {
             // Recurse over decls inside the namespace, like
             // CodeGenModule::EmitNamespace() does.
-            if (!shouldIgnore(*NDI))
+            if (!shouldIgnore(*NDI) && !deferCodeGen(*NDI))
               m_Consumer->HandleTopLevelDecl(DeclGroupRef(*NDI));
           }
-        } else if (!shouldIgnore(*DI)) {
+        } else if (!shouldIgnore(*DI) && !deferCodeGen(*DI)) {
           m_Consumer->HandleTopLevelDecl(DeclGroupRef(*DI));
         }
         continue;
@@ -190,7 +202,8 @@ namespace cling {
     Transaction::DelayCallInfo DCI(DGR, Transaction::kCCIHandleInterestingDecl);
     m_CurTransaction->append(DCI);
     if (m_Consumer
-        && (!comesFromASTReader(DGR) || !shouldIgnore(*DGR.begin())))
+        && (!comesFromASTReader(DGR)
+            || (!shouldIgnore(*DGR.begin()) && !deferCodeGen(*DGR.begin()))))
       m_Consumer->HandleTopLevelDecl(DGR);
   }
 
@@ -260,7 +273,7 @@ namespace cling {
     m_CurTransaction->append(DCI);
     if (m_Consumer
         && (!comesFromASTReader(DeclGroupRef(D))
-            || !shouldIgnore(D)))
+            || (!shouldIgnore(D) && !deferCodeGen(D))))
     m_Consumer->HandleCXXImplicitFunctionInstantiation(D);
   }
 
@@ -33,6 +33,7 @@ namespace cling {
   class WrapperTransformer;
   class DeclCollector;
   class IncrementalParser;
+  class LazyCodeGen;
   class Transaction;
 
   ///\brief Serves as DeclCollector's connector to the PPCallbacks interface.
@@ -75,6 +76,15 @@ namespace cling {
     /// Whether Transform() is active; prevents recursion.
     bool m_Transforming = false;
 
+    ///\brief Keeps deserialized inline functions back from CodeGen, if set.
+    ///
+    LazyCodeGen* m_LazyCodeGen = nullptr;
+
+    ///\brief Whether a decl coming from an AST file is kept back from
+    /// CodeGen, see LazyCodeGen.
+    ///
+    bool deferCodeGen(const clang::Decl* D) const;
+
     ///\brief Test whether the first decl of the DeclGroupRef comes from an AST
     /// file.
     ///
@@ -115,6 +125,8 @@ namespace cling {
       m_Consumer = Consumer;
     }
 
+    void setLazyCodeGen(LazyCodeGen* LCG) { m_LazyCodeGen = LCG; }
+
     /// \name PPCallbacks overrides
     /// Macro support
     void MacroDefined(const clang::Token &MacroNameTok,
@@ -41,6 +41,8 @@ namespace cling {
 
     virtual ~DeclExtractor();
 
+    const char* getName() const override { return "DeclExtractor"; }
+
     ///\brief Scans the wrapper for declarations and extracts them onto the
     /// global scope.
     ///
@@ -730,8 +730,14 @@ bool DeclUnloader::VisitRedeclarable(clang::Redeclarable<T>* R, DeclContext* DC)
   }
 
   void DeclUnloader::MaybeRemoveDeclFromModule(GlobalDecl& GD) const {
-    if (!m_CurTransaction
-        || !m_CurTransaction->getModule()) // syntax-only mode exit
+    // Without a transaction the module stays as it is; CodeGen still forgets
+    // the declaration.
+    if (!m_CurTransaction) {
+      if (m_CodeGen)
+        m_CodeGen->forgetDecl(GD);
+      return;
+    }
+    if (!m_CurTransaction->getModule()) // syntax-only mode exit
       return;
 
     using namespace llvm;
@@ -8,10 +8,13 @@
 //------------------------------------------------------------------------------
 
 #include "cling/Interpreter/DynamicLibraryManager.h"
+#include "ExecutorProcess.h"
+#include "StatCache.h"
 #include "cling/Interpreter/InterpreterCallbacks.h"
 #include "cling/Interpreter/InvocationOptions.h"
 #include "cling/Utils/Paths.h"
 #include "cling/Utils/Platform.h"
+#include "cling/Utils/Trace.h"
 
 #include "llvm/Support/DynamicLibrary.h"
 #include "llvm/Support/FileSystem.h"
@@ -23,7 +26,8 @@
 
 namespace cling {
   DynamicLibraryManager::DynamicLibraryManager(const InvocationOptions& Opts)
-    : m_Opts(Opts), m_Callbacks(0) {
+    : m_Opts(Opts), m_Callbacks(0), m_StatCache(0),
+      m_ExecutorProcess(0) {
     const llvm::SmallVector<const char*, 10> kSysLibraryEnv = {
       "LD_LIBRARY_PATH",
   #if __APPLE__
@@ -100,11 +104,16 @@ namespace cling {
            IPath = Paths.begin(), E = Paths.end();IPath != E; ++IPath) {
       llvm::SmallString<512> ThisPath(*IPath); // FIXME: move alloc outside loop
       llvm::sys::path::append(ThisPath, libStem);
+      if (m_StatCache && m_StatCache->isKnownMissing(ThisPath))
+        continue;
       bool exists;
       if (isSharedLib(ThisPath.str(), &exists))
         return ThisPath.str();
       if (exists)
         return "";
+      // Unreadable is not missing.
+      if (m_StatCache && !llvm::sys::fs::exists(ThisPath.str()))
+        m_StatCache->noteMissing(ThisPath);
     }
     return "";
   }
@@ -194,6 +203,7 @@ namespace cling {
   DynamicLibraryManager::LoadLibResult
   DynamicLibraryManager::loadLibrary(const std::string& libStem,
                                      bool permanent, bool resolved) {
+    utils::Trace::Span S("loadLibrary", "library", libStem);
     std::string       lResolved;
     const std::string &canonicalLoadedLib = resolved ? libStem : lResolved;
     if (!resolved) {
@@ -217,6 +227,10 @@ namespace cling {
     else if (InterpreterCallbacks* C = getCallbacks())
       C->LibraryLoaded(dyLibHandle, canonicalLoadedLib);
 
+    // The JITted code links against the executor's copy of the library.
+    if (m_ExecutorProcess)
+      m_ExecutorProcess->loadLibrary(canonicalLoadedLib);
+
     std::pair<DyLibs::iterator, bool> insRes
       = m_DyLibs.insert(std::pair<DyLibHandle, std::string>(dyLibHandle,
                                                             canonicalLoadedLib));
@@ -249,6 +263,9 @@ namespace cling {
                    << errMsg << '\n';
     }
 
+    if (m_ExecutorProcess)
+      m_ExecutorProcess->unloadLibrary(canonicalLoadedLib);
+
     if (InterpreterCallbacks* C = getCallbacks())
       C->LibraryUnloaded(dyLibHandle, canonicalLoadedLib);
 
@@ -179,6 +179,7 @@ namespace cling {
 
     ~EvaluateTSynthesizer();
 
+    const char* getName() const override { return "EvaluateTSynthesizer"; }
     Result Transform(clang::Decl* D) override;
 
     MapTy& getSubstSymbolMap() { return m_SubstSymbolMap; }
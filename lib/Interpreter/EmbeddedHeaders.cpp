@@ -0,0 +1,121 @@
+//------------------------------------------------------------------------------
+// CLING - the C++ LLVM-based InterpreterG :)
+//
+// This file is dual-licensed: you can choose to license it under the University
+// of Illinois Open Source License or the GNU Lesser General Public License. See
+// LICENSE.TXT for details.
+//------------------------------------------------------------------------------
+
+#include "EmbeddedHeaders.h"
+
+#include "llvm/ADT/SmallString.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/ADT/StringRef.h"
+#include "llvm/Support/Compression.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/Path.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include <tuple>
+
+#ifdef CLING_EMBED_RUNTIME_HEADERS
+// Defines EmbeddedHeadersBlob, EmbeddedHeadersBlobSize,
+// EmbeddedHeadersExpandedSize and EmbeddedHeadersCompressed; written by
+// embed-headers.py.
+#include "cling-embedded-headers.inc"
+#endif
+
+using namespace clang;
+
+#define CLING_EMBEDDED_ROOT "/__cling_embedded__"
+
+#ifdef CLING_EMBED_RUNTIME_HEADERS
+namespace {
+  // Record layout of the (uncompressed) blob, repeated until its end:
+  //   <relative path> '\0' <decimal size> '\0' <contents> '\0'
+  // The trailing '\0' lets the contents be handed out as null terminated
+  // memory buffers without copying them.
+
+  ///\brief Returns the uncompressed blob; empty if it cannot be expanded.
+  ///
+  static llvm::StringRef getBlob() {
+    llvm::StringRef Raw(reinterpret_cast<const char*>(EmbeddedHeadersBlob),
+                        EmbeddedHeadersBlobSize);
+    if (!EmbeddedHeadersCompressed)
+      return Raw;
+
+    // Expanded once and kept for the lifetime of the process: the memory
+    // buffers of the in-memory file system point into it.
+    static const llvm::SmallVector<char, 0>* Expanded = [Raw]() {
+      auto* Buf = new llvm::SmallVector<char, 0>();
+      if (!llvm::zlib::isAvailable()
+          || llvm::zlib::uncompress(Raw, *Buf, EmbeddedHeadersExpandedSize)
+             != llvm::zlib::StatusOK) {
+        llvm::errs() << "cling::EmbeddedHeaders: cannot expand the embedded"
+                        " headers; falling back to the file system.\n";
+        Buf->clear();
+      }
+      return Buf;
+    }();
+    return llvm::StringRef(Expanded->data(), Expanded->size());
+  }
+} // unnamed namespace
+#endif
+
+namespace cling {
+
+  bool EmbeddedHeaders::isAvailable() {
+#ifdef CLING_EMBED_RUNTIME_HEADERS
+    return !getBlob().empty();
+#else
+    return false;
+#endif
+  }
+
+  const char* EmbeddedHeaders::getIncludeDir() {
+    return CLING_EMBEDDED_ROOT "/include";
+  }
+
+  const char* EmbeddedHeaders::getResourceDir() {
+    return CLING_EMBEDDED_ROOT "/resource";
+  }
+
+  llvm::IntrusiveRefCntPtr<vfs::FileSystem>
+  EmbeddedHeaders::createOverlay(llvm::IntrusiveRefCntPtr<vfs::FileSystem>
+                                 Base) {
+#ifdef CLING_EMBED_RUNTIME_HEADERS
+    llvm::StringRef Blob = getBlob();
+    if (Blob.empty())
+      return Base;
+
+    llvm::IntrusiveRefCntPtr<vfs::InMemoryFileSystem>
+      Mem(new vfs::InMemoryFileSystem());
+    llvm::SmallString<256> Path;
+    while (!Blob.empty()) {
+      llvm::StringRef Name, Size;
+      std::tie(Name, Blob) = Blob.split('\0');
+      std::tie(Size, Blob) = Blob.split('\0');
+      size_t Len;
+      if (Name.empty() || Size.getAsInteger(10, Len) || Blob.size() <= Len) {
+        llvm::errs() << "cling::EmbeddedHeaders: malformed record for '"
+                     << Name << "'; falling back to the file system.\n";
+        return Base;
+      }
+      Path = CLING_EMBEDDED_ROOT;
+      llvm::sys::path::append(Path, Name);
+      Mem->addFile(Path, /*ModificationTime*/ 0,
+                   llvm::MemoryBuffer::getMemBuffer(Blob.substr(0, Len), Path,
+                                                 /*RequiresNullTerminator*/
+                                                 true));
+      Blob = Blob.drop_front(Len + 1);
+    }
+
+    llvm::IntrusiveRefCntPtr<vfs::OverlayFileSystem>
+      Overlay(new vfs::OverlayFileSystem(Base));
+    Overlay->pushOverlay(Mem);
+    return Overlay;
+#else
+    return Base;
+#endif
+  }
+} // namespace cling
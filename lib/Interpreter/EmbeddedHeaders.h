@@ -0,0 +1,48 @@
+//--------------------------------------------------------------------*- C++ -*-
+// CLING - the C++ LLVM-based InterpreterG :)
+//
+// This file is dual-licensed: you can choose to license it under the University
+// of Illinois Open Source License or the GNU Lesser General Public License. See
+// LICENSE.TXT for details.
+//------------------------------------------------------------------------------
+
+#ifndef CLING_EMBEDDED_HEADERS_H
+#define CLING_EMBEDDED_HEADERS_H
+
+#include "clang/Basic/VirtualFileSystem.h"
+
+#include "llvm/ADT/IntrusiveRefCntPtr.h"
+
+namespace cling {
+
+  ///\brief cling's runtime headers and clang's resource headers, compiled into
+  /// the library when it is configured with CLING_EMBED_RUNTIME_HEADERS.
+  ///
+  /// The headers are served from an in-memory file system mounted in front of
+  /// the real one, so starting the interpreter reads none of them from disk
+  /// and an installation does not need to ship them next to the binary.
+  ///
+  class EmbeddedHeaders {
+  public:
+    ///\brief Whether this build carries the embedded headers.
+    ///
+    static bool isAvailable();
+
+    ///\brief The virtual directory holding cling's include/ tree.
+    ///
+    static const char* getIncludeDir();
+
+    ///\brief The virtual directory to use as clang's -resource-dir.
+    ///
+    static const char* getResourceDir();
+
+    ///\brief Mounts the embedded headers in front of Base.
+    ///
+    ///\returns the overlay, or Base if the headers are not embedded.
+    ///
+    static llvm::IntrusiveRefCntPtr<clang::vfs::FileSystem>
+    createOverlay(llvm::IntrusiveRefCntPtr<clang::vfs::FileSystem> Base);
+  };
+} // namespace cling
+
+#endif // CLING_EMBEDDED_HEADERS_H
@@ -0,0 +1,871 @@
+//------------------------------------------------------------------------------
+// CLING - the C++ LLVM-based InterpreterG :)
+//
+// This file is dual-licensed: you can choose to license it under the University
+// of Illinois Open Source License or the GNU Lesser General Public License. See
+// LICENSE.TXT for details.
+//------------------------------------------------------------------------------
+
+#include "ExecutorProcess.h"
+
+#include "IncrementalExecutor.h"
+
+#include "cling/Interpreter/Value.h"
+#include "cling/Utils/Platform.h"
+
+#include "clang/AST/Type.h"
+
+#include "llvm/ExecutionEngine/RTDyldMemoryManager.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <new>
+
+#ifdef __linux__
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/prctl.h>
+#include <sys/syscall.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+using namespace cling;
+
+namespace {
+  enum RequestKind {
+    kCall,
+    kInit,
+    kLookup,
+    kLoadLibrary,
+    kUnloadLibrary,
+    kRegisterEHFrames,
+    kDeregisterEHFrames,
+    kRunDestructors,
+    kCallForString,
+    kShutdown,
+    kReply
+  };
+
+  ///\brief Header of a message in a Ring; Size bytes of payload follow.
+  ///
+  struct Message {
+    uint32_t Kind;
+    uint32_t Size;
+    uint64_t Arg0;
+    uint64_t Arg1;
+  };
+
+  ///\brief A single-producer, single-consumer byte ring in shared memory.
+  ///
+  struct Ring {
+    enum { kSize = 1 << 16 };
+    enum { kMaxPayload = kSize - sizeof(Message) };
+
+    ///\brief Bytes consumed so far; only the consumer writes it.
+    std::atomic<uint64_t> Head;
+    ///\brief Bytes produced so far; only the producer writes it.
+    std::atomic<uint64_t> Tail;
+    ///\brief Set while the consumer sleeps on the doorbell.
+    std::atomic<uint32_t> Sleeping;
+    char Data[kSize];
+
+    void reset() {
+      Head = 0;
+      Tail = 0;
+      Sleeping = 0;
+    }
+
+    bool empty() const {
+      return Head.load(std::memory_order_acquire)
+        == Tail.load(std::memory_order_acquire);
+    }
+
+    static size_t padded(size_t N) { return (N + 7) & ~size_t(7); }
+
+    void copyIn(uint64_t Pos, const char* From, size_t N) {
+      for (size_t Done = 0; Done < N;) {
+        size_t Offset = (Pos + Done) % kSize;
+        size_t Chunk = std::min(N - Done, size_t(kSize) - Offset);
+        ::memcpy(Data + Offset, From + Done, Chunk);
+        Done += Chunk;
+      }
+    }
+
+    void copyOut(uint64_t Pos, char* To, size_t N) const {
+      for (size_t Done = 0; Done < N;) {
+        size_t Offset = (Pos + Done) % kSize;
+        size_t Chunk = std::min(N - Done, size_t(kSize) - Offset);
+        ::memcpy(To + Done, Data + Offset, Chunk);
+        Done += Chunk;
+      }
+    }
+
+    ///\brief Appends a message.
+    ///
+    void push(Message M, llvm::StringRef Payload) {
+      M.Size = Payload.size();
+      const size_t Total = padded(sizeof(Message) + Payload.size());
+      assert(Total <= kSize && "Message does not fit into the ring!");
+      const uint64_t T = Tail.load(std::memory_order_relaxed);
+      // Requests and replies alternate, so this does not spin in practice.
+      while (T + Total - Head.load(std::memory_order_acquire) > kSize)
+        ;
+      copyIn(T, reinterpret_cast<const char*>(&M), sizeof(Message));
+      copyIn(T + sizeof(Message), Payload.data(), Payload.size());
+      // Sequentially consistent: pairs with the consumer's Sleeping flag.
+      Tail.store(T + Total);
+    }
+
+    ///\brief Removes the next message; the ring must not be empty.
+    ///
+    void pop(Message& M, std::string& Payload) {
+      const uint64_t H = Head.load(std::memory_order_relaxed);
+      copyOut(H, reinterpret_cast<char*>(&M), sizeof(Message));
+      Payload.resize(M.Size);
+      if (M.Size)
+        copyOut(H + sizeof(Message), &Payload[0], M.Size);
+      Head.store(H + padded(sizeof(Message) + M.Size),
+                 std::memory_order_release);
+    }
+  };
+
+  ///\brief How long a receiver polls its ring before it sleeps.
+  ///
+  static const std::chrono::microseconds kSpinTime(50);
+
+  ///\brief Size of the address range reserved for JITted sections; pages are
+  /// only backed once they are used.
+  ///
+  static const size_t kArenaSize
+    = sizeof(void*) == 8 ? size_t(1) << 32 : size_t(1) << 28;
+
+  ///\brief In the executor: where the interpreter looks for dump requests.
+  ///
+  static std::atomic<uint32_t>* s_DumpRequested = 0;
+
+  static void flushOutput() {
+    ::fflush(0);
+    llvm::outs().flush();
+    llvm::errs().flush();
+  }
+
+  ///\brief Whether the interpreter can use a Value produced by the executor.
+  ///
+  /// Values with managed storage point into the executor's heap. Printing
+  /// dereferences references and character pointers, and only the arena is
+  /// visible to both processes.
+  ///
+  static bool canTransfer(const Value& V, const char* Arena) {
+    if (V.needsManagedAllocation())
+      return false;
+    clang::QualType QT = V.getType();
+    if (QT->isReferenceType()
+        || (QT->isPointerType() && QT->getPointeeType()->isAnyCharacterType())) {
+      const char* P = static_cast<const char*>(V.getPtr());
+      return !P || (P >= Arena && P < Arena + kArenaSize);
+    }
+    return true;
+  }
+} // unnamed namespace
+
+bool ExecutorProcess::s_IsExecutor = false;
+
+///\brief The memory both processes communicate through.
+///
+struct ExecutorProcess::Shared {
+  Ring ToExecutor;
+  Ring FromExecutor;
+
+  ///\brief The statement asked for its Value to be printed.
+  std::atomic<uint32_t> DumpRequested;
+
+  ///\brief Where wrappers run by the executor store their Value.
+  alignas(Value) char ValueSlot[sizeof(Value)];
+};
+
+Value* ExecutorProcess::getValueSlot() const {
+  return reinterpret_cast<Value*>(m_Shared->ValueSlot);
+}
+
+bool ExecutorProcess::deferDump() {
+  if (!s_DumpRequested)
+    return false;
+  s_DumpRequested->store(1);
+  return true;
+}
+
+#ifdef __linux__
+
+namespace {
+  static void ringDoorbell(Ring& R, int Bell) {
+    if (R.Sleeping.load()) {
+      uint64_t One = 1;
+      ssize_t Ret = ::write(Bell, &One, sizeof(One));
+      (void)Ret;
+    }
+  }
+
+  ///\brief Waits until R holds a message.
+  ///
+  ///\param [in] Lifeline - Hangs up if the sender dies; -1 to wait forever.
+  ///\returns false if Lifeline hung up first.
+  ///
+  static bool waitForMessage(Ring& R, int Bell, int Lifeline) {
+    // Spinning keeps the round trip in the microseconds for back to back
+    // requests; going through the scheduler costs much more.
+    auto Deadline = std::chrono::steady_clock::now() + kSpinTime;
+    do {
+      for (unsigned I = 0; I < 64; ++I)
+        if (!R.empty())
+          return true;
+    } while (std::chrono::steady_clock::now() < Deadline);
+
+    while (true) {
+      R.Sleeping.store(1);
+      if (!R.empty()) {
+        R.Sleeping.store(0);
+        return true;
+      }
+      pollfd Fds[2] = {{Bell, POLLIN, 0}, {Lifeline, POLLIN, 0}};
+      int Ret = ::poll(Fds, Lifeline < 0 ? 1 : 2, -1);
+      R.Sleeping.store(0);
+      if (Ret < 0 && errno != EINTR)
+        return false;
+      if (Ret > 0 && (Fds[0].revents & POLLIN)) {
+        uint64_t Count;
+        ssize_t Read = ::read(Bell, &Count, sizeof(Count));
+        (void)Read;
+      }
+      if (!R.empty())
+        return true;
+      if (Ret > 0 && Lifeline >= 0 && Fds[1].revents)
+        return false;
+    }
+  }
+
+  static void drainDoorbell(int Bell) {
+    uint64_t Count;
+    while (::read(Bell, &Count, sizeof(Count)) > 0)
+      ;
+  }
+
+  ///\brief Creates an unnamed file in memory of the given size.
+  ///
+  ///\returns its descriptor, or -1.
+  ///
+  static int createMemoryFile(size_t Size) {
+    int Fd = -1;
+#ifdef SYS_memfd_create
+    Fd = ::syscall(SYS_memfd_create, "cling-jit", 1 /*MFD_CLOEXEC*/);
+#endif
+    if (Fd < 0) {
+      char Name[] = "/dev/shm/cling-jit-XXXXXX";
+      Fd = ::mkostemp(Name, O_CLOEXEC);
+      if (Fd >= 0)
+        ::unlink(Name);
+    }
+    if (Fd >= 0 && ::ftruncate(Fd, Size)) {
+      ::close(Fd);
+      Fd = -1;
+    }
+    return Fd;
+  }
+} // unnamed namespace
+
+///\brief The pages of the arena written since saveSections(), and their
+/// content before.
+///
+struct ExecutorProcess::DirtyPages {
+  ///\brief The tracked, initially read-only, part of the arena.
+  char* Begin;
+  char* End;
+  ///\brief Receives the content of a page before its first write, at the
+  /// page's offset from Begin; only the pages copied to are backed.
+  char* Backup;
+  ///\brief The offsets of the written pages, with room for all of them.
+  std::unique_ptr<size_t[]> Offsets;
+  size_t Capacity;
+  size_t NumDirty;
+  size_t PageSize;
+  struct sigaction OldAction;
+
+  ///\brief The pages being tracked; one arena at a time.
+  static DirtyPages* s_Active;
+
+  ///\brief Records the first write to a tracked page; hands other faults
+  /// on to the previous handler.
+  static void onFault(int Sig, siginfo_t* Info, void* Context);
+};
+
+ExecutorProcess::DirtyPages* ExecutorProcess::DirtyPages::s_Active = 0;
+
+void ExecutorProcess::DirtyPages::onFault(int Sig, siginfo_t* Info,
+                                          void* Context) {
+  DirtyPages* D = s_Active;
+  if (!D) {
+    ::signal(SIGSEGV, SIG_DFL);
+    return;
+  }
+  char* Addr = static_cast<char*>(Info->si_addr);
+  if (Addr >= D->Begin && Addr < D->End && D->NumDirty < D->Capacity) {
+    const size_t Offset = (Addr - D->Begin) / D->PageSize * D->PageSize;
+    ::memcpy(D->Backup + Offset, D->Begin + Offset, D->PageSize);
+    if (!::mprotect(D->Begin + Offset, D->PageSize, PROT_READ | PROT_WRITE)) {
+      D->Offsets[D->NumDirty++] = Offset;
+      return;
+    }
+  }
+  // Not ours: the faulting instruction runs again, under the old handler.
+  ::sigaction(SIGSEGV, &D->OldAction, 0);
+}
+
+ExecutorProcess::ExecutorProcess(IncrementalExecutor& Exe):
+  m_Exe(Exe), m_Shared(0), m_Arena(0), m_ArenaUsed(0), m_ExecArena(0),
+  m_NumFinalized(0), m_NumSaved(0), m_DirtyPages(0), m_ToExecutorBell(-1),
+  m_FromExecutorBell(-1), m_Lifeline(-1), m_Pid(0), m_NumStarts(0),
+  m_Active(false) {
+  void* Shm = ::mmap(0, sizeof(Shared), PROT_READ | PROT_WRITE,
+                     MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+  // Two views of the same pages: the JIT writes the code through the first
+  // one, and both processes run it from the second one.
+  void* Arena = MAP_FAILED;
+  void* ExecArena = MAP_FAILED;
+  const int Fd = createMemoryFile(kArenaSize);
+  if (Fd >= 0) {
+    Arena = ::mmap(0, kArenaSize, PROT_READ | PROT_WRITE,
+                   MAP_SHARED | MAP_NORESERVE, Fd, 0);
+    ExecArena = ::mmap(0, kArenaSize, PROT_READ | PROT_EXEC,
+                       MAP_SHARED | MAP_NORESERVE, Fd, 0);
+    ::close(Fd);
+  }
+  void* Backup = ::mmap(0, kArenaSize, PROT_READ | PROT_WRITE,
+                        MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+  m_ToExecutorBell = ::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+  m_FromExecutorBell = ::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+  if (Shm == MAP_FAILED || Arena == MAP_FAILED || ExecArena == MAP_FAILED
+      || Backup == MAP_FAILED || m_ToExecutorBell < 0
+      || m_FromExecutorBell < 0) {
+    llvm::errs() << "cling::ExecutorProcess: cannot set up shared memory: "
+                 << ::strerror(errno) << "; running code in-process.\n";
+    if (Shm != MAP_FAILED)
+      ::munmap(Shm, sizeof(Shared));
+    if (Arena != MAP_FAILED)
+      ::munmap(Arena, kArenaSize);
+    if (ExecArena != MAP_FAILED)
+      ::munmap(ExecArena, kArenaSize);
+    if (Backup != MAP_FAILED)
+      ::munmap(Backup, kArenaSize);
+    return;
+  }
+  m_Shared = new (Shm) Shared();
+  new (m_Shared->ValueSlot) Value();
+  m_Arena = static_cast<char*>(Arena);
+  m_ExecArena = static_cast<char*>(ExecArena);
+  m_DirtyPages = new DirtyPages();
+  m_DirtyPages->Begin = m_DirtyPages->End = m_Arena;
+  m_DirtyPages->Backup = static_cast<char*>(Backup);
+  m_DirtyPages->Capacity = 0;
+  m_DirtyPages->NumDirty = 0;
+  m_DirtyPages->PageSize = ::sysconf(_SC_PAGESIZE);
+}
+
+ExecutorProcess::~ExecutorProcess() {
+  if (m_Pid) {
+    ::kill(m_Pid, SIGKILL);
+    reap();
+  }
+  // The slot may reference the executor's heap; do not destroy it here.
+  if (m_Shared)
+    ::munmap(m_Shared, sizeof(Shared));
+  if (m_Arena)
+    ::munmap(m_Arena, kArenaSize);
+  if (m_ExecArena)
+    ::munmap(m_ExecArena, kArenaSize);
+  if (m_DirtyPages) {
+    ::munmap(m_DirtyPages->Backup, kArenaSize);
+    delete m_DirtyPages;
+  }
+  if (m_ToExecutorBell >= 0)
+    ::close(m_ToExecutorBell);
+  if (m_FromExecutorBell >= 0)
+    ::close(m_FromExecutorBell);
+}
+
+uint8_t* ExecutorProcess::allocate(uintptr_t Size, unsigned Alignment,
+                                   bool Writable) {
+  if (!Alignment)
+    Alignment = 16;
+  const size_t Start = (m_ArenaUsed + Alignment - 1) & ~size_t(Alignment - 1);
+  if (Start + Size > kArenaSize) {
+    llvm::errs() << "cling::ExecutorProcess: out of memory for JITted code.\n";
+    return 0;
+  }
+  m_ArenaUsed = Start + Size;
+  char* Addr = m_Arena + Start;
+  if (Writable && Size)
+    m_Writable.push_back(Section{Addr, Size, std::vector<char>()});
+  return reinterpret_cast<uint8_t*>(Addr);
+}
+
+void ExecutorProcess::finalizeSections() {
+  for (size_t I = m_NumFinalized, E = m_Writable.size(); I < E; ++I) {
+    Section& S = m_Writable[I];
+    S.Image.assign(S.Addr, S.Addr + S.Size);
+  }
+  m_NumFinalized = m_Writable.size();
+}
+
+void ExecutorProcess::saveSections() {
+  m_NumSaved = m_NumFinalized;
+  DirtyPages& D = *m_DirtyPages;
+  assert(!DirtyPages::s_Active && "Another arena is being tracked!");
+  // The sections linked meanwhile must not share a page with the tracked
+  // ones, restoring it would clobber them.
+  const size_t Size = (m_ArenaUsed + D.PageSize - 1) & ~(D.PageSize - 1);
+  m_ArenaUsed = Size;
+  if (!m_NumSaved || !Size)
+    return;
+  const size_t NumPages = Size / D.PageSize;
+  if (D.Capacity < NumPages) {
+    D.Capacity = std::max(NumPages, 2 * D.Capacity);
+    D.Offsets.reset(new size_t[D.Capacity]);
+  }
+  D.End = D.Begin + Size;
+  D.NumDirty = 0;
+
+  struct sigaction Action;
+  ::memset(&Action, 0, sizeof(Action));
+  Action.sa_sigaction = &DirtyPages::onFault;
+  Action.sa_flags = SA_SIGINFO;
+  sigemptyset(&Action.sa_mask);
+  if (::sigaction(SIGSEGV, &Action, &D.OldAction))
+    return;
+  DirtyPages::s_Active = &D;
+  if (::mprotect(D.Begin, Size, PROT_READ)) {
+    ::sigaction(SIGSEGV, &D.OldAction, 0);
+    DirtyPages::s_Active = 0;
+  }
+}
+
+void ExecutorProcess::restoreSections() {
+  DirtyPages& D = *m_DirtyPages;
+  if (DirtyPages::s_Active == &D) {
+    for (size_t I = 0; I < D.NumDirty; ++I)
+      ::memcpy(D.Begin + D.Offsets[I], D.Backup + D.Offsets[I], D.PageSize);
+    ::mprotect(D.Begin, D.End - D.Begin, PROT_READ | PROT_WRITE);
+    ::sigaction(SIGSEGV, &D.OldAction, 0);
+    DirtyPages::s_Active = 0;
+  }
+  for (size_t I = m_NumSaved; I < m_NumFinalized; ++I) {
+    Section& S = m_Writable[I];
+    ::memcpy(S.Addr, S.Image.data(), S.Size);
+  }
+  m_NumSaved = 0;
+}
+
+bool ExecutorProcess::start() {
+  // A thread holding a lock at the fork would hold it forever in the
+  // executor.
+  if (m_BeforeFork)
+    m_BeforeFork();
+
+  int Lifeline[2];
+  if (::pipe2(Lifeline, O_CLOEXEC)) {
+    llvm::errs() << "cling::ExecutorProcess: cannot create a pipe: "
+                 << ::strerror(errno) << '\n';
+    return false;
+  }
+  m_Shared->ToExecutor.reset();
+  m_Shared->FromExecutor.reset();
+  drainDoorbell(m_ToExecutorBell);
+  drainDoorbell(m_FromExecutorBell);
+  // Do not let the executor inherit pending output.
+  flushOutput();
+
+  const pid_t Parent = ::getpid();
+  const pid_t Pid = ::fork();
+  if (Pid < 0) {
+    llvm::errs() << "cling::ExecutorProcess: cannot fork: "
+                 << ::strerror(errno) << '\n';
+    ::close(Lifeline[0]);
+    ::close(Lifeline[1]);
+    return false;
+  }
+
+  if (!Pid) {
+    // The write end of the lifeline stays open until this process dies.
+    ::close(Lifeline[0]);
+    s_IsExecutor = true;
+    s_DumpRequested = &m_Shared->DumpRequested;
+    // This copy runs everything itself.
+    m_Active = false;
+    m_Pid = 0;
+    ::prctl(PR_SET_PDEATHSIG, SIGKILL);
+    if (::getppid() != Parent)
+      ::_exit(0);
+    // Die quietly, the interpreter reports it; an interrupt only stops the
+    // executor.
+    for (int Sig: {SIGSEGV, SIGBUS, SIGILL, SIGFPE, SIGABRT, SIGINT})
+      ::signal(Sig, SIG_DFL);
+    serve();
+  }
+
+  ::close(Lifeline[1]);
+  m_Lifeline = Lifeline[0];
+  m_Pid = Pid;
+  ++m_NumStarts;
+  return true;
+}
+
+int ExecutorProcess::reap() {
+  int Status = 0;
+  while (::waitpid(m_Pid, &Status, 0) < 0 && errno == EINTR)
+    ;
+  ::close(m_Lifeline);
+  m_Lifeline = -1;
+  m_Pid = 0;
+  return Status;
+}
+
+bool ExecutorProcess::ensureRunning() {
+  if (m_Pid)
+    return true;
+  if (!m_Active || !start())
+    return false;
+  if (m_NumStarts == 1) {
+    // Whatever ran so far ran here, before the fork: that is the state a
+    // restarted executor returns to.
+    for (size_t I = 0; I < m_NumFinalized; ++I) {
+      Section& S = m_Writable[I];
+      S.Image.assign(S.Addr, S.Addr + S.Size);
+    }
+  }
+  return true;
+}
+
+void ExecutorProcess::restart() {
+  // The lifeline also hangs up if the executor closed it; make sure it is
+  // gone.
+  ::kill(m_Pid, SIGKILL);
+  int Status = reap();
+  llvm::errs() << "cling: the executor process ";
+  if (WIFSIGNALED(Status))
+    llvm::errs() << "was killed by signal " << WTERMSIG(Status) << " ("
+                 << ::strsignal(WTERMSIG(Status)) << ")";
+  else
+    llvm::errs() << "exited with status " << WEXITSTATUS(Status);
+  llvm::errs() << "; restarting it.\n";
+
+  while (start()) {
+    for (size_t I = 0; I < m_NumFinalized; ++I) {
+      Section& S = m_Writable[I];
+      ::memcpy(S.Addr, S.Image.data(), S.Size);
+    }
+
+    size_t Replayed = 0;
+    while (Replayed < m_Inits.size()
+           && transact(kInit, m_Inits[Replayed].Addr,
+                       (uint64_t)m_Inits[Replayed].Module, llvm::StringRef(),
+                       0))
+      ++Replayed;
+
+    if (Replayed == m_Inits.size()) {
+      // Libraries loaded while the previous executor ran may now live at
+      // other addresses; code linked against them is stale.
+      unsigned Moved = 0;
+      for (auto& Sym: m_Symbols) {
+        uint64_t Addr = 0;
+        if (!transact(kLookup, 0, 0, Sym.getKey(), &Addr))
+          break;
+        if (Addr != Sym.getValue()) {
+          ++Moved;
+          Sym.setValue(Addr);
+        }
+      }
+      if (Moved)
+        llvm::errs() << "cling: " << Moved << " library symbols moved in the "
+                        "new executor process; re-enter code using them.\n";
+      return;
+    }
+
+    ::kill(m_Pid, SIGKILL);
+    reap();
+    llvm::errs() << "cling: replaying a static initializer crashed the "
+                    "executor process again; dropping it.\n";
+    m_Inits.erase(m_Inits.begin() + Replayed);
+  }
+}
+
+bool ExecutorProcess::transact(unsigned Kind, uint64_t Arg0, uint64_t Arg1,
+                               llvm::StringRef Payload, uint64_t* Result,
+                               std::string* ReplyPayload) {
+  // Keep the output of both processes in order.
+  flushOutput();
+  Message M = {Kind, 0, Arg0, Arg1};
+  m_Shared->ToExecutor.push(M, Payload);
+  ringDoorbell(m_Shared->ToExecutor, m_ToExecutorBell);
+  if (!waitForMessage(m_Shared->FromExecutor, m_FromExecutorBell, m_Lifeline))
+    return false;
+  Message Reply;
+  std::string Received;
+  m_Shared->FromExecutor.pop(Reply, Received);
+  if (Result)
+    *Result = Reply.Arg0;
+  if (ReplyPayload)
+    ReplyPayload->swap(Received);
+  return true;
+}
+
+ExecutorProcess::Status
+ExecutorProcess::request(unsigned Kind, uint64_t Arg0, uint64_t Arg1,
+                         llvm::StringRef Payload, uint64_t* Result,
+                         std::string* ReplyPayload) {
+  if (!ensureRunning())
+    return kFailure;
+  if (transact(Kind, Arg0, Arg1, Payload, Result, ReplyPayload))
+    return kSuccess;
+  restart();
+  return kCrashed;
+}
+
+void ExecutorProcess::serve() {
+  Ring& In = m_Shared->ToExecutor;
+  Ring& Out = m_Shared->FromExecutor;
+  Message M;
+  std::string Payload;
+  std::string ReplyPayload;
+  while (true) {
+    if (!waitForMessage(In, m_ToExecutorBell, -1))
+      continue;
+    In.pop(M, Payload);
+
+    uint64_t Result = 0;
+    ReplyPayload.clear();
+    switch (M.Kind) {
+    case kCall: {
+      // Release what the previous statement left behind.
+      if (M.Arg1)
+        *getValueSlot() = Value();
+      typedef void (*Wrapper_t)(void*);
+      reinterpret_cast<Wrapper_t>(M.Arg0)(reinterpret_cast<void*>(M.Arg1));
+      break;
+    }
+    case kInit: {
+      m_Exe.m_CurrentAtExitModule = reinterpret_cast<llvm::Module*>(M.Arg1);
+      typedef void (*Init_t)();
+      reinterpret_cast<Init_t>(M.Arg0)();
+      m_Exe.m_CurrentAtExitModule = 0;
+      break;
+    }
+    case kLookup:
+      Result = llvm::RTDyldMemoryManager::getSymbolAddressInProcess(Payload);
+      break;
+    case kLoadLibrary: {
+      std::string Err;
+      Result = platform::DLOpen(Payload, &Err) != 0;
+      break;
+    }
+    case kUnloadLibrary:
+      // Drop the reference just taken and the one from kLoadLibrary.
+      if (const void* Lib = platform::DLOpen(Payload)) {
+        platform::DLClose(Lib);
+        platform::DLClose(Lib);
+      }
+      break;
+    case kRegisterEHFrames:
+      llvm::RTDyldMemoryManager::registerEHFramesInProcess(
+                                   reinterpret_cast<uint8_t*>(M.Arg0), M.Arg1);
+      break;
+    case kDeregisterEHFrames:
+      llvm::RTDyldMemoryManager::deregisterEHFramesInProcess(
+                                   reinterpret_cast<uint8_t*>(M.Arg0), M.Arg1);
+      break;
+    case kRunDestructors:
+      m_Exe.runAndRemoveStaticDestructors(
+                              reinterpret_cast<const llvm::Module*>(M.Arg0));
+      break;
+    case kCallForString: {
+      typedef void (*Function_t)(void*);
+      reinterpret_cast<Function_t>(M.Arg0)(&ReplyPayload);
+      if (ReplyPayload.size() > size_t(Ring::kMaxPayload)) {
+        ReplyPayload.resize(size_t(Ring::kMaxPayload) - 3);
+        ReplyPayload += "...";
+      }
+      break;
+    }
+    case kShutdown:
+      m_Exe.shuttingDown();
+      break;
+    }
+
+    flushOutput();
+    Message Reply = {kReply, 0, Result, 0};
+    Out.push(Reply, ReplyPayload);
+    ringDoorbell(Out, m_FromExecutorBell);
+    if (M.Kind == kShutdown)
+      ::_exit(0);
+  }
+}
+
+uint64_t ExecutorProcess::lookup(llvm::StringRef Name) {
+  auto I = m_Symbols.find(Name);
+  if (I != m_Symbols.end())
+    return I->getValue();
+  uint64_t Addr = 0;
+  if (request(kLookup, 0, 0, Name, &Addr) != kSuccess)
+    return 0;
+  // Not remembering misses: the library might be loaded later.
+  if (Addr)
+    m_Symbols[Name] = Addr;
+  return Addr;
+}
+
+void ExecutorProcess::registerEHFrames(uint8_t* Addr, size_t Size) {
+  // An executor started later inherits the interpreter's registration.
+  if (m_Pid)
+    request(kRegisterEHFrames, (uint64_t)Addr, Size);
+}
+
+void ExecutorProcess::deregisterEHFrames(uint8_t* Addr, size_t Size) {
+  if (m_Pid)
+    request(kDeregisterEHFrames, (uint64_t)Addr, Size);
+}
+
+void ExecutorProcess::loadLibrary(llvm::StringRef Path) {
+  // An executor started later inherits the library from the interpreter.
+  if (!m_Pid)
+    return;
+  uint64_t Loaded = 0;
+  if (request(kLoadLibrary, 0, 0, Path, &Loaded) == kSuccess && !Loaded)
+    llvm::errs() << "cling::ExecutorProcess: cannot load '" << Path
+                 << "' into the executor process.\n";
+}
+
+void ExecutorProcess::unloadLibrary(llvm::StringRef Path) {
+  if (m_Pid)
+    request(kUnloadLibrary, 0, 0, Path);
+}
+
+ExecutorProcess::Status
+ExecutorProcess::call(uint64_t Addr, Value* V, bool DirectResult) {
+  Value* Slot = getValueSlot();
+  uint64_t Arg = 0;
+  if (DirectResult)
+    Arg = (uint64_t)&Slot->getULL();
+  else if (V)
+    Arg = (uint64_t)Slot;
+  m_Shared->DumpRequested = 0;
+
+  Status S = request(kCall, Addr, Arg);
+  if (S != kSuccess || !V)
+    return S;
+
+  if (DirectResult) {
+    // All members of the storage union share its address; long double is
+    // the widest of them.
+    ::memcpy(&V->getULL(), &Slot->getULL(), sizeof(long double));
+    return kSuccess;
+  }
+  if (!Slot->isValid())
+    return kSuccess;
+  if (!canTransfer(*Slot, m_Arena)) {
+    llvm::errs() << "cling: the value of type '"
+                 << Slot->getType().getAsString()
+                 << "' stays in the executor process.\n";
+    return kSuccess;
+  }
+  *V = *Slot;
+  if (m_Shared->DumpRequested)
+    V->dump();
+  return kSuccess;
+}
+
+ExecutorProcess::Status
+ExecutorProcess::callForString(uint64_t Addr, std::string& Result) {
+  Result.clear();
+  return request(kCallForString, Addr, 0, llvm::StringRef(), 0, &Result);
+}
+
+ExecutorProcess::Status
+ExecutorProcess::runInit(uint64_t Addr, const llvm::Module* Module) {
+  Status S = request(kInit, Addr, (uint64_t)Module);
+  if (S == kSuccess)
+    m_Inits.push_back(Init{Addr, Module});
+  return S;
+}
+
+ExecutorProcess::Status
+ExecutorProcess::runDestructors(const llvm::Module* Module) {
+  // Nothing was registered in an executor that never ran.
+  if (!m_Pid)
+    return kSuccess;
+  return request(kRunDestructors, (uint64_t)Module, 0);
+}
+
+void ExecutorProcess::forgetModule(const llvm::Module* Module) {
+  m_Inits.erase(std::remove_if(m_Inits.begin(), m_Inits.end(),
+                               [Module](const Init& I) {
+                                 return I.Module == Module;
+                               }),
+                m_Inits.end());
+}
+
+void ExecutorProcess::shutDown() {
+  if (m_Pid) {
+    transact(kShutdown, 0, 0, llvm::StringRef(), 0);
+    reap();
+  }
+  m_Active = false;
+}
+
+#else // __linux__
+
+ExecutorProcess::ExecutorProcess(IncrementalExecutor& Exe):
+  m_Exe(Exe), m_Shared(0), m_Arena(0), m_ArenaUsed(0), m_ExecArena(0),
+  m_NumFinalized(0), m_NumSaved(0), m_DirtyPages(0), m_ToExecutorBell(-1),
+  m_FromExecutorBell(-1), m_Lifeline(-1), m_Pid(0), m_NumStarts(0),
+  m_Active(false) {
+  llvm::errs() << "cling::ExecutorProcess: not supported on this platform; "
+                  "running code in-process.\n";
+}
+
+ExecutorProcess::~ExecutorProcess() {}
+
+uint8_t* ExecutorProcess::allocate(uintptr_t, unsigned, bool) { return 0; }
+void ExecutorProcess::finalizeSections() {}
+void ExecutorProcess::saveSections() {}
+void ExecutorProcess::restoreSections() {}
+uint64_t ExecutorProcess::lookup(llvm::StringRef) { return 0; }
+void ExecutorProcess::registerEHFrames(uint8_t*, size_t) {}
+void ExecutorProcess::deregisterEHFrames(uint8_t*, size_t) {}
+void ExecutorProcess::loadLibrary(llvm::StringRef) {}
+void ExecutorProcess::unloadLibrary(llvm::StringRef) {}
+
+ExecutorProcess::Status
+ExecutorProcess::call(uint64_t, Value*, bool) { return kFailure; }
+
+ExecutorProcess::Status
+ExecutorProcess::callForString(uint64_t, std::string&) { return kFailure; }
+
+ExecutorProcess::Status
+ExecutorProcess::runInit(uint64_t, const llvm::Module*) { return kFailure; }
+
+ExecutorProcess::Status
+ExecutorProcess::runDestructors(const llvm::Module*) { return kSuccess; }
+
+void ExecutorProcess::forgetModule(const llvm::Module*) {}
+void ExecutorProcess::shutDown() {}
+
+#endif // __linux__
@@ -0,0 +1,306 @@
+//--------------------------------------------------------------------*- C++ -*-
+// CLING - the C++ LLVM-based InterpreterG :)
+//
+// This file is dual-licensed: you can choose to license it under the University
+// of Illinois Open Source License or the GNU Lesser General Public License. See
+// LICENSE.TXT for details.
+//------------------------------------------------------------------------------
+
+#ifndef CLING_EXECUTOR_PROCESS_H
+#define CLING_EXECUTOR_PROCESS_H
+
+#include "llvm/ADT/StringMap.h"
+#include "llvm/ADT/StringRef.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+namespace llvm {
+  class Module;
+}
+
+namespace cling {
+  class IncrementalExecutor;
+  class Value;
+
+  ///\brief Runs the JITted code of an interpreter in a separate process, so
+  /// that a crash in user code does not take the interpreter down with it.
+  ///
+  /// The executor is forked from the interpreter. All sections the JIT
+  /// allocates live in an arena of shared memory mapped before the fork, so
+  /// code linked by the interpreter later on shows up at the same address in
+  /// the executor; only the requests to run it travel between the processes.
+  /// The arena is mapped twice: the JIT writes the code through a writable
+  /// view and it runs from an executable one, so no page is writable and
+  /// executable through the same mapping.
+  /// Requests and replies go through two rings in shared memory; the receiving
+  /// side spins briefly and then sleeps on an eventfd doorbell.
+  ///
+  /// If the executor dies, the interpreter forks a new one, restores the
+  /// initial image of all writable sections and re-runs the static
+  /// initializers of the transactions that are still loaded. Statements are
+  /// not replayed.
+  ///
+  /// Code running in the executor only has a stale copy of the interpreter
+  /// and must not call back into it; values that need managed storage stay in
+  /// the executor. Code the interpreter runs itself meanwhile, like the value
+  /// printer's probes, sees the executor's globals but not its heap, and its
+  /// writes to them are undone, see saveSections(). Objects that may point
+  /// into the heap, like a std::vector, are printed by the executor instead,
+  /// see callForString().
+  ///
+  /// Only the forking thread continues in the executor: the interpreter's
+  /// background threads are paused through setBeforeFork(), and an embedder
+  /// must not run other threads that could hold locks the executor needs.
+  ///
+  class ExecutorProcess {
+  public:
+    enum Status {
+      kSuccess,
+      kFailure,
+      ///\brief The executor died while handling the request; a new one has
+      /// been started.
+      kCrashed
+    };
+
+  private:
+    struct Shared;
+    struct DirtyPages;
+
+    ///\brief A writable section and its content before any code ran.
+    ///
+    struct Section {
+      char* Addr;
+      size_t Size;
+      std::vector<char> Image;
+    };
+
+    ///\brief A static initializer run by the executor.
+    ///
+    struct Init {
+      uint64_t Addr;
+      const llvm::Module* Module;
+    };
+
+    IncrementalExecutor& m_Exe;
+
+    ///\brief Rings, doorbell state and the slot receiving Values.
+    ///
+    Shared* m_Shared;
+
+    ///\brief Shared memory holding all JITted sections, as written by the
+    /// JIT.
+    ///
+    char* m_Arena;
+    size_t m_ArenaUsed;
+
+    ///\brief The same memory, mapped read-only and executable; code runs
+    /// from here.
+    ///
+    char* m_ExecArena;
+
+    std::vector<Section> m_Writable;
+
+    ///\brief Number of m_Writable entries whose image was taken.
+    ///
+    size_t m_NumFinalized;
+
+    ///\brief Number of m_Writable entries whose image was taken by
+    /// saveSections().
+    ///
+    size_t m_NumSaved;
+
+    ///\brief The pages written since saveSections() and what they held.
+    ///
+    DirtyPages* m_DirtyPages;
+
+    ///\brief Brings the interpreter's other threads to a halt.
+    ///
+    std::function<void()> m_BeforeFork;
+
+    ///\brief The initializers to replay after a crash, in execution order.
+    ///
+    std::vector<Init> m_Inits;
+
+    ///\brief Symbol addresses in the executor, as handed to the JIT.
+    ///
+    llvm::StringMap<uint64_t> m_Symbols;
+
+    ///\brief eventfds waking up the executor and the interpreter.
+    ///
+    int m_ToExecutorBell;
+    int m_FromExecutorBell;
+
+    ///\brief Read end of a pipe whose write end only the executor holds; it
+    /// hangs up when the executor dies.
+    ///
+    int m_Lifeline;
+
+    ///\brief The executor's process id; 0 if it is not running.
+    ///
+    int m_Pid;
+
+    ///\brief How many executors were started so far.
+    ///
+    unsigned m_NumStarts;
+
+    ///\brief Whether code runs in the executor; until then it runs here.
+    ///
+    bool m_Active;
+
+    ///\brief Whether this copy of the object lives in the executor.
+    ///
+    static bool s_IsExecutor;
+
+    bool ensureRunning();
+    bool start();
+
+    ///\brief Replaces a dead executor, replaying the static initializers.
+    ///
+    void restart();
+
+    ///\brief Waits for the executor to end.
+    ///
+    ///\returns its wait status.
+    ///
+    int reap();
+
+    ///\brief Sends a request and waits for its reply, without recovering
+    /// from a crash.
+    ///
+    ///\returns false if the executor died.
+    ///
+    bool transact(unsigned Kind, uint64_t Arg0, uint64_t Arg1,
+                  llvm::StringRef Payload, uint64_t* Result,
+                  std::string* ReplyPayload = 0);
+
+    ///\brief Sends a request; restarts the executor if it dies on it.
+    ///
+    Status request(unsigned Kind, uint64_t Arg0, uint64_t Arg1,
+                   llvm::StringRef Payload = llvm::StringRef(),
+                   uint64_t* Result = 0, std::string* ReplyPayload = 0);
+
+    ///\brief The executor's request loop; never returns.
+    ///
+    void serve();
+
+    Value* getValueSlot() const;
+
+  public:
+    ExecutorProcess(IncrementalExecutor& Exe);
+    ~ExecutorProcess();
+
+    ///\brief Whether the shared memory could be set up.
+    ///
+    bool isValid() const { return m_Arena != 0; }
+
+    ///\brief Whether code should be sent to the executor.
+    ///
+    bool isActive() const { return m_Active; }
+
+    ///\brief From now on, run code in the executor, starting it on demand.
+    ///
+    void activate() { m_Active = isValid(); }
+
+    ///\brief Sets what pauses the interpreter's other threads before an
+    /// executor is forked; they may hold locks the executor needs.
+    ///
+    void setBeforeFork(std::function<void()> F) { m_BeforeFork = F; }
+
+    ///\brief Whether the calling process is an executor.
+    ///
+    static bool isExecutor() { return s_IsExecutor; }
+
+    ///\brief Called by the executor instead of printing a Value: asks the
+    /// interpreter to print it once the statement has finished.
+    ///
+    ///\returns false if the caller should print the value itself.
+    ///
+    static bool deferDump();
+
+    ///\brief Allocates memory for a JITted section.
+    ///
+    ///\returns the address to write the section to; code runs from
+    /// getExecutableAddress() of it.
+    ///
+    uint8_t* allocate(uintptr_t Size, unsigned Alignment, bool Writable);
+
+    ///\brief Returns where code written to Addr in the arena runs from.
+    ///
+    uint64_t getExecutableAddress(const void* Addr) const {
+      return (uint64_t)(m_ExecArena + (static_cast<const char*>(Addr)
+                                       - m_Arena));
+    }
+
+    ///\brief Records the content of the writable sections allocated since the
+    /// last call, which is what a restarted executor starts from.
+    ///
+    void finalizeSections();
+
+    ///\brief Starts tracking the writes into the sections allocated so far,
+    /// before the interpreter runs code itself while the executor is in use.
+    ///
+    /// The pages are made read-only; the first write to each of them saves
+    /// its content and makes it writable again, so a probe costs what it
+    /// writes rather than the size of all sections. Sections allocated
+    /// meanwhile start on a page of their own. Writes by system calls into
+    /// the tracked pages fail with EFAULT.
+    ///
+    void saveSections();
+
+    ///\brief Undoes what code run by the interpreter wrote into the
+    /// writable sections since saveSections(); those allocated meanwhile
+    /// return to their image after linking. The executor must not have run
+    /// code in between.
+    ///
+    void restoreSections();
+
+    ///\brief Returns the address of a symbol in the executor; 0 if unknown.
+    ///
+    uint64_t lookup(llvm::StringRef Name);
+
+    void registerEHFrames(uint8_t* Addr, size_t Size);
+    void deregisterEHFrames(uint8_t* Addr, size_t Size);
+
+    void loadLibrary(llvm::StringRef Path);
+    void unloadLibrary(llvm::StringRef Path);
+
+    ///\brief Runs a wrapper function in the executor.
+    ///
+    ///\param [in] Addr - The wrapper's address.
+    ///\param [in,out] V - The Value the wrapper sets, if any.
+    ///\param [in] DirectResult - The wrapper stores its builtin result into
+    ///   the storage of V, which the caller types once it returned.
+    ///
+    Status call(uint64_t Addr, Value* V, bool DirectResult);
+
+    ///\brief Runs a function storing a std::string in the executor, e.g. a
+    /// printer that reads the executor's heap.
+    ///
+    ///\param [in] Addr - The function's address; it takes a std::string*.
+    ///\param [out] Result - The string, truncated to what a reply holds.
+    ///
+    Status callForString(uint64_t Addr, std::string& Result);
+
+    ///\brief Runs a static initializer of Module in the executor.
+    ///
+    Status runInit(uint64_t Addr, const llvm::Module* Module);
+
+    ///\brief Runs the executor's static destructors bound to Module.
+    ///
+    Status runDestructors(const llvm::Module* Module);
+
+    ///\brief Stops replaying the initializers of an unloaded Module.
+    ///
+    void forgetModule(const llvm::Module* Module);
+
+    ///\brief Runs the executor's remaining static destructors and ends it.
+    ///
+    void shutDown();
+  };
+} // namespace cling
+
+#endif // CLING_EXECUTOR_PROCESS_H
@@ -0,0 +1,203 @@
+//------------------------------------------------------------------------------
+// CLING - the C++ LLVM-based InterpreterG :)
+//
+// This file is dual-licensed: you can choose to license it under the University
+// of Illinois Open Source License or the GNU Lesser General Public License. See
+// LICENSE.TXT for details.
+//------------------------------------------------------------------------------
+
+#include "HeaderPrefetcher.h"
+
+#include "clang/Lex/Lexer.h"
+
+#include "llvm/ADT/SmallString.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/Path.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include <algorithm>
+
+using namespace clang;
+
+namespace cling {
+
+  static std::string getCurrentPath() {
+    llvm::SmallString<256> CWD;
+    llvm::sys::fs::current_path(CWD);
+    return CWD.str();
+  }
+
+  HeaderPrefetcher::HeaderPrefetcher(const LangOptions& LangOpts)
+    : m_LangOpts(LangOpts), m_CWD(getCurrentPath()), m_Busy(0),
+      m_Stop(false), m_Paused(false), m_NumFilesRead(0) {}
+
+  HeaderPrefetcher::~HeaderPrefetcher() {
+    {
+      std::lock_guard<std::mutex> Guard(m_Lock);
+      m_Stop = true;
+    }
+    m_WorkAvailable.notify_all();
+    for (std::thread& Worker : m_Workers)
+      Worker.join();
+  }
+
+  void HeaderPrefetcher::prefetch(llvm::StringRef Input,
+                                  const std::vector<std::string>& SearchDirs) {
+    if (Input.find("include") == llvm::StringRef::npos
+        && Input.find("import") == llvm::StringRef::npos)
+      return;
+
+    // Quoted includes of the prompt are relative to the working directory.
+    std::vector<Request> Found;
+    scanIncludes(Input, m_CWD,
+                 std::make_shared<const std::vector<std::string>>(SearchDirs),
+                 Found);
+    if (Found.empty())
+      return;
+
+    std::lock_guard<std::mutex> Guard(m_Lock);
+    if (m_Workers.empty()) {
+      unsigned NumWorkers
+        = std::max(1u, std::min(4u, std::thread::hardware_concurrency()));
+      for (unsigned I = 0; I < NumWorkers; ++I)
+        m_Workers.emplace_back(&HeaderPrefetcher::workerMain, this);
+    }
+    for (Request& R : Found)
+      m_Queue.push_back(std::move(R));
+    m_Paused = false;
+    m_WorkAvailable.notify_all();
+  }
+
+  void HeaderPrefetcher::wait() {
+    std::unique_lock<std::mutex> Guard(m_Lock);
+    m_Idle.wait(Guard, [this] {
+      return (m_Queue.empty() || m_Paused) && !m_Busy;
+    });
+  }
+
+  void HeaderPrefetcher::pause() {
+    std::unique_lock<std::mutex> Guard(m_Lock);
+    m_Paused = true;
+    m_Idle.wait(Guard, [this] { return !m_Busy; });
+  }
+
+  void HeaderPrefetcher::workerMain() {
+    std::unique_lock<std::mutex> Guard(m_Lock);
+    while (true) {
+      m_WorkAvailable.wait(Guard, [this] {
+        return m_Stop || (!m_Paused && !m_Queue.empty());
+      });
+      if (m_Stop)
+        return;
+      Request R = std::move(m_Queue.front());
+      m_Queue.pop_front();
+      ++m_Busy;
+
+      Guard.unlock();
+      std::vector<Request> Found;
+      process(R, Found);
+      Guard.lock();
+
+      for (Request& F : Found)
+        m_Queue.push_back(std::move(F));
+      --m_Busy;
+      if (!Found.empty())
+        m_WorkAvailable.notify_all();
+      if ((m_Queue.empty() || m_Paused) && !m_Busy)
+        m_Idle.notify_all();
+    }
+  }
+
+  void HeaderPrefetcher::process(const Request& R,
+                                 std::vector<Request>& Found) {
+    std::string Path = resolve(R);
+    if (Path.empty())
+      return;
+    {
+      std::lock_guard<std::mutex> Guard(m_Lock);
+      // The headers read long ago are likely evicted from the caches again.
+      if (m_Seen.size() >= kMaxSeen)
+        m_Seen.clear();
+      if (!m_Seen.insert(Path).second)
+        return;
+    }
+
+    llvm::ErrorOr<std::unique_ptr<llvm::MemoryBuffer>> MB
+      = llvm::MemoryBuffer::getFile(Path);
+    if (!MB)
+      return;
+    ++m_NumFilesRead;
+    scanIncludes((*MB)->getBuffer(), llvm::sys::path::parent_path(Path),
+                 R.SearchDirs, Found);
+  }
+
+  void HeaderPrefetcher::print(llvm::raw_ostream& Out) const {
+    Out << "Header prefetcher:\n"
+        << "  files read: " << m_NumFilesRead << '\n';
+  }
+
+  std::string HeaderPrefetcher::resolve(const Request& R) {
+    if (llvm::sys::path::is_absolute(R.Name))
+      return llvm::sys::fs::is_regular_file(R.Name) ? R.Name : std::string();
+
+    auto tryDir = [&R](llvm::StringRef Dir, std::string& Result) {
+      llvm::SmallString<256> Path(Dir);
+      llvm::sys::path::append(Path, R.Name);
+      if (!llvm::sys::fs::is_regular_file(Path))
+        return false;
+      Result = Path.str();
+      return true;
+    };
+
+    std::string Result;
+    if (!R.Angled && tryDir(R.IncluderDir, Result))
+      return Result;
+    for (const std::string& Dir : *R.SearchDirs)
+      if (tryDir(Dir, Result))
+        return Result;
+    return std::string();
+  }
+
+  void HeaderPrefetcher::scanIncludes(llvm::StringRef Code,
+                                      llvm::StringRef IncluderDir,
+                                      const SearchDirs_t& SearchDirs,
+                                      std::vector<Request>& Found) const {
+    // A raw lexer needs no Preprocessor or SourceManager, so it is safe to
+    // run on any thread. It skips comments; conditionals are not evaluated,
+    // reading a header too many is cheap.
+    Lexer L(SourceLocation(), m_LangOpts, Code.begin(), Code.begin(),
+            Code.end());
+    Token Tok;
+    do {
+      L.LexFromRawLexer(Tok);
+      if (Tok.isNot(tok::hash) || !Tok.isAtStartOfLine())
+        continue;
+      L.LexFromRawLexer(Tok);
+      if (Tok.isNot(tok::raw_identifier))
+        continue;
+      llvm::StringRef Directive = Tok.getRawIdentifier();
+      if (Directive != "include" && Directive != "include_next"
+          && Directive != "import")
+        continue;
+
+      // The raw lexer does not lex header names; read it from the buffer.
+      llvm::StringRef Rest(L.getBufferLocation(),
+                           Code.end() - L.getBufferLocation());
+      Rest = Rest.ltrim(" \t");
+      if (Rest.empty() || (Rest[0] != '<' && Rest[0] != '"'))
+        continue; // A macro, we do not expand these.
+      const char Close = Rest[0] == '<' ? '>' : '"';
+      size_t End = Rest.find(Close, 1);
+      if (End == llvm::StringRef::npos || End > Rest.find('\n'))
+        continue;
+
+      Request R;
+      R.Name = Rest.slice(1, End);
+      R.IncluderDir = IncluderDir;
+      R.SearchDirs = SearchDirs;
+      R.Angled = Close == '>';
+      Found.push_back(std::move(R));
+    } while (Tok.isNot(tok::eof));
+  }
+} // namespace cling
@@ -0,0 +1,147 @@
+//--------------------------------------------------------------------*- C++ -*-
+// CLING - the C++ LLVM-based InterpreterG :)
+//
+// This file is dual-licensed: you can choose to license it under the University
+// of Illinois Open Source License or the GNU Lesser General Public License. See
+// LICENSE.TXT for details.
+//------------------------------------------------------------------------------
+
+#ifndef CLING_HEADER_PREFETCHER_H
+#define CLING_HEADER_PREFETCHER_H
+
+#include "clang/Basic/LangOptions.h"
+
+#include "llvm/ADT/StringRef.h"
+#include "llvm/ADT/StringSet.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace llvm {
+  class raw_ostream;
+}
+
+namespace cling {
+
+  ///\brief Reads the headers an input is about to include on background
+  /// threads.
+  ///
+  /// The workers resolve #include directives against a snapshot of the search
+  /// paths, read the files and raw-lex them for further #includes, following
+  /// them transitively. They never touch the compiler's FileManager or
+  /// HeaderSearch, which are not thread safe; the gain is that the parser
+  /// finds the files in the operating system's caches, which hides most of
+  /// the I/O latency of cold or network file systems.
+  ///
+  class HeaderPrefetcher {
+  private:
+    typedef std::shared_ptr<const std::vector<std::string>> SearchDirs_t;
+
+    ///\brief An #include directive to follow.
+    ///
+    struct Request {
+      std::string Name;
+      std::string IncluderDir;
+      ///\brief The #include search path when the top-level input was seen.
+      SearchDirs_t SearchDirs;
+      bool Angled;
+    };
+
+    ///\brief The language options to raw-lex with.
+    ///
+    const clang::LangOptions m_LangOpts;
+
+    ///\brief Headers waiting to be resolved and read.
+    ///
+    std::deque<Request> m_Queue;
+
+    ///\brief Resolved headers that were already read, or are being read;
+    /// forgotten once there are more than kMaxSeen of them.
+    ///
+    llvm::StringSet<> m_Seen;
+    enum { kMaxSeen = 8192 };
+
+    ///\brief The working directory when the prefetcher was created, which
+    /// quoted includes of the prompt are relative to. A stale one only
+    /// costs prefetches.
+    ///
+    const std::string m_CWD;
+
+    std::vector<std::thread> m_Workers;
+    std::mutex m_Lock;
+    std::condition_variable m_WorkAvailable;
+    std::condition_variable m_Idle;
+
+    ///\brief Number of workers busy with a request.
+    ///
+    unsigned m_Busy;
+
+    ///\brief Tells the workers to exit.
+    ///
+    bool m_Stop;
+
+    ///\brief Tells the workers not to start new requests until the next
+    /// prefetch().
+    ///
+    bool m_Paused;
+
+    ///\brief Number of files read so far.
+    ///
+    std::atomic<unsigned> m_NumFilesRead;
+
+    void workerMain();
+
+    ///\brief Resolves the request and reads the file, collecting its
+    /// #include directives into Found.
+    ///
+    void process(const Request& R, std::vector<Request>& Found);
+
+    ///\brief Finds the file a request refers to; empty if there is none.
+    ///
+    static std::string resolve(const Request& R);
+
+    ///\brief Collects the #include directives in Code.
+    ///
+    void scanIncludes(llvm::StringRef Code, llvm::StringRef IncluderDir,
+                      const SearchDirs_t& SearchDirs,
+                      std::vector<Request>& Found) const;
+
+  public:
+    HeaderPrefetcher(const clang::LangOptions& LangOpts);
+    ~HeaderPrefetcher();
+
+    ///\brief Starts reading the headers included by an input.
+    ///
+    ///\param [in] Input - The code about to be parsed.
+    ///\param [in] SearchDirs - The current #include search path.
+    ///
+    void prefetch(llvm::StringRef Input,
+                  const std::vector<std::string>& SearchDirs);
+
+    ///\brief Blocks until all queued headers have been read, or the
+    /// prefetcher was paused.
+    ///
+    void wait();
+
+    ///\brief Blocks until no worker reads a header, and keeps them idle
+    /// until the next prefetch(), e.g. before the process forks.
+    ///
+    void pause();
+
+    ///\brief Returns how many files the workers read.
+    ///
+    unsigned getNumFilesRead() const { return m_NumFilesRead; }
+
+    ///\brief Prints how many files the workers read.
+    ///
+    void print(llvm::raw_ostream& Out) const;
+  };
+} // namespace cling
+
+#endif // CLING_HEADER_PREFETCHER_H
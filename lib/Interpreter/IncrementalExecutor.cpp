@@ -8,6 +8,7 @@
 //------------------------------------------------------------------------------
 
 #include "IncrementalExecutor.h"
+#include "ExecutorProcess.h"
 #include "IncrementalJIT.h"
 #include "Threading.h"
 
@@ -25,6 +26,7 @@
 #include "llvm/IR/LegacyPassManager.h"
 #include "llvm/ADT/SmallPtrSet.h"
 #include "llvm/ADT/Triple.h"
+#include "llvm/MC/SubtargetFeature.h"
 #include "llvm/Support/raw_ostream.h"
 #include "llvm/Support/Host.h"
 #include "llvm/Support/TargetRegistry.h"
@@ -44,7 +46,9 @@ using namespace llvm;
 namespace cling {
 
 IncrementalExecutor::IncrementalExecutor(clang::DiagnosticsEngine& diags,
-                                         const clang::CodeGenOptions& CGOpt):
+                                         const clang::CodeGenOptions& CGOpt,
+                                         bool OutOfProcess):
+  m_ForceInProcess(false),
   m_externalIncrementalExecutor(nullptr),
   m_CurrentAtExitModule(0)
 #if 0
@@ -59,7 +63,14 @@ IncrementalExecutor::IncrementalExecutor(clang::DiagnosticsEngine& diags,
   // can use this object yet.
   m_AtExitFuncs.reserve(256);
 
-  m_JIT.reset(new IncrementalJIT(*this, CreateHostTargetMachine(CGOpt)));
+  if (OutOfProcess) {
+    m_Process.reset(new ExecutorProcess(*this));
+    if (!m_Process->isValid())
+      m_Process.reset();
+  }
+
+  m_JIT.reset(new IncrementalJIT(*this, CreateHostTargetMachine(CGOpt),
+                                 m_Process.get()));
 }
 
 // Keep in source: ~unique_ptr<ClingJIT> needs ClingJIT
@@ -67,7 +78,8 @@ IncrementalExecutor::~IncrementalExecutor() {}
 
 std::unique_ptr<TargetMachine>
   IncrementalExecutor::CreateHostTargetMachine(const
-                                           clang::CodeGenOptions& CGOpt) const {
+                                           clang::CodeGenOptions& CGOpt,
+                                           bool forSharedLib) {
   // TODO: make this configurable.
   Triple TheTriple(sys::getProcessTriple());
 #ifdef _WIN32
@@ -87,9 +99,21 @@ std::unique_ptr<TargetMachine>
 
   std::string MCPU;
   std::string FeaturesStr;
+  Optional<Reloc::Model> RelocModel;
+  CodeModel::Model CMModel = CodeModel::JITDefault;
+  if (forSharedLib) {
+    MCPU = sys::getHostCPUName();
+    SubtargetFeatures Features;
+    StringMap<bool> HostFeatures;
+    if (sys::getHostCPUFeatures(HostFeatures))
+      for (auto&& F: HostFeatures)
+        Features.AddFeature(F.first(), F.second);
+    FeaturesStr = Features.getString();
+    RelocModel = Reloc::PIC_;
+    CMModel = CodeModel::Default;
+  }
 
   TargetOptions Options = TargetOptions();
-  CodeModel::Model CMModel = CodeModel::JITDefault;
   CodeGenOpt::Level OptLevel = CodeGenOpt::Default;
   switch (CGOpt.OptimizationLevel) {
     case 0: OptLevel = CodeGenOpt::None; break;
@@ -103,13 +127,17 @@ std::unique_ptr<TargetMachine>
   TM.reset(TheTarget->createTargetMachine(TheTriple.getTriple(),
                                           MCPU, FeaturesStr,
                                           Options,
-                                          Optional<Reloc::Model>(),
+                                          RelocModel,
                                           CMModel,
                                           OptLevel));
   return TM;
 }
 
 void IncrementalExecutor::shuttingDown() {
+  // The executor runs the destructors of what it constructed.
+  if (m_Process && m_Process->isActive())
+    m_Process->shutDown();
+
   // No need to protect this access, since hopefully there is no concurrent
   // shutdown request.
   for (size_t I = 0, N = m_AtExitFuncs.size(); I < N; ++I) {
@@ -197,7 +225,8 @@ freeCallersOfUnresolvedSymbols(llvm::SmallVectorImpl<llvm::Function*>&
 #endif
 
 IncrementalExecutor::ExecutionResult
-IncrementalExecutor::runStaticInitializersOnce(const Transaction& T) {
+IncrementalExecutor::runStaticInitializersOnce(const Transaction& T,
+                                               PerfStat* Stat /*=0*/) {
   llvm::Module* m = T.getModule();
   assert(m && "Module must not be null");
 
@@ -240,36 +269,49 @@ IncrementalExecutor::runStaticInitializersOnce(const Transaction& T) {
 
   //SmallVector<Function*, 2> initFuncs;
 
-  for (unsigned i = 0, e = InitList->getNumOperands(); i != e; ++i) {
-    llvm::ConstantStruct *CS
-      = llvm::dyn_cast<llvm::ConstantStruct>(InitList->getOperand(i));
-    if (CS == 0) continue;
-
-    llvm::Constant *FP = CS->getOperand(1);
-    if (FP->isNullValue())
-      continue;  // Found a sentinal value, ignore.
-
-    // Strip off constant expression casts.
-    if (llvm::ConstantExpr *CE = llvm::dyn_cast<llvm::ConstantExpr>(FP))
-      if (CE->isCast())
-        FP = CE->getOperand(0);
-
-    // Execute the ctor/dtor function!
-    if (llvm::Function *F = llvm::dyn_cast<llvm::Function>(FP)) {
-      const llvm::StringRef fName = F->getName();
-      executeInit(fName);
+  // Looking the initializers up has the JIT compile the module; do that
+  // before running any of them, so that the execution is measured alone.
+  llvm::SmallVector<InitFun_t, 4> initFuns;
+  {
+    PerfStat::Scope Measure(Stat, PerfStat::kCompilation);
+    for (unsigned i = 0, e = InitList->getNumOperands(); i != e; ++i) {
+      llvm::ConstantStruct *CS
+        = llvm::dyn_cast<llvm::ConstantStruct>(InitList->getOperand(i));
+      if (CS == 0) continue;
+
+      llvm::Constant *FP = CS->getOperand(1);
+      if (FP->isNullValue())
+        continue;  // Found a sentinal value, ignore.
+
+      // Strip off constant expression casts.
+      if (llvm::ConstantExpr *CE = llvm::dyn_cast<llvm::ConstantExpr>(FP))
+        if (CE->isCast())
+          FP = CE->getOperand(0);
+
+      // Resolve the ctor/dtor function.
+      if (llvm::Function *F = llvm::dyn_cast<llvm::Function>(FP)) {
+        const llvm::StringRef fName = F->getName();
+        InitFun_t fun;
+        if (executeInitOrWrapper(fName, fun) == kExeSuccess)
+          initFuns.push_back(fun);
 /*
-      initFuncs.push_back(F);
-      if (fName.startswith("_GLOBAL__sub_I_")) {
-        BasicBlock& BB = F->getEntryBlock();
-        for (BasicBlock::iterator I = BB.begin(), E = BB.end(); I != E; ++I)
-          if (CallInst* call = dyn_cast<CallInst>(I))
-            initFuncs.push_back(call->getCalledFunction());
-      }
+        initFuncs.push_back(F);
+        if (fName.startswith("_GLOBAL__sub_I_")) {
+          BasicBlock& BB = F->getEntryBlock();
+          for (BasicBlock::iterator I = BB.begin(), E = BB.end(); I != E; ++I)
+            if (CallInst* call = dyn_cast<CallInst>(I))
+              initFuncs.push_back(call->getCalledFunction());
+        }
 */
+      }
     }
   }
 
+  PerfStat::Scope Measure(Stat, PerfStat::kExecution);
+  for (InitFun_t fun: initFuns)
+    if (executeInit(fun) == kExeExecutorCrashed)
+      return kExeExecutorCrashed;
+
 /*
   for (SmallVector<Function*,2>::iterator I = initFuncs.begin(),
          E = initFuncs.end(); I != E; ++I) {
@@ -298,14 +340,20 @@ IncrementalExecutor::runStaticInitializersOnce(const Transaction& T) {
 
 void IncrementalExecutor::runAndRemoveStaticDestructors(Transaction* T) {
   assert(T && "Must be set");
-  // Collect all the dtors bound to this transaction.
+  if (m_Process && m_Process->isActive())
+    m_Process->runDestructors(T->getModule());
+  runAndRemoveStaticDestructors(T->getModule());
+}
+
+void IncrementalExecutor::runAndRemoveStaticDestructors(const llvm::Module* M) {
+  // Collect all the dtors bound to this module.
   AtExitFunctions boundToT;
 
   {
     cling::internal::SpinLockGuard slg(m_AtExitFuncsSpinLock);
     for (AtExitFunctions::iterator I = m_AtExitFuncs.begin();
          I != m_AtExitFuncs.end();)
-      if (I->m_FromM == T->getModule()) {
+      if (I->m_FromM == M) {
         boundToT.push_back(*I);
         I = m_AtExitFuncs.erase(I);
       }
@@ -321,6 +369,64 @@ void IncrementalExecutor::runAndRemoveStaticDestructors(Transaction* T) {
   }
 }
 
+void IncrementalExecutor::activateExecutorProcess() {
+  if (m_Process)
+    m_Process->activate();
+}
+
+ExecutorProcess* IncrementalExecutor::getExecutorProcess() const {
+  return m_Process && m_Process->isActive() ? m_Process.get() : nullptr;
+}
+
+bool IncrementalExecutor::runsInExecutor() const {
+  return !m_ForceInProcess && m_Process && m_Process->isActive();
+}
+
+bool IncrementalExecutor::beginIsolation() {
+  // Nested scopes are undone by the outermost one.
+  if (!runsInExecutor())
+    return false;
+  m_Process->saveSections();
+  return true;
+}
+
+void IncrementalExecutor::endIsolation() {
+  m_Process->restoreSections();
+}
+
+IncrementalExecutor::ExecutionResult
+IncrementalExecutor::executeInExecutor(void* fun, Value* returnValue,
+                                       bool directResult) {
+  switch (m_Process->call((uint64_t)fun, returnValue, directResult)) {
+  case ExecutorProcess::kSuccess: return kExeSuccess;
+  case ExecutorProcess::kCrashed: return kExeExecutorCrashed;
+  case ExecutorProcess::kFailure: break;
+  }
+  // The executor could not be started; run the code here.
+  InProcessRAII IP(this);
+  typedef void (*WrapperFun_t)(void*);
+  void* arg = directResult ? (void*)&returnValue->getULL() : returnValue;
+  ((WrapperFun_t)fun)(arg);
+  return kExeSuccess;
+}
+
+IncrementalExecutor::ExecutionResult
+IncrementalExecutor::executeInitInExecutor(void* fun) {
+  switch (m_Process->runInit((uint64_t)fun, m_CurrentAtExitModule)) {
+  case ExecutorProcess::kSuccess: return kExeSuccess;
+  case ExecutorProcess::kCrashed: return kExeExecutorCrashed;
+  case ExecutorProcess::kFailure: break;
+  }
+  typedef void (*InitFun_t)();
+  ((InitFun_t)fun)();
+  return kExeSuccess;
+}
+
+void IncrementalExecutor::forgetModuleInExecutor(const llvm::Module* M) {
+  if (m_Process)
+    m_Process->forgetModule(M);
+}
+
 void
 IncrementalExecutor::installLazyFunctionCreator(LazyFunctionCreatorFunc_t fp)
 {
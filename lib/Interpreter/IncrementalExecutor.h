@@ -15,9 +15,11 @@
 #include "llvm/ADT/StringRef.h"
 
 #include "IncrementalJIT.h"
+#include "PerfStat.h"
 
 #include "cling/Interpreter/Transaction.h"
 #include "cling/Interpreter/Value.h"
+#include "cling/Utils/Trace.h"
 
 #include <vector>
 #include <set>
@@ -37,14 +39,26 @@ namespace llvm {
 }
 
 namespace cling {
+  class ExecutorProcess;
   class Value;
   class IncrementalJIT;
 
   class IncrementalExecutor {
+    friend class ExecutorProcess;
+
   public:
     typedef void* (*LazyFunctionCreatorFunc_t)(const std::string&);
 
   private:
+    ///\brief The process running the JITted code, if not this one. Declared
+    /// before m_JIT, whose memory manager allocates from it.
+    ///
+    std::unique_ptr<ExecutorProcess> m_Process;
+
+    ///\brief Whether code runs in this process even if m_Process is active.
+    ///
+    bool m_ForceInProcess;
+
     ///\brief Our JIT interface.
     ///
     std::unique_ptr<IncrementalJIT> m_JIT;
@@ -132,19 +146,71 @@ namespace cling {
     clang::DiagnosticsEngine& m_Diags;
 #endif
 
-    std::unique_ptr<llvm::TargetMachine>
-       CreateHostTargetMachine(const clang::CodeGenOptions& CGOpt) const;
+    ///\brief Saves the memory shared with the executor process before code
+    /// that would run there runs here, see InProcessRAII.
+    ///
+    ///\returns false if there is nothing to undo afterwards.
+    ///
+    bool beginIsolation();
+
+    ///\brief Undoes the writes into the memory shared with the executor
+    /// process since beginIsolation().
+    ///
+    void endIsolation();
 
   public:
+    ///\brief Creates a TargetMachine for the host.
+    ///
+    ///\param[in] CGOpt - Options providing the optimization level.
+    ///\param[in] forSharedLib - Generate position independent code, tuned
+    ///   for the host CPU, instead of code for the JIT.
+    ///
+    static std::unique_ptr<llvm::TargetMachine>
+       CreateHostTargetMachine(const clang::CodeGenOptions& CGOpt,
+                               bool forSharedLib = false);
+
     enum ExecutionResult {
       kExeSuccess,
       kExeFunctionNotCompiled,
       kExeUnresolvedSymbols,
+      kExeExecutorCrashed,
       kNumExeResults
     };
 
+    ///\brief Runs code in this process while in scope, e.g. for code that
+    /// calls back into the interpreter.
+    ///
+    struct InProcessRAII {
+      IncrementalExecutor* m_Exe;
+      bool m_Old;
+      bool m_Isolated;
+      ///\param [in] Isolate - Undo at the end of the scope what the code
+      ///   wrote into the memory shared with the executor process.
+      ///
+      InProcessRAII(IncrementalExecutor* Exe, bool Enable = true,
+                    bool Isolate = false):
+        m_Exe(Exe), m_Old(Exe ? Exe->m_ForceInProcess : false),
+        m_Isolated(false) {
+        if (m_Exe && Enable) {
+          m_Isolated = Isolate && m_Exe->beginIsolation();
+          m_Exe->m_ForceInProcess = true;
+        }
+      }
+      ~InProcessRAII() {
+        if (m_Exe) {
+          m_Exe->m_ForceInProcess = m_Old;
+          if (m_Isolated)
+            m_Exe->endIsolation();
+        }
+      }
+    };
+
+    ///\param [in] OutOfProcess - Prepare to run the code in an executor
+    ///   process, see activateExecutorProcess().
+    ///
     IncrementalExecutor(clang::DiagnosticsEngine& diags,
-                        const clang::CodeGenOptions& CGOpt);
+                        const clang::CodeGenOptions& CGOpt,
+                        bool OutOfProcess = false);
 
     ~IncrementalExecutor();
 
@@ -170,11 +236,22 @@ namespace cling {
         m_ModulesToJIT.erase(iMod);
       else
         m_JIT->removeModules((size_t)H.m_Opaque);
+      forgetModuleInExecutor(M);
       return true;
     }
 
+    ///\brief Renames a symbol of a transaction's modules in the JIT, see
+    /// IncrementalJIT::renameSymbol().
+    bool renameInJIT(Transaction::ExeUnloadHandle H, const std::string& Name,
+                     const std::string& NewName) {
+      return m_JIT->renameSymbol((size_t)H.m_Opaque, Name, NewName);
+    }
+
     ///\brief Run the static initializers of all modules collected to far.
-    ExecutionResult runStaticInitializersOnce(const Transaction& T);
+    ///\param[in] Stat - Gets the compilation and the execution of the
+    ///   initializers, if set.
+    ExecutionResult runStaticInitializersOnce(const Transaction& T,
+                                              PerfStat* Stat = 0);
 
     ///\brief Runs all destructors bound to the given transaction and removes
     /// them from the list.
@@ -182,19 +259,58 @@ namespace cling {
     ///
     void runAndRemoveStaticDestructors(Transaction* T);
 
+    ///\brief From now on, run code in the executor process, if there is one.
+    ///
+    void activateExecutorProcess();
+
+    ///\brief Returns the executor process, or null if code runs here.
+    ///
+    ExecutorProcess* getExecutorProcess() const;
+
+    ///\brief Whether the next wrapper or initializer runs in the executor.
+    ///
+    bool runsInExecutor() const;
+
     ///\brief Runs a wrapper function.
+    ///
+    ///\param[in] function - The wrapper's mangled name.
+    ///\param[in,out] returnValue - The Value the wrapper sets, if any.
+    ///\param[in] directResult - The wrapper stores its builtin result into
+    ///   the storage of returnValue, which the caller types once it returned.
+    ///\param[in] In - The transaction defining the wrapper, if known; later
+    ///   transactions might define a wrapper of the same name.
+    ///\param[in] Stat - Gets the compilation and the execution of the
+    ///   wrapper, if set.
     ExecutionResult executeWrapper(llvm::StringRef function,
-                                   Value* returnValue = 0) {
-      // Set the value to cling::invalid.
-      if (returnValue) {
+                                   Value* returnValue = 0,
+                                   bool directResult = false,
+                                   const Transaction* In = 0,
+                                   PerfStat* Stat = 0) {
+      void* arg = returnValue;
+      if (directResult) {
+        assert(returnValue && "Direct result without a Value!");
+        // All members of the storage union share its address.
+        arg = &returnValue->getULL();
+      } else if (returnValue) {
+        // Set the value to cling::invalid.
         *returnValue = Value();
       }
       typedef void (*InitFun_t)(void*);
       InitFun_t fun;
-      ExecutionResult res = executeInitOrWrapper(function, fun);
+      ExecutionResult res;
+      {
+        // Looking the wrapper up has the JIT compile its module.
+        utils::Trace::Span S("resolve", "execution", function);
+        PerfStat::Scope Measure(Stat, PerfStat::kCompilation);
+        res = executeInitOrWrapper(function, fun, In);
+      }
       if (res != kExeSuccess)
         return res;
-      (*fun)(returnValue);
+      utils::Trace::Span S("execute", "execution", function);
+      PerfStat::Scope Measure(Stat, PerfStat::kExecution);
+      if (runsInExecutor())
+        return executeInExecutor((void*)fun, returnValue, directResult);
+      (*fun)(arg);
       return kExeSuccess;
     }
 
@@ -240,6 +356,54 @@ namespace cling {
     ///param[in] GV - global value for which the address will be returned.
     void* getPointerToGlobalFromJIT(const llvm::GlobalValue& GV);
 
+    ///\brief Forwards to IncrementalJIT::retainCodeTables().
+    ///
+    void retainJITCodeTables() { m_JIT->retainCodeTables(); }
+
+    ///\brief Forwards to IncrementalJIT::releaseCodeTables().
+    ///
+    void releaseJITCodeTables() { m_JIT->releaseCodeTables(); }
+
+    ///\brief Forwards to IncrementalJIT::lookupCode().
+    ///
+    bool lookupJITCode(uint64_t Addr, std::string& Function, std::string& File,
+                       unsigned& Line) const {
+      return m_JIT->lookupCode(Addr, Function, File, Line);
+    }
+
+    ///\brief Forwards to IncrementalJIT::addDebugModule().
+    ///
+    unsigned addDebugModule(llvm::Module& M) {
+      return m_JIT->addDebugModule(M);
+    }
+
+    ///\brief Forwards to IncrementalJIT::getWritableSections().
+    ///
+    void getJITWritableSections(
+                 std::vector<std::pair<uintptr_t, uintptr_t>>& Ranges) const {
+      m_JIT->getWritableSections(Ranges);
+    }
+
+    ///\brief Forwards to IncrementalJIT::writePerfMap().
+    ///
+    void writePerfMap() const { m_JIT->writePerfMap(); }
+
+    ///\brief Forwards to IncrementalJIT::enableObjectCache().
+    ///
+    bool enableObjectCache(llvm::StringRef Dir) {
+      return m_JIT->enableObjectCache(Dir);
+    }
+
+    const JITObjectCache* getObjectCache() const {
+      return m_JIT->getObjectCache();
+    }
+
+    ///\brief Forwards to IncrementalJIT::setMaterializer().
+    ///
+    void setMaterializer(SymbolMaterializer* M, bool Lazily) {
+      m_JIT->setMaterializer(M, Lazily);
+    }
+
     ///\brief Keep track of the entities whose dtor we need to call.
     ///
     void AddAtExitFunc(void (*func) (void*), void* arg);
@@ -257,25 +421,46 @@ namespace cling {
     ///\brief Remember that the symbol could not be resolved by the JIT.
     void* HandleMissingFunction(const std::string& symbol);
 
-    ///\brief Runs an initializer function.
-    ExecutionResult executeInit(llvm::StringRef function) {
-      typedef void (*InitFun_t)();
-      InitFun_t fun;
-      ExecutionResult res = executeInitOrWrapper(function, fun);
-      if (res != kExeSuccess)
-        return res;
+    ///\brief Runs the destructors bound to M in this process.
+    ///
+    void runAndRemoveStaticDestructors(const llvm::Module* M);
+
+    ///\brief Runs a wrapper in the executor process.
+    ///
+    ExecutionResult executeInExecutor(void* fun, Value* returnValue,
+                                      bool directResult);
+
+    ///\brief Runs an initializer in the executor process.
+    ///
+    ExecutionResult executeInitInExecutor(void* fun);
+
+    ///\brief Tells the executor process that M is gone.
+    ///
+    void forgetModuleInExecutor(const llvm::Module* M);
+
+    typedef void (*InitFun_t)();
+
+    ///\brief Runs a resolved initializer function.
+    ExecutionResult executeInit(InitFun_t fun) {
+      if (runsInExecutor())
+        return executeInitInExecutor((void*)fun);
       (*fun)();
       return kExeSuccess;
     }
 
     template <class T>
-    ExecutionResult executeInitOrWrapper(llvm::StringRef funcname, T& fun) {
+    ExecutionResult executeInitOrWrapper(llvm::StringRef funcname, T& fun,
+                                         const Transaction* In = 0) {
       union {
         T fun;
         void* address;
       } p2f;
-      p2f.address = (void*)m_JIT->getSymbolAddress(funcname,
-                                                   false /*no dlsym*/);
+      if (In)
+        p2f.address = (void*)m_JIT->getSymbolAddressIn(
+                          (size_t)In->getExeUnloadHandle().m_Opaque, funcname);
+      else
+        p2f.address = (void*)m_JIT->getSymbolAddress(funcname,
+                                                     false /*no dlsym*/);
 
       // check if there is any unresolved symbol in the list
       if (diagnoseUnresolvedSymbols(funcname, "function") || !p2f.address) {
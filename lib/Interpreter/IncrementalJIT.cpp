@@ -9,11 +9,24 @@
 
 #include "IncrementalJIT.h"
 
+#include "ExecutorProcess.h"
 #include "IncrementalExecutor.h"
+#include "MemProfiler.h"
+#include "TransactionHeap.h"
 #include "cling/Utils/Platform.h"
 
+#include "llvm/ADT/StringExtras.h"
+#include "llvm/DebugInfo/DWARF/DWARFContext.h"
 #include "llvm/ExecutionEngine/Orc/LambdaResolver.h"
+#include "llvm/IR/Module.h"
+#include "llvm/Object/SymbolSize.h"
 #include "llvm/Support/DynamicLibrary.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/raw_ostream.h"
+
+#ifdef __linux__
+#include <unistd.h>
+#endif
 
 #ifdef __APPLE__
 // Apple adds an extra '_'
@@ -45,6 +58,81 @@ public:
   }
 };
 
+///\brief Memory manager placing all sections into the memory shared with
+/// the executor process, and resolving symbols as the executor sees them.
+class SharedArenaMemoryManager: public ClingMemoryManager {
+  cling::ExecutorProcess& m_Process;
+
+  ///\brief The code sections written since the last object was loaded,
+  /// still linked for the writable view of the arena.
+  std::vector<uint8_t*> m_UnmappedCode;
+
+public:
+  SharedArenaMemoryManager(cling::IncrementalExecutor& Exe,
+                           cling::ExecutorProcess& Process):
+    ClingMemoryManager(Exe), m_Process(Process) {}
+
+  uint8_t *allocateCodeSection(uintptr_t Size, unsigned Alignment,
+                               unsigned SectionID,
+                               StringRef SectionName) override {
+    uint8_t* Addr = m_Process.allocate(Size, Alignment, false /*Writable*/);
+    if (Addr)
+      m_UnmappedCode.push_back(Addr);
+    return Addr;
+  }
+
+  uint8_t *allocateDataSection(uintptr_t Size, unsigned Alignment,
+                               unsigned SectionID, StringRef SectionName,
+                               bool IsReadOnly) override {
+    return m_Process.allocate(Size, Alignment, !IsReadOnly);
+  }
+
+  using ClingMemoryManager::notifyObjectLoaded;
+
+  void notifyObjectLoaded(RuntimeDyld &Dyld,
+                          const object::ObjectFile &Obj) override {
+    // Relocate the code for where it runs; RuntimeDyld still writes it
+    // through the writable view.
+    for (uint8_t* Addr: m_UnmappedCode)
+      Dyld.mapSectionAddress(Addr, m_Process.getExecutableAddress(Addr));
+    m_UnmappedCode.clear();
+  }
+
+  bool finalizeMemory(std::string *ErrMsg = nullptr) override {
+    // Nothing to protect: the code runs from the executable view of the
+    // arena, which is never writable.
+    m_Process.finalizeSections();
+    return false;
+  }
+
+  void registerEHFrames(uint8_t *Addr, uint64_t LoadAddr,
+                        size_t Size) override {
+    ClingMemoryManager::registerEHFrames(Addr, LoadAddr, Size);
+    m_Process.registerEHFrames(Addr, Size);
+  }
+
+  void deregisterEHFrames(uint8_t *Addr, uint64_t LoadAddr,
+                          size_t Size) override {
+    ClingMemoryManager::deregisterEHFrames(Addr, LoadAddr, Size);
+    m_Process.deregisterEHFrames(Addr, Size);
+  }
+
+  uint64_t getSymbolAddress(const std::string &Name) override {
+    if (m_Process.isActive())
+      if (uint64_t Addr = m_Process.lookup(Name))
+        return Addr;
+    return ClingMemoryManager::getSymbolAddress(Name);
+  }
+};
+
+static std::unique_ptr<RTDyldMemoryManager>
+createMemoryManager(cling::IncrementalExecutor& Exe,
+                    cling::ExecutorProcess* Process) {
+  if (Process)
+    return llvm::make_unique<SharedArenaMemoryManager>(Exe, *Process);
+  return llvm::make_unique<ClingMemoryManager>(Exe);
+}
+
   class NotifyFinalizedT {
   public:
     NotifyFinalizedT(cling::IncrementalJIT &jit) : m_JIT(jit) {}
@@ -77,6 +165,12 @@ public:
     uint8_t *Addr =
       getExeMM()->allocateCodeSection(Size, Alignment, SectionID, SectionName);
     m_jit.m_SectionsAllocatedSinceLastLoad.insert(Addr);
+    if (Addr) {
+      // Where the code runs, which is where the profiles find it.
+      const uintptr_t Start = m_jit.m_Process
+        ? m_jit.m_Process->getExecutableAddress(Addr) : (uintptr_t)Addr;
+      m_jit.m_CodeSinceLastLoad.push_back(std::make_pair(Start, Start + Size));
+    }
     return Addr;
   }
 
@@ -86,6 +180,9 @@ public:
     uint8_t *Addr = getExeMM()->allocateDataSection(Size, Alignment, SectionID,
                                                     SectionName, IsReadOnly);
     m_jit.m_SectionsAllocatedSinceLastLoad.insert(Addr);
+    if (Addr && !IsReadOnly)
+      m_jit.m_WritableSinceLastLoad.push_back(
+                      std::make_pair((uintptr_t)Addr, (uintptr_t)Addr + Size));
     return Addr;
   }
 
@@ -129,6 +226,11 @@ public:
     return getExeMM()->notifyObjectLoaded(EE, O);
   }
 
+  void notifyObjectLoaded(RuntimeDyld &Dyld,
+                          const object::ObjectFile &O) override {
+    return getExeMM()->notifyObjectLoaded(Dyld, O);
+  }
+
   bool finalizeMemory(std::string *ErrMsg = nullptr) override {
     // Each set of objects loaded will be finalized exactly once, but since
     // symbol lookup during relocation may recursively trigger the
@@ -151,15 +253,20 @@ public:
 }; // class Azog
 
 IncrementalJIT::IncrementalJIT(IncrementalExecutor& exe,
-                               std::unique_ptr<TargetMachine> TM):
+                               std::unique_ptr<TargetMachine> TM,
+                               ExecutorProcess* Process):
   m_Parent(exe),
   m_TM(std::move(TM)),
   m_TMDataLayout(m_TM->createDataLayout()),
-  m_ExeMM(llvm::make_unique<ClingMemoryManager>(m_Parent)),
+  m_ExeMM(createMemoryManager(m_Parent, Process)),
+  m_Process(Process),
   m_NotifyObjectLoaded(*this),
-  m_ObjectLayer(m_SymbolMap, m_NotifyObjectLoaded, NotifyFinalizedT(*this)),
+  m_ObjectLayer(*this, m_NotifyObjectLoaded, NotifyFinalizedT(*this)),
   m_CompileLayer(m_ObjectLayer, llvm::orc::SimpleCompiler(*m_TM)),
-  m_LazyEmitLayer(m_CompileLayer) {
+  m_LazyEmitLayer(m_CompileLayer),
+  m_Materializer(nullptr),
+  m_NumCodeTableUsers(0),
+  m_SymbolsByAddressValid(false) {
 
   // Enable JIT symbol resolution from the binary.
   llvm::sys::DynamicLibrary::LoadLibraryPermanently(0, 0);
@@ -205,6 +312,17 @@ IncrementalJIT::getInjectedSymbols(const std::string& Name) const {
                      llvm::JITSymbolFlags::Exported);
   }
 
+  // Route the allocations of the session's code to the transaction heaps,
+  // else of code linked while profiling memory through the profiler's hooks.
+  StringRef Unprefixed(Name);
+  if (Unprefixed.startswith(MANGLE_PREFIX)) {
+    Unprefixed = Unprefixed.drop_front(strlen(MANGLE_PREFIX));
+    if (uint64_t Hook = TransactionHeap::getHook(Unprefixed))
+      return JITSymbol(Hook, llvm::JITSymbolFlags::Exported);
+    if (uint64_t Hook = MemProfiler::getHook(Unprefixed))
+      return JITSymbol(Hook, llvm::JITSymbolFlags::Exported);
+  }
+
   auto SymMapI = m_SymbolMap.find(Name);
   if (SymMapI != m_SymbolMap.end())
     return JITSymbol(SymMapI->second, llvm::JITSymbolFlags::Exported);
@@ -255,9 +373,105 @@ IncrementalJIT::getSymbolAddressWithoutMangling(const std::string& Name,
   if (auto Sym = m_LazyEmitLayer.findSymbol(Name, false))
     return Sym;
 
+  return materializeSymbol(Name);
+}
+
+uint64_t IncrementalJIT::getSymbolAddressIn(size_t handle,
+                                            const std::string& Name) {
+  if (handle == (size_t)-1)
+    return getSymbolAddress(Name, false /*no dlsym*/);
+  return m_LazyEmitLayer.findSymbolIn(m_UnloadPoints[handle], Mangle(Name),
+                                      false).getAddress();
+}
+
+bool IncrementalJIT::renameSymbol(size_t handle, const std::string& Name,
+                                  const std::string& NewName) {
+  if (handle == (size_t)-1)
+    return false;
+  const uint64_t Addr = getSymbolAddressIn(handle, Name);
+  if (!Addr)
+    return false;
+  const std::string Mangled = Mangle(Name);
+  const std::string NewMangled = Mangle(NewName);
+
+  // The object set whose code holds the symbol.
+  const void* ObjSet = nullptr;
+  for (auto&& Code: m_CodeSections) {
+    for (auto&& Range: Code.second) {
+      if (Addr >= Range.first && Addr < Range.second) {
+        ObjSet = Code.first;
+        break;
+      }
+    }
+    if (ObjSet)
+      break;
+  }
+  if (!ObjSet || !m_ObjectLayer.renameSymbol(ObjSet, Mangled, NewMangled))
+    return false;
+
+  auto I = m_SymbolMap.find(Mangled);
+  if (I != m_SymbolMap.end() && I->second == Addr)
+    m_SymbolMap.erase(I);
+  m_SymbolMap[NewMangled] = Addr;
+  auto F = m_Functions.find(Addr);
+  if (F != m_Functions.end() && F->second.Name == Mangled)
+    F->second.Name = NewMangled;
+  m_SymbolsByAddressValid = false;
+  return true;
+}
+
+llvm::orc::JITSymbol
+IncrementalJIT::materializeSymbol(const std::string& Name) {
+  StringRef Unprefixed(Name);
+  if (!m_Materializer || !Unprefixed.startswith(MANGLE_PREFIX))
+    return llvm::orc::JITSymbol(nullptr);
+  Unprefixed = Unprefixed.drop_front(strlen(MANGLE_PREFIX));
+  if (!m_Materializer->canMaterialize(Unprefixed))
+    return llvm::orc::JITSymbol(nullptr);
+
+  if (m_StubsMgr) {
+    if (auto Stub = m_StubsMgr->findStub(Name, false))
+      return Stub;
+    // The stub calls the trampoline until the function is generated.
+    auto Callback = m_CallbackMgr->getCompileCallback();
+    const std::string NameNoPrefix = Unprefixed.str();
+    Callback.setCompileAction([this, Name, NameNoPrefix]()
+                              -> llvm::orc::TargetAddress {
+      if (llvm::orc::TargetAddress Addr = emitMaterialized(Name)) {
+        if (auto Err = m_StubsMgr->updatePointer(Name, Addr))
+          consumeError(std::move(Err));
+        return Addr;
+      }
+      // Report the missing symbol like any other.
+      return (uint64_t)getParent().NotifyLazyFunctionCreators(NameNoPrefix);
+    });
+    if (auto Err = m_StubsMgr->createStub(Name, Callback.getAddress(),
+                                          llvm::JITSymbolFlags::Exported))
+      consumeError(std::move(Err));
+    else
+      return m_StubsMgr->findStub(Name, false);
+  }
+
+  if (llvm::orc::TargetAddress Addr = emitMaterialized(Name))
+    return llvm::orc::JITSymbol(Addr, llvm::JITSymbolFlags::Exported);
   return llvm::orc::JITSymbol(nullptr);
 }
 
+llvm::orc::TargetAddress
+IncrementalJIT::emitMaterialized(const std::string& Name) {
+  // A stub called after setMaterializer(nullptr, ...).
+  if (!m_Materializer)
+    return 0;
+  llvm::Module* M
+    = m_Materializer->materialize(StringRef(Name).drop_front(
+                                                    strlen(MANGLE_PREFIX)));
+  if (!M)
+    return 0;
+  // The module stays for the session; no transaction unloads it.
+  addModules(std::vector<llvm::Module*>(1, M));
+  return m_LazyEmitLayer.findSymbol(Name, false).getAddress();
+}
+
 size_t IncrementalJIT::addModules(std::vector<llvm::Module*>&& modules) {
   // If this module doesn't have a DataLayout attached then attach the
   // default.
@@ -311,6 +525,221 @@ size_t IncrementalJIT::addModules(std::vector<llvm::Module*>&& modules) {
 // }
 
 
+void IncrementalJIT::recordObject(const void* ObjSet,
+                                  const object::ObjectFile& Obj,
+                                  const RuntimeDyld::LoadedObjectInfo& Info) {
+  for (const auto& SymSize: object::computeSymbolSizes(Obj)) {
+    const object::SymbolRef& Sym = SymSize.first;
+    if (Sym.getType() != object::SymbolRef::ST_Function || !SymSize.second)
+      continue;
+    Expected<StringRef> Name = Sym.getName();
+    if (!Name) {
+      consumeError(Name.takeError());
+      continue;
+    }
+    Expected<uint64_t> Addr = Sym.getAddress();
+    if (!Addr) {
+      consumeError(Addr.takeError());
+      continue;
+    }
+    Expected<object::section_iterator> Sec = Sym.getSection();
+    if (!Sec) {
+      consumeError(Sec.takeError());
+      continue;
+    }
+    if (*Sec == Obj.section_end())
+      continue;
+    const uint64_t Start = Info.getSectionLoadAddress(**Sec)
+      + *Addr - (*Sec)->getAddress();
+    m_Functions[Start] = FunctionRange{Start + SymSize.second, *Name, ObjSet};
+  }
+
+  for (const object::SectionRef& Sec: Obj.sections()) {
+    StringRef SecName;
+    if (Sec.getName(SecName) || !SecName.endswith("debug_line"))
+      continue;
+    DebugObject D;
+    D.Obj = Info.getObjectForDebug(Obj);
+    if (!D.Obj.getBinary())
+      break;
+    D.Context.reset(new DWARFContextInMemory(*D.Obj.getBinary()));
+    m_DebugObjects[ObjSet].push_back(std::move(D));
+    break;
+  }
+}
+
+void IncrementalJIT::forgetObjectSet(const void* ObjSet) {
+  for (auto I = m_Functions.begin(); I != m_Functions.end();) {
+    if (I->second.ObjSet == ObjSet) {
+      m_ShadowFunctions.erase(I->first);
+      I = m_Functions.erase(I);
+    } else
+      ++I;
+  }
+  m_DebugObjects.erase(ObjSet);
+  m_WritableSections.erase(ObjSet);
+  m_CodeSections.erase(ObjSet);
+  m_SymbolsByAddressValid = false;
+}
+
+void IncrementalJIT::getWritableSections(
+                  std::vector<std::pair<uintptr_t, uintptr_t>>& Ranges) const {
+  for (auto&& Sections: m_WritableSections)
+    Ranges.insert(Ranges.end(), Sections.second.begin(),
+                  Sections.second.end());
+}
+
+bool IncrementalJIT::lookupSymbol(uint64_t Addr,
+                                  std::string& Function) const {
+  if (!m_SymbolsByAddressValid) {
+    m_CodeRanges.clear();
+    m_SymbolsByAddress.clear();
+    for (auto&& Sections: m_CodeSections)
+      for (auto&& Section: Sections.second)
+        m_CodeRanges[Section.first] = Section.second;
+    for (auto&& Sym: m_SymbolMap)
+      m_SymbolsByAddress.insert(std::make_pair(Sym.second, Sym.first().str()));
+    m_SymbolsByAddressValid = true;
+  }
+
+  auto R = m_CodeRanges.upper_bound(Addr);
+  if (R == m_CodeRanges.begin() || Addr >= (--R)->second)
+    return false;
+  // Without sizes, the closest symbol in the same section.
+  auto S = m_SymbolsByAddress.upper_bound(Addr);
+  if (S == m_SymbolsByAddress.begin() || (--S)->first < R->first)
+    return false;
+  Function = S->second;
+  return true;
+}
+
+bool IncrementalJIT::lookupCode(uint64_t Addr, std::string& Function,
+                                std::string& File, unsigned& Line) const {
+  File.clear();
+  Line = 0;
+  auto I = m_Functions.upper_bound(Addr);
+  if (I == m_Functions.begin() || Addr >= std::prev(I)->second.End)
+    return lookupSymbol(Addr, Function);
+  --I;
+
+  Function = I->second.Name;
+  const DILineInfoSpecifier Spec(
+                     DILineInfoSpecifier::FileLineInfoKind::AbsoluteFilePath,
+                     DILineInfoSpecifier::FunctionNameKind::None);
+  auto D = m_DebugObjects.find(I->second.ObjSet);
+  if (D != m_DebugObjects.end()) {
+    for (const DebugObject& Obj: D->second) {
+      DILineInfo LineInfo = Obj.Context->getLineInfoForAddress(Addr, Spec);
+      if (LineInfo.Line) {
+        File = LineInfo.FileName;
+        Line = LineInfo.Line;
+        return true;
+      }
+    }
+  }
+  auto S = m_ShadowFunctions.find(I->first);
+  if (S != m_ShadowFunctions.end()) {
+    DILineInfo LineInfo = S->second.Obj->Context->getLineInfoForAddress(
+                               S->second.Start + (Addr - I->first), Spec);
+    if (LineInfo.Line) {
+      File = LineInfo.FileName;
+      Line = LineInfo.Line;
+    }
+  }
+  return true;
+}
+
+unsigned IncrementalJIT::addDebugModule(llvm::Module& M) {
+  // The object is not loaded, so all its sections start at 0: put all code
+  // into one, such that the addresses in the line tables are unique.
+  for (Function& F: M)
+    F.setComdat(nullptr);
+  M.setDataLayout(m_TMDataLayout);
+
+  auto Shadow = std::make_shared<DebugObject>();
+  Shadow->Obj = llvm::orc::SimpleCompiler(*m_TM)(M);
+  const object::ObjectFile* Obj = Shadow->Obj.getBinary();
+  if (!Obj)
+    return 0;
+  Shadow->Context.reset(new DWARFContextInMemory(*Obj));
+
+  // The functions of the object by name, with their start and size.
+  StringMap<std::pair<uint64_t, uint64_t>> ShadowRanges;
+  for (const auto& SymSize: object::computeSymbolSizes(*Obj)) {
+    const object::SymbolRef& Sym = SymSize.first;
+    if (Sym.getType() != object::SymbolRef::ST_Function || !SymSize.second)
+      continue;
+    Expected<StringRef> Name = Sym.getName();
+    if (!Name) {
+      consumeError(Name.takeError());
+      continue;
+    }
+    Expected<uint64_t> Addr = Sym.getAddress();
+    if (!Addr) {
+      consumeError(Addr.takeError());
+      continue;
+    }
+    ShadowRanges[*Name] = std::make_pair(*Addr, SymSize.second);
+  }
+
+  unsigned NumFunctions = 0;
+  for (auto&& F: m_Functions) {
+    if (m_DebugObjects.count(F.second.ObjSet)
+        || m_ShadowFunctions.count(F.first))
+      continue;
+    auto R = ShadowRanges.find(F.second.Name);
+    // A different size means different code, e.g. for a function with
+    // internal linkage that merely has the same name.
+    if (R == ShadowRanges.end()
+        || R->second.second != F.second.End - F.first)
+      continue;
+    m_ShadowFunctions[F.first] = ShadowFunction{Shadow, R->second.first};
+    ++NumFunctions;
+  }
+  return NumFunctions;
+}
+
+bool IncrementalJIT::enableObjectCache(StringRef Dir) {
+  if (std::error_code EC = sys::fs::create_directories(Dir)) {
+    errs() << "cling: cannot create the JIT cache " << Dir << ": "
+           << EC.message() << '\n';
+    return false;
+  }
+  m_ObjectCache.reset(new JITObjectCache(Dir, *m_TM));
+  m_CompileLayer.setObjectCache(m_ObjectCache.get());
+  return true;
+}
+
+void IncrementalJIT::setMaterializer(SymbolMaterializer* M, bool Lazily) {
+  m_Materializer = M;
+  if (!M || !Lazily || m_StubsMgr)
+    return;
+  const Triple& T = m_TM->getTargetTriple();
+  auto StubsMgrBuilder = llvm::orc::createLocalIndirectStubsManagerBuilder(T);
+  m_CallbackMgr = llvm::orc::createLocalCompileCallbackManager(T, 0);
+  // Else functions are generated when first referenced.
+  if (!StubsMgrBuilder || !m_CallbackMgr) {
+    m_CallbackMgr.reset();
+    return;
+  }
+  m_StubsMgr = StubsMgrBuilder();
+}
+
+void IncrementalJIT::writePerfMap() const {
+#ifdef __linux__
+  const std::string Path = "/tmp/perf-" + utostr(::getpid()) + ".map";
+  std::error_code EC;
+  raw_fd_ostream Out(Path, EC, sys::fs::F_Text);
+  if (EC) {
+    errs() << "cling: cannot write " << Path << ": " << EC.message() << '\n';
+    return;
+  }
+  for (auto&& F: m_Functions)
+    Out << utohexstr(F.first) << ' ' << utohexstr(F.second.End - F.first)
+        << ' ' << F.second.Name << '\n';
+#endif
+}
+
 void IncrementalJIT::removeModules(size_t handle) {
   if (handle == (size_t)-1)
     return;
@@ -16,10 +16,14 @@
 #include <string>
 #include <vector>
 
+#include "JITObjectCache.h"
+
 #include "llvm/IR/Mangler.h"
 #include "llvm/IR/GlobalValue.h"
+#include "llvm/DebugInfo/DIContext.h"
 #include "llvm/ExecutionEngine/JITEventListener.h"
 #include "llvm/ExecutionEngine/Orc/CompileUtils.h"
+#include "llvm/ExecutionEngine/Orc/IndirectionUtils.h"
 #include "llvm/ExecutionEngine/Orc/IRCompileLayer.h"
 #include "llvm/ExecutionEngine/Orc/LazyEmittingLayer.h"
 #include "llvm/ExecutionEngine/Orc/ObjectLinkingLayer.h"
@@ -33,8 +37,25 @@ class RTDyldMemoryManager;
 
 namespace cling {
 class Azog;
+class ExecutorProcess;
 class IncrementalExecutor;
 
+///\brief Generates the code of symbols that no module added to the JIT
+/// defines, when the JIT needs them; see IncrementalJIT::setMaterializer().
+class SymbolMaterializer {
+public:
+  virtual ~SymbolMaterializer() {}
+
+  ///\brief Whether materialize() can define the symbol.
+  /// \param Name - the symbol's name, without the platform's prefix
+  virtual bool canMaterialize(llvm::StringRef Name) const = 0;
+
+  ///\brief Generates a module defining the symbol.
+  /// \param Name - the symbol's name, without the platform's prefix
+  /// \returns the module, owned by the materializer, or null on errors
+  virtual llvm::Module* materialize(llvm::StringRef Name) = 0;
+};
+
 class IncrementalJIT {
 public:
   using SymbolMapT = llvm::StringMap<llvm::orc::TargetAddress>;
@@ -63,6 +84,9 @@ private:
       m_JIT.m_UnfinalizedSections[H]
         = std::move(m_JIT.m_SectionsAllocatedSinceLastLoad);
       m_JIT.m_SectionsAllocatedSinceLastLoad = SectionAddrSet();
+      m_JIT.m_WritableSections[H->get()]
+        = std::move(m_JIT.m_WritableSinceLastLoad);
+      m_JIT.m_WritableSinceLastLoad.clear();
       assert(Objects.size() == Infos.size() &&
              "Incorrect number of Infos for Objects.");
       if (auto GDBListener = m_JIT.m_GDBListener) {
@@ -71,6 +95,13 @@ private:
                                            *Infos[I]);
       }
 
+      m_JIT.m_CodeSections[H->get()] = std::move(m_JIT.m_CodeSinceLastLoad);
+      m_JIT.m_CodeSinceLastLoad.clear();
+      if (m_JIT.m_NumCodeTableUsers) {
+        for (size_t I = 0, N = Objects.size(); I < N; ++I)
+          m_JIT.recordObject(H->get(), *Objects[I]->getBinary(), *Infos[I]);
+      }
+
       for (const auto &Object: Objects) {
         for (const auto &Symbol: Object->getBinary()->symbols()) {
           auto Flags = Symbol.getFlags();
@@ -92,6 +123,7 @@ private:
           }
         }
       }
+      m_JIT.m_SymbolsByAddressValid = false;
     }
 
   private:
@@ -104,10 +136,10 @@ private:
     using Base_t = llvm::orc::ObjectLinkingLayer<NotifyObjectLoadedT>;
     using NotifyLoadedFtor = NotifyObjectLoadedT;
     using NotifyFinalizedFtor = Base_t::NotifyFinalizedFtor;
-    RemovableObjectLinkingLayer(SymbolMapT &SymMap,
+    RemovableObjectLinkingLayer(IncrementalJIT &JIT,
                                 NotifyObjectLoadedT NotifyLoaded,
                    NotifyFinalizedFtor NotifyFinalized = NotifyFinalizedFtor()):
-      Base_t(NotifyLoaded, NotifyFinalized), m_SymbolMap(SymMap)
+      Base_t(NotifyLoaded, NotifyFinalized), m_JIT(JIT)
     {}
 
     void removeObjectSet(llvm::orc::ObjectLinkingLayerBase::ObjSetHandleT H) {
@@ -121,17 +153,39 @@ private:
       const AccessSymbolTable* HSymTable
         = static_cast<const AccessSymbolTable*>(H->get());
       for (auto&& NameSym: HSymTable->getSymbolTable()) {
-        auto iterSymMap = m_SymbolMap.find(NameSym.first());
-        if (iterSymMap == m_SymbolMap.end())
+        auto iterSymMap = m_JIT.m_SymbolMap.find(NameSym.first());
+        if (iterSymMap == m_JIT.m_SymbolMap.end())
           continue;
         // Is this this symbol (address)?
         if (iterSymMap->second == NameSym.second.getAddress())
-          m_SymbolMap.erase(iterSymMap);
+          m_JIT.m_SymbolMap.erase(iterSymMap);
       }
+      m_JIT.forgetObjectSet(H->get());
       llvm::orc::ObjectLinkingLayer<NotifyObjectLoadedT>::removeObjectSet(H);
     }
+
+    ///\brief Renames a symbol in the symbol table of a linked object set.
+    /// \returns false if the object set does not define the symbol
+    bool renameSymbol(const void* ObjSet, llvm::StringRef Name,
+                      llvm::StringRef NewName) {
+      struct AccessSymbolTable: public LinkedObjectSet {
+        llvm::StringMap<llvm::RuntimeDyld::SymbolInfo>& getSymbolTable() {
+          return SymbolTable;
+        }
+      };
+      auto& Table = static_cast<AccessSymbolTable*>(
+             const_cast<LinkedObjectSet*>(
+               static_cast<const LinkedObjectSet*>(ObjSet)))->getSymbolTable();
+      auto I = Table.find(Name);
+      if (I == Table.end())
+        return false;
+      llvm::RuntimeDyld::SymbolInfo Sym = I->second;
+      Table.erase(I);
+      Table.insert(std::make_pair(NewName, Sym));
+      return true;
+    }
   private:
-    SymbolMapT& m_SymbolMap;
+    IncrementalJIT& m_JIT;
   };
 
   typedef RemovableObjectLinkingLayer ObjectLayerT;
@@ -146,12 +200,27 @@ private:
   /// IncrementalExecutor to handle missing or special symbols.
   std::unique_ptr<llvm::RTDyldMemoryManager> m_ExeMM;
 
+  ///\brief The executor process the code is placed for, if any.
+  ExecutorProcess* m_Process;
+
   NotifyObjectLoadedT m_NotifyObjectLoaded;
 
   ObjectLayerT m_ObjectLayer;
   CompileLayerT m_CompileLayer;
   LazyEmitLayerT m_LazyEmitLayer;
 
+  ///\brief The objects of earlier sessions, if enabled.
+  std::unique_ptr<JITObjectCache> m_ObjectCache;
+
+  ///\brief Generates the symbols no module defines, if set.
+  SymbolMaterializer* m_Materializer;
+
+  ///\brief The stubs standing in for materializable functions until their
+  /// first call, and the trampolines the stubs point to meanwhile; null
+  /// if the functions are materialized when referenced.
+  std::unique_ptr<llvm::orc::JITCompileCallbackManager> m_CallbackMgr;
+  std::unique_ptr<llvm::orc::IndirectStubsManager> m_StubsMgr;
+
   // We need to store ObjLayerT::ObjSetHandles for each of the object sets
   // that have been emitted but not yet finalized so that we can forward the
   // mapSectionAddress calls appropriately.
@@ -166,10 +235,76 @@ private:
   std::map<ObjectLayerT::ObjSetHandleT, SectionAddrSet, ObjSetHandleCompare>
     m_UnfinalizedSections;
 
+  ///\brief The writable data sections of the loaded objects, start and
+  /// end, by linked object set.
+  std::map<const void*, std::vector<std::pair<uintptr_t, uintptr_t>>>
+    m_WritableSections;
+  std::vector<std::pair<uintptr_t, uintptr_t>> m_WritableSinceLastLoad;
+
   ///\brief Vector of ModuleSetHandleT. UnloadHandles index into that
   /// vector.
   std::vector<ModuleSetHandleT> m_UnloadPoints;
 
+  ///\brief Where a JITted function ended up.
+  struct FunctionRange {
+    uint64_t End;
+    std::string Name;
+    ///\brief The linked object set defining the function.
+    const void* ObjSet;
+  };
+
+  ///\brief The JITted functions by start address.
+  std::map<uint64_t, FunctionRange> m_Functions;
+
+  ///\brief An object file with debug info, relocated to where it was loaded.
+  struct DebugObject {
+    llvm::object::OwningBinary<llvm::object::ObjectFile> Obj;
+    std::unique_ptr<llvm::DIContext> Context;
+  };
+
+  ///\brief The objects with line tables, by linked object set.
+  std::map<const void*, std::vector<DebugObject>> m_DebugObjects;
+
+  ///\brief A function compiled without debug info, located in an object
+  /// compiled from the same declarations with debug info, see
+  /// addDebugModule().
+  struct ShadowFunction {
+    std::shared_ptr<DebugObject> Obj;
+    ///\brief The function's address in Obj.
+    uint64_t Start;
+  };
+
+  ///\brief The shadows of JITted functions by start address.
+  std::map<uint64_t, ShadowFunction> m_ShadowFunctions;
+
+  ///\brief How many users need the functions and line tables of the
+  /// objects loaded meanwhile, see retainCodeTables().
+  unsigned m_NumCodeTableUsers;
+
+  ///\brief The code sections of the loaded objects, start and end, by
+  /// linked object set.
+  std::map<const void*, std::vector<std::pair<uintptr_t, uintptr_t>>>
+    m_CodeSections;
+  std::vector<std::pair<uintptr_t, uintptr_t>> m_CodeSinceLastLoad;
+
+  ///\brief m_CodeSections and m_SymbolMap by address, for the code loaded
+  /// while no one needed its functions; rebuilt by the first lookupSymbol()
+  /// after objects were loaded or removed.
+  mutable std::map<uint64_t, uint64_t> m_CodeRanges;
+  mutable std::map<uint64_t, std::string> m_SymbolsByAddress;
+  mutable bool m_SymbolsByAddressValid;
+
+  ///\brief Finds the symbol at or before an address in JITted code.
+  /// \returns false if Addr is not in a JITted code section
+  bool lookupSymbol(uint64_t Addr, std::string& Function) const;
+
+  ///\brief Records the functions and line tables of a loaded object.
+  void recordObject(const void* ObjSet, const llvm::object::ObjectFile& Obj,
+                    const llvm::RuntimeDyld::LoadedObjectInfo& Info);
+
+  ///\brief Forgets what recordObject() recorded for an object set.
+  void forgetObjectSet(const void* ObjSet);
+
 
   std::string Mangle(llvm::StringRef Name) {
     std::string MangledName;
@@ -183,9 +318,19 @@ private:
 
   llvm::orc::JITSymbol getInjectedSymbols(const std::string& Name) const;
 
+  ///\brief Asks the SymbolMaterializer for a symbol no module defines.
+  llvm::orc::JITSymbol materializeSymbol(const std::string& Name);
+
+  ///\brief Adds the materialized module defining a symbol to the JIT.
+  /// \returns the symbol's address, or 0 on errors
+  llvm::orc::TargetAddress emitMaterialized(const std::string& Name);
+
 public:
+  ///\param [in] Process - If set, place the JITted code where the executor
+  ///   process can run it.
   IncrementalJIT(IncrementalExecutor& exe,
-                 std::unique_ptr<llvm::TargetMachine> TM);
+                 std::unique_ptr<llvm::TargetMachine> TM,
+                 ExecutorProcess* Process = nullptr);
 
   ///\brief Get the address of a symbol from the JIT or the memory manager,
   /// mangling the name as needed. Use this to resolve symbols as coming
@@ -199,6 +344,13 @@ public:
       .getAddress();
   }
 
+  ///\brief Get the address of a symbol defined by the modules added under a
+  /// handle, even if earlier modules define it as well.
+  /// \param handle - what addModules() returned; (size_t)-1 looks for the
+  ///   symbol in all modules, like getSymbolAddress().
+  /// \param Name - name to look for, mangled as needed.
+  uint64_t getSymbolAddressIn(size_t handle, const std::string& Name);
+
   ///\brief Get the address of a symbol from the JIT or the memory manager.
   /// Use this to resolve symbols of known, target-specific names.
   llvm::orc::JITSymbol getSymbolAddressWithoutMangling(const std::string& Name,
@@ -207,8 +359,72 @@ public:
   size_t addModules(std::vector<llvm::Module*>&& modules);
   void removeModules(size_t handle);
 
+  ///\brief Renames a symbol defined by the modules added under a handle, in
+  /// the JIT's symbol tables and the recorded functions, such that later
+  /// modules can define the old name without the JIT seeing it twice. The
+  /// code stays where it is.
+  /// \param handle - what addModules() returned.
+  /// \param Name, NewName - the names, mangled as needed.
+  /// \returns false if the modules do not define an emitted symbol Name
+  bool renameSymbol(size_t handle, const std::string& Name,
+                    const std::string& NewName);
+
   IncrementalExecutor& getParent() const { return m_Parent; }
 
+  ///\brief Records the function ranges and, for code compiled with debug
+  /// info, the line tables of the objects loaded from now on, until the
+  /// matching releaseCodeTables(). Objects loaded otherwise only keep their
+  /// code sections, and lookupCode() finds the closest symbol for them.
+  void retainCodeTables() { ++m_NumCodeTableUsers; }
+  void releaseCodeTables() {
+    assert(m_NumCodeTableUsers && "Unbalanced releaseCodeTables()");
+    --m_NumCodeTableUsers;
+  }
+
+  ///\brief Finds the JITted function containing an address.
+  /// \param Addr - the address to look for
+  /// \param Function - set to the function's symbol name
+  /// \param File, Line - set to the source location, if the function was
+  ///   compiled with debug info while its tables were retained; otherwise
+  ///   to "" and 0
+  /// \returns false if Addr is not in JITted code
+  bool lookupCode(uint64_t Addr, std::string& Function, std::string& File,
+                  unsigned& Line) const;
+
+  ///\brief Provides line tables for JITted functions compiled without debug
+  /// info. The module, generated with debug info from the same declarations,
+  /// is compiled but not loaded; its functions are matched to the JITted
+  /// ones by name and size, as debug info does not change the generated
+  /// code.
+  /// \param M - the module; it is modified
+  /// \returns the number of JITted functions that gained line tables
+  unsigned addDebugModule(llvm::Module& M);
+
+  ///\brief Keeps the objects of the modules in a directory, where later
+  /// sessions find them, see JITObjectCache.
+  /// \returns false if the directory cannot be created
+  bool enableObjectCache(llvm::StringRef Dir);
+
+  const JITObjectCache* getObjectCache() const { return m_ObjectCache.get(); }
+
+  ///\brief Generates the symbols that no module defines through M, once
+  /// the process and the loaded libraries do not provide them either.
+  /// \param M - the materializer; null to stop materializing
+  /// \param Lazily - whether functions are generated on their first call
+  ///   rather than when first referenced. Only for code running in this
+  ///   process, and only where ORC has stubs for the target.
+  void setMaterializer(SymbolMaterializer* M, bool Lazily);
+
+  ///\brief Collects the writable data sections of the loaded objects, i.e.
+  /// where the JITted globals live.
+  /// \param Ranges - gets their start and end
+  void getWritableSections(
+                 std::vector<std::pair<uintptr_t, uintptr_t>>& Ranges) const;
+
+  ///\brief Writes the JITted functions to /tmp/perf-<pid>.map, where perf
+  /// looks up the symbols of JITted code. Only on Linux.
+  void writePerfMap() const;
+
   void
   RemoveUnfinalizedSection(llvm::orc::ObjectLinkingLayerBase::ObjSetHandleT H) {
     m_UnfinalizedSections.erase(H);
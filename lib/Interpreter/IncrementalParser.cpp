@@ -17,6 +17,7 @@
 #include "DeclCollector.h"
 #include "DeclExtractor.h"
 #include "DynamicLookup.h"
+#include "ExecutorProcess.h"
 #include "IncrementalExecutor.h"
 #include "NullDerefProtectionTransformer.h"
 #include "TransactionPool.h"
@@ -25,7 +26,9 @@
 #include "cling/Interpreter/CIFactory.h"
 #include "cling/Interpreter/Interpreter.h"
 #include "cling/Interpreter/InterpreterCallbacks.h"
+#include "cling/Interpreter/StartupProfile.h"
 #include "cling/Interpreter/Transaction.h"
+#include "cling/Utils/Trace.h"
 
 #include "clang/AST/ASTContext.h"
 #include "clang/AST/Attr.h"
@@ -41,14 +44,16 @@
 #include "clang/Sema/SemaDiagnostic.h"
 #include "clang/Serialization/ASTWriter.h"
 
+#include "llvm/ADT/Twine.h"
 #include "llvm/IR/LLVMContext.h"
 #include "llvm/IR/Module.h"
 #include "llvm/Support/CrashRecoveryContext.h"
 #include "llvm/Support/MemoryBuffer.h"
 #include "llvm/Support/raw_os_ostream.h"
 
+#include <algorithm>
 #include <iostream>
-#include <sstream>
+#include <iterator>
 #include <stdio.h>
 
 using namespace clang;
@@ -104,13 +109,63 @@ namespace {
 
     return false;
   }
+
+  ///\brief Makes a failing compilation as cheap as possible while its
+  /// diagnostics are thrown away, see CompilationOptions::SilentProbe.
+  ///
+  class SilentProbeRAII {
+    clang::DiagnosticsEngine& m_Diags;
+    clang::LangOptions& m_LangOpts;
+    bool m_Active;
+    clang::IgnoringDiagConsumer m_Ignore;
+    clang::DiagnosticConsumer* m_OldClient;
+    std::unique_ptr<clang::DiagnosticConsumer> m_OwnedClient;
+    bool m_OldIgnoreWarnings;
+    unsigned m_OldErrorLimit;
+    clang::OverloadsShown m_OldShowOverloads;
+    unsigned m_OldSpellChecking;
+
+  public:
+    SilentProbeRAII(clang::CompilerInstance& CI, bool Active)
+      : m_Diags(CI.getDiagnostics()),
+        m_LangOpts(const_cast<clang::LangOptions&>(CI.getLangOpts())),
+        m_Active(Active), m_OldClient(nullptr) {
+      if (!m_Active)
+        return;
+      m_OldIgnoreWarnings = m_Diags.getIgnoreAllWarnings();
+      m_OldErrorLimit = m_Diags.getErrorLimit();
+      m_OldShowOverloads = m_Diags.getShowOverloads();
+      m_OldSpellChecking = m_LangOpts.SpellChecking;
+
+      // Errors still count, so that the error limit turns everything after
+      // the first one into a fatal error, which stops Sema from instantiating
+      // and diagnosing further; they just never get formatted.
+      m_OwnedClient = m_Diags.takeClient();
+      m_OldClient = m_Diags.getClient();
+      m_Diags.setClient(&m_Ignore, /*owns*/ false);
+      m_Diags.setIgnoreAllWarnings(true);
+      m_Diags.setErrorLimit(1);
+      m_Diags.setShowOverloads(clang::Ovl_Best);
+      m_LangOpts.SpellChecking = 0;
+    }
+
+    ~SilentProbeRAII() {
+      if (!m_Active)
+        return;
+      m_Diags.setClient(m_OldClient, m_OwnedClient.release() != nullptr);
+      m_Diags.setIgnoreAllWarnings(m_OldIgnoreWarnings);
+      m_Diags.setErrorLimit(m_OldErrorLimit);
+      m_Diags.setShowOverloads(m_OldShowOverloads);
+      m_LangOpts.SpellChecking = m_OldSpellChecking;
+    }
+  };
 } // unnamed namespace
 
 namespace cling {
   IncrementalParser::IncrementalParser(Interpreter* interp, const char* llvmdir):
     m_Interpreter(interp),
     m_CI(CIFactory::createCI("", interp->getOptions(), llvmdir)),
-    m_Consumer(nullptr), m_ModuleNo(0) {
+    m_Consumer(nullptr), m_ModuleNo(0), m_CompletionFileNo(0) {
     assert(m_CI.get() && "CompilerInstance is (null)!");
 
     m_Consumer = dyn_cast<DeclCollector>(&m_CI->getSema().getASTConsumer());
@@ -137,7 +192,8 @@ namespace cling {
       getCodeGenerator()->Initialize(getCI()->getASTContext());
       m_BackendPasses.reset(new BackendPasses(getCI()->getCodeGenOpts(),
                                               getCI()->getTargetOpts(),
-                                              getCI()->getLangOpts()));
+                                              getCI()->getLangOpts(),
+                                              m_Interpreter->getJITProfile()));
     }
 
     CompilationOptions CO;
@@ -152,6 +208,7 @@ namespace cling {
     const std::string& PCHFileName
       = m_CI->getInvocation().getPreprocessorOpts().ImplicitPCHInclude;
     if (!PCHFileName.empty()) {
+      StartupProfile::Phase P("LoadPCH");
       Transaction* CurT = beginTransaction(CO);
       m_CI->createPCHExternalASTSource(PCHFileName,
                                        true /*DisablePCHValidation*/,
@@ -183,6 +240,7 @@ namespace cling {
       // <new> is needed by the ValuePrinter so it's a good thing to include it.
       // We need to include it to determine the version number of the standard
       // library implementation.
+      StartupProfile::Phase P("#include <new>");
       ParseInternal("#include <new>");
       // That's really C++ ABI compatibility. C has other problems ;-)
       CheckABICompatibility(m_CI.get());
@@ -231,15 +289,17 @@ namespace cling {
   Transaction* IncrementalParser::beginTransaction(const CompilationOptions&
                                                    Opts) {
     Transaction* OldCurT = m_Consumer->getTransaction();
-    Transaction* NewCurT = m_TransactionPool->takeTransaction(m_CI->getSema());
-    NewCurT->setCompilationOpts(Opts);
     // If we are in the middle of transaction and we see another begin
     // transaction - it must be nested transaction.
-    if (OldCurT && OldCurT != NewCurT
-        && (OldCurT->getState() == Transaction::kCollecting
-            || OldCurT->getState() == Transaction::kCompleted)) {
-      OldCurT->addNestedTransaction(NewCurT); // takes the ownership
-    }
+    Transaction* ParentT = 0;
+    if (OldCurT && (OldCurT->getState() == Transaction::kCollecting
+                    || OldCurT->getState() == Transaction::kCompleted))
+      ParentT = OldCurT;
+    Transaction* NewCurT
+      = m_TransactionPool->takeTransaction(m_CI->getSema(), ParentT);
+    NewCurT->setCompilationOpts(Opts);
+    if (ParentT)
+      ParentT->addNestedTransaction(NewCurT); // takes the ownership
 
     m_Consumer->setTransaction(NewCurT);
     return NewCurT;
@@ -411,10 +471,11 @@ namespace cling {
       m_Consumer->setTransaction(prevConsumerT);
     }
     T->setState(Transaction::kCommitted);
+    indexTransaction(T);
+    T->compact();
 
     if (InterpreterCallbacks* callbacks = m_Interpreter->getCallbacks())
       callbacks->TransactionCommitted(*T);
-
   }
 
   void IncrementalParser::markWholeTransactionAsUsed(Transaction* T) const {
@@ -453,6 +514,9 @@ namespace cling {
     assert(T->getState() == Transaction::kCompleted && "Must be completed");
     assert(hasCodeGenerator() && "No CodeGen");
 
+    utils::Trace::Span S("codegen", "transaction");
+    S.setTransactionID(T->getUniqueID());
+
     // Could trigger derserialization of decls.
     Transaction* deserT = beginTransaction(CompilationOptions());
 
@@ -519,12 +583,27 @@ namespace cling {
     bool success = true;
     //if (!success)
     //  m_Interpreter->unload(*T);
-    if (m_BackendPasses && T->getModule())
+    if (m_BackendPasses && T->getModule()) {
+      utils::Trace::Span S("BackendPasses", "transaction");
+      S.setTransactionID(T->getUniqueID());
       m_BackendPasses->runOnModule(*T->getModule());
+    }
     return success;
   }
 
   void IncrementalParser::deregisterTransaction(Transaction& T) {
+    unindexTransaction(&T);
+
+    // T is the last transaction: the buffers from its input onwards, nested
+    // inputs included, are not referenced anymore. Give back their input
+    // numbers and their include offsets in the virtual file. Their source
+    // location entries stay; the SourceManager cannot remove them.
+    if (T.getBufferFID().isValid()) {
+      while (!m_MemoryBuffers.empty()
+             && !(m_MemoryBuffers.back().second < T.getBufferFID()))
+        m_MemoryBuffers.pop_back();
+    }
+
     if (&T == m_Consumer->getTransaction())
       m_Consumer->setTransaction(T.getParent());
 
@@ -543,13 +622,66 @@ namespace cling {
   }
 
   std::vector<const Transaction*> IncrementalParser::getAllTransactions() {
-    std::vector<const Transaction*> result(m_Transactions.size());
-    const cling::Transaction* T = getFirstTransaction();
-    while (T) {
-      result.push_back(T);
-      T = T->getNext();
+    return std::vector<const Transaction*>(m_Transactions.begin(),
+                                           m_Transactions.end());
+  }
+
+  void IncrementalParser::indexTransaction(Transaction* T) {
+    const SourceManager& SM = getCI()->getSourceManager();
+    llvm::SmallVector<FileID, 2>& Files = m_TransactionFiles[T];
+    auto addFile = [&](FileID FID) {
+      llvm::SmallVector<Transaction*, 2>& Ts = m_FileTransactions[FID];
+      if (Ts.empty() || Ts.back() != T) {
+        Ts.push_back(T);
+        Files.push_back(FID);
+      }
+    };
+    if (T->getBufferFID().isValid())
+      addFile(T->getBufferFID());
+    for (auto I = T->decls_begin(), E = T->decls_end(); I != E; ++I) {
+      for (Decl* D : I->m_DGR) {
+        m_DeclTransactions[D] = T;
+        SourceLocation Loc = D->getLocation();
+        if (Loc.isValid()) {
+          FileID FID = SM.getFileID(SM.getExpansionLoc(Loc));
+          if (FID.isValid())
+            addFile(FID);
+        }
+      }
     }
-    return result;
+  }
+
+  void IncrementalParser::unindexTransaction(Transaction* T) {
+    if (T->hasNestedTransactions())
+      for (auto I = T->nested_begin(), E = T->nested_end(); I != E; ++I)
+        unindexTransaction(*I);
+
+    // The decls might already be reverted; only use them as keys.
+    for (auto I = T->decls_begin(), E = T->decls_end(); I != E; ++I) {
+      for (Decl* D : I->m_DGR) {
+        auto Pos = m_DeclTransactions.find(D);
+        if (Pos != m_DeclTransactions.end() && Pos->second == T)
+          m_DeclTransactions.erase(Pos);
+      }
+    }
+
+    auto Files = m_TransactionFiles.find(T);
+    if (Files == m_TransactionFiles.end())
+      return;
+    // Other transactions might still declare in the same files; only drop T.
+    for (FileID FID : Files->second) {
+      auto Pos = m_FileTransactions.find(FID);
+      if (Pos == m_FileTransactions.end())
+        continue;
+      llvm::SmallVector<Transaction*, 2>& Ts = Pos->second;
+      // Unloading goes backwards, T is usually the last one.
+      auto TPos = std::find(Ts.rbegin(), Ts.rend(), T);
+      if (TPos != Ts.rend())
+        Ts.erase(std::next(TPos).base());
+      if (Ts.empty())
+        m_FileTransactions.erase(Pos);
+    }
+    m_TransactionFiles.erase(Files);
   }
 
   // Each input line is contained in separate memory buffer. The SourceManager
@@ -591,8 +723,20 @@ namespace cling {
   IncrementalParser::ParseResultTransaction
   IncrementalParser::Compile(llvm::StringRef input,
                              const CompilationOptions& Opts) {
+    if (ExecutorProcess::isExecutor()) {
+      // Its copy of the compiler is out of sync with the interpreter's.
+      llvm::errs() << "cling: code in the executor process cannot call into "
+                      "the interpreter.\n";
+      return ParseResultTransaction(nullptr, kFailed);
+    }
+    SilentProbeRAII SilentProbe(*getCI(), Opts.SilentProbe);
     Transaction* CurT = beginTransaction(Opts);
-    EParseResult ParseRes = ParseInternal(input);
+    EParseResult ParseRes;
+    {
+      utils::Trace::Span S("parse", "transaction", input);
+      ParseRes = ParseInternal(input);
+      S.setTransactionID(CurT->getUniqueID());
+    }
 
     if (ParseRes == kSuccessWithWarnings)
       CurT->setIssuedDiags(Transaction::kWarnings);
@@ -600,7 +744,11 @@ namespace cling {
       CurT->setIssuedDiags(Transaction::kErrors);
 
     ParseResultTransaction PRT = endTransaction(CurT);
-    commitTransaction(PRT);
+    {
+      utils::Trace::Span S("commit", "transaction");
+      S.setTransactionID(CurT->getUniqueID());
+      commitTransaction(PRT);
+    }
 
     return PRT;
   }
@@ -630,15 +778,16 @@ namespace cling {
     assert(PP.isIncrementalProcessingEnabled() && "Not in incremental mode!?");
     PP.enableIncrementalProcessing();
 
-    std::ostringstream source_name;
-    source_name << "input_line_" << (m_MemoryBuffers.size() + 1);
+    // Input numbers and include offsets of unloaded inputs get reused, see
+    // deregisterTransaction(); each input still gets a FileID of its own.
+    const size_t InputNo = m_MemoryBuffers.size() + 1;
 
     // Create an uninitialized memory buffer, copy code in and append "\n"
     size_t InputSize = input.size(); // don't include trailing 0
     // MemBuffer size should *not* include terminating zero
     std::unique_ptr<llvm::MemoryBuffer>
       MB(llvm::MemoryBuffer::getNewUninitMemBuffer(InputSize + 1,
-                                                   source_name.str()));
+                                   "input_line_" + llvm::Twine(InputNo)));
     char* MBStart = const_cast<char*>(MB->getBufferStart());
     memcpy(MBStart, input.data(), InputSize);
     memcpy(MBStart + InputSize, "\n", 2);
@@ -662,7 +811,9 @@ namespace cling {
       // Create FileEntry and FileID for the current buffer.
       // Enabling the completion point only works on FileEntries.
       const clang::FileEntry* FE
-        = SM.getFileManager().getVirtualFile("vfile for " + source_name.str(),
+        = SM.getFileManager().getVirtualFile(
+                          ("vfile for completion_" +
+                           llvm::Twine(++m_CompletionFileNo)).str(),
                                              InputSize, 0 /* mod time*/);
       SM.overrideFileContents(FE, std::move(MB));
       FID = SM.createFileID(FE, NewLoc, SrcMgr::C_User);
@@ -716,10 +867,16 @@ namespace cling {
       // If we got a null return and something *was* parsed, ignore it.  This
       // is due to a top-level semicolon, an action override, or a parse error
       // skipping something.
-      if (Diags.hasErrorOccurred() || Diags.hasFatalErrorOccurred())
+      bool Failed = Diags.hasErrorOccurred() || Diags.hasFatalErrorOccurred();
+      if (Failed)
         m_Consumer->getTransaction()->setIssuedDiags(Transaction::kErrors);
       if (ADecl)
         m_Consumer->HandleTopLevelDecl(ADecl.get());
+      // Nobody will see what else is wrong with a failed probe.
+      if (Failed && CO.SilentProbe) {
+        m_Parser->SkipUntil(tok::eof);
+        break;
+      }
     };
 
     if (CO.CodeCompletionOffset != -1) {
@@ -777,6 +934,29 @@ namespace cling {
     }
   }
 
+  void IncrementalParser::printTransactionStats(llvm::raw_ostream& Out) const {
+    size_t Arenas = 0, ArenaMemory = 0;
+    for (const Transaction* T : m_Transactions) {
+      if (size_t Memory = T->getArenaMemory()) {
+        ++Arenas;
+        ArenaMemory += Memory;
+      }
+    }
+    const Transaction::AllocationStats& Stats
+      = Transaction::getAllocationStats();
+    Out << "Transactions: " << m_Transactions.size() << " top-level\n"
+        << "  allocated on the heap:     " << Stats.m_HeapTransactions << "\n"
+        << "  reused from the pool:      " << Stats.m_PooledTransactions << "\n"
+        << "  nested, in arenas:         " << Stats.m_ArenaTransactions << "\n"
+        << "  nested, reused in arenas:  " << Stats.m_ArenaReusedTransactions
+        << "\n"
+        << "Decl queues:\n"
+        << "  grown on the heap:         " << Stats.m_QueueHeapAllocations
+        << "\n"
+        << "  compacted into arenas:     " << Stats.m_QueueCompactions << "\n"
+        << "Arenas: " << Arenas << " holding " << ArenaMemory << " bytes\n";
+  }
+
   void IncrementalParser::SetTransformers(bool isChildInterpreter) {
     // Add transformers to the IncrementalParser, which owns them
     Sema* TheSema = &m_CI->getSema();
@@ -803,5 +983,9 @@ namespace cling {
                                 std::move(WrapperTransformers));
   }
 
+  void IncrementalParser::setLazyCodeGen(LazyCodeGen* LCG) {
+    m_Consumer->setLazyCodeGen(LCG);
+  }
+
 
 } // namespace cling
@@ -12,9 +12,11 @@
 
 #include "clang/Basic/SourceLocation.h"
 
+#include "llvm/ADT/DenseMap.h"
 #include "llvm/ADT/PointerIntPair.h"
 #include "llvm/ADT/SmallVector.h"
 #include "llvm/ADT/StringRef.h"
+#include "llvm/ADT/iterator_range.h"
 
 #include <vector>
 #include <deque>
@@ -23,6 +25,7 @@
 namespace llvm {
   struct GenericValue;
   class MemoryBuffer;
+  class raw_ostream;
 }
 
 namespace clang {
@@ -39,6 +42,7 @@ namespace cling {
   class DeclCollector;
   class ExecutionContext;
   class Interpreter;
+  class LazyCodeGen;
   class Transaction;
   class TransactionPool;
   class ASTTransformer;
@@ -81,9 +85,31 @@ namespace cling {
     ///
     std::deque<Transaction*> m_Transactions;
 
+    ///\brief The committed transaction that holds each declaration.
+    ///
+    llvm::DenseMap<const clang::Decl*, Transaction*> m_DeclTransactions;
+
+    ///\brief The committed transactions that parsed a file or declared
+    /// something in it, in commit order; the prompt input buffers map to
+    /// their transaction.
+    ///
+    llvm::DenseMap<clang::FileID, llvm::SmallVector<Transaction*, 2> >
+      m_FileTransactions;
+
+    ///\brief The files each committed transaction, nested or not, is indexed
+    /// under in m_FileTransactions.
+    ///
+    llvm::DenseMap<const Transaction*, llvm::SmallVector<clang::FileID, 2> >
+      m_TransactionFiles;
+
     ///\brief Number of created modules.
     unsigned m_ModuleNo;
 
+    ///\brief Number of virtual files created for code completion. Unlike
+    /// input numbers these are never reused: the file manager keeps each
+    /// entry, whose contents live FileIDs might still refer to.
+    unsigned m_CompletionFileNo;
+
     ///\brief Code generator
     ///
     std::unique_ptr<clang::CodeGenerator> m_CodeGen;
@@ -109,6 +135,7 @@ namespace cling {
     clang::Parser* getParser() const { return m_Parser.get(); }
     clang::CodeGenerator* getCodeGenerator() const { return m_CodeGen.get(); }
     bool hasCodeGenerator() const { return m_CodeGen.get(); }
+    BackendPasses* getBackendPasses() const { return m_BackendPasses.get(); }
     clang::SourceLocation getLastMemoryBufferEndLoc() const;
 
     /// \{
@@ -180,6 +207,37 @@ namespace cling {
     ///
     std::vector<const Transaction*> getAllTransactions();
 
+    typedef std::deque<Transaction*>::const_iterator const_transaction_iterator;
+    typedef llvm::iterator_range<const_transaction_iterator> transaction_range;
+
+    ///\brief Iterates over the top-level transactions, oldest first.
+    ///
+    transaction_range transactions() const {
+      return transaction_range(m_Transactions.begin(), m_Transactions.end());
+    }
+
+    ///\brief Returns the committed transaction whose queue holds D, nested or
+    /// not, or 0 if none does.
+    ///
+    Transaction* getTransactionFor(const clang::Decl* D) const {
+      return m_DeclTransactions.lookup(D);
+    }
+
+    ///\brief Returns the first committed transaction that parsed the file or
+    /// declared something in it, or 0 if none did.
+    ///
+    Transaction* getTransactionFor(clang::FileID FID) const {
+      auto I = m_FileTransactions.find(FID);
+      return I == m_FileTransactions.end() ? 0 : I->second.front();
+    }
+
+    ///\brief Returns whether the transaction, nested or not, is committed and
+    /// not unloaded.
+    ///
+    bool isCommitted(const Transaction* T) const {
+      return m_TransactionFiles.count(T);
+    }
+
     /// \}
 
     ///\brief Compiles the given input with the given compilation options.
@@ -192,6 +250,24 @@ namespace cling {
 
     void printTransactionStructure() const;
 
+  private:
+    ///\brief Adds the decls and files of a committed transaction to the
+    /// transaction index.
+    ///
+    void indexTransaction(Transaction* T);
+
+    ///\brief Removes an unloaded transaction and its nested transactions from
+    /// the transaction index.
+    ///
+    void unindexTransaction(Transaction* T);
+
+  public:
+
+    ///\brief Prints the allocation counters of the transactions and the
+    /// memory held by their arenas.
+    ///
+    void printTransactionStats(llvm::raw_ostream& Out) const;
+
     ///\brief Adds a UsedAttr to all decls in the transaction.
     ///
     ///\param[in] T - the transaction for which all decls will get a UsedAttr.
@@ -208,6 +284,11 @@ namespace cling {
     ///
     void SetTransformers(bool isChildInterpreter);
 
+    ///\brief Keeps the deserialized inline functions back from CodeGen
+    /// through LCG, see LazyCodeGen.
+    ///
+    void setLazyCodeGen(LazyCodeGen* LCG);
+
   private:
     ///\brief Finalizes the consumers (e.g. CodeGen) on a transaction.
     ///
@@ -11,12 +11,24 @@
 #include "cling/Utils/Paths.h"
 #include "ClingUtils.h"
 
+#include "DeclUnloader.h"
 #include "DynamicLookup.h"
+#include "ExecutorProcess.h"
 #include "ExternalInterpreterSource.h"
 #include "ForwardDeclPrinter.h"
+#include "HeaderPrefetcher.h"
 #include "IncrementalExecutor.h"
 #include "IncrementalParser.h"
+#include "JITProfile.h"
+#include "LazyCodeGen.h"
+#include "LazyDebugInfo.h"
+#include "MemProfiler.h"
 #include "MultiplexInterpreterCallbacks.h"
+#include "PerfStat.h"
+#include "SamplingProfiler.h"
+#include "SessionExporter.h"
+#include "StatCache.h"
+#include "TransactionHeap.h"
 #include "TransactionUnloader.h"
 
 #include "cling/Interpreter/CIFactory.h"
@@ -25,13 +37,17 @@
 #include "cling/Interpreter/CompilationOptions.h"
 #include "cling/Interpreter/DynamicLibraryManager.h"
 #include "cling/Interpreter/LookupHelper.h"
+#include "cling/Interpreter/StartupProfile.h"
 #include "cling/Interpreter/Transaction.h"
 #include "cling/Interpreter/Value.h"
 #include "cling/Interpreter/AutoloadCallback.h"
 #include "cling/Utils/AST.h"
 #include "cling/Utils/SourceNormalization.h"
+#include "cling/Utils/Trace.h"
 
+#include "clang/AST/ASTConsumer.h"
 #include "clang/AST/ASTContext.h"
+#include "clang/AST/DeclCXX.h"
 #include "clang/AST/GlobalDecl.h"
 #include "clang/Basic/TargetInfo.h"
 #include "clang/Basic/SourceManager.h"
@@ -44,11 +60,14 @@
 #include "clang/Sema/Sema.h"
 #include "clang/Sema/SemaDiagnostic.h"
 
+#include "llvm/ADT/ArrayRef.h"
 #include "llvm/IR/LLVMContext.h"
 #include "llvm/IR/Module.h"
 #include "llvm/Support/Path.h"
 #include "llvm/Support/raw_ostream.h"
 
+#include <algorithm>
+#include <cstring>
 #include <sstream>
 #include <string>
 #include <vector>
@@ -66,6 +85,8 @@ namespace {
       return cling::Interpreter::kExeFunctionNotCompiled;
     case cling::IncrementalExecutor::kExeUnresolvedSymbols:
       return cling::Interpreter::kExeUnresolvedSymbols;
+    case cling::IncrementalExecutor::kExeExecutorCrashed:
+      return cling::Interpreter::kExeExecutorCrashed;
     default: break;
     }
     return cling::Interpreter::kExeSuccess;
@@ -74,6 +95,29 @@ namespace {
   static bool isPracticallyEmptyModule(const llvm::Module* M) {
     return M->empty() && M->global_empty() && M->alias_empty();
   }
+
+  ///\brief Tells the callbacks about an input passed to the interpreter's
+  /// API, and about its result once the scope ends.
+  ///
+  class InputCallbacksRAII {
+    cling::InterpreterCallbacks* m_Callbacks;
+    cling::Interpreter::CompilationResult m_Result;
+  public:
+    InputCallbacksRAII(cling::InterpreterCallbacks* Callbacks,
+                       llvm::StringRef Function, llvm::StringRef Input):
+      m_Callbacks(Callbacks), m_Result(cling::Interpreter::kFailure) {
+      if (m_Callbacks)
+        m_Callbacks->InputStarted(Function, Input);
+    }
+    ~InputCallbacksRAII() {
+      if (m_Callbacks)
+        m_Callbacks->InputFinished(m_Result);
+    }
+    cling::Interpreter::CompilationResult
+    finish(cling::Interpreter::CompilationResult Result) {
+      return m_Result = Result;
+    }
+  };
 } // unnamed namespace
 
 namespace cling {
@@ -154,14 +198,39 @@ namespace cling {
   Interpreter::Interpreter(int argc, const char* const *argv,
                            const char* llvmdir /*= 0*/, bool noRuntime,
                            const Interpreter* parentInterp) :
-    m_Opts(argc, argv),
+    m_Opts(argc, argv), m_NumRunningWrappers(0),
     m_UniqueCounter(parentInterp ? parentInterp->m_UniqueCounter + 1 : 0),
-    m_PrintDebug(false), m_DynamicLookupDeclared(false),
-    m_DynamicLookupEnabled(false), m_RawInputEnabled(false) {
+    m_IsTopLevel(!parentInterp), m_WrapperSlots(0), m_PrintDebug(false),
+    m_DeclaredRuntimeTiers(0), m_DynamicLookupEnabled(false),
+    m_RawInputEnabled(false),
+    m_PerfStat(0), m_LastStartupTransaction(0) {
+
+    if (!m_Opts.StartupProfile.empty())
+      m_StartupProfile.reset(new StartupProfile());
+    // Records nothing if no profile was requested.
+    StartupProfile::Activation ProfileActivation(m_StartupProfile.get());
+    StartupProfile::Phase CtorPhase("Interpreter");
+
+    if (m_IsTopLevel)
+      utils::Trace::initFromEnvironment();
 
     m_LLVMContext.reset(new llvm::LLVMContext);
-    m_DyLibManager.reset(new DynamicLibraryManager(getOptions()));
-    m_IncrParser.reset(new IncrementalParser(this, llvmdir));
+    {
+      StartupProfile::Phase P("DynamicLibraryManager");
+      m_DyLibManager.reset(new DynamicLibraryManager(getOptions()));
+    }
+    {
+      StartupProfile::Phase P("IncrementalParser");
+      m_IncrParser.reset(new IncrementalParser(this, llvmdir));
+    }
+
+    if (!m_Opts.StatCache.empty()) {
+      StartupProfile::Phase P("StatCache");
+      m_StatCache.reset(new StatCache(m_Opts.StatCache));
+      getCI()->getFileManager().addStatCache(
+                                       m_StatCache->createFileSystemStatCache());
+      m_DyLibManager->setStatCache(m_StatCache.get());
+    }
 
     Sema& SemaRef = getSema();
     Preprocessor& PP = SemaRef.getPreprocessor();
@@ -173,9 +242,36 @@ namespace cling {
                                                      /*SkipFunctionBodies*/false,
                                                      /*isTemp*/true), this));
 
+    if (m_Opts.PrefetchHeaders)
+      m_HeaderPrefetcher.reset(new HeaderPrefetcher(getCI()->getLangOpts()));
+
+    if (!isInSyntaxOnlyMode()
+        && (!m_Opts.ProfileGenerate.empty() || !m_Opts.ProfileUse.empty()))
+      m_JITProfile.reset(new JITProfile(m_Opts.ProfileGenerate,
+                                        m_Opts.ProfileUse));
+
     if (!isInSyntaxOnlyMode())
       m_Executor.reset(new IncrementalExecutor(SemaRef.Diags,
-                                               getCI()->getCodeGenOpts()));
+                                               getCI()->getCodeGenOpts(),
+                                               m_Opts.ExecutorProcess));
+
+    // Compile without debug info from the start; the level requested, or
+    // line tables, are generated when needed.
+    if (m_Executor && m_Opts.LazyDebugInfo) {
+      CodeGenOptions& CGO = getCI()->getCodeGenOpts();
+      codegenoptions::DebugInfoKind Kind = CGO.getDebugInfo();
+      if (Kind == codegenoptions::NoDebugInfo)
+        Kind = codegenoptions::DebugLineTablesOnly;
+      CGO.setDebugInfo(codegenoptions::NoDebugInfo);
+      m_LazyDebugInfo.reset(new LazyDebugInfo(*this, Kind));
+      // The debug modules are matched to the JITted functions.
+      m_Executor->retainJITCodeTables();
+    }
+
+    if (m_Executor && !m_Opts.JITCache.empty()) {
+      StartupProfile::Phase P("JITObjectCache");
+      m_Executor->enableObjectCache(m_Opts.JITCache);
+    }
 
     // Tell the diagnostic client that we are entering file parsing mode.
     DiagnosticConsumer& DClient = getCI()->getDiagnosticClient();
@@ -183,20 +279,37 @@ namespace cling {
 
     llvm::SmallVector<IncrementalParser::ParseResultTransaction, 2>
       IncrParserTransactions;
-    m_IncrParser->Initialize(IncrParserTransactions, parentInterp);
+    {
+      StartupProfile::Phase P("IncrementalParser::Initialize");
+      m_IncrParser->Initialize(IncrParserTransactions, parentInterp);
+    }
+
+    // The PCH is attached; only what it must emit was deserialized so far.
+    if (m_Executor && m_Opts.LazyPCHCodeGen) {
+      m_LazyCodeGen.reset(new LazyCodeGen(*this,
+                                          m_IncrParser->getBackendPasses()));
+      m_IncrParser->setLazyCodeGen(m_LazyCodeGen.get());
+      m_Executor->setMaterializer(m_LazyCodeGen.get(),
+                                  /*Lazily*/ !m_Opts.ExecutorProcess);
+    }
 
     handleFrontendOptions();
 
     if (!noRuntime) {
+      StartupProfile::Phase P("IncludeRuntime");
       if (getCI()->getLangOpts().CPlusPlus)
         IncludeCXXRuntime();
       else
         IncludeCRuntime();
     }
-    // Commit the transactions, now that gCling is set up. It is needed for
-    // static initialization in these transactions through local_cxa_atexit().
-    for (auto&& I: IncrParserTransactions)
-      m_IncrParser->commitTransaction(I);
+    {
+      StartupProfile::Phase P("commitTransactions");
+      // Commit the transactions, now that gCling is set up. It is needed for
+      // static initialization in these transactions through
+      // local_cxa_atexit().
+      for (auto&& I: IncrParserTransactions)
+        m_IncrParser->commitTransaction(I);
+    }
     // Disable suggestions for ROOT
     bool showSuggestions = !llvm::StringRef(ClingStringify(CLING_VERSION)).startswith("ROOT");
 
@@ -207,7 +320,30 @@ namespace cling {
       setCallbacks(std::move(AutoLoadCB));
     }
 
-    m_IncrParser->SetTransformers(parentInterp);
+    {
+      StartupProfile::Phase P("SetTransformers");
+      m_IncrParser->SetTransformers(parentInterp);
+    }
+
+    // The runtime ran here; user code runs in the executor, if requested.
+    if (m_Executor && m_Opts.ExecutorProcess) {
+      m_Executor->activateExecutorProcess();
+      if (ExecutorProcess* EP = m_Executor->getExecutorProcess()) {
+        EP->setBeforeFork([this]() {
+          if (m_HeaderPrefetcher)
+            m_HeaderPrefetcher->pause();
+        });
+      }
+      m_DyLibManager->setExecutorProcess(m_Executor->getExecutorProcess());
+      if (m_JITProfile)
+        m_JITProfile->setExecutorProcess(m_Executor->getExecutorProcess());
+    }
+
+    m_LastStartupTransaction = getLastTransaction();
+
+    // Only the code entered from now on allocates from the heaps.
+    if (m_Executor && m_Opts.TransactionHeap && !m_Opts.ExecutorProcess)
+      m_TransactionHeap.reset(new TransactionHeap(m_Opts.TransactionHeapDebug));
   }
 
   ///\brief Constructor for the child Interpreter.
@@ -239,8 +375,30 @@ namespace cling {
   }
 
   Interpreter::~Interpreter() {
+    // Flush what has been recorded so far, if CLING_TRACE asked for it; a
+    // child interpreter would overwrite its parent's trace.
+    if (m_IsTopLevel)
+      utils::Trace::writeOutputFile();
+    // Values released from now on, e.g. at exit, need their destructor calls
+    // while the interpreter is still in one piece.
+    compileRequestedDtorCalls();
+    // Stop reading headers before anything goes away.
+    m_HeaderPrefetcher.reset();
+    m_SamplingProfiler.reset();
+    m_MemProfiler.reset();
     if (m_Executor)
       m_Executor->shuttingDown();
+    // The static destructors might have released blocks of the heaps.
+    m_TransactionHeap.reset();
+    // Its CodeGenerator refers to the ASTContext.
+    if (m_LazyCodeGen) {
+      m_IncrParser->setLazyCodeGen(nullptr);
+      m_Executor->setMaterializer(nullptr, false);
+      m_LazyCodeGen.reset();
+    }
+    // The counters include what ran at exit.
+    if (m_JITProfile)
+      m_JITProfile->write();
     for (size_t i = 0, e = m_StoredStates.size(); i != e; ++i)
       delete m_StoredStates[i];
     getCI()->getDiagnostics().getClient()->EndSourceFile();
@@ -289,6 +447,7 @@ namespace cling {
         "cling::Interpreter *gCling=(cling::Interpreter*)"
         << "0x" << std::hex << (uintptr_t)this << " ;} }";
     }
+    StartupProfile::Phase P("RuntimeUniverse");
     declare(initializer.str());
   }
 
@@ -372,6 +531,109 @@ namespace cling {
     ClangInternalState::printIncludedFiles(Out, getCI()->getSourceManager());
   }
 
+  void Interpreter::printTransactionStats(llvm::raw_ostream& Out) const {
+    m_IncrParser->printTransactionStats(Out);
+  }
+
+  void Interpreter::printStatCacheStats(llvm::raw_ostream& Out) const {
+    if (m_StatCache)
+      m_StatCache->print(Out);
+    else
+      Out << "Stat cache: disabled, see --stat-cache\n";
+  }
+
+  void Interpreter::printJITCacheStats(llvm::raw_ostream& Out) const {
+    if (m_Executor && m_Executor->getObjectCache())
+      m_Executor->getObjectCache()->print(Out);
+    else
+      Out << "JIT cache: disabled, see --jit-cache\n";
+  }
+
+  void Interpreter::printLazyCodeGenStats(llvm::raw_ostream& Out) const {
+    if (m_LazyCodeGen)
+      m_LazyCodeGen->print(Out);
+    else
+      Out << "Lazy PCH codegen: disabled, see --lazy-pch-codegen\n";
+  }
+
+  void Interpreter::printPrefetchStats(llvm::raw_ostream& Out) const {
+    if (m_HeaderPrefetcher) {
+      m_HeaderPrefetcher->wait();
+      m_HeaderPrefetcher->print(Out);
+    }
+    else
+      Out << "Header prefetcher: disabled, see --prefetch-headers\n";
+  }
+
+
+  bool Interpreter::startProfiling() {
+    if (!m_Executor)
+      return false;
+    if (!m_SamplingProfiler)
+      m_SamplingProfiler.reset(new SamplingProfiler());
+    if (!m_SamplingProfiler->start())
+      return false;
+    m_Executor->retainJITCodeTables();
+    return true;
+  }
+
+  bool Interpreter::stopProfiling() {
+    if (!m_SamplingProfiler || !m_SamplingProfiler->stop())
+      return false;
+    m_Executor->releaseJITCodeTables();
+    return true;
+  }
+
+  void Interpreter::printProfile(llvm::raw_ostream& Out) {
+    if (m_SamplingProfiler && m_Executor) {
+      loadDebugInfo();
+      m_SamplingProfiler->report(Out, *m_Executor);
+    }
+    else
+      Out << "Profile: nothing sampled, see .profile start\n";
+  }
+
+  bool Interpreter::startMemoryProfiling() {
+    // The hooks record into this process.
+    if (!m_Executor || m_Executor->getExecutorProcess())
+      return false;
+    if (!m_MemProfiler)
+      m_MemProfiler.reset(new MemProfiler(*m_Executor));
+    if (!m_MemProfiler->start())
+      return false;
+    m_Executor->retainJITCodeTables();
+    return true;
+  }
+
+  bool Interpreter::stopMemoryProfiling() {
+    if (!m_MemProfiler || !m_MemProfiler->stop())
+      return false;
+    m_Executor->releaseJITCodeTables();
+    return true;
+  }
+
+  void Interpreter::printMemoryProfile(llvm::raw_ostream& Out) const {
+    if (m_MemProfiler)
+      m_MemProfiler->report(Out);
+    else
+      Out << "Memory profile: nothing recorded, see .memprof start\n";
+  }
+
+  unsigned Interpreter::loadDebugInfo() {
+    if (!m_LazyDebugInfo)
+      return 0;
+    BackendPasses* Passes = m_IncrParser->getBackendPasses();
+    // The instrumentation registers its counters with the profile.
+    if (m_JITProfile && m_JITProfile->isGenerating())
+      Passes = 0;
+    const unsigned NumFunctions
+      = m_LazyDebugInfo->load(getFirstTransaction(), *m_Executor, Passes);
+    // The functions are not in this process otherwise.
+    if (!m_Executor->getExecutorProcess())
+      m_Executor->writePerfMap();
+    return NumFunctions;
+  }
+
 
   void Interpreter::GetIncludePaths(llvm::SmallVectorImpl<std::string>& incpaths,
                                    bool withSystem, bool withFlags) {
@@ -393,6 +655,7 @@ namespace cling {
   Interpreter::CompilationResult
   Interpreter::process(const std::string& input, Value* V /* = 0 */,
                        Transaction** T /* = 0 */) {
+    InputCallbacksRAII Notify(getCallbacks(), "process", input);
     std::string wrapReadySource = input;
     size_t wrapPoint = std::string::npos;
     if (!isRawInputEnabled())
@@ -406,7 +669,7 @@ namespace cling {
       CO.DynamicScoping = isDynamicLookupEnabled();
       CO.Debug = isPrintingDebug();
       CO.CheckPointerValidity = 1;
-      return DeclareInternal(input, CO, T);
+      return Notify.finish(DeclareInternal(input, CO, T));
     }
 
     CompilationOptions CO;
@@ -418,10 +681,22 @@ namespace cling {
     CO.CheckPointerValidity = 1;
     if (EvaluateInternal(wrapReadySource, CO, V, T, wrapPoint)
                                                      == Interpreter::kFailure) {
-      return Interpreter::kFailure;
+      return Notify.finish(Interpreter::kFailure);
     }
 
-    return Interpreter::kSuccess;
+    return Notify.finish(Interpreter::kSuccess);
+  }
+
+  Interpreter::CompilationResult
+  Interpreter::perfstat(const std::string& input, llvm::raw_ostream& Out,
+                        Value* V /* = 0 */) {
+    PerfStat Stat;
+    PerfStat* PrevStat = m_PerfStat;
+    m_PerfStat = &Stat;
+    CompilationResult Result = process(input, V);
+    m_PerfStat = PrevStat;
+    Stat.print(Out, input);
+    return Result;
   }
 
   Interpreter::CompilationResult
@@ -535,6 +810,7 @@ namespace cling {
 
   Interpreter::CompilationResult
   Interpreter::declare(const std::string& input, Transaction** T/*=0 */) {
+    InputCallbacksRAII Notify(getCallbacks(), "declare", input);
     CompilationOptions CO;
     CO.DeclarationExtraction = 0;
     CO.ValuePrinting = 0;
@@ -543,7 +819,7 @@ namespace cling {
     CO.Debug = isPrintingDebug();
     CO.CheckPointerValidity = 0;
 
-    return DeclareInternal(input, CO, T);
+    return Notify.finish(DeclareInternal(input, CO, T));
   }
 
   Interpreter::CompilationResult
@@ -552,12 +828,54 @@ namespace cling {
     // ExprStmt can be evaluated and etc. Such enforcement cannot happen in the
     // worker, because it is used from various places, where there is no such
     // rule
+    InputCallbacksRAII Notify(getCallbacks(), "evaluate", input);
     CompilationOptions CO;
     CO.DeclarationExtraction = 0;
     CO.ValuePrinting = 0;
     CO.ResultEvaluation = 1;
 
-    return EvaluateInternal(input, CO, &V);
+    return Notify.finish(EvaluateInternal(input, CO, &V));
+  }
+
+  Interpreter::CompilationResult
+  Interpreter::probe(const std::string& input, Value* V /* = 0 */) {
+    CompilationOptions CO;
+    CO.DeclarationExtraction = 0;
+    CO.ValuePrinting = 0;
+    CO.ResultEvaluation = (bool)V;
+    CO.DynamicScoping = isDynamicLookupEnabled();
+    CO.Debug = isPrintingDebug();
+    CO.SilentProbe = 1;
+
+    return EvaluateInternal(input, CO, V);
+  }
+
+  bool Interpreter::isRunningInExecutorProcess() const {
+    return m_Executor && m_Executor->runsInExecutor();
+  }
+
+  Interpreter::ExecutionResult
+  Interpreter::evaluateStringInExecutor(const std::string& input,
+                                        std::string& result) {
+    result.clear();
+    if (!isRunningInExecutorProcess())
+      return kExeFunctionNotCompiled;
+    std::string name;
+    createUniqueName(name);
+    name += "_string";
+    const std::string code = "extern \"C\" void " + name + "(void* out) {\n"
+      "  *(std::string*)out = " + input + ";\n}";
+    void* Addr = compileFunction(name, code, /*ifUniq*/false,
+                                 /*withAccessControl*/false);
+    if (!Addr)
+      return kExeCompilationError;
+    switch (m_Executor->getExecutorProcess()->callForString((uint64_t)Addr,
+                                                           result)) {
+    case ExecutorProcess::kSuccess: return kExeSuccess;
+    case ExecutorProcess::kCrashed: return kExeExecutorCrashed;
+    case ExecutorProcess::kFailure: break;
+    }
+    return kExeFunctionNotCompiled;
   }
 
   Interpreter::CompilationResult
@@ -614,23 +932,25 @@ namespace cling {
 
   Interpreter::CompilationResult
   Interpreter::echo(const std::string& input, Value* V /* = 0 */) {
+    InputCallbacksRAII Notify(getCallbacks(), "echo", input);
     CompilationOptions CO;
     CO.DeclarationExtraction = 0;
     CO.ValuePrinting = CompilationOptions::VPEnabled;
     CO.ResultEvaluation = (bool)V;
 
-    return EvaluateInternal(input, CO, V);
+    return Notify.finish(EvaluateInternal(input, CO, V));
   }
 
   Interpreter::CompilationResult
   Interpreter::execute(const std::string& input) {
+    InputCallbacksRAII Notify(getCallbacks(), "execute", input);
     CompilationOptions CO;
     CO.DeclarationExtraction = 0;
     CO.ValuePrinting = 0;
     CO.ResultEvaluation = 0;
     CO.DynamicScoping = 0;
     CO.Debug = isPrintingDebug();
-    return EvaluateInternal(input, CO);
+    return Notify.finish(EvaluateInternal(input, CO));
   }
 
   Interpreter::CompilationResult Interpreter::emitAllDecls(Transaction* T) {
@@ -673,7 +993,9 @@ namespace cling {
   }
 
   Interpreter::ExecutionResult
-  Interpreter::RunFunction(const FunctionDecl* FD, Value* res /*=0*/) {
+  Interpreter::RunFunction(const FunctionDecl* FD, Value* res /*=0*/,
+                           bool directResult /*=false*/,
+                           const Transaction* T /*=0*/) {
     if (getCI()->getDiagnostics().hasErrorOccurred())
       return kExeCompilationError;
 
@@ -686,8 +1008,16 @@ namespace cling {
 
     std::string mangledNameIfNeeded;
     utils::Analyze::maybeMangleDeclName(FD, mangledNameIfNeeded);
+    // What the wrapper evaluates leaves its destructor calls requested, see
+    // EvaluateInternal().
+    struct RunningRAII {
+      unsigned& m_Count;
+      RunningRAII(unsigned& Count): m_Count(Count) { ++m_Count; }
+      ~RunningRAII() { --m_Count; }
+    } Running(m_NumRunningWrappers);
     IncrementalExecutor::ExecutionResult ExeRes =
-       m_Executor->executeWrapper(mangledNameIfNeeded, res);
+       m_Executor->executeWrapper(mangledNameIfNeeded, res, directResult, T,
+                                  m_PerfStat);
     return ConvertExecutionResult(ExeRes);
   }
 
@@ -843,28 +1173,90 @@ namespace cling {
 
   void*
   Interpreter::compileDtorCallFor(const clang::RecordDecl* RD) {
-    void* &addr = m_DtorWrappers[RD];
-    if (addr)
-      return addr;
+    auto Cached = m_DtorWrappers.find(RD);
+    if (Cached != m_DtorWrappers.end() && Cached->second)
+      return Cached->second;
+    // Take the requested calls along, in the same module.
+    std::vector<const RecordDecl*> RDs(1, RD);
+    for (const RecordDecl* Pending : m_PendingDtorWrappers)
+      if (Pending != RD)
+        RDs.push_back(Pending);
+    m_PendingDtorWrappers.clear();
+    llvm::SmallVector<void*, 4> Addrs;
+    compileDtorCallsFor(RDs, Addrs);
+    return Addrs.front();
+  }
+
+  void* Interpreter::requestDtorCallFor(const clang::RecordDecl* RD) {
+    auto Cached = m_DtorWrappers.find(RD);
+    if (Cached != m_DtorWrappers.end() && Cached->second)
+      return Cached->second;
+    if (std::find(m_PendingDtorWrappers.begin(), m_PendingDtorWrappers.end(),
+                  RD) == m_PendingDtorWrappers.end())
+      m_PendingDtorWrappers.push_back(RD);
+    return 0;
+  }
 
-    std::string funcname;
-    {
-      llvm::raw_string_ostream namestr(funcname);
-      namestr << "__cling_Destruct_" << RD;
+  void Interpreter::compileRequestedDtorCalls() {
+    if (m_PendingDtorWrappers.empty())
+      return;
+    std::vector<const RecordDecl*> RDs;
+    RDs.swap(m_PendingDtorWrappers);
+    llvm::SmallVector<void*, 4> Addrs;
+    compileDtorCallsFor(RDs, Addrs);
+  }
+
+  void
+  Interpreter::compileDtorCallsFor(llvm::ArrayRef<const RecordDecl*> RDs,
+                                   llvm::SmallVectorImpl<void*>& Addrs) {
+    Addrs.assign(RDs.size(), 0);
+    if (isInSyntaxOnlyMode())
+      return;
+
+    llvm::SmallVector<size_t, 4> Missing;
+    for (size_t I = 0, E = RDs.size(); I != E; ++I) {
+      auto Cached = m_DtorWrappers.find(RDs[I]);
+      if (Cached != m_DtorWrappers.end() && Cached->second)
+        Addrs[I] = Cached->second;
+      else if (const CXXRecordDecl* CRD = dyn_cast<CXXRecordDecl>(RDs[I]))
+        if (CRD->hasDefinition() && !CRD->hasTrivialDestructor())
+          Missing.push_back(I);
     }
+    if (Missing.empty())
+      return;
 
-    std::string code = "extern \"C\" void ";
-    clang::QualType RDQT(RD->getTypeForDecl(), 0);
-    std::string typeName
-      = utils::TypeName::GetFullyQualifiedName(RDQT, RD->getASTContext());
-    std::string dtorName = RD->getNameAsString();
-    code += funcname + "(void* obj){((" + typeName + "*)obj)->~"
-      + dtorName + "();}";
+    // Synthesize the missing wrappers in the AST - no source text is involved,
+    // which also covers types that cannot be named, like lambdas or local
+    // classes - and emit them all as one module.
+    llvm::SmallVector<std::pair<size_t, FunctionDecl*>, 4> Pending;
+    {
+      PushTransactionRAII RAII(this);
+      Sema& S = getSema();
+      for (size_t I : Missing) {
+        std::string FuncName;
+        {
+          llvm::raw_string_ostream NameStr(FuncName);
+          NameStr << "__cling_Destruct_" << RDs[I];
+        }
+        CXXRecordDecl* CRD
+          = cast<CXXRecordDecl>(const_cast<RecordDecl*>(RDs[I]));
+        if (FunctionDecl* FD
+            = utils::Synthesize::DestructorThunk(&S, CRD, FuncName)) {
+          S.getASTConsumer().HandleTopLevelDecl(
+                  DeclGroupRef(Decl::castFromDeclContext(FD->getDeclContext())));
+          Pending.push_back(std::make_pair(I, FD));
+        }
+      }
+      // Define the destructors that are template members, before the
+      // transaction is committed.
+      S.PerformPendingInstantiations();
+    }
 
-    // ifUniq = false: we know it's unique, no need to check.
-    addr = compileFunction(funcname, code, false /*ifUniq*/,
-                           false /*withAccessControl*/);
-    return addr;
+    for (size_t I = 0, E = Pending.size(); I != E; ++I) {
+      void* Addr = getAddressOfGlobal(GlobalDecl(Pending[I].second));
+      m_DtorWrappers[RDs[Pending[I].first]] = Addr;
+      Addrs[Pending[I].first] = Addr;
+    }
   }
 
   void Interpreter::createUniqueName(std::string& out) {
@@ -878,14 +1270,102 @@ namespace cling {
 
   llvm::StringRef Interpreter::createUniqueWrapper() const {
     llvm::SmallString<128> out(utils::Synthesize::UniquePrefix);
+    ASTContext& C = getCI()->getASTContext();
+    // A slot is free once the wrapper that used it got unloaded or rolled
+    // back, i.e. when the name is not declared anymore.
+    for (unsigned Slot = 0; Slot < m_WrapperSlots; ++Slot) {
+      out.resize(strlen(utils::Synthesize::UniquePrefix));
+      llvm::raw_svector_ostream(out) << "_slot" << Slot;
+      IdentifierInfo& II = C.Idents.getOwn(out);
+      if (C.getTranslationUnitDecl()->lookup(DeclarationName(&II)).empty())
+        return II.getName();
+    }
+    out.resize(strlen(utils::Synthesize::UniquePrefix));
     llvm::raw_svector_ostream(out) << m_UniqueCounter++;
-    return (getCI()->getASTContext().Idents.getOwn(out)).getName();
+    return C.Idents.getOwn(out).getName();
   }
 
   bool Interpreter::isUniqueWrapper(llvm::StringRef name) {
     return name.startswith(utils::Synthesize::UniquePrefix);
   }
 
+  void Interpreter::reclaimWrapperSlot(Transaction& T, const Value& V) {
+    FunctionDecl* FD = T.getWrapperFD();
+    if (!FD || !FD->getName().startswith(utils::Synthesize::UniquePrefix)
+        || !FD->getName().substr(strlen(utils::Synthesize::UniquePrefix))
+              .startswith("_slot"))
+      return;
+
+    if (canUnloadWithWrapper(T, V)) {
+      unload(T);
+      return;
+    }
+
+    // The transaction outlives the wrapper; keep the wrapper's code with it
+    // under a name of its own, in the module and in the JIT, and free the
+    // slot's name for the next input.
+    std::string Name;
+    utils::Analyze::maybeMangleDeclName(GlobalDecl(FD), Name);
+    std::string NewName = Name;
+    llvm::raw_string_ostream(NewName) << '_' << m_UniqueCounter++;
+    if (llvm::Module* M = T.getModule())
+      if (llvm::GlobalValue* GV = M->getNamedValue(Name))
+        GV->setName(NewName);
+    if (m_Executor)
+      m_Executor->renameInJIT(T.getExeUnloadHandle(), Name, NewName);
+
+    for (auto I = T.decls_begin(), E = T.decls_end(); I != E; ++I) {
+      if (!I->m_DGR.isNull() && *I->m_DGR.begin() == FD) {
+        T.erase(I);
+        break;
+      }
+    }
+    UnloadDecl(&getSema(), m_IncrParser->getCodeGenerator(), FD);
+  }
+
+  bool Interpreter::canUnloadWithWrapper(const Transaction& T,
+                                         const Value& V) const {
+    const FunctionDecl* FD = T.getWrapperFD();
+    if (m_IncrParser->getLastTransaction() != &T
+        || T.hasNestedTransactions()
+        || T.deserialized_decls_begin() != T.deserialized_decls_end())
+      return false;
+
+    // Anything else declared by the input outlives the wrapper.
+    for (auto I = T.decls_begin(), E = T.decls_end(); I != E; ++I)
+      for (const Decl* D : I->m_DGR)
+        if (D != FD)
+          return false;
+
+    // Local statics and types would be unloaded with the wrapper.
+    for (const Decl* D : FD->decls()) {
+      if (isa<TagDecl>(D))
+        return false;
+      if (const VarDecl* VD = dyn_cast<VarDecl>(D))
+        if (VD->isStaticLocal())
+          return false;
+    }
+
+    // The result could point into the wrapper's module.
+    if (V.isValid() && !V.isVoid()) {
+      const clang::Type* Ty = V.getType()->getUnqualifiedDesugaredType();
+      if (!Ty->isArithmeticType() && !Ty->isEnumeralType())
+        return false;
+    }
+    return true;
+  }
+
+  void Interpreter::prefetchHeaders(const std::string& input) const {
+    if (!m_HeaderPrefetcher)
+      return;
+    HeaderSearch& HS = getCI()->getPreprocessor().getHeaderSearchInfo();
+    std::vector<std::string> SearchDirs;
+    for (auto I = HS.search_dir_begin(), E = HS.search_dir_end(); I != E; ++I)
+      if (I->isNormalDir())
+        SearchDirs.push_back(I->getDir()->getName());
+    m_HeaderPrefetcher->prefetch(input, SearchDirs);
+  }
+
   Interpreter::CompilationResult
   Interpreter::DeclareInternal(const std::string& input,
                                const CompilationOptions& CO,
@@ -895,10 +1375,19 @@ namespace cling {
            && CO.ResultEvaluation == 0
            && "Compilation Options not compatible with \"declare\" mode.");
 
+    if (CO.DynamicScoping
+        && declareRuntimeTier(kRuntimeDynamicLookup) != kSuccess)
+      return Interpreter::kFailure;
+
     StateDebuggerRAII stateDebugger(this);
 
-    IncrementalParser::ParseResultTransaction PRT
-      = m_IncrParser->Compile(input, CO);
+    prefetchHeaders(input);
+
+    IncrementalParser::ParseResultTransaction PRT;
+    {
+      PerfStat::Scope Measure(m_PerfStat, PerfStat::kCompilation);
+      PRT = m_IncrParser->Compile(input, CO);
+    }
     if (PRT.getInt() == IncrementalParser::kFailed)
       return Interpreter::kFailure;
 
@@ -913,8 +1402,27 @@ namespace cling {
                                 Value* V, /* = 0 */
                                 Transaction** T /* = 0 */,
                                 size_t wrapPoint /* = 0*/) {
+    // EvaluateT needs its runtime before the first dynamic scope is parsed.
+    if (CO.DynamicScoping
+        && declareRuntimeTier(kRuntimeDynamicLookup) != kSuccess)
+      return Interpreter::kFailure;
+
+    // The destructor calls of the values of earlier inputs, in one module;
+    // inputs of running code leave them to the next top-level one.
+    if (!m_NumRunningWrappers)
+      compileRequestedDtorCalls();
+
     StateDebuggerRAII stateDebugger(this);
 
+    // Probes, e.g. value printing, work on this process' memory; what they
+    // write into the executor's globals is undone. They do not see the
+    // executor's heap, see evaluateStringInExecutor().
+    IncrementalExecutor::InProcessRAII InProcess(m_Executor.get(),
+                                                 CO.SilentProbe,
+                                                 /*Isolate*/true);
+
+    prefetchHeaders(input);
+
     // Wrap the expression
     std::string WrapperBuffer;
     const std::string& Wrapper = WrapInput(input, WrapperBuffer, wrapPoint);
@@ -923,8 +1431,11 @@ namespace cling {
     // non-default C++ at the prompt:
     CO.IgnorePromptDiags = 1;
 
-    IncrementalParser::ParseResultTransaction PRT
-      = m_IncrParser->Compile(Wrapper, CO);
+    IncrementalParser::ParseResultTransaction PRT;
+    {
+      PerfStat::Scope Measure(m_PerfStat, PerfStat::kCompilation);
+      PRT = m_IncrParser->Compile(Wrapper, CO);
+    }
     Transaction* lastT = PRT.getPointer();
     if (lastT && lastT->getState() != Transaction::kCommitted) {
       assert((lastT->getState() == Transaction::kCommitted
@@ -955,7 +1466,26 @@ namespace cling {
       V = &resultV;
     if (!lastT->getWrapperFD()) // no wrapper to run
       return Interpreter::kSuccess;
-    else if (RunFunction(lastT->getWrapperFD(), V) < kExeFirstError){
+
+    MemProfiler::TransactionScope Attribute(m_MemProfiler.get(),
+                                            lastT->getUniqueID());
+    TransactionHeap::Scope Heap(m_TransactionHeap.get(), lastT->getUniqueID());
+    if (void* DirectTy = lastT->getDirectResultType()) {
+      // The wrapper stores its builtin or pointer result straight into the
+      // storage; type it here instead of through a runtime call, once the
+      // wrapper returned. V stays invalid if it fails or throws.
+      Value Direct;
+      *V = Value();
+      if (RunFunction(lastT->getWrapperFD(), &Direct, /*directResult*/true,
+                      lastT) < kExeFirstError) {
+        *V = Value(QualType::getFromOpaquePtr(DirectTy), *this);
+        // All members of the storage union share its address; long double
+        // is the widest of them.
+        ::memcpy(&V->getULL(), &Direct.getULL(), sizeof(long double));
+      }
+    }
+    else if (RunFunction(lastT->getWrapperFD(), V, /*directResult*/false,
+                         lastT) < kExeFirstError) {
       if (lastT->getCompilationOpts().ValuePrinting
           != CompilationOptions::VPDisabled
           && V->isValid()
@@ -963,8 +1493,9 @@ namespace cling {
           // dumpIfNoStorage.
           && V->needsManagedAllocation())
         V->dump();
-      return Interpreter::kSuccess;
     }
+    if (m_WrapperSlots)
+      reclaimWrapperSlot(*lastT, *V);
     return Interpreter::kSuccess;
   }
 
@@ -1002,7 +1533,14 @@ namespace cling {
     std::string canonicalLib = DLM->lookupLibrary(filename);
     if (allowSharedLib && !canonicalLib.empty()) {
       switch (DLM->loadLibrary(canonicalLib, /*permanent*/false, /*resolved*/true)) {
-      case DynamicLibraryManager::kLoadLibSuccess: // Intentional fall through
+      case DynamicLibraryManager::kLoadLibSuccess: {
+        // A library written by exportSession() comes with the declarations
+        // of what it defines.
+        if (SessionExporter::isExported(canonicalLib))
+          return loadFile(SessionExporter::getAutoloadPath(canonicalLib),
+                          /*allowSharedLib*/false, T);
+        return kSuccess;
+      }
       case DynamicLibraryManager::kLoadLibAlreadyLoaded:
         return kSuccess;
       case DynamicLibraryManager::kLoadLibNotFound:
@@ -1039,6 +1577,11 @@ namespace cling {
                                   Transaction::ExeUnloadHandle({(void*)(size_t)-1}));
       }
     }
+    // What the destructors did not release is leaked.
+    if (m_MemProfiler)
+      m_MemProfiler->reportLeaks(T.getUniqueID(), llvm::errs());
+    if (m_LazyDebugInfo)
+      m_LazyDebugInfo->forget(T);
 
     // We can revert the most recent transaction or a nested transaction of a
     // transaction that is not in the middle of the transaction collection
@@ -1062,6 +1605,14 @@ namespace cling {
     else
       T.setState(Transaction::kRolledBackWithErrors);
 
+    // Once its code and globals are gone, what remains can refer to the
+    // transaction's heap only from the other heaps and the JITted globals.
+    if (m_TransactionHeap) {
+      std::vector<std::pair<uintptr_t, uintptr_t>> Globals;
+      m_Executor->getJITWritableSections(Globals);
+      m_TransactionHeap->release(T.getUniqueID(), Globals);
+    }
+
     m_IncrParser->deregisterTransaction(T);
   }
 
@@ -1083,10 +1634,8 @@ namespace cling {
                                 std::vector<const Transaction*> &transactions,
                                          unsigned int begin, unsigned int end) {
 
-    for(auto i = begin; i != end; --i) {
-      if (transactions[i-1] != nullptr)
-        executor.runAndRemoveStaticDestructors(const_cast<Transaction*>(transactions[i-1]));
-    }
+    for(auto i = begin; i != end; --i)
+      executor.runAndRemoveStaticDestructors(const_cast<Transaction*>(transactions[i-1]));
   }
 
   void Interpreter::runAndRemoveStaticDestructors(unsigned numberOfTransactions) {
@@ -1156,23 +1705,64 @@ namespace cling {
     return m_IncrParser->getLastTransaction();
   }
 
+  Interpreter::transaction_range Interpreter::transactions() const {
+    return m_IncrParser->transactions();
+  }
+
+  const Transaction*
+  Interpreter::getTransactionFor(const clang::Decl* D) const {
+    return m_IncrParser->getTransactionFor(D);
+  }
+
+  const Transaction* Interpreter::getTransactionFor(clang::FileID FID) const {
+    return m_IncrParser->getTransactionFor(FID);
+  }
+
+  bool Interpreter::isCommitted(const Transaction* T) const {
+    return m_IncrParser->isCommitted(T);
+  }
+
   const Transaction* Interpreter::getCurrentTransaction() const {
     return m_IncrParser->getCurrentTransaction();
   }
 
 
-  void Interpreter::enableDynamicLookup(bool value /*=true*/) {
-    if (!m_DynamicLookupDeclared && value) {
-      // No dynlookup for the dynlookup header!
-      m_DynamicLookupEnabled = false;
-      if (loadModuleForHeader("cling/Interpreter/DynamicLookupRuntimeUniverse.h")
-          != kSuccess)
-      declare("#include \"cling/Interpreter/DynamicLookupRuntimeUniverse.h\"");
+  Interpreter::CompilationResult
+  Interpreter::declareRuntimeTier(RuntimeTier Tier) const {
+    if (m_DeclaredRuntimeTiers & Tier)
+      return kSuccess;
+    // Mark it first: the tier's own transaction must not recurse here.
+    m_DeclaredRuntimeTiers |= Tier;
+
+    const char* Header = 0;
+    switch (Tier) {
+    case kRuntimeValuePrinting:
+      Header = "cling/Interpreter/RuntimePrintValue.h";
+      break;
+    case kRuntimeDynamicLookup:
+      Header = "cling/Interpreter/DynamicLookupRuntimeUniverse.h";
+      break;
     }
-    m_DynamicLookupDeclared = true;
+    assert(Header && "Unknown runtime tier!");
 
-    // Enable it *after* parsing the headers.
-    m_DynamicLookupEnabled = value;
+    // The header might be part of a module; importing is cheaper.
+    if (const_cast<Interpreter*>(this)->loadModuleForHeader(Header)
+        == kSuccess)
+      return kSuccess;
+
+    // No dynlookup for the runtime headers!
+    CompilationOptions CO;
+    CO.DeclarationExtraction = 0;
+    CO.ValuePrinting = 0;
+    CO.ResultEvaluation = 0;
+    CO.DynamicScoping = 0;
+    CO.Debug = isPrintingDebug();
+    if (DeclareInternal(std::string("#include \"") + Header + "\"", CO)
+        != kSuccess) {
+      m_DeclaredRuntimeTiers &= ~Tier;
+      return kFailure;
+    }
+    return kSuccess;
   }
 
   Interpreter::ExecutionResult
@@ -1183,11 +1773,20 @@ namespace cling {
     IncrementalExecutor::ExecutionResult ExeRes
        = IncrementalExecutor::kExeSuccess;
     if (!isPracticallyEmptyModule(T.getModule())) {
-      T.setExeUnloadHandle(m_Executor.get(), m_Executor->emitToJIT());
+      {
+        utils::Trace::Span S("emitToJIT", "transaction");
+        S.setTransactionID(T.getUniqueID());
+        T.setExeUnloadHandle(m_Executor.get(), m_Executor->emitToJIT());
+      }
 
       // Forward to IncrementalExecutor; should not be called by
       // anyone except for IncrementalParser.
-      ExeRes = m_Executor->runStaticInitializersOnce(T);
+      utils::Trace::Span S("staticInit", "transaction");
+      S.setTransactionID(T.getUniqueID());
+      MemProfiler::TransactionScope Attribute(m_MemProfiler.get(),
+                                              T.getUniqueID());
+      TransactionHeap::Scope Heap(m_TransactionHeap.get(), T.getUniqueID());
+      ExeRes = m_Executor->runStaticInitializersOnce(T, m_PerfStat);
     }
 
     return ConvertExecutionResult(ExeRes);
@@ -1266,11 +1865,32 @@ namespace cling {
     std::error_code EC;
     llvm::raw_fd_ostream out(outFile.data(), EC,
                              llvm::sys::fs::OpenFlags::F_None);
-    llvm::raw_fd_ostream log((outFile + ".skipped").str().c_str(),
-                             EC, llvm::sys::fs::OpenFlags::F_None);
-    log << "Generated for :" << inFile << "\n";
+    std::unique_ptr<llvm::raw_fd_ostream> log;
+    if (enableLogs) {
+      log.reset(new llvm::raw_fd_ostream((outFile + ".skipped").str().c_str(),
+                                         EC, llvm::sys::fs::OpenFlags::F_None));
+      *log << "Generated for :" << inFile << "\n";
+    }
     forwardDeclare(*T, fwdGen.getCI()->getSema(), out, enableMacros,
-                   &log);
+                   log.get());
+  }
+
+  Interpreter::CompilationResult
+  Interpreter::exportSession(llvm::StringRef libPath) {
+    if (isInSyntaxOnlyMode()) {
+      llvm::errs() << "cling::Interpreter::exportSession: "
+                      "no code is generated in syntax-only mode.\n";
+      return kFailure;
+    }
+    const Transaction* First = m_LastStartupTransaction
+      ? m_LastStartupTransaction->getNext() : getFirstTransaction();
+    if (!First) {
+      llvm::errs() << "cling::Interpreter::exportSession: "
+                      "nothing to export.\n";
+      return kFailure;
+    }
+    SessionExporter Exporter(*this, First);
+    return Exporter.exportTo(libPath) ? kSuccess : kFailure;
   }
 
   void Interpreter::forwardDeclare(Transaction& T, Sema& S,
@@ -62,9 +62,35 @@ namespace {
   static void ParseStartupOpts(cling::InvocationOptions& Opts,
                                InputArgList& Args) {
     Opts.ErrorOut = Args.hasArg(OPT__errorout);
+    Opts.ExecutorProcess = Args.hasArg(OPT__executor_process);
+    Opts.LazyDebugInfo = Args.hasArg(OPT__lazy_debug_info);
+    Opts.LazyPCHCodeGen = Args.hasArg(OPT__lazy_pch_codegen);
     Opts.NoLogo = Args.hasArg(OPT__nologo);
+    Opts.PrefetchHeaders = Args.hasArg(OPT__prefetch_headers);
+    Opts.TransactionHeapDebug = Args.hasArg(OPT__transaction_heap_debug);
+    Opts.TransactionHeap = Opts.TransactionHeapDebug
+      || Args.hasArg(OPT__transaction_heap);
     Opts.ShowVersion = Args.hasArg(OPT_version);
     Opts.Help = Args.hasArg(OPT_help);
+    if (Arg* ProfileArg = Args.getLastArg(OPT__startup_profile,
+                                          OPT__startup_profile_EQ)) {
+      if (ProfileArg->getOption().matches(OPT__startup_profile_EQ))
+        Opts.StartupProfile = ProfileArg->getValue();
+      if (Opts.StartupProfile.empty())
+        Opts.StartupProfile = "-";
+    }
+    if (Arg* ProfileGenArg = Args.getLastArg(OPT__profile_generate_EQ))
+      Opts.ProfileGenerate = ProfileGenArg->getValue();
+    if (Arg* ProfileUseArg = Args.getLastArg(OPT__profile_use_EQ))
+      Opts.ProfileUse = ProfileUseArg->getValue();
+    if (Arg* RecordArg = Args.getLastArg(OPT__record_session_EQ))
+      Opts.RecordSession = RecordArg->getValue();
+    if (Arg* ReplayArg = Args.getLastArg(OPT__replay_session_EQ))
+      Opts.ReplaySession = ReplayArg->getValue();
+    if (Arg* StatCacheArg = Args.getLastArg(OPT__stat_cache_EQ))
+      Opts.StatCache = StatCacheArg->getValue();
+    if (Arg* JITCacheArg = Args.getLastArg(OPT__jit_cache_EQ))
+      Opts.JITCache = JITCacheArg->getValue();
     if (Arg* MetaStringArg = Args.getLastArg(OPT__metastr, OPT__metastr_EQ)) {
       Opts.MetaString = MetaStringArg->getValue();
       if (Opts.MetaString.empty()) {
@@ -135,8 +161,10 @@ void CompilerOptions::Parse(int argc, const char* const argv[],
 }
 
 InvocationOptions::InvocationOptions(int argc, const char* const* argv) :
-  MetaString("."), ErrorOut(false), NoLogo(false), ShowVersion(false),
-  Help(false) {
+  MetaString("."), ErrorOut(false), ExecutorProcess(false),
+  LazyDebugInfo(false), LazyPCHCodeGen(false), NoLogo(false),
+  PrefetchHeaders(false), TransactionHeap(false), TransactionHeapDebug(false),
+  ShowVersion(false), Help(false) {
 
   ArrayRef<const char *> ArgStrings(argv, argv + argc);
   unsigned MissingArgIndex, MissingArgCount;
@@ -0,0 +1,123 @@
+//------------------------------------------------------------------------------
+// CLING - the C++ LLVM-based InterpreterG :)
+//
+// This file is dual-licensed: you can choose to license it under the University
+// of Illinois Open Source License or the GNU Lesser General Public License. See
+// LICENSE.TXT for details.
+//------------------------------------------------------------------------------
+
+#include "JITObjectCache.h"
+
+#include "llvm/ADT/SmallString.h"
+#include "llvm/ADT/Twine.h"
+#include "llvm/Bitcode/ReaderWriter.h"
+#include "llvm/IR/Module.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/Format.h"
+#include "llvm/Support/MD5.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/Path.h"
+#include "llvm/Support/raw_ostream.h"
+#include "llvm/Target/TargetMachine.h"
+
+using namespace llvm;
+
+namespace cling {
+
+  JITObjectCache::JITObjectCache(StringRef Dir, const TargetMachine& TM):
+    m_Dir(Dir),
+    m_Target((Twine(TM.getTargetTriple().str()) + ":" + TM.getTargetCPU()
+              + ":" + TM.getTargetFeatureString()
+              + ":" + Twine((int)TM.getOptLevel())
+              + ":" + Twine((int)TM.getRelocationModel())
+              + ":" + Twine((int)TM.getCodeModel())).str()),
+    m_NumHits(0), m_NumMisses(0), m_NumWritten(0) {}
+
+  std::string JITObjectCache::getKey(const Module& M) const {
+    // The name numbers the modules of the session; it does not change the
+    // code, apart from the names of static initializers.
+    Module& NcM = const_cast<Module&>(M);
+    const std::string Name = M.getModuleIdentifier();
+    const std::string SourceName = M.getSourceFileName();
+    NcM.setModuleIdentifier("");
+    NcM.setSourceFileName("");
+    SmallString<0> Bitcode;
+    {
+      raw_svector_ostream OS(Bitcode);
+      WriteBitcodeToFile(&M, OS);
+    }
+    NcM.setModuleIdentifier(Name);
+    NcM.setSourceFileName(SourceName);
+
+    MD5 Hash;
+    Hash.update(m_Target);
+    Hash.update(Bitcode.str());
+    MD5::MD5Result Result;
+    Hash.final(Result);
+    SmallString<32> Key;
+    MD5::stringifyResult(Result, Key);
+    return Key.str();
+  }
+
+  std::string JITObjectCache::getPath(StringRef Key) const {
+    SmallString<256> Path(m_Dir);
+    sys::path::append(Path, Twine(Key) + ".o");
+    return Path.str();
+  }
+
+  std::unique_ptr<MemoryBuffer> JITObjectCache::getObject(const Module* M) {
+    TimeRecord Start = TimeRecord::getCurrentTime(/*Start*/true);
+    std::string Key = getKey(*M);
+    TimeRecord End = TimeRecord::getCurrentTime(/*Start*/false);
+    End -= Start;
+    m_KeyTime += End;
+    ErrorOr<std::unique_ptr<MemoryBuffer>> Obj
+      = MemoryBuffer::getFile(getPath(Key));
+    if (!Obj) {
+      ++m_NumMisses;
+      m_PendingKeys[M] = std::move(Key);
+      return nullptr;
+    }
+    ++m_NumHits;
+    return std::move(*Obj);
+  }
+
+  void JITObjectCache::notifyObjectCompiled(const Module* M,
+                                            MemoryBufferRef Obj) {
+    auto Key = m_PendingKeys.find(M);
+    if (Key == m_PendingKeys.end())
+      return;
+    const std::string Path = getPath(Key->second);
+    m_PendingKeys.erase(Key);
+
+    // Concurrent sessions must not see partial objects.
+    int FD;
+    SmallString<256> TmpPath;
+    if (sys::fs::createUniqueFile(Path + "-%%%%%%.tmp", FD, TmpPath))
+      return;
+    {
+      raw_fd_ostream Out(FD, /*shouldClose*/true);
+      Out << Obj.getBuffer();
+      Out.close();
+      if (Out.has_error()) {
+        Out.clear_error();
+        sys::fs::remove(TmpPath);
+        return;
+      }
+    }
+    if (sys::fs::rename(TmpPath, Path)) {
+      sys::fs::remove(TmpPath);
+      return;
+    }
+    ++m_NumWritten;
+  }
+
+  void JITObjectCache::print(raw_ostream& Out) const {
+    Out << "JIT cache: " << m_Dir << '\n'
+        << "  modules loaded:  " << m_NumHits << '\n'
+        << "  modules missed:  " << m_NumMisses << '\n'
+        << "  objects written: " << m_NumWritten << '\n'
+        << "  hashing time:    "
+        << format("%.3f", m_KeyTime.getWallTime() * 1000.) << " ms\n";
+  }
+} // namespace cling
@@ -0,0 +1,84 @@
+//--------------------------------------------------------------------*- C++ -*-
+// CLING - the C++ LLVM-based InterpreterG :)
+//
+// This file is dual-licensed: you can choose to license it under the University
+// of Illinois Open Source License or the GNU Lesser General Public License. See
+// LICENSE.TXT for details.
+//------------------------------------------------------------------------------
+
+#ifndef CLING_JIT_OBJECT_CACHE_H
+#define CLING_JIT_OBJECT_CACHE_H
+
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/StringRef.h"
+#include "llvm/ExecutionEngine/ObjectCache.h"
+#include "llvm/Support/Timer.h"
+
+#include <string>
+
+namespace llvm {
+  class Module;
+  class raw_ostream;
+  class TargetMachine;
+}
+
+namespace cling {
+
+  ///\brief Keeps the object code of the JITted modules in a directory, for
+  /// the sessions to come.
+  ///
+  /// A module's object is stored under the hash of its bitcode, its name
+  /// left out, and of the target machine's settings; a later session
+  /// compiling the same module, for instance the instantiations of the
+  /// templates in a header included again, loads the object instead of
+  /// generating the code. Modules referring to the addresses of the
+  /// session's objects, like most statements do, differ in every session
+  /// and are never found.
+  ///
+  /// Every module is serialized to bitcode to compute its key, also when
+  /// the object is found; '.stats jitcache' reports the time spent on it.
+  /// Only the code generation is cached: Sema still instantiates the
+  /// templates in every session.
+  ///
+  class JITObjectCache: public llvm::ObjectCache {
+  private:
+    const std::string m_Dir;
+
+    ///\brief What the hashes cover of the target machine.
+    ///
+    const std::string m_Target;
+
+    ///\brief The keys of the modules not found in the cache, until their
+    /// object is compiled.
+    ///
+    llvm::DenseMap<const llvm::Module*, std::string> m_PendingKeys;
+
+    unsigned m_NumHits;
+    unsigned m_NumMisses;
+    unsigned m_NumWritten;
+
+    ///\brief The time spent on computing the keys.
+    ///
+    llvm::TimeRecord m_KeyTime;
+
+    std::string getKey(const llvm::Module& M) const;
+    std::string getPath(llvm::StringRef Key) const;
+
+  public:
+    ///\param [in] Dir - The directory; it must exist.
+    ///\param [in] TM - The target machine generating the objects.
+    ///
+    JITObjectCache(llvm::StringRef Dir, const llvm::TargetMachine& TM);
+
+    void notifyObjectCompiled(const llvm::Module* M,
+                              llvm::MemoryBufferRef Obj) override;
+    std::unique_ptr<llvm::MemoryBuffer>
+    getObject(const llvm::Module* M) override;
+
+    ///\brief Prints how many modules were found and stored.
+    ///
+    void print(llvm::raw_ostream& Out) const;
+  };
+} // namespace cling
+
+#endif // CLING_JIT_OBJECT_CACHE_H
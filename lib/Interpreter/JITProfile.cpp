@@ -0,0 +1,206 @@
+//------------------------------------------------------------------------------
+// CLING - the C++ LLVM-based InterpreterG :)
+//
+// This file is dual-licensed: you can choose to license it under the University
+// of Illinois Open Source License or the GNU Lesser General Public License. See
+// LICENSE.TXT for details.
+//------------------------------------------------------------------------------
+
+#include "JITProfile.h"
+
+#include "ExecutorProcess.h"
+
+#include "cling/Utils/AST.h"
+
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/SmallString.h"
+#include "llvm/IR/Constants.h"
+#include "llvm/IR/Function.h"
+#include "llvm/IR/GlobalVariable.h"
+#include "llvm/IR/IRBuilder.h"
+#include "llvm/IR/IntrinsicInst.h"
+#include "llvm/IR/Module.h"
+#include "llvm/ProfileData/InstrProfReader.h"
+#include "llvm/ProfileData/InstrProfWriter.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/MD5.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include <cctype>
+#include <cstring>
+
+using namespace llvm;
+
+namespace {
+  static bool isUniqueName(StringRef Name) {
+    return Name.find(cling::utils::Synthesize::UniquePrefix) != StringRef::npos;
+  }
+
+  ///\brief Hashes what identifies an operand across sessions: names of
+  /// globals other than cling's unique ones, contents of string literals and
+  /// integer constants. Addresses baked in by cling, as inttoptr, vary from
+  /// one session to the next and are left out.
+  ///
+  static void hashOperand(MD5& Hash, const Value* V) {
+    if (const GlobalVariable* GV = dyn_cast<GlobalVariable>(V)) {
+      if (GV->hasPrivateLinkage() && GV->hasInitializer())
+        if (const ConstantDataSequential* CDS
+              = dyn_cast<ConstantDataSequential>(GV->getInitializer())) {
+          Hash.update(CDS->getRawDataValues());
+          return;
+        }
+    }
+    if (const GlobalValue* GV = dyn_cast<GlobalValue>(V)) {
+      if (!isUniqueName(GV->getName()))
+        Hash.update(GV->getName());
+      return;
+    }
+    if (const ConstantInt* CI = dyn_cast<ConstantInt>(V))
+      Hash.update(CI->getValue().toString(16, /*Signed*/false));
+  }
+} // unnamed namespace
+
+namespace cling {
+
+JITProfile::JITProfile(StringRef OutFile, StringRef UseFile):
+  m_OutFile(OutFile), m_UseFile(UseFile), m_Process(0) {}
+
+JITProfile::~JITProfile() {}
+
+std::string JITProfile::getStableName(const llvm::Function& F) {
+  StringRef Name = F.getName();
+  const size_t Pos = Name.find(utils::Synthesize::UniquePrefix);
+  if (Pos == StringRef::npos)
+    return Name;
+
+  MD5 Hash;
+  for (const BasicBlock& BB: F) {
+    for (const Instruction& I: BB) {
+      const unsigned Opcode = I.getOpcode();
+      Hash.update(ArrayRef<uint8_t>((const uint8_t*)&Opcode, sizeof(Opcode)));
+      for (const Use& Op: I.operands())
+        hashOperand(Hash, Op.get());
+    }
+  }
+  MD5::MD5Result Result;
+  Hash.final(Result);
+  SmallString<32> Digest;
+  MD5::stringifyResult(Result, Digest);
+
+  // Drop the number following the prefix and, in mangled names, the length
+  // preceding it.
+  size_t Begin = Pos;
+  while (Begin && isdigit(Name[Begin - 1]))
+    --Begin;
+  size_t End = Pos + strlen(utils::Synthesize::UniquePrefix);
+  if (Name.substr(End).startswith("_slot"))
+    End += strlen("_slot");
+  while (End < Name.size() && isdigit(Name[End]))
+    ++End;
+  return (Name.substr(0, Begin) + utils::Synthesize::UniquePrefix + "_"
+          + Digest + Name.substr(End)).str();
+}
+
+uint64_t* JITProfile::allocateCounters(uint32_t NumCounters) {
+  // Code running in the executor updates counters in the shared arena.
+  if (m_Process && m_Process->isActive())
+    if (uint8_t* Mem = m_Process->allocate(NumCounters * sizeof(uint64_t),
+                                           alignof(uint64_t),
+                                           /*Writable*/false))
+      return reinterpret_cast<uint64_t*>(Mem);
+  m_Storage.emplace_back(new uint64_t[NumCounters]());
+  return m_Storage.back().get();
+}
+
+void JITProfile::lowerCounters(llvm::Module& M) {
+  SmallVector<InstrProfIncrementInst*, 64> Increments;
+  SmallVector<Instruction*, 8> ValueProfiles;
+  for (llvm::Function& F: M)
+    for (BasicBlock& BB: F)
+      for (Instruction& I: BB) {
+        if (InstrProfIncrementInst* Inc = dyn_cast<InstrProfIncrementInst>(&I))
+          Increments.push_back(Inc);
+        else if (isa<InstrProfValueProfileInst>(&I))
+          ValueProfiles.push_back(&I);
+      }
+
+  // Only the edge counters are kept.
+  for (Instruction* I: ValueProfiles)
+    I->eraseFromParent();
+
+  DenseMap<GlobalVariable*, uint64_t*> Counters;
+  Type* Int64Ty = Type::getInt64Ty(M.getContext());
+  for (InstrProfIncrementInst* Inc: Increments) {
+    GlobalVariable* NameVar = Inc->getName();
+    uint64_t*& FuncCounters = Counters[NameVar];
+    if (!FuncCounters) {
+      const uint32_t NumCounters = Inc->getNumCounters()->getZExtValue();
+      FuncCounters = allocateCounters(NumCounters);
+      StringRef Name
+        = cast<ConstantDataSequential>(NameVar->getInitializer())->getAsString();
+      m_Functions.push_back(Function{Name, Inc->getHash()->getZExtValue(),
+                                     FuncCounters, NumCounters});
+    }
+
+    uint64_t* Counter = FuncCounters + Inc->getIndex()->getZExtValue();
+    IRBuilder<> Builder(Inc);
+    Constant* Addr
+      = ConstantExpr::getIntToPtr(ConstantInt::get(Int64Ty, (uintptr_t)Counter),
+                                  Int64Ty->getPointerTo());
+    Value* Count = Builder.CreateLoad(Addr, "pgocount");
+    Builder.CreateStore(Builder.CreateAdd(Count, Builder.getInt64(1)), Addr);
+    Inc->eraseFromParent();
+  }
+
+  for (auto&& I: Counters) {
+    GlobalVariable* NameVar = I.first;
+    NameVar->removeDeadConstantUsers();
+    if (NameVar->use_empty())
+      NameVar->eraseFromParent();
+  }
+  // The marker of IR-level profiles would be defined by every module.
+  if (GlobalVariable* Version = M.getNamedGlobal("__llvm_profile_raw_version"))
+    Version->eraseFromParent();
+}
+
+bool JITProfile::write() {
+  if (!isGenerating())
+    return true;
+
+  InstrProfWriter Writer;
+  if (Error E = Writer.setIsIRLevelProfile(true))
+    consumeError(std::move(E));
+
+  // Accumulate over the sessions writing to the same file.
+  if (sys::fs::exists(m_OutFile)) {
+    auto ReaderOrErr = IndexedInstrProfReader::create(m_OutFile);
+    if (!ReaderOrErr) {
+      consumeError(ReaderOrErr.takeError());
+      errs() << "cling::JITProfile: replacing unreadable profile '"
+             << m_OutFile << "'.\n";
+    } else if ((*ReaderOrErr)->isIRLevelProfile()) {
+      for (InstrProfRecord& Record: **ReaderOrErr)
+        if (Error E = Writer.addRecord(std::move(Record)))
+          consumeError(std::move(E));
+    }
+  }
+
+  for (const Function& F: m_Functions) {
+    std::vector<uint64_t> Counts(F.Counters, F.Counters + F.NumCounters);
+    if (Error E = Writer.addRecord(InstrProfRecord(F.Name, F.Hash,
+                                                   std::move(Counts))))
+      consumeError(std::move(E));
+  }
+
+  std::error_code EC;
+  raw_fd_ostream Out(m_OutFile, EC, sys::fs::F_None);
+  if (EC) {
+    errs() << "cling::JITProfile: cannot write '" << m_OutFile << "': "
+           << EC.message() << '\n';
+    return false;
+  }
+  Writer.write(Out);
+  return true;
+}
+
+} // namespace cling
@@ -0,0 +1,102 @@
+//--------------------------------------------------------------------*- C++ -*-
+// CLING - the C++ LLVM-based InterpreterG :)
+//
+// This file is dual-licensed: you can choose to license it under the University
+// of Illinois Open Source License or the GNU Lesser General Public License. See
+// LICENSE.TXT for details.
+//------------------------------------------------------------------------------
+
+#ifndef CLING_JIT_PROFILE_H
+#define CLING_JIT_PROFILE_H
+
+#include "llvm/ADT/StringRef.h"
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace llvm {
+  class Function;
+  class Module;
+}
+
+namespace cling {
+  class ExecutorProcess;
+
+  ///\brief Profile of the JITted code, for profile-guided optimization.
+  ///
+  /// BackendPasses instruments or annotates the modules with LLVM's IR-level
+  /// PGO passes. The instrumentation's counters are lowered here to plain
+  /// arrays owned by the profile, which outlive unloaded transactions; at
+  /// shutdown they are merged into an indexed profile file, so no profile
+  /// runtime and no llvm-profdata merge step is needed. The same file is then
+  /// handed to the next session through --profile-use.
+  ///
+  /// Functions are keyed by their name, except that the numbering of cling's
+  /// unique names is replaced by a hash of the function's code; a statement
+  /// profiled in one session thus matches the same statement in the next.
+  ///
+  class JITProfile {
+  private:
+    ///\brief An instrumented function and its counters.
+    ///
+    struct Function {
+      std::string Name;
+      uint64_t Hash;
+      uint64_t* Counters;
+      uint32_t NumCounters;
+    };
+
+    ///\brief The file the counters are merged into; empty if not generating.
+    ///
+    std::string m_OutFile;
+
+    ///\brief The profile annotating the modules; empty if not using one.
+    ///
+    std::string m_UseFile;
+
+    std::vector<Function> m_Functions;
+
+    ///\brief Counter arrays allocated in this process.
+    ///
+    std::vector<std::unique_ptr<uint64_t[]>> m_Storage;
+
+    ///\brief Where the counters go once code runs in another process.
+    ///
+    ExecutorProcess* m_Process;
+
+    uint64_t* allocateCounters(uint32_t NumCounters);
+
+  public:
+    ///\param [in] OutFile - The profile to write, or empty.
+    ///\param [in] UseFile - The profile to optimize with, or empty.
+    ///
+    JITProfile(llvm::StringRef OutFile, llvm::StringRef UseFile);
+    ~JITProfile();
+
+    bool isGenerating() const { return !m_OutFile.empty(); }
+    llvm::StringRef getUseFile() const { return m_UseFile; }
+
+    ///\brief Allocates the counters of code running in Process from now on.
+    ///
+    void setExecutorProcess(ExecutorProcess* Process) { m_Process = Process; }
+
+    ///\brief Returns the name F is profiled as.
+    ///
+    static std::string getStableName(const llvm::Function& F);
+
+    ///\brief Replaces the instrumentation intrinsics in M by updates of
+    /// counters registered with this profile.
+    ///
+    void lowerCounters(llvm::Module& M);
+
+    ///\brief Merges the counters into the output file.
+    ///
+    ///\returns false if the file could not be written.
+    ///
+    bool write();
+  };
+} // namespace cling
+
+#endif // CLING_JIT_PROFILE_H
@@ -0,0 +1,169 @@
+//------------------------------------------------------------------------------
+// CLING - the C++ LLVM-based InterpreterG :)
+//
+// This file is dual-licensed: you can choose to license it under the University
+// of Illinois Open Source License or the GNU Lesser General Public License. See
+// LICENSE.TXT for details.
+//------------------------------------------------------------------------------
+
+#include "LazyCodeGen.h"
+
+#include "BackendPasses.h"
+
+#include "cling/Interpreter/Interpreter.h"
+#include "cling/Utils/AST.h"
+
+#include "clang/AST/ASTContext.h"
+#include "clang/AST/Attr.h"
+#include "clang/AST/DeclCXX.h"
+#include "clang/AST/GlobalDecl.h"
+#include "clang/CodeGen/ModuleBuilder.h"
+#include "clang/Frontend/CompilerInstance.h"
+
+#include "llvm/IR/Module.h"
+#include "llvm/Support/raw_ostream.h"
+#include "llvm/Transforms/Utils/ModuleUtils.h"
+
+using namespace clang;
+
+namespace cling {
+
+  LazyCodeGen::LazyCodeGen(Interpreter& Interp, BackendPasses* Passes):
+    m_Interp(Interp), m_Passes(Passes), m_Thread(std::this_thread::get_id()),
+    m_NumDeferred(0), m_NumMaterialized(0) {}
+
+  LazyCodeGen::~LazyCodeGen() {}
+
+  void LazyCodeGen::getGlobalDecls(const FunctionDecl* FD,
+                                   llvm::SmallVectorImpl<GlobalDecl>& GDs) {
+    if (const CXXConstructorDecl* Ctor = dyn_cast<CXXConstructorDecl>(FD)) {
+      GDs.push_back(GlobalDecl(Ctor, Ctor_Complete));
+      GDs.push_back(GlobalDecl(Ctor, Ctor_Base));
+    } else if (const CXXDestructorDecl* Dtor
+               = dyn_cast<CXXDestructorDecl>(FD)) {
+      GDs.push_back(GlobalDecl(Dtor, Dtor_Complete));
+      GDs.push_back(GlobalDecl(Dtor, Dtor_Base));
+      if (Dtor->isVirtual())
+        GDs.push_back(GlobalDecl(Dtor, Dtor_Deleting));
+    } else {
+      GDs.push_back(GlobalDecl(FD));
+    }
+  }
+
+  void LazyCodeGen::getNames(const FunctionDecl* FD,
+                             llvm::SmallVectorImpl<std::string>& Names) const {
+    llvm::SmallVector<GlobalDecl, 3> GDs;
+    getGlobalDecls(FD, GDs);
+    for (const GlobalDecl& GD: GDs) {
+      Names.push_back(std::string());
+      utils::Analyze::maybeMangleDeclName(GD, Names.back());
+    }
+  }
+
+  bool LazyCodeGen::defer(const Decl* D) {
+    const FunctionDecl* FD = dyn_cast<FunctionDecl>(D);
+    if (!FD || !FD->isFromASTFile())
+      return false;
+    // The JIT has it already.
+    if (m_Materialized.count(FD))
+      return true;
+    if (!FD->doesThisDeclarationHaveABody() || FD->isDependentContext()
+        || FD->hasAttr<UsedAttr>())
+      return false;
+    // Only what every module referring to it defines anyway.
+    if (FD->getASTContext().GetGVALinkageForFunction(FD) != GVA_DiscardableODR)
+      return false;
+
+    llvm::SmallVector<std::string, 3> Names;
+    getNames(FD, Names);
+    if (m_Deferred.count(Names.front()))
+      return true;
+    for (const std::string& N: Names)
+      m_Deferred[N] = FD;
+    ++m_NumDeferred;
+    return true;
+  }
+
+  bool LazyCodeGen::canMaterialize(llvm::StringRef Name) const {
+    return m_Deferred.count(Name);
+  }
+
+  llvm::Module* LazyCodeGen::materialize(llvm::StringRef Name) {
+    // A stub called by another thread would run Sema and CodeGen
+    // concurrently with the interpreter's.
+    assert(std::this_thread::get_id() == m_Thread
+           && "Materializing outside of the interpreter's thread!");
+    if (std::this_thread::get_id() != m_Thread) {
+      llvm::errs() << "cling::LazyCodeGen: cannot generate the code of '"
+                   << Name << "' outside of the interpreter's thread.\n";
+      return nullptr;
+    }
+    auto I = m_Deferred.find(Name);
+    if (I == m_Deferred.end())
+      return nullptr;
+    const FunctionDecl* FD = I->second;
+    llvm::SmallVector<std::string, 3> Names;
+    getNames(FD, Names);
+    for (const std::string& N: Names)
+      m_Deferred.erase(N);
+    m_Materialized.insert(FD);
+
+    CompilerInstance* CI = m_Interp.getCI();
+    ASTContext& Ctx = CI->getASTContext();
+    const unsigned NumErrors = CI->getDiagnosticClient().getNumErrors();
+    {
+      // Emission might deserialize or instantiate further declarations.
+      Interpreter::PushTransactionRAII RAII(&m_Interp);
+      if (!m_CodeGen) {
+        m_CodeGen.reset(CreateLLVMCodeGen(CI->getDiagnostics(),
+                                          "cling-lazy-module-0",
+                                          CI->getHeaderSearchOpts(),
+                                          CI->getPreprocessorOpts(),
+                                          CI->getCodeGenOpts(), m_Context));
+        m_CodeGen->Initialize(Ctx);
+      }
+      // CodeGen only reads the declaration.
+      m_CodeGen->HandleTopLevelDecl(
+        DeclGroupRef(const_cast<FunctionDecl*>(FD)));
+      // CodeGen emits what the module refers to; llvm.used keeps it through
+      // the passes although nothing calls it.
+      llvm::SmallVector<GlobalDecl, 3> GDs;
+      getGlobalDecls(FD, GDs);
+      llvm::SmallVector<llvm::GlobalValue*, 3> Used;
+      for (const GlobalDecl& GD: GDs) {
+        llvm::Constant* C = m_CodeGen->GetAddrOfGlobal(GD,
+                                                       /*isForDefinition*/false);
+        if (llvm::GlobalValue* GV
+            = dyn_cast<llvm::GlobalValue>(C->stripPointerCasts()))
+          Used.push_back(GV);
+      }
+      llvm::appendToUsed(*m_CodeGen->GetModule(), Used);
+      m_CodeGen->HandleTranslationUnit(Ctx);
+    }
+    std::unique_ptr<llvm::Module> M(m_CodeGen->ReleaseModule());
+    std::string ModuleName;
+    {
+      llvm::raw_string_ostream strm(ModuleName);
+      strm << "cling-lazy-module-" << m_Modules.size() + 1;
+    }
+    m_CodeGen->StartModule(ModuleName, m_Context, CI->getCodeGenOpts());
+
+    if (CI->getDiagnosticClient().getNumErrors() != NumErrors || !M) {
+      llvm::errs() << "cling::LazyCodeGen: cannot generate the code of '"
+                   << Name << "'.\n";
+      return nullptr;
+    }
+    if (m_Passes)
+      m_Passes->runOnModule(*M);
+    ++m_NumMaterialized;
+    m_Modules.push_back(std::move(M));
+    return m_Modules.back().get();
+  }
+
+  void LazyCodeGen::print(llvm::raw_ostream& Out) const {
+    Out << "Deserialized inline functions:\n"
+        << "  kept back: " << m_NumDeferred << '\n'
+        << "  generated: " << m_NumMaterialized << '\n';
+  }
+
+} // namespace cling
@@ -0,0 +1,126 @@
+//--------------------------------------------------------------------*- C++ -*-
+// CLING - the C++ LLVM-based InterpreterG :)
+//
+// This file is dual-licensed: you can choose to license it under the University
+// of Illinois Open Source License or the GNU Lesser General Public License. See
+// LICENSE.TXT for details.
+//------------------------------------------------------------------------------
+
+#ifndef CLING_LAZY_CODEGEN_H
+#define CLING_LAZY_CODEGEN_H
+
+#include "IncrementalJIT.h"
+
+#include "llvm/ADT/DenseSet.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/ADT/StringMap.h"
+#include "llvm/IR/LLVMContext.h"
+
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace clang {
+  class CodeGenerator;
+  class Decl;
+  class FunctionDecl;
+  class GlobalDecl;
+}
+
+namespace llvm {
+  class Module;
+  class raw_ostream;
+}
+
+namespace cling {
+  class BackendPasses;
+  class Interpreter;
+
+  ///\brief Generates the code of the inline functions deserialized from a
+  /// PCH only when the JIT needs them.
+  ///
+  /// The DeclCollector hands every function definition deserialized while
+  /// handling a transaction to CodeGen, which emits it again in each module
+  /// referring to it, together with whatever it calls in turn. The inline
+  /// functions are kept back instead; a module calling one refers to its
+  /// symbol, which the IncrementalJIT asks for once neither the JIT nor the
+  /// libraries define it. The function then gets a module of its own,
+  /// generated by a CodeGenerator of its own, once per session; the JIT
+  /// generates it on the first call where it has stubs for the target.
+  ///
+  /// Functions CodeGen finds on its own, those defined in their class, are
+  /// still emitted where they are referenced.
+  ///
+  /// Generating a function runs Sema and CodeGen, which are not thread-safe:
+  /// the stubs must be called first from the interpreter's thread; other
+  /// threads get the missing symbol reported.
+  ///
+  class LazyCodeGen: public SymbolMaterializer {
+  private:
+    Interpreter& m_Interp;
+
+    ///\brief The passes the transactions' modules go through, if any.
+    ///
+    BackendPasses* m_Passes;
+
+    ///\brief The context of the generated modules; declared before them.
+    ///
+    llvm::LLVMContext m_Context;
+
+    std::unique_ptr<clang::CodeGenerator> m_CodeGen;
+
+    ///\brief The generated modules, added to the JIT for the session.
+    ///
+    std::vector<std::unique_ptr<llvm::Module>> m_Modules;
+
+    ///\brief The functions kept back, by symbol; constructors and
+    /// destructors have a symbol per variant.
+    ///
+    llvm::StringMap<const clang::FunctionDecl*> m_Deferred;
+
+    ///\brief The functions generated on demand.
+    ///
+    llvm::DenseSet<const clang::FunctionDecl*> m_Materialized;
+
+    ///\brief The thread the interpreter runs on.
+    ///
+    std::thread::id m_Thread;
+
+    unsigned m_NumDeferred;
+    unsigned m_NumMaterialized;
+
+    ///\brief Collects the variants of a function CodeGen emits.
+    ///
+    static void getGlobalDecls(const clang::FunctionDecl* FD,
+                               llvm::SmallVectorImpl<clang::GlobalDecl>& GDs);
+
+    ///\brief Collects the symbols of a function.
+    ///
+    void getNames(const clang::FunctionDecl* FD,
+                  llvm::SmallVectorImpl<std::string>& Names) const;
+
+  public:
+    ///\param [in] Passes - The passes the transactions' modules go through,
+    ///   if any.
+    ///
+    LazyCodeGen(Interpreter& Interp, BackendPasses* Passes);
+    ~LazyCodeGen();
+
+    ///\brief Keeps back a declaration coming from an AST file, if it is a
+    /// function that can be generated when needed.
+    ///
+    ///\returns whether CodeGen must not see the declaration.
+    ///
+    bool defer(const clang::Decl* D);
+
+    bool canMaterialize(llvm::StringRef Name) const override;
+    llvm::Module* materialize(llvm::StringRef Name) override;
+
+    ///\brief Prints how many functions were kept back and generated.
+    ///
+    void print(llvm::raw_ostream& Out) const;
+  };
+} // namespace cling
+
+#endif // CLING_LAZY_CODEGEN_H
@@ -0,0 +1,118 @@
+//------------------------------------------------------------------------------
+// CLING - the C++ LLVM-based InterpreterG :)
+//
+// This file is dual-licensed: you can choose to license it under the University
+// of Illinois Open Source License or the GNU Lesser General Public License. See
+// LICENSE.TXT for details.
+//------------------------------------------------------------------------------
+
+#include "LazyDebugInfo.h"
+
+#include "BackendPasses.h"
+#include "IncrementalExecutor.h"
+
+#include "cling/Interpreter/Interpreter.h"
+#include "cling/Interpreter/Transaction.h"
+
+#include "clang/AST/ASTContext.h"
+#include "clang/AST/Decl.h"
+#include "clang/AST/DeclCXX.h"
+#include "clang/CodeGen/ModuleBuilder.h"
+#include "clang/Frontend/CompilerInstance.h"
+
+#include "llvm/IR/LLVMContext.h"
+#include "llvm/IR/Module.h"
+#include "llvm/Support/raw_ostream.h"
+
+using namespace clang;
+
+namespace cling {
+
+  LazyDebugInfo::LazyDebugInfo(Interpreter& Interp,
+                               codegenoptions::DebugInfoKind Kind):
+    m_Interp(Interp), m_Kind(Kind) {}
+
+  void LazyDebugInfo::collect(const Transaction& T, CodeGenerator& CG) {
+    for (auto I = T.nested_begin(), E = T.nested_end(); I != E; ++I)
+      if ((*I)->getState() == Transaction::kCommitted)
+        collect(**I, CG);
+
+    // As IncrementalParser::codeGenTransaction() does; wrappers included,
+    // as the statements are code, too.
+    for (auto I = T.decls_begin(), E = T.decls_end(); I != E; ++I) {
+      for (Decl* D: I->m_DGR) {
+        switch (I->m_Call) {
+        case Transaction::kCCIHandleTopLevelDecl:
+        case Transaction::kCCIHandleInterestingDecl:
+          CG.HandleTopLevelDecl(DeclGroupRef(D));
+          break;
+        case Transaction::kCCIHandleTagDeclDefinition:
+          CG.HandleTagDeclDefinition(cast<TagDecl>(D));
+          break;
+        case Transaction::kCCIHandleVTable:
+          CG.HandleVTable(cast<CXXRecordDecl>(D));
+          break;
+        case Transaction::kCCIHandleCXXImplicitFunctionInstantiation:
+          CG.HandleCXXImplicitFunctionInstantiation(cast<FunctionDecl>(D));
+          break;
+        case Transaction::kCCIHandleCXXStaticMemberVarInstantiation:
+          CG.HandleCXXStaticMemberVarInstantiation(cast<VarDecl>(D));
+          break;
+        case Transaction::kCCICompleteTentativeDefinition:
+          CG.CompleteTentativeDefinition(cast<VarDecl>(D));
+          break;
+        default:
+          break;
+        }
+      }
+    }
+  }
+
+  unsigned LazyDebugInfo::load(const Transaction* First,
+                               IncrementalExecutor& Exe,
+                               BackendPasses* Passes) {
+    std::vector<const Transaction*> Pending;
+    for (const Transaction* T = First; T; T = T->getNext())
+      if (T->getState() == Transaction::kCommitted && T->getModule()
+          && !m_Loaded.count(T->getModule()))
+        Pending.push_back(T);
+    if (Pending.empty())
+      return 0;
+
+    CompilerInstance* CI = m_Interp.getCI();
+    CodeGenOptions CGOpts = CI->getCodeGenOpts();
+    CGOpts.setDebugInfo(m_Kind);
+    // A context of its own: the module is dropped once compiled.
+    llvm::LLVMContext Ctx;
+    std::unique_ptr<CodeGenerator>
+      CG(CreateLLVMCodeGen(CI->getDiagnostics(), "cling-debug-info",
+                           CI->getHeaderSearchOpts(),
+                           CI->getPreprocessorOpts(), CGOpts, Ctx));
+    const unsigned NumErrors = CI->getDiagnosticClient().getNumErrors();
+    {
+      // Emission might deserialize or instantiate further declarations.
+      Interpreter::PushTransactionRAII RAII(&m_Interp);
+      CG->Initialize(CI->getASTContext());
+      for (const Transaction* T: Pending)
+        collect(*T, *CG);
+      CG->HandleTranslationUnit(CI->getASTContext());
+    }
+    std::unique_ptr<llvm::Module> M(CG->ReleaseModule());
+    if (CI->getDiagnosticClient().getNumErrors() != NumErrors || !M) {
+      llvm::errs() << "cling::LazyDebugInfo: cannot generate the debug info "
+                      "of the session.\n";
+      return 0;
+    }
+    // Generate the code of the JITted modules, such that it can be matched.
+    if (Passes)
+      Passes->runOnModule(*M);
+    for (const Transaction* T: Pending)
+      m_Loaded.insert(T->getModule());
+    return Exe.addDebugModule(*M);
+  }
+
+  void LazyDebugInfo::forget(const Transaction& T) {
+    m_Loaded.erase(T.getModule());
+  }
+
+} // namespace cling
@@ -0,0 +1,80 @@
+//--------------------------------------------------------------------*- C++ -*-
+// CLING - the C++ LLVM-based InterpreterG :)
+//
+// This file is dual-licensed: you can choose to license it under the University
+// of Illinois Open Source License or the GNU Lesser General Public License. See
+// LICENSE.TXT for details.
+//------------------------------------------------------------------------------
+
+#ifndef CLING_LAZY_DEBUG_INFO_H
+#define CLING_LAZY_DEBUG_INFO_H
+
+#include "clang/Frontend/CodeGenOptions.h"
+
+#include "llvm/ADT/DenseSet.h"
+
+namespace clang {
+  class CodeGenerator;
+}
+
+namespace llvm {
+  class Module;
+}
+
+namespace cling {
+  class BackendPasses;
+  class IncrementalExecutor;
+  class Interpreter;
+  class Transaction;
+
+  ///\brief Generates the debug info of the JITted code only when it is
+  /// needed.
+  ///
+  /// The transactions are compiled without debug info. When it is needed,
+  /// the declarations of the transactions not handled yet are handed once
+  /// more to a CodeGenerator of their own, generating debug info this time.
+  /// The IncrementalJIT compiles that module without loading it and takes
+  /// the line tables of the functions whose code it matches.
+  ///
+  /// Debuggers do not see the line tables, as the object they come from is
+  /// not loaded; the code instrumented for --profile-generate gets none.
+  ///
+  class LazyDebugInfo {
+  private:
+    Interpreter& m_Interp;
+
+    ///\brief The debug info to generate.
+    ///
+    clang::codegenoptions::DebugInfoKind m_Kind;
+
+    ///\brief The modules of the transactions handled so far.
+    ///
+    llvm::DenseSet<const llvm::Module*> m_Loaded;
+
+    ///\brief Feeds the declarations of T and its nested transactions to CG.
+    ///
+    void collect(const Transaction& T, clang::CodeGenerator& CG);
+
+  public:
+    LazyDebugInfo(Interpreter& Interp,
+                  clang::codegenoptions::DebugInfoKind Kind);
+
+    ///\brief Generates the debug info of the committed transactions from
+    /// First on that were not handled yet.
+    ///
+    ///\param [in] Exe - The executor that ran their code.
+    ///\param [in] Passes - The passes the transactions' modules went
+    ///   through, if any.
+    ///
+    ///\returns the number of JITted functions that gained line tables.
+    ///
+    unsigned load(const Transaction* First, IncrementalExecutor& Exe,
+                  BackendPasses* Passes);
+
+    ///\brief Forgets an unloaded transaction.
+    ///
+    void forget(const Transaction& T);
+  };
+} // namespace cling
+
+#endif // CLING_LAZY_DEBUG_INFO_H
@@ -12,6 +12,7 @@
 #include "DeclUnloader.h"
 #include "cling/Interpreter/Interpreter.h"
 #include "cling/Utils/AST.h"
+#include "cling/Utils/Trace.h"
 
 #include "clang/AST/ASTContext.h"
 #include "clang/Frontend/CompilerInstance.h"
@@ -463,6 +464,7 @@ namespace cling {
 
   QualType LookupHelper::findType(llvm::StringRef typeName,
                                   DiagSetting diagOnOff) const {
+    utils::Trace::Span TraceS("findType", "lookup", typeName);
     //
     //  Our return value.
     //
@@ -517,6 +519,7 @@ namespace cling {
                                       DiagSetting diagOnOff,
                                       const Type** resultType /* = 0 */,
                                       bool instantiateTemplate/*=true*/) const {
+    utils::Trace::Span TraceS("findScope", "lookup", className);
 
     //
     //  Some utilities.
@@ -776,6 +779,7 @@ namespace cling {
 
   const ClassTemplateDecl* LookupHelper::findClassTemplate(llvm::StringRef Name,
                                                            DiagSetting diagOnOff) const {
+    utils::Trace::Span TraceS("findClassTemplate", "lookup", Name);
     //
     //  Find a class template decl given its name.
     //
@@ -871,6 +875,7 @@ namespace cling {
   const ValueDecl* LookupHelper::findDataMember(const clang::Decl* scopeDecl,
                                                 llvm::StringRef dataName,
                                                 DiagSetting diagOnOff) const {
+    utils::Trace::Span TraceS("findDataMember", "lookup", dataName);
     // Lookup a data member based on its Decl(Context), name.
 
     Parser& P = *m_Parser;
@@ -1461,6 +1466,7 @@ namespace cling {
                               LookupHelper::DiagSetting diagOnOff
                               )
   {
+    utils::Trace::Span TraceS("findFunction", "lookup", funcName);
 
     assert(scopeDecl && "Decl cannot be null");
     //
@@ -0,0 +1,370 @@
+//------------------------------------------------------------------------------
+// CLING - the C++ LLVM-based InterpreterG :)
+//
+// This file is dual-licensed: you can choose to license it under the University
+// of Illinois Open Source License or the GNU Lesser General Public License. See
+// LICENSE.TXT for details.
+//------------------------------------------------------------------------------
+
+#include "MemProfiler.h"
+
+#include "AllocationFunctions.h"
+#include "IncrementalExecutor.h"
+
+#include "llvm/ADT/StringExtras.h"
+#include "llvm/Support/Compiler.h"
+#include "llvm/Support/Format.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+#ifndef LLVM_ON_WIN32
+#include <cxxabi.h>
+#endif
+
+using namespace llvm;
+
+namespace {
+  ///\brief The profiler the hooks report to; set while one exists, even if
+  /// it is not running, so that it sees the release of its blocks.
+  ///
+  static std::atomic<cling::MemProfiler*> s_Profiler(nullptr);
+
+  static void recordAlloc(void* Ptr, size_t Size, void* CallSite) {
+    cling::MemProfiler* Profiler = s_Profiler.load(std::memory_order_acquire);
+    if (Ptr && Profiler && Profiler->isRunning())
+      Profiler->recordAlloc(Ptr, Size, (uintptr_t)CallSite);
+  }
+
+  static void recordFree(void* Ptr) {
+    if (!Ptr)
+      return;
+    if (cling::MemProfiler* Profiler = s_Profiler.load(std::memory_order_acquire))
+      Profiler->recordFree(Ptr);
+  }
+
+  // The hooks must stay real calls: __builtin_return_address(0) is the
+  // JITted call site.
+
+  LLVM_ATTRIBUTE_NOINLINE static void* hookMalloc(size_t Size) {
+    void* Ptr = ::malloc(Size);
+    recordAlloc(Ptr, Size, __builtin_return_address(0));
+    return Ptr;
+  }
+
+  LLVM_ATTRIBUTE_NOINLINE static void* hookCalloc(size_t N, size_t Size) {
+    void* Ptr = ::calloc(N, Size);
+    recordAlloc(Ptr, N * Size, __builtin_return_address(0));
+    return Ptr;
+  }
+
+  LLVM_ATTRIBUTE_NOINLINE static void* hookRealloc(void* Old, size_t Size) {
+    void* Ptr = ::realloc(Old, Size);
+    if (Ptr || !Size) {
+      recordFree(Old);
+      recordAlloc(Ptr, Size, __builtin_return_address(0));
+    }
+    return Ptr;
+  }
+
+  LLVM_ATTRIBUTE_NOINLINE static void hookFree(void* Ptr) {
+    recordFree(Ptr);
+    ::free(Ptr);
+  }
+
+  LLVM_ATTRIBUTE_NOINLINE static void* hookNew(size_t Size) {
+    void* Ptr = ::operator new(Size);
+    recordAlloc(Ptr, Size, __builtin_return_address(0));
+    return Ptr;
+  }
+
+  LLVM_ATTRIBUTE_NOINLINE static void* hookNewArray(size_t Size) {
+    void* Ptr = ::operator new[](Size);
+    recordAlloc(Ptr, Size, __builtin_return_address(0));
+    return Ptr;
+  }
+
+  LLVM_ATTRIBUTE_NOINLINE
+  static void* hookNewNothrow(size_t Size, const std::nothrow_t& NT) {
+    void* Ptr = ::operator new(Size, NT);
+    recordAlloc(Ptr, Size, __builtin_return_address(0));
+    return Ptr;
+  }
+
+  LLVM_ATTRIBUTE_NOINLINE
+  static void* hookNewArrayNothrow(size_t Size, const std::nothrow_t& NT) {
+    void* Ptr = ::operator new[](Size, NT);
+    recordAlloc(Ptr, Size, __builtin_return_address(0));
+    return Ptr;
+  }
+
+  LLVM_ATTRIBUTE_NOINLINE static void hookDelete(void* Ptr) {
+    recordFree(Ptr);
+    ::operator delete(Ptr);
+  }
+
+  LLVM_ATTRIBUTE_NOINLINE static void hookDeleteArray(void* Ptr) {
+    recordFree(Ptr);
+    ::operator delete[](Ptr);
+  }
+
+  // Sized deallocation forwards to the unsized operators, which every
+  // runtime provides.
+  LLVM_ATTRIBUTE_NOINLINE static void hookDeleteSized(void* Ptr, size_t) {
+    hookDelete(Ptr);
+  }
+
+  LLVM_ATTRIBUTE_NOINLINE static void hookDeleteArraySized(void* Ptr, size_t) {
+    hookDeleteArray(Ptr);
+  }
+
+  ///\brief The hooks, indexed by cling::AllocationFunction.
+  ///
+  static void* const kHooks[cling::kNumAllocationFunctions] = {
+    (void*)&hookMalloc,
+    (void*)&hookCalloc,
+    (void*)&hookRealloc,
+    (void*)&hookFree,
+    (void*)&hookNew,
+    (void*)&hookNewArray,
+    (void*)&hookNewNothrow,
+    (void*)&hookNewArrayNothrow,
+    (void*)&hookDelete,
+    (void*)&hookDeleteArray,
+    (void*)&hookDeleteSized,
+    (void*)&hookDeleteArraySized
+  };
+
+  static std::string demangle(const std::string& Name) {
+#ifndef LLVM_ON_WIN32
+    int Status = 0;
+    char* Demangled = abi::__cxa_demangle(Name.c_str(), 0, 0, &Status);
+    if (Status == 0) {
+      std::string Result = Demangled;
+      free(Demangled);
+      return Result;
+    }
+#endif
+    return Name;
+  }
+
+  ///\brief A call site or transaction and its counts, for sorting.
+  ///
+  struct Entry {
+    std::string Name;
+    size_t Allocs;
+    size_t Bytes;
+    size_t LiveBlocks;
+    size_t LiveBytes;
+  };
+
+  static void printEntries(raw_ostream& Out, std::vector<Entry>& Entries,
+                           unsigned MaxEntries, const char* What) {
+    std::sort(Entries.begin(), Entries.end(),
+              [](const Entry& L, const Entry& R) {
+                return L.Bytes != R.Bytes ? L.Bytes > R.Bytes
+                                          : L.Allocs > R.Allocs;
+              });
+    Out << "   allocs        bytes     live   live bytes  " << What << '\n';
+    for (size_t I = 0, E = std::min<size_t>(Entries.size(), MaxEntries);
+         I < E; ++I) {
+      const Entry& En = Entries[I];
+      Out << format("  %7zu %12zu %8zu %12zu  ", En.Allocs, En.Bytes,
+                    En.LiveBlocks, En.LiveBytes)
+          << En.Name << '\n';
+    }
+  }
+} // unnamed namespace
+
+namespace cling {
+
+  MemProfiler::TransactionScope::TransactionScope(MemProfiler* Profiler,
+                                                  unsigned TransactionID):
+    m_Profiler(Profiler), m_Prev(0) {
+    if (!m_Profiler)
+      return;
+    std::lock_guard<std::mutex> Lock(m_Profiler->m_Mutex);
+    m_Prev = m_Profiler->m_CurrentTransaction;
+    m_Profiler->m_CurrentTransaction = TransactionID;
+  }
+
+  MemProfiler::TransactionScope::~TransactionScope() {
+    if (!m_Profiler)
+      return;
+    std::lock_guard<std::mutex> Lock(m_Profiler->m_Mutex);
+    m_Profiler->m_CurrentTransaction = m_Prev;
+  }
+
+  MemProfiler::MemProfiler(const IncrementalExecutor& Exe):
+    m_Exe(Exe), m_Running(false), m_CurrentTransaction(0) {
+    s_Profiler.store(this, std::memory_order_release);
+  }
+
+  MemProfiler::~MemProfiler() {
+    MemProfiler* Self = this;
+    s_Profiler.compare_exchange_strong(Self, nullptr);
+  }
+
+  bool MemProfiler::start() {
+#ifdef LLVM_ON_WIN32
+    return false;
+#else
+    std::lock_guard<std::mutex> Lock(m_Mutex);
+    if (m_Running)
+      return false;
+    m_Sites.clear();
+    m_SiteCounts.clear();
+    m_SiteOfAddress.clear();
+    m_TransactionCounts.clear();
+    m_LiveBlocks.clear();
+    m_Running = true;
+    return true;
+#endif
+  }
+
+  bool MemProfiler::stop() {
+    std::lock_guard<std::mutex> Lock(m_Mutex);
+    if (!m_Running)
+      return false;
+    m_Running = false;
+    return true;
+  }
+
+  unsigned MemProfiler::getSite(uintptr_t CallSite) {
+    auto Known = m_SiteOfAddress.find(CallSite);
+    if (Known != m_SiteOfAddress.end())
+      return Known->second;
+
+    Site S;
+    std::string File;
+    unsigned Line = 0;
+    // The return address is behind the call.
+    if (m_Exe.lookupJITCode(CallSite - 1, S.Function, File, Line)) {
+      S.Function = demangle(S.Function);
+      if (Line)
+        S.Location = File + ":" + utostr(Line);
+    } else {
+      S.Function = "0x" + utohexstr(CallSite);
+    }
+    // Sites are counted per function and line, not per address.
+    unsigned Index = m_Sites.size();
+    for (unsigned I = 0, E = m_Sites.size(); I < E; ++I)
+      if (m_Sites[I].Function == S.Function
+          && m_Sites[I].Location == S.Location) {
+        Index = I;
+        break;
+      }
+    if (Index == m_Sites.size()) {
+      m_Sites.push_back(std::move(S));
+      m_SiteCounts.emplace_back();
+    }
+    m_SiteOfAddress[CallSite] = Index;
+    return Index;
+  }
+
+  void MemProfiler::recordAlloc(void* Ptr, size_t Size, uintptr_t CallSite) {
+    std::lock_guard<std::mutex> Lock(m_Mutex);
+    if (!m_Running)
+      return;
+    const unsigned SiteIndex = getSite(CallSite);
+    Block& B = m_LiveBlocks[Ptr];
+    B = Block{Size, SiteIndex, m_CurrentTransaction};
+    for (Counts* C: {&m_SiteCounts[SiteIndex],
+                     &m_TransactionCounts[m_CurrentTransaction]}) {
+      ++C->Allocs;
+      C->Bytes += Size;
+      ++C->LiveBlocks;
+      C->LiveBytes += Size;
+    }
+  }
+
+  void MemProfiler::recordFree(void* Ptr) {
+    std::lock_guard<std::mutex> Lock(m_Mutex);
+    auto I = m_LiveBlocks.find(Ptr);
+    if (I == m_LiveBlocks.end())
+      return;
+    const Block& B = I->second;
+    for (Counts* C: {&m_SiteCounts[B.Site],
+                     &m_TransactionCounts[B.TransactionID]}) {
+      --C->LiveBlocks;
+      C->LiveBytes -= B.Size;
+    }
+    m_LiveBlocks.erase(I);
+  }
+
+  void MemProfiler::report(raw_ostream& Out, unsigned MaxEntries) const {
+    std::lock_guard<std::mutex> Lock(m_Mutex);
+    Counts Total;
+    std::vector<Entry> Sites;
+    for (size_t I = 0, E = m_Sites.size(); I < E; ++I) {
+      const Counts& C = m_SiteCounts[I];
+      Total.Allocs += C.Allocs;
+      Total.Bytes += C.Bytes;
+      Total.LiveBlocks += C.LiveBlocks;
+      Total.LiveBytes += C.LiveBytes;
+      std::string Name = m_Sites[I].Function;
+      if (!m_Sites[I].Location.empty())
+        Name += " at " + m_Sites[I].Location;
+      Sites.push_back(Entry{Name, C.Allocs, C.Bytes, C.LiveBlocks,
+                            C.LiveBytes});
+    }
+    Out << "Memory profile: " << Total.Allocs << " allocations of "
+        << Total.Bytes << " bytes, " << Total.LiveBlocks << " blocks of "
+        << Total.LiveBytes << " bytes still allocated\n";
+    if (Sites.empty())
+      return;
+    printEntries(Out, Sites, MaxEntries, "call site");
+
+    std::vector<Entry> Transactions;
+    for (auto&& I: m_TransactionCounts) {
+      const Counts& C = I.second;
+      Transactions.push_back(Entry{I.first ? "transaction " + utostr(I.first)
+                                           : std::string("(other)"),
+                                   C.Allocs, C.Bytes, C.LiveBlocks,
+                                   C.LiveBytes});
+    }
+    printEntries(Out, Transactions, MaxEntries, "transaction");
+  }
+
+  void MemProfiler::reportLeaks(unsigned TransactionID,
+                                raw_ostream& Out) const {
+    std::lock_guard<std::mutex> Lock(m_Mutex);
+    auto T = m_TransactionCounts.find(TransactionID);
+    if (T == m_TransactionCounts.end() || !T->second.LiveBlocks)
+      return;
+    Out << "cling: transaction " << TransactionID << " is unloaded with "
+        << T->second.LiveBlocks << " blocks of " << T->second.LiveBytes
+        << " bytes still allocated, from:\n";
+    std::vector<size_t> BytesPerSite(m_Sites.size());
+    for (auto&& I: m_LiveBlocks)
+      if (I.second.TransactionID == TransactionID)
+        BytesPerSite[I.second.Site] += I.second.Size;
+    std::vector<unsigned> Order;
+    for (unsigned I = 0, E = BytesPerSite.size(); I < E; ++I)
+      if (BytesPerSite[I])
+        Order.push_back(I);
+    std::sort(Order.begin(), Order.end(), [&](unsigned L, unsigned R) {
+      return BytesPerSite[L] > BytesPerSite[R];
+    });
+    for (unsigned I: Order) {
+      Out << format("  %12zu bytes  ", BytesPerSite[I]) << m_Sites[I].Function;
+      if (!m_Sites[I].Location.empty())
+        Out << " at " << m_Sites[I].Location;
+      Out << '\n';
+    }
+  }
+
+  uint64_t MemProfiler::getHook(StringRef Name) {
+    MemProfiler* Profiler = s_Profiler.load(std::memory_order_acquire);
+    if (!Profiler || !Profiler->isRunning())
+      return 0;
+    AllocationFunction F = getAllocationFunction(Name);
+    if (F == kNumAllocationFunctions)
+      return 0;
+    return (uint64_t)(uintptr_t)kHooks[F];
+  }
+
+} // namespace cling
@@ -0,0 +1,153 @@
+//--------------------------------------------------------------------*- C++ -*-
+// CLING - the C++ LLVM-based InterpreterG :)
+//
+// This file is dual-licensed: you can choose to license it under the University
+// of Illinois Open Source License or the GNU Lesser General Public License. See
+// LICENSE.TXT for details.
+//------------------------------------------------------------------------------
+
+#ifndef CLING_MEM_PROFILER_H
+#define CLING_MEM_PROFILER_H
+
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/StringRef.h"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace llvm {
+  class raw_ostream;
+}
+
+namespace cling {
+  class IncrementalExecutor;
+
+  ///\brief Counts the heap allocations of the JITted code.
+  ///
+  /// While a profiler is running, the IncrementalJIT resolves malloc,
+  /// calloc, realloc, free and the global operators new and delete of the
+  /// code it links to hooks that forward to the real functions and record
+  /// each block with its call site and the transaction whose code was
+  /// running. Code linked earlier is not observed; code linked while
+  /// profiling keeps calling the hooks, which only record while a profiler
+  /// runs, but keep tracking the release of blocks recorded earlier.
+  ///
+  /// Blocks released by compiled libraries remain live for the profiler.
+  /// Not available on Windows.
+  ///
+  class MemProfiler {
+  public:
+    ///\brief Attributes the allocations in the enclosing scope to a
+    /// transaction.
+    ///
+    class TransactionScope {
+    private:
+      MemProfiler* m_Profiler;
+      unsigned m_Prev;
+    public:
+      TransactionScope(MemProfiler* Profiler, unsigned TransactionID);
+      ~TransactionScope();
+    };
+
+  private:
+    ///\brief Where allocations come from.
+    ///
+    struct Site {
+      std::string Function;
+      std::string Location;
+    };
+
+    struct Counts {
+      size_t Allocs = 0;
+      size_t Bytes = 0;
+      size_t LiveBlocks = 0;
+      size_t LiveBytes = 0;
+    };
+
+    struct Block {
+      size_t Size;
+      unsigned Site;
+      unsigned TransactionID;
+    };
+
+    const IncrementalExecutor& m_Exe;
+
+    ///\brief Protects everything below but m_Running; the JITted code may
+    /// allocate from several threads.
+    ///
+    mutable std::mutex m_Mutex;
+
+    ///\brief Whether allocations are recorded; read by the hooks without
+    /// taking m_Mutex.
+    ///
+    std::atomic<bool> m_Running;
+
+    ///\brief The transaction whose code runs, or 0.
+    ///
+    unsigned m_CurrentTransaction;
+
+    ///\brief Call sites, resolved when first seen: the code might be
+    /// unloaded by the time of the report.
+    ///
+    std::vector<Site> m_Sites;
+    std::vector<Counts> m_SiteCounts;
+    llvm::DenseMap<uintptr_t, unsigned> m_SiteOfAddress;
+
+    llvm::DenseMap<unsigned, Counts> m_TransactionCounts;
+    llvm::DenseMap<void*, Block> m_LiveBlocks;
+
+    unsigned getSite(uintptr_t CallSite);
+
+  public:
+    MemProfiler(const IncrementalExecutor& Exe);
+    ~MemProfiler();
+
+    ///\brief Discards the previous records and starts recording.
+    ///
+    ///\returns false if the profiler was running already.
+    ///
+    bool start();
+
+    ///\brief Stops recording new allocations.
+    ///
+    ///\returns false if the profiler was not running.
+    ///
+    bool stop();
+
+    bool isRunning() const { return m_Running; }
+
+    ///\brief Records a block allocated by the JITted code at CallSite.
+    ///
+    void recordAlloc(void* Ptr, size_t Size, uintptr_t CallSite);
+
+    ///\brief Records the release of a block.
+    ///
+    void recordFree(void* Ptr);
+
+    ///\brief Prints the call sites and transactions allocating most, and
+    /// how much of their memory is still allocated.
+    ///
+    ///\param [in] Out - The stream to print to.
+    ///\param [in] MaxEntries - How many call sites and transactions to list.
+    ///
+    void report(llvm::raw_ostream& Out, unsigned MaxEntries = 20) const;
+
+    ///\brief Prints the blocks allocated while the transaction's code ran
+    /// that are still allocated, if any. Called when it is unloaded.
+    ///
+    void reportLeaks(unsigned TransactionID, llvm::raw_ostream& Out) const;
+
+    ///\brief Returns the address of the hook interposing the given C or
+    /// C++ runtime function, by its linkage name without the platform's
+    /// global prefix; 0 if the function is not interposed or no profiler is
+    /// running.
+    ///
+    static uint64_t getHook(llvm::StringRef Name);
+  };
+} // namespace cling
+
+#endif // CLING_MEM_PROFILER_H
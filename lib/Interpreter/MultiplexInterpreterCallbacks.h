@@ -113,6 +113,17 @@ namespace cling {
        }
      }
 
+    void InputStarted(llvm::StringRef Function,
+                      llvm::StringRef Input) override {
+      for (auto&& cb : m_Callbacks)
+        cb->InputStarted(Function, Input);
+    }
+
+    void InputFinished(int Result) override {
+      for (auto&& cb : m_Callbacks)
+        cb->InputFinished(Result);
+    }
+
     void SetIsRuntime(bool val) override {
       InterpreterCallbacks::SetIsRuntime(val);
       for (auto&& cb : m_Callbacks)
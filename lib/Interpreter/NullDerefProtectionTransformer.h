@@ -32,6 +32,9 @@ namespace cling {
     NullDerefProtectionTransformer(cling::Interpreter* I);
 
     virtual ~NullDerefProtectionTransformer();
+    const char* getName() const override {
+      return "NullDerefProtectionTransformer";
+    }
     Result Transform(clang::Decl* D) override;
   };
 
@@ -0,0 +1,218 @@
+//------------------------------------------------------------------------------
+// CLING - the C++ LLVM-based InterpreterG :)
+//
+// This file is dual-licensed: you can choose to license it under the University
+// of Illinois Open Source License or the GNU Lesser General Public License. See
+// LICENSE.TXT for details.
+//------------------------------------------------------------------------------
+
+#include "PerfStat.h"
+
+#include "llvm/Support/Compiler.h"
+#include "llvm/Support/Format.h"
+#include "llvm/Support/raw_ostream.h"
+
+#ifdef __linux__
+#include <cerrno>
+#include <cstring>
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#if defined(LLVM_ON_UNIX)
+#include <sys/resource.h>
+#endif
+
+using namespace llvm;
+
+namespace {
+  static const char* const kCounterNames[cling::PerfStat::kNumCounters] = {
+    "cycles",
+    "instructions",
+    "cache-references",
+    "cache-misses",
+    "branch-misses",
+    "page-faults"
+  };
+
+  static const char* const kPhaseNames[cling::PerfStat::kNumPhases] = {
+    "compilation",
+    "execution"
+  };
+
+  ///\brief Returns the peak resident set size of the process in kB, or -1.
+  ///
+  static long getMaxRSS() {
+#if defined(LLVM_ON_UNIX)
+    struct rusage Usage;
+    if (!getrusage(RUSAGE_SELF, &Usage))
+#ifdef __APPLE__
+      return Usage.ru_maxrss / 1024; // In bytes.
+#else
+      return Usage.ru_maxrss;
+#endif
+#endif
+    return -1;
+  }
+
+#ifdef __linux__
+  static int openCounter(cling::PerfStat::CounterKind Kind) {
+    static const struct { uint32_t Type; uint64_t Config; }
+    kEvents[cling::PerfStat::kNumCounters] = {
+      { PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES },
+      { PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS },
+      { PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_REFERENCES },
+      { PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES },
+      { PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES },
+      { PERF_TYPE_SOFTWARE, PERF_COUNT_SW_PAGE_FAULTS }
+    };
+    struct perf_event_attr Attr;
+    memset(&Attr, 0, sizeof(Attr));
+    Attr.size = sizeof(Attr);
+    Attr.type = kEvents[Kind].Type;
+    Attr.config = kEvents[Kind].Config;
+    Attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED
+                       | PERF_FORMAT_TOTAL_TIME_RUNNING;
+    Attr.disabled = 1;
+    // User-space events only: allowed at the default perf_event_paranoid.
+    Attr.exclude_kernel = 1;
+    Attr.exclude_hv = 1;
+    // Counters are not grouped: a machine without, say, cache events still
+    // counts the others.
+    return syscall(__NR_perf_event_open, &Attr, 0 /*this thread*/,
+                   -1 /*any CPU*/, -1 /*no group*/, 0 /*flags*/);
+  }
+#endif
+} // unnamed namespace
+
+namespace cling {
+
+  PerfStat::Scope::Scope(PerfStat* Stat, PhaseKind Phase):
+    m_Stat(Stat), m_Phase(Phase) {
+    if (!m_Stat)
+      return;
+    // Remove what nested scopes add to the other phases.
+    m_Start = TimeRecord::getCurrentTime(/*Start*/true);
+    for (unsigned I = 0; I < kNumPhases; ++I)
+      m_Start -= m_Stat->m_Times[I];
+    if (m_Phase == kExecution)
+      m_Stat->beginExecution();
+  }
+
+  PerfStat::Scope::~Scope() {
+    if (!m_Stat)
+      return;
+    if (m_Phase == kExecution)
+      m_Stat->endExecution();
+    TimeRecord Elapsed = TimeRecord::getCurrentTime(/*Start*/false);
+    for (unsigned I = 0; I < kNumPhases; ++I)
+      Elapsed -= m_Stat->m_Times[I];
+    Elapsed -= m_Start;
+    m_Stat->m_Times[m_Phase] += Elapsed;
+  }
+
+  PerfStat::PerfStat():
+    m_StartMaxRSS(-1), m_MaxRSSDelta(-1), m_ExecutionDepth(0) {
+    for (unsigned I = 0; I < kNumCounters; ++I) {
+      m_FDs[I] = -1;
+      m_Counts[I] = 0;
+    }
+#ifdef __linux__
+    int FirstError = 0;
+    for (unsigned I = 0; I < kNumCounters; ++I) {
+      m_FDs[I] = openCounter(CounterKind(I));
+      if (m_FDs[I] < 0 && !FirstError)
+        FirstError = errno;
+    }
+    for (unsigned I = 0; I < kNumCounters; ++I)
+      if (m_FDs[I] >= 0)
+        return;
+    m_Unavailable = strerror(FirstError);
+#else
+    m_Unavailable = "not supported on this platform";
+#endif
+  }
+
+  PerfStat::~PerfStat() {
+#ifdef __linux__
+    for (unsigned I = 0; I < kNumCounters; ++I)
+      if (m_FDs[I] >= 0)
+        close(m_FDs[I]);
+#endif
+  }
+
+  void PerfStat::beginExecution() {
+    if (m_ExecutionDepth++)
+      return;
+    m_StartMaxRSS = getMaxRSS();
+#ifdef __linux__
+    for (unsigned I = 0; I < kNumCounters; ++I)
+      if (m_FDs[I] >= 0)
+        ioctl(m_FDs[I], PERF_EVENT_IOC_ENABLE, 0);
+#endif
+  }
+
+  void PerfStat::endExecution() {
+    if (--m_ExecutionDepth)
+      return;
+#ifdef __linux__
+    for (unsigned I = 0; I < kNumCounters; ++I)
+      if (m_FDs[I] >= 0)
+        ioctl(m_FDs[I], PERF_EVENT_IOC_DISABLE, 0);
+    // The counters keep their values while disabled; the last read covers
+    // all executions so far.
+    for (unsigned I = 0; I < kNumCounters; ++I) {
+      if (m_FDs[I] < 0)
+        continue;
+      uint64_t Values[3]; // Value, time enabled, time running.
+      if (read(m_FDs[I], Values, sizeof(Values)) != sizeof(Values))
+        continue;
+      // Scale counts the kernel multiplexed with other events.
+      if (Values[2] && Values[2] < Values[1])
+        Values[0] = (uint64_t)((double)Values[0] * Values[1] / Values[2]);
+      m_Counts[I] = Values[0];
+    }
+#endif
+    const long MaxRSS = getMaxRSS();
+    if (MaxRSS >= 0 && m_StartMaxRSS >= 0)
+      m_MaxRSSDelta = (m_MaxRSSDelta < 0 ? 0 : m_MaxRSSDelta)
+        + MaxRSS - m_StartMaxRSS;
+  }
+
+  void PerfStat::print(raw_ostream& Out, StringRef Statement) const {
+    Out << "Performance of '" << Statement << "':\n";
+    for (unsigned I = 0; I < kNumPhases; ++I) {
+      const TimeRecord& T = m_Times[I];
+      Out << format("  %-12s %10.3f ms wall %10.3f ms CPU\n", kPhaseNames[I],
+                    T.getWallTime() * 1e3,
+                    (T.getUserTime() + T.getSystemTime()) * 1e3);
+    }
+
+    if (!hasCounters()) {
+      Out << "  hardware counters unavailable: " << m_Unavailable << '\n';
+    } else {
+      for (unsigned I = 0; I < kNumCounters; ++I) {
+        if (m_FDs[I] < 0) {
+          Out << format("  %20s  %s\n", "<not supported>", kCounterNames[I]);
+          continue;
+        }
+        Out << format("  %20llu  %-16s", (unsigned long long)m_Counts[I],
+                      kCounterNames[I]);
+        if (I == kInstructions && m_FDs[kCycles] >= 0 && m_Counts[kCycles])
+          Out << format("  # %.2f per cycle",
+                        (double)m_Counts[I] / m_Counts[kCycles]);
+        else if (I == kCacheMisses && m_FDs[kCacheReferences] >= 0
+                 && m_Counts[kCacheReferences])
+          Out << format("  # %.2f%% of references",
+                        100. * m_Counts[I] / m_Counts[kCacheReferences]);
+        Out << '\n';
+      }
+    }
+
+    if (m_MaxRSSDelta >= 0)
+      Out << "  peak RSS grew by " << m_MaxRSSDelta << " kB\n";
+  }
+
+} // namespace cling
@@ -0,0 +1,110 @@
+//--------------------------------------------------------------------*- C++ -*-
+// CLING - the C++ LLVM-based InterpreterG :)
+//
+// This file is dual-licensed: you can choose to license it under the University
+// of Illinois Open Source License or the GNU Lesser General Public License. See
+// LICENSE.TXT for details.
+//------------------------------------------------------------------------------
+
+#ifndef CLING_PERF_STAT_H
+#define CLING_PERF_STAT_H
+
+#include "llvm/ADT/StringRef.h"
+#include "llvm/Support/Timer.h"
+
+#include <cstdint>
+#include <string>
+
+namespace llvm {
+  class raw_ostream;
+}
+
+namespace cling {
+
+  ///\brief Measures the compilation and the execution of a statement.
+  ///
+  /// Both are timed (wall and CPU time). The execution is also measured with
+  /// the hardware performance counters of perf_event_open, counting the
+  /// user-space events of the calling thread only, and by the growth of the
+  /// process' peak resident set. Counters the kernel refuses are reported as
+  /// such; without any, only the timers are reported.
+  ///
+  class PerfStat {
+  public:
+    enum PhaseKind {
+      kCompilation,
+      kExecution,
+      kNumPhases
+    };
+
+    ///\brief Adds the time spent in the enclosing scope to a phase of a
+    /// PerfStat, and counts the events of the execution phase. A null
+    /// PerfStat measures nothing.
+    ///
+    class Scope {
+    private:
+      PerfStat* m_Stat;
+      PhaseKind m_Phase;
+      llvm::TimeRecord m_Start;
+    public:
+      Scope(PerfStat* Stat, PhaseKind Phase);
+      ~Scope();
+    };
+
+    enum CounterKind {
+      kCycles,
+      kInstructions,
+      kCacheReferences,
+      kCacheMisses,
+      kBranchMisses,
+      kPageFaults,
+      kNumCounters
+    };
+
+  private:
+    ///\brief File descriptors of the counters; -1 for those not available.
+    ///
+    int m_FDs[kNumCounters];
+
+    uint64_t m_Counts[kNumCounters];
+
+    ///\brief Time spent in each phase.
+    ///
+    llvm::TimeRecord m_Times[kNumPhases];
+
+    ///\brief Why no counter could be opened; empty if one could.
+    ///
+    std::string m_Unavailable;
+
+    ///\brief Peak resident set size before the execution, in kB.
+    ///
+    long m_StartMaxRSS;
+
+    ///\brief Growth of the peak resident set size, in kB; -1 if unknown.
+    ///
+    long m_MaxRSSDelta;
+
+    ///\brief Number of open execution scopes; counters run while positive.
+    ///
+    unsigned m_ExecutionDepth;
+
+    void beginExecution();
+    void endExecution();
+
+  public:
+    ///\brief Opens the counters, which start out disabled.
+    ///
+    PerfStat();
+    ~PerfStat();
+
+    ///\brief Whether at least one hardware or software counter is available.
+    ///
+    bool hasCounters() const { return m_Unavailable.empty(); }
+
+    ///\brief Prints the measurement of Statement.
+    ///
+    void print(llvm::raw_ostream& Out, llvm::StringRef Statement) const;
+  };
+} // namespace cling
+
+#endif // CLING_PERF_STAT_H
@@ -0,0 +1,333 @@
+//------------------------------------------------------------------------------
+// CLING - the C++ LLVM-based InterpreterG :)
+//
+// This file is dual-licensed: you can choose to license it under the University
+// of Illinois Open Source License or the GNU Lesser General Public License. See
+// LICENSE.TXT for details.
+//------------------------------------------------------------------------------
+
+#include "SamplingProfiler.h"
+
+#include "IncrementalExecutor.h"
+
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/ADT/StringExtras.h"
+#include "llvm/ADT/StringMap.h"
+#include "llvm/Support/Format.h"
+#include "llvm/Support/Path.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#ifdef __linux__
+#include <cerrno>
+#include <csignal>
+#include <cstdlib>
+#include <cstring>
+#include <cxxabi.h>
+#include <dlfcn.h>
+#include <pthread.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <ucontext.h>
+#include <unistd.h>
+
+// Older C libraries do not name the thread a timer signals.
+#ifndef sigev_notify_thread_id
+#define sigev_notify_thread_id _sigev_un._tid
+#endif
+#endif
+
+using namespace llvm;
+
+#ifdef __linux__
+
+namespace {
+  ///\brief Words of the sample buffer: about 16 MB.
+  static const size_t kBufferWords = 1 << 21;
+  static const unsigned kMaxDepth = 64;
+  static const unsigned kIntervalUs = 1000;
+
+  ///\brief A function or source line and how often it was hit.
+  struct Entry {
+    std::string Name;
+    size_t Self;
+    size_t Total;
+  };
+
+  static void printEntries(raw_ostream& Out, std::vector<Entry>& Entries,
+                           size_t NumSamples, unsigned MaxEntries,
+                           bool WithTotal) {
+    std::sort(Entries.begin(), Entries.end(),
+              [](const Entry& L, const Entry& R) {
+                return L.Self != R.Self ? L.Self > R.Self : L.Total > R.Total;
+              });
+    for (size_t I = 0, E = std::min<size_t>(Entries.size(), MaxEntries);
+         I < E; ++I) {
+      Out << format("  %5.1f%%", 100. * Entries[I].Self / NumSamples);
+      if (WithTotal)
+        Out << format("  %5.1f%%", 100. * Entries[I].Total / NumSamples);
+      Out << "  " << Entries[I].Name << '\n';
+    }
+  }
+
+  static cling::SamplingProfiler* s_Active = 0;
+  static pthread_t s_Thread;
+  static timer_t s_Timer;
+  static struct sigaction s_OldAction;
+
+  static void handleProfSignal(int, siginfo_t*, void* UContext) {
+    if (!s_Active || !pthread_equal(pthread_self(), s_Thread))
+      return;
+    const int SavedErrno = errno;
+    s_Active->record(UContext);
+    errno = SavedErrno;
+  }
+
+  static std::string demangle(const char* Name) {
+    int Status = 0;
+    char* Demangled = abi::__cxa_demangle(Name, 0, 0, &Status);
+    std::string Result = Status == 0 ? Demangled : Name;
+    free(Demangled);
+    return Result;
+  }
+} // unnamed namespace
+
+namespace cling {
+
+SamplingProfiler::SamplingProfiler():
+  m_Used(0), m_NumSamples(0), m_NumDropped(0), m_StackEnd(0) {}
+
+SamplingProfiler::~SamplingProfiler() {
+  stop();
+}
+
+bool SamplingProfiler::isRunning() const {
+  return s_Active == this;
+}
+
+bool SamplingProfiler::start() {
+  if (s_Active)
+    return false;
+
+  pthread_attr_t Attr;
+  if (pthread_getattr_np(pthread_self(), &Attr))
+    return false;
+  void* StackAddr = 0;
+  size_t StackSize = 0;
+  pthread_attr_getstack(&Attr, &StackAddr, &StackSize);
+  pthread_attr_destroy(&Attr);
+  m_StackEnd = (uintptr_t)StackAddr + StackSize;
+
+  if (!m_Buffer)
+    m_Buffer.reset(new uintptr_t[kBufferWords]);
+  m_Used = 0;
+  m_NumSamples = 0;
+  m_NumDropped = 0;
+
+  s_Thread = pthread_self();
+  s_Active = this;
+  struct sigaction Action;
+  memset(&Action, 0, sizeof(Action));
+  Action.sa_sigaction = handleProfSignal;
+  // Do not let the samples interrupt the sampled code's system calls.
+  Action.sa_flags = SA_SIGINFO | SA_RESTART;
+  sigemptyset(&Action.sa_mask);
+  if (sigaction(SIGPROF, &Action, &s_OldAction)) {
+    s_Active = 0;
+    return false;
+  }
+
+  // A timer on the thread's CPU time, signalling only that thread: the
+  // process-wide ITIMER_PROF would interrupt whichever thread is running,
+  // and the samples of the other threads would be lost.
+  struct sigevent Event;
+  memset(&Event, 0, sizeof(Event));
+  Event.sigev_notify = SIGEV_THREAD_ID;
+  Event.sigev_signo = SIGPROF;
+  Event.sigev_notify_thread_id = syscall(SYS_gettid);
+  if (timer_create(CLOCK_THREAD_CPUTIME_ID, &Event, &s_Timer)) {
+    sigaction(SIGPROF, &s_OldAction, 0);
+    s_Active = 0;
+    return false;
+  }
+  struct itimerspec Interval;
+  Interval.it_interval.tv_sec = 0;
+  Interval.it_interval.tv_nsec = kIntervalUs * 1000;
+  Interval.it_value = Interval.it_interval;
+  if (timer_settime(s_Timer, 0, &Interval, 0)) {
+    timer_delete(s_Timer);
+    sigaction(SIGPROF, &s_OldAction, 0);
+    s_Active = 0;
+    return false;
+  }
+  return true;
+}
+
+bool SamplingProfiler::stop() {
+  if (!isRunning())
+    return false;
+  timer_delete(s_Timer);
+  sigaction(SIGPROF, &s_OldAction, 0);
+  s_Active = 0;
+  return true;
+}
+
+void SamplingProfiler::record(const void* UContext) {
+  const ucontext_t* Ctx = static_cast<const ucontext_t*>(UContext);
+#if defined(__x86_64__)
+  uintptr_t PC = Ctx->uc_mcontext.gregs[REG_RIP];
+  uintptr_t FP = Ctx->uc_mcontext.gregs[REG_RBP];
+  const uintptr_t SP = Ctx->uc_mcontext.gregs[REG_RSP];
+#elif defined(__i386__)
+  uintptr_t PC = Ctx->uc_mcontext.gregs[REG_EIP];
+  uintptr_t FP = Ctx->uc_mcontext.gregs[REG_EBP];
+  const uintptr_t SP = Ctx->uc_mcontext.gregs[REG_ESP];
+#elif defined(__aarch64__)
+  uintptr_t PC = Ctx->uc_mcontext.pc;
+  uintptr_t FP = Ctx->uc_mcontext.regs[29];
+  const uintptr_t SP = Ctx->uc_mcontext.sp;
+#else
+  (void)Ctx;
+  ++m_NumDropped;
+  return;
+#endif
+
+  const size_t Used = m_Used;
+  if (Used + 1 + kMaxDepth > kBufferWords) {
+    ++m_NumDropped;
+    return;
+  }
+  uintptr_t* Frames = &m_Buffer[Used + 1];
+  unsigned Depth = 0;
+  Frames[Depth++] = PC;
+  // Follow the frame pointers as long as they stay on the live part of the
+  // stack and move outwards; code without them ends the walk early.
+  while (Depth < kMaxDepth && FP >= SP && FP % sizeof(uintptr_t) == 0
+         && FP + 2 * sizeof(uintptr_t) <= m_StackEnd) {
+    const uintptr_t* Frame = reinterpret_cast<const uintptr_t*>(FP);
+    if (!Frame[1])
+      break;
+    Frames[Depth++] = Frame[1];
+    if (Frame[0] <= FP)
+      break;
+    FP = Frame[0];
+  }
+  m_Buffer[Used] = Depth;
+  m_Used = Used + 1 + Depth;
+  ++m_NumSamples;
+}
+
+void SamplingProfiler::report(raw_ostream& Out, const IncrementalExecutor& Exe,
+                              unsigned MaxEntries /*= 20*/) const {
+  const size_t Used = m_Used;
+  const size_t NumSamples = m_NumSamples;
+  Out << "Profile: " << NumSamples << " samples of " << kIntervalUs
+      << " us CPU time";
+  if (m_NumDropped)
+    Out << ", " << m_NumDropped << " dropped";
+  Out << '\n';
+  if (!NumSamples)
+    return;
+
+  // Where an address is: an index into Functions, and one into Lines or -1.
+  struct Location {
+    unsigned Function;
+    int Line;
+  };
+  DenseMap<uintptr_t, Location> Locations;
+  std::vector<Entry> Functions;
+  std::vector<Entry> Lines;
+  StringMap<unsigned> FunctionIndex;
+  StringMap<unsigned> LineIndex;
+
+  auto resolve = [&](uintptr_t Addr) -> Location {
+    auto Known = Locations.find(Addr);
+    if (Known != Locations.end())
+      return Known->second;
+
+    std::string Name, File;
+    unsigned Line = 0;
+    if (Exe.lookupJITCode(Addr, Name, File, Line)) {
+      Name = demangle(Name.c_str()) + " [JIT]";
+    } else {
+      Dl_info Info;
+      if (dladdr(reinterpret_cast<void*>(Addr), &Info) && Info.dli_fname) {
+        if (Info.dli_sname)
+          Name = demangle(Info.dli_sname);
+        else
+          Name = "0x" + utohexstr(Addr - (uintptr_t)Info.dli_fbase);
+        Name += " [" + sys::path::filename(Info.dli_fname).str() + "]";
+      } else {
+        Name = "0x" + utohexstr(Addr);
+      }
+    }
+
+    auto F = FunctionIndex.insert(std::make_pair(Name, Functions.size()));
+    if (F.second)
+      Functions.push_back(Entry{Name, 0, 0});
+    Location Loc{F.first->second, -1};
+    if (Line) {
+      std::string Where = File + ":" + utostr(Line);
+      auto L = LineIndex.insert(std::make_pair(Where, Lines.size()));
+      if (L.second)
+        Lines.push_back(Entry{Where, 0, 0});
+      Loc.Line = L.first->second;
+    }
+    Locations[Addr] = Loc;
+    return Loc;
+  };
+
+  SmallVector<unsigned, kMaxDepth> Seen;
+  for (size_t Pos = 0; Pos < Used; Pos += 1 + m_Buffer[Pos]) {
+    const size_t Depth = m_Buffer[Pos];
+    Seen.clear();
+    for (size_t I = 0; I < Depth; ++I) {
+      // Return addresses point behind the call.
+      Location Loc = resolve(m_Buffer[Pos + 1 + I] - (I ? 1 : 0));
+      if (!I) {
+        ++Functions[Loc.Function].Self;
+        if (Loc.Line >= 0)
+          ++Lines[Loc.Line].Self;
+      }
+      // Recursion counts once.
+      if (std::find(Seen.begin(), Seen.end(), Loc.Function) == Seen.end()) {
+        Seen.push_back(Loc.Function);
+        ++Functions[Loc.Function].Total;
+      }
+    }
+  }
+
+  Out << "   self   total  function\n";
+  printEntries(Out, Functions, NumSamples, MaxEntries, /*WithTotal*/true);
+  if (!Lines.empty()) {
+    Out << "   self  line\n";
+    printEntries(Out, Lines, NumSamples, MaxEntries, /*WithTotal*/false);
+  }
+}
+
+} // namespace cling
+
+#else // __linux__
+
+namespace cling {
+
+SamplingProfiler::SamplingProfiler():
+  m_Used(0), m_NumSamples(0), m_NumDropped(0), m_StackEnd(0) {}
+SamplingProfiler::~SamplingProfiler() {}
+bool SamplingProfiler::isRunning() const { return false; }
+bool SamplingProfiler::start() { return false; }
+bool SamplingProfiler::stop() { return false; }
+void SamplingProfiler::record(const void*) {}
+
+void SamplingProfiler::report(raw_ostream& Out, const IncrementalExecutor&,
+                              unsigned) const {
+  Out << "Profile: sampling is not supported on this platform\n";
+}
+
+} // namespace cling
+
+#endif // __linux__
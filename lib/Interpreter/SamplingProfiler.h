@@ -0,0 +1,93 @@
+//--------------------------------------------------------------------*- C++ -*-
+// CLING - the C++ LLVM-based InterpreterG :)
+//
+// This file is dual-licensed: you can choose to license it under the University
+// of Illinois Open Source License or the GNU Lesser General Public License. See
+// LICENSE.TXT for details.
+//------------------------------------------------------------------------------
+
+#ifndef CLING_SAMPLING_PROFILER_H
+#define CLING_SAMPLING_PROFILER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+namespace llvm {
+  class raw_ostream;
+}
+
+namespace cling {
+  class IncrementalExecutor;
+
+  ///\brief Finds where the interpreter's thread spends its CPU time.
+  ///
+  /// A timer on the CPU time of the thread that started the profiler sends
+  /// it SIGPROF every millisecond; the handler records the thread's stack
+  /// by following the frame pointers. Other threads are neither sampled nor
+  /// interrupted. The addresses are resolved only for the report: JITted
+  /// code through the IncrementalJIT, which also knows the source lines of
+  /// code compiled with debug info while profiling, anything else through
+  /// the dynamic linker.
+  ///
+  /// Only one profiler samples at a time. Only implemented on Linux.
+  ///
+  class SamplingProfiler {
+  private:
+    ///\brief The recorded stacks, each as its depth followed by its frames,
+    /// innermost first.
+    ///
+    std::unique_ptr<uintptr_t[]> m_Buffer;
+
+    ///\brief Number of m_Buffer's words in use.
+    ///
+    volatile size_t m_Used;
+
+    volatile size_t m_NumSamples;
+
+    ///\brief Samples that did not fit into m_Buffer.
+    ///
+    volatile size_t m_NumDropped;
+
+    ///\brief Upper end of the sampled thread's stack.
+    ///
+    uintptr_t m_StackEnd;
+
+  public:
+    SamplingProfiler();
+    ~SamplingProfiler();
+
+    ///\brief Discards the previous samples and starts sampling the calling
+    /// thread.
+    ///
+    ///\returns false if a profiler is running already or sampling is not
+    /// supported.
+    ///
+    bool start();
+
+    ///\brief Stops sampling, keeping the samples for report().
+    ///
+    ///\returns false if this profiler was not running.
+    ///
+    bool stop();
+
+    bool isRunning() const;
+
+    ///\brief Records the interrupted stack described by UContext. Called
+    /// from the signal handler; async-signal-safe.
+    ///
+    void record(const void* UContext);
+
+    ///\brief Prints the functions and, for code with debug info, the source
+    /// lines the samples hit most.
+    ///
+    ///\param [in] Out - The stream to print to.
+    ///\param [in] Exe - Resolves addresses in JITted code.
+    ///\param [in] MaxEntries - How many functions and lines to list.
+    ///
+    void report(llvm::raw_ostream& Out, const IncrementalExecutor& Exe,
+                unsigned MaxEntries = 20) const;
+  };
+} // namespace cling
+
+#endif // CLING_SAMPLING_PROFILER_H
@@ -0,0 +1,450 @@
+//------------------------------------------------------------------------------
+// CLING - the C++ LLVM-based InterpreterG :)
+//
+// This file is dual-licensed: you can choose to license it under the University
+// of Illinois Open Source License or the GNU Lesser General Public License. See
+// LICENSE.TXT for details.
+//------------------------------------------------------------------------------
+
+#include "SessionExporter.h"
+
+#include "IncrementalExecutor.h"
+#include "cling-compiledata.h"
+
+#include "cling/Interpreter/Interpreter.h"
+#include "cling/Interpreter/Transaction.h"
+#include "cling/Utils/AST.h"
+
+#include "clang/AST/ASTContext.h"
+#include "clang/AST/Decl.h"
+#include "clang/AST/DeclCXX.h"
+#include "clang/AST/DeclTemplate.h"
+#include "clang/Basic/SourceManager.h"
+#include "clang/CodeGen/ModuleBuilder.h"
+#include "clang/Frontend/CodeGenOptions.h"
+#include "clang/Frontend/CompilerInstance.h"
+#include "clang/Lex/HeaderSearch.h"
+#include "clang/Lex/Preprocessor.h"
+
+#include "llvm/ADT/SmallString.h"
+#include "llvm/ADT/Triple.h"
+#include "llvm/Analysis/TargetLibraryInfo.h"
+#include "llvm/Analysis/TargetTransformInfo.h"
+#include "llvm/IR/LLVMContext.h"
+#include "llvm/IR/LegacyPassManager.h"
+#include "llvm/IR/Module.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/Path.h"
+#include "llvm/Support/Program.h"
+#include "llvm/Support/raw_ostream.h"
+#include "llvm/Target/TargetMachine.h"
+#include "llvm/Transforms/IPO.h"
+#include "llvm/Transforms/IPO/PassManagerBuilder.h"
+
+#include <cctype>
+#include <cstring>
+#include <vector>
+
+using namespace clang;
+
+namespace {
+  ///\brief Whether a file holds definitions rather than declarations, like
+  /// the macros loaded with .L or .x; the header repeats their declarations
+  /// instead of including them.
+  ///
+  static bool isSourceFile(llvm::StringRef Path) {
+    llvm::StringRef Ext = llvm::sys::path::extension(Path);
+    return Ext == ".C" || Ext == ".c" || Ext == ".cc" || Ext == ".cpp"
+      || Ext == ".cxx" || Ext == ".c++";
+  }
+
+  static bool isClingInternal(const Decl* D) {
+    if (const NamedDecl* ND = dyn_cast<NamedDecl>(D))
+      if (const IdentifierInfo* II = ND->getIdentifier())
+        return II->getName().startswith("__cling");
+    return false;
+  }
+
+  static bool isOutOfLine(const Decl* D) {
+    return D->getLexicalDeclContext() != D->getDeclContext();
+  }
+
+  ///\brief Starts the header of an exported library, followed by the
+  /// library's file name.
+  ///
+  static const char kHeaderMarker[] = "// cling session export: ";
+} // unnamed namespace
+
+namespace cling {
+
+SessionExporter::SessionExporter(Interpreter& Interp, const Transaction* First):
+  m_Interp(Interp), m_First(First) {}
+
+std::string SessionExporter::getHeaderPath(llvm::StringRef LibPath) {
+  llvm::SmallString<256> Path(LibPath);
+  llvm::sys::path::replace_extension(Path, "h");
+  return Path.str();
+}
+
+std::string SessionExporter::getAutoloadPath(llvm::StringRef LibPath) {
+  llvm::SmallString<256> Path(LibPath);
+  llvm::sys::path::replace_extension(Path, "autoload.h");
+  return Path.str();
+}
+
+bool SessionExporter::isExported(llvm::StringRef LibPath) {
+  llvm::ErrorOr<std::unique_ptr<llvm::MemoryBuffer>> Header
+    = llvm::MemoryBuffer::getFile(getHeaderPath(LibPath));
+  if (!Header)
+    return false;
+  llvm::StringRef FirstLine = (*Header)->getBuffer().split('\n').first;
+  return FirstLine.startswith(kHeaderMarker)
+    && FirstLine.substr(strlen(kHeaderMarker))
+         == llvm::sys::path::filename(LibPath)
+    && llvm::sys::fs::exists(getAutoloadPath(LibPath));
+}
+
+std::string SessionExporter::getInclude(SourceLocation Loc) const {
+  Preprocessor& PP = m_Interp.getCI()->getPreprocessor();
+  const SourceManager& SM = PP.getSourceManager();
+  std::string Include;
+  // Walk up to the outermost header below an input line or a source file.
+  FileID FID = SM.getFileID(SM.getExpansionLoc(Loc));
+  while (FID.isValid()) {
+    const FileEntry* FE = SM.getFileEntryForID(FID);
+    if (!FE || isSourceFile(FE->getName()))
+      break;
+    bool IsSystem = false;
+    std::string Path
+      = PP.getHeaderSearchInfo().suggestPathToFileForDiagnostics(FE,
+                                                                 &IsSystem);
+    Include = IsSystem ? "<" + Path + ">" : "\"" + Path + "\"";
+    FID = SM.getFileID(SM.getIncludeLoc(FID));
+  }
+  return Include;
+}
+
+void SessionExporter::collectForHeader(const Decl* D) {
+  if (D->isImplicit() || D->isInvalidDecl() || isClingInternal(D))
+    return;
+  std::string Include = getInclude(D->getLocation());
+  if (Include.empty())
+    m_Decls.push_back(D);
+  else
+    m_Includes.insert(Include);
+}
+
+void SessionExporter::collect(const Transaction& T, CodeGenerator& CG) {
+  for (auto I = T.nested_begin(), E = T.nested_end(); I != E; ++I)
+    if ((*I)->getState() == Transaction::kCommitted)
+      collect(**I, CG);
+
+  for (auto I = T.decls_begin(), E = T.decls_end(); I != E; ++I) {
+    for (Decl* D: I->m_DGR) {
+      switch (I->m_Call) {
+      case Transaction::kCCIHandleTopLevelDecl:
+      case Transaction::kCCIHandleInterestingDecl:
+        if (const FunctionDecl* FD = dyn_cast<FunctionDecl>(D))
+          if (utils::Analyze::IsWrapper(FD))
+            continue;
+        CG.HandleTopLevelDecl(DeclGroupRef(D));
+        if (!T.getParent() && D->getDeclContext()->isTranslationUnit())
+          collectForHeader(D);
+        break;
+      case Transaction::kCCIHandleTagDeclDefinition:
+        CG.HandleTagDeclDefinition(cast<TagDecl>(D));
+        break;
+      case Transaction::kCCIHandleVTable:
+        CG.HandleVTable(cast<CXXRecordDecl>(D));
+        break;
+      case Transaction::kCCIHandleCXXImplicitFunctionInstantiation:
+        CG.HandleCXXImplicitFunctionInstantiation(cast<FunctionDecl>(D));
+        break;
+      case Transaction::kCCIHandleCXXStaticMemberVarInstantiation:
+        CG.HandleCXXStaticMemberVarInstantiation(cast<VarDecl>(D));
+        break;
+      case Transaction::kCCICompleteTentativeDefinition:
+        CG.CompleteTentativeDefinition(cast<VarDecl>(D));
+        break;
+      default:
+        break;
+      }
+    }
+  }
+}
+
+std::unique_ptr<llvm::Module>
+SessionExporter::emitModule(llvm::LLVMContext& Ctx,
+                            const CodeGenOptions& CGOpts) {
+  CompilerInstance* CI = m_Interp.getCI();
+  std::unique_ptr<CodeGenerator> CG(CreateLLVMCodeGen(CI->getDiagnostics(),
+                                                      "cling-export",
+                                                      CI->getHeaderSearchOpts(),
+                                                      CI->getPreprocessorOpts(),
+                                                      CGOpts, Ctx));
+  const unsigned NumErrors = CI->getDiagnosticClient().getNumErrors();
+  {
+    // Emission might deserialize or instantiate further declarations.
+    Interpreter::PushTransactionRAII RAII(&m_Interp);
+    CG->Initialize(CI->getASTContext());
+    for (const Transaction* T = m_First; T; T = T->getNext())
+      if (T->getState() == Transaction::kCommitted)
+        collect(*T, *CG);
+    CG->HandleTranslationUnit(CI->getASTContext());
+  }
+  if (CI->getDiagnosticClient().getNumErrors() != NumErrors) {
+    llvm::errs() << "cling::SessionExporter: cannot generate the code of the "
+                    "session.\n";
+    return nullptr;
+  }
+  return std::unique_ptr<llvm::Module>(CG->ReleaseModule());
+}
+
+bool SessionExporter::writeObject(llvm::Module& M, llvm::TargetMachine& TM,
+                                  llvm::StringRef ObjPath) {
+  using namespace llvm;
+  M.setDataLayout(TM.createDataLayout());
+  M.setTargetTriple(TM.getTargetTriple().str());
+
+  // From clang's EmitAssemblyHelper, at -O2; BackendPasses keeps the JIT's
+  // modules unoptimized.
+  PassManagerBuilder PMBuilder;
+  PMBuilder.OptLevel = 2;
+  PMBuilder.Inliner = createFunctionInliningPass(PMBuilder.OptLevel, 0);
+  PMBuilder.LoopVectorize = true;
+  PMBuilder.SLPVectorize = true;
+  PMBuilder.LibraryInfo = new TargetLibraryInfoImpl(TM.getTargetTriple());
+
+  legacy::FunctionPassManager FPM(&M);
+  FPM.add(createTargetTransformInfoWrapperPass(TM.getTargetIRAnalysis()));
+  PMBuilder.populateFunctionPassManager(FPM);
+  FPM.doInitialization();
+  for (auto&& F: M.functions())
+    if (!F.isDeclaration())
+      FPM.run(F);
+  FPM.doFinalization();
+
+  legacy::PassManager MPM;
+  MPM.add(createTargetTransformInfoWrapperPass(TM.getTargetIRAnalysis()));
+  PMBuilder.populateModulePassManager(MPM);
+  MPM.run(M);
+
+  std::error_code EC;
+  raw_fd_ostream Out(ObjPath, EC, sys::fs::F_None);
+  if (EC) {
+    errs() << "cling::SessionExporter: cannot write '" << ObjPath << "': "
+           << EC.message() << '\n';
+    return false;
+  }
+  legacy::PassManager CodeGenPasses;
+  CodeGenPasses.add(
+                 createTargetTransformInfoWrapperPass(TM.getTargetIRAnalysis()));
+  if (TM.addPassesToEmitFile(CodeGenPasses, Out,
+                             TargetMachine::CGFT_ObjectFile)) {
+    errs() << "cling::SessionExporter: the target cannot emit object files.\n";
+    return false;
+  }
+  CodeGenPasses.run(M);
+  return true;
+}
+
+bool SessionExporter::link(llvm::StringRef ObjPath, llvm::StringRef LibPath) {
+#if defined(CLING_CXX_PATH)
+  llvm::StringRef Compiler = CLING_CXX_PATH;
+#elif defined(CLING_CXX_RLTV)
+  llvm::StringRef Compiler = CLING_CXX_RLTV;
+#else
+  llvm::StringRef Compiler = "c++";
+#endif
+  // The compiler might come with arguments of its own.
+  llvm::SmallVector<llvm::StringRef, 4> Words;
+  Compiler.split(Words, ' ', -1, /*KeepEmpty*/false);
+  if (Words.empty())
+    return false;
+  std::string Program = Words[0];
+  if (!llvm::sys::path::is_absolute(Program)) {
+    llvm::ErrorOr<std::string> Found = llvm::sys::findProgramByName(Program);
+    if (!Found) {
+      llvm::errs() << "cling::SessionExporter: cannot find the compiler '"
+                   << Program << "'.\n";
+      return false;
+    }
+    Program = *Found;
+  }
+
+  std::vector<std::string> Args(Words.begin(), Words.end());
+  Args.push_back("-shared");
+  Args.push_back("-o");
+  Args.push_back(LibPath);
+  Args.push_back(ObjPath);
+  std::vector<const char*> Argv;
+  for (const std::string& Arg: Args)
+    Argv.push_back(Arg.c_str());
+  Argv.push_back(nullptr);
+
+  std::string ErrMsg;
+  const int ExitCode = llvm::sys::ExecuteAndWait(Program, Argv.data(),
+                                                 /*env*/nullptr,
+                                                 /*redirects*/nullptr,
+                                                 /*secondsToWait*/0,
+                                                 /*memoryLimit*/0, &ErrMsg);
+  if (ExitCode) {
+    llvm::errs() << "cling::SessionExporter: linking failed";
+    if (ExitCode < 0)
+      llvm::errs() << ": " << ErrMsg;
+    else
+      llvm::errs() << " with exit code " << ExitCode;
+    llvm::errs() << ":\n ";
+    for (const std::string& Arg: Args)
+      llvm::errs() << ' ' << Arg;
+    llvm::errs() << '\n';
+    return false;
+  }
+  return true;
+}
+
+void SessionExporter::printDecl(const Decl* D, llvm::raw_ostream& Out,
+                                const PrintingPolicy& Policy,
+                                unsigned Indent) const {
+  if (D->isImplicit() || isClingInternal(D))
+    return;
+
+  if (const NamespaceDecl* ND = dyn_cast<NamespaceDecl>(D)) {
+    // Its content has internal linkage; the library does not provide it.
+    if (ND->isAnonymousNamespace())
+      return;
+    Out.indent(Indent) << (ND->isInline() ? "inline " : "") << "namespace "
+                       << ND->getName() << " {\n";
+    for (const Decl* Child: ND->decls())
+      printDecl(Child, Out, Policy, Indent + 2);
+    Out.indent(Indent) << "}\n";
+    return;
+  }
+
+  if (const LinkageSpecDecl* LSD = dyn_cast<LinkageSpecDecl>(D)) {
+    Out.indent(Indent) << "extern \""
+                       << (LSD->getLanguage() == LinkageSpecDecl::lang_c
+                           ? "C" : "C++") << "\" {\n";
+    for (const Decl* Child: LSD->decls())
+      printDecl(Child, Out, Policy, Indent + 2);
+    Out.indent(Indent) << "}\n";
+    return;
+  }
+
+  if (const FunctionDecl* FD = dyn_cast<FunctionDecl>(D)) {
+    // Members defined out of line are declared by their class.
+    if (isOutOfLine(FD) || (!FD->isExternallyVisible() && !FD->isInlined()))
+      return;
+    if (FD->doesThisDeclarationHaveABody() && !FD->isInlined()
+        && !FD->isConstexpr()) {
+      // The library has the definition.
+      PrintingPolicy Terse(Policy);
+      Terse.TerseOutput = true;
+      Out.indent(Indent);
+      FD->print(Out, Terse, Indent);
+      Out << ";\n";
+      return;
+    }
+  }
+
+  if (const VarDecl* VD = dyn_cast<VarDecl>(D)) {
+    if (isOutOfLine(VD))
+      return;
+    if (!VD->isExternallyVisible()) {
+      // Constants are used in constant expressions; anything else would be
+      // a copy of its own.
+      if (!VD->getType().isConstQualified())
+        return;
+    } else if (VD->isThisDeclarationADefinition() == VarDecl::Definition) {
+      PrintingPolicy NoInit(Policy);
+      NoInit.SuppressInitializers = true;
+      Out.indent(Indent) << "extern ";
+      VD->print(Out, NoInit, Indent);
+      Out << ";\n";
+      return;
+    }
+  }
+
+  if (isa<FileScopeAsmDecl>(D) || isa<EmptyDecl>(D))
+    return;
+
+  Out.indent(Indent);
+  D->print(Out, Policy, Indent);
+  Out << ";\n";
+}
+
+bool SessionExporter::writeHeader(llvm::StringRef HeaderPath,
+                                  llvm::StringRef LibPath) {
+  std::error_code EC;
+  llvm::raw_fd_ostream Out(HeaderPath, EC, llvm::sys::fs::F_None);
+  if (EC) {
+    llvm::errs() << "cling::SessionExporter: cannot write '" << HeaderPath
+                 << "': " << EC.message() << '\n';
+    return false;
+  }
+
+  std::string Guard = llvm::sys::path::stem(LibPath).upper();
+  for (char& C: Guard)
+    if (!isalnum((unsigned char)C))
+      C = '_';
+  Guard = "CLING_EXPORT_" + Guard + "_H";
+
+  Out << kHeaderMarker << llvm::sys::path::filename(LibPath) << '\n'
+      << "// Declares the code exported from a cling session into\n// "
+      << llvm::sys::path::filename(LibPath) << "; load that library first.\n"
+      << "#ifndef " << Guard << "\n#define " << Guard << "\n\n";
+  for (const std::string& Include: m_Includes)
+    Out << "#include " << Include << '\n';
+  if (!m_Includes.empty())
+    Out << '\n';
+
+  PrintingPolicy Policy = m_Interp.getCI()->getASTContext().getPrintingPolicy();
+  for (const Decl* D: m_Decls)
+    printDecl(D, Out, Policy, 0);
+
+  Out << "\n#endif // " << Guard << '\n';
+  return true;
+}
+
+bool SessionExporter::exportTo(llvm::StringRef Path) {
+  llvm::SmallString<256> LibPath(Path);
+  llvm::sys::fs::make_absolute(LibPath);
+
+  CodeGenOptions CGOpts(m_Interp.getCI()->getCodeGenOpts());
+  CGOpts.OptimizationLevel = 2;
+  CGOpts.RelocationModel = "pic";
+
+  llvm::LLVMContext Ctx;
+  std::unique_ptr<llvm::Module> M = emitModule(Ctx, CGOpts);
+  if (!M)
+    return false;
+
+  std::unique_ptr<llvm::TargetMachine> TM
+    = IncrementalExecutor::CreateHostTargetMachine(CGOpts,
+                                                   true /*forSharedLib*/);
+  if (!TM)
+    return false;
+
+  llvm::SmallString<128> ObjPath;
+  if (std::error_code EC
+        = llvm::sys::fs::createTemporaryFile("cling-export", "o", ObjPath)) {
+    llvm::errs() << "cling::SessionExporter: cannot create a temporary file: "
+                 << EC.message() << '\n';
+    return false;
+  }
+  const bool Linked = writeObject(*M, *TM, ObjPath) && link(ObjPath, LibPath);
+  llvm::sys::fs::remove(ObjPath);
+  if (!Linked)
+    return false;
+
+  const std::string HeaderPath = getHeaderPath(LibPath);
+  if (!writeHeader(HeaderPath, LibPath))
+    return false;
+  m_Interp.GenerateAutoloadingMap(HeaderPath, getAutoloadPath(LibPath),
+                                  false /*enableMacros*/,
+                                  false /*enableLogs*/);
+  return true;
+}
+
+} // namespace cling
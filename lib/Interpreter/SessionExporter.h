@@ -0,0 +1,124 @@
+//--------------------------------------------------------------------*- C++ -*-
+// CLING - the C++ LLVM-based InterpreterG :)
+//
+// This file is dual-licensed: you can choose to license it under the University
+// of Illinois Open Source License or the GNU Lesser General Public License. See
+// LICENSE.TXT for details.
+//------------------------------------------------------------------------------
+
+#ifndef CLING_SESSION_EXPORTER_H
+#define CLING_SESSION_EXPORTER_H
+
+#include "llvm/ADT/SetVector.h"
+#include "llvm/ADT/StringRef.h"
+
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace clang {
+  class CodeGenerator;
+  class CodeGenOptions;
+  class Decl;
+  class PrintingPolicy;
+  class SourceLocation;
+}
+
+namespace llvm {
+  class LLVMContext;
+  class Module;
+  class raw_ostream;
+  class TargetMachine;
+}
+
+namespace cling {
+  class Interpreter;
+  class Transaction;
+
+  ///\brief Compiles the code entered in a session into a shared library.
+  ///
+  /// The declarations of the committed transactions are handed once more to
+  /// a CodeGenerator of their own, producing a single module that is
+  /// optimized like a regular -O2 compilation for the host CPU. The object
+  /// file is linked by the compiler cling was configured with. Wrappers, i.e.
+  /// the statements of the session, are not exported.
+  ///
+  /// Next to the library go a header declaring what the library defines and
+  /// forward declarations annotated to autoload that header; loading the
+  /// library with .L also declares them.
+  ///
+  class SessionExporter {
+  private:
+    Interpreter& m_Interp;
+
+    ///\brief The first transaction to export.
+    ///
+    const Transaction* m_First;
+
+    ///\brief Top-level declarations from the session's inputs and source
+    /// files, which the header repeats.
+    ///
+    std::vector<const clang::Decl*> m_Decls;
+
+    ///\brief The headers the exported code was declared in, as #include
+    /// directives.
+    ///
+    llvm::SetVector<std::string> m_Includes;
+
+    ///\brief Feeds the declarations of T and its nested transactions to CG.
+    ///
+    void collect(const Transaction& T, clang::CodeGenerator& CG);
+
+    ///\brief Records where the header gets a declaration from.
+    ///
+    void collectForHeader(const clang::Decl* D);
+
+    ///\brief Returns the #include directive providing a declaration at Loc;
+    /// empty if the declaration is printed into the header.
+    ///
+    std::string getInclude(clang::SourceLocation Loc) const;
+
+    std::unique_ptr<llvm::Module>
+    emitModule(llvm::LLVMContext& Ctx, const clang::CodeGenOptions& CGOpts);
+
+    ///\brief Optimizes M at -O2 for TM and writes it as an object file.
+    ///
+    bool writeObject(llvm::Module& M, llvm::TargetMachine& TM,
+                     llvm::StringRef ObjPath);
+    bool link(llvm::StringRef ObjPath, llvm::StringRef LibPath);
+    bool writeHeader(llvm::StringRef HeaderPath, llvm::StringRef LibPath);
+
+    ///\brief Prints the part of D the header needs.
+    ///
+    void printDecl(const clang::Decl* D, llvm::raw_ostream& Out,
+                   const clang::PrintingPolicy& Policy, unsigned Indent) const;
+
+  public:
+    ///\param [in] Interp - The interpreter whose session is exported.
+    ///\param [in] First - The first transaction to export.
+    ///
+    SessionExporter(Interpreter& Interp, const Transaction* First);
+
+    ///\brief Writes the library, its header and its autoload declarations.
+    ///
+    ///\returns false if any of them could not be written.
+    ///
+    bool exportTo(llvm::StringRef LibPath);
+
+    ///\brief Returns the header written next to a library.
+    ///
+    static std::string getHeaderPath(llvm::StringRef LibPath);
+
+    ///\brief Returns the autoload declarations written next to a library.
+    ///
+    static std::string getAutoloadPath(llvm::StringRef LibPath);
+
+    ///\brief Checks whether a library was written by a SessionExporter,
+    /// i.e. whether its header starts with the exporter's marker and its
+    /// autoload declarations exist.
+    ///
+    static bool isExported(llvm::StringRef LibPath);
+  };
+} // namespace cling
+
+#endif // CLING_SESSION_EXPORTER_H
@@ -0,0 +1,142 @@
+//------------------------------------------------------------------------------
+// CLING - the C++ LLVM-based InterpreterG :)
+//
+// This file is dual-licensed: you can choose to license it under the University
+// of Illinois Open Source License or the GNU Lesser General Public License. See
+// LICENSE.TXT for details.
+//------------------------------------------------------------------------------
+
+#include "cling/Interpreter/StartupProfile.h"
+#include "cling/Utils/Trace.h"
+
+#include "clang/Basic/FileSystemStatCache.h"
+
+#include "llvm/Support/Compiler.h"
+#include "llvm/Support/Format.h"
+#include "llvm/Support/raw_ostream.h"
+
+using namespace clang;
+
+namespace {
+  LLVM_THREAD_LOCAL cling::StartupProfile* gActiveProfile = 0;
+
+  ///\brief Forwards to the next stat cache (or the file system), counting
+  /// the calls into the profile it was created for.
+  ///
+  class StatCounter : public FileSystemStatCache {
+  private:
+    cling::StartupProfile* m_Profile;
+  public:
+    StatCounter(cling::StartupProfile* Profile) : m_Profile(Profile) {}
+
+    LookupResult getStat(const char* Path, FileData& Data, bool isFile,
+                         std::unique_ptr<vfs::File>* F,
+                         vfs::FileSystem& FS) override {
+      LookupResult Result = statChained(Path, Data, isFile, F, FS);
+      // Stop counting once the startup is over.
+      if (m_Profile && m_Profile == cling::StartupProfile::getActive())
+        m_Profile->countStat(F && *F);
+      return Result;
+    }
+  };
+
+  static unsigned long long toMicroseconds(double Seconds) {
+    return (unsigned long long)(Seconds * 1e6);
+  }
+} // unnamed namespace
+
+namespace cling {
+
+  StartupProfile::Activation::Activation(StartupProfile* Profile):
+    m_Prev(gActiveProfile) {
+    gActiveProfile = Profile;
+  }
+
+  StartupProfile::Activation::~Activation() {
+    gActiveProfile = m_Prev;
+  }
+
+  StartupProfile::Phase::Phase(const char* Name):
+    m_Profile(gActiveProfile), m_Index(0) {
+    if (m_Profile)
+      m_Index = m_Profile->beginPhase(Name);
+  }
+
+  StartupProfile::Phase::~Phase() {
+    if (m_Profile)
+      m_Profile->endPhase(m_Index);
+  }
+
+  StartupProfile::StartupProfile():
+    m_Origin(llvm::TimeRecord::getCurrentTime()), m_Depth(0), m_StatCalls(0),
+    m_FilesOpened(0) {}
+
+  StartupProfile* StartupProfile::getActive() {
+    return gActiveProfile;
+  }
+
+  std::unique_ptr<FileSystemStatCache> StartupProfile::createStatCounter() {
+    return std::unique_ptr<FileSystemStatCache>(new StatCounter(getActive()));
+  }
+
+  size_t StartupProfile::beginPhase(const char* Name) {
+    PhaseRecord R;
+    R.Name = Name;
+    R.Depth = m_Depth++;
+    // Subtracted again in endPhase.
+    R.StatCalls = m_StatCalls;
+    R.FilesOpened = m_FilesOpened;
+    R.Start = llvm::TimeRecord::getCurrentTime(/*Start*/ true);
+    m_Phases.push_back(R);
+    return m_Phases.size() - 1;
+  }
+
+  void StartupProfile::endPhase(size_t Index) {
+    llvm::TimeRecord End = llvm::TimeRecord::getCurrentTime(/*Start*/ false);
+    PhaseRecord& R = m_Phases[Index];
+    R.Elapsed = End;
+    R.Elapsed -= R.Start;
+    R.StatCalls = m_StatCalls - R.StatCalls;
+    R.FilesOpened = m_FilesOpened - R.FilesOpened;
+    --m_Depth;
+  }
+
+  void StartupProfile::printJSON(llvm::raw_ostream& Out) const {
+    Out << "[\n";
+    for (size_t I = 0, N = m_Phases.size(); I < N; ++I) {
+      const PhaseRecord& R = m_Phases[I];
+      Out << "  {\"name\": ";
+      utils::Trace::printJSONString(Out, R.Name);
+      Out << ", \"depth\": " << R.Depth
+          << llvm::format(", \"start\": %.6f",
+                          R.Start.getWallTime() - m_Origin.getWallTime())
+          << llvm::format(", \"wall\": %.6f", R.Elapsed.getWallTime())
+          << llvm::format(", \"user\": %.6f", R.Elapsed.getUserTime())
+          << llvm::format(", \"system\": %.6f", R.Elapsed.getSystemTime())
+          << ", \"stats\": " << R.StatCalls
+          << ", \"files_opened\": " << R.FilesOpened << '}'
+          << (I + 1 < N ? ",\n" : "\n");
+    }
+    Out << "]\n";
+  }
+
+  void StartupProfile::printChromeTrace(llvm::raw_ostream& Out) const {
+    Out << "{\"traceEvents\": [\n";
+    for (size_t I = 0, N = m_Phases.size(); I < N; ++I) {
+      const PhaseRecord& R = m_Phases[I];
+      Out << "  {\"name\": ";
+      utils::Trace::printJSONString(Out, R.Name);
+      Out << ", \"cat\": \"startup\", \"ph\": \"X\", \"pid\": 1, \"tid\": 1"
+          << ", \"ts\": "
+          << toMicroseconds(R.Start.getWallTime() - m_Origin.getWallTime())
+          << ", \"dur\": " << toMicroseconds(R.Elapsed.getWallTime())
+          << ", \"args\": {\"cpu_us\": "
+          << toMicroseconds(R.Elapsed.getProcessTime())
+          << ", \"stats\": " << R.StatCalls
+          << ", \"files_opened\": " << R.FilesOpened << "}}"
+          << (I + 1 < N ? ",\n" : "\n");
+    }
+    Out << "], \"displayTimeUnit\": \"ms\"}\n";
+  }
+
+} // namespace cling
@@ -0,0 +1,199 @@
+//------------------------------------------------------------------------------
+// CLING - the C++ LLVM-based InterpreterG :)
+//
+// This file is dual-licensed: you can choose to license it under the University
+// of Illinois Open Source License or the GNU Lesser General Public License. See
+// LICENSE.TXT for details.
+//------------------------------------------------------------------------------
+
+#include "StatCache.h"
+
+#include "clang/Basic/FileSystemStatCache.h"
+
+#include "llvm/ADT/SmallString.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/Path.h"
+#include "llvm/Support/TimeValue.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include <tuple>
+
+using namespace clang;
+
+namespace {
+  static const char* const Signature = "cling-stat-cache 1";
+
+  ///\brief Hands the misses recorded in a StatCache to clang's FileManager.
+  ///
+  class ClingStatCache : public FileSystemStatCache {
+    cling::StatCache& m_Cache;
+
+  public:
+    ClingStatCache(cling::StatCache& Cache) : m_Cache(Cache) {}
+
+    LookupResult getStat(const char* Path, FileData& Data, bool isFile,
+                         std::unique_ptr<vfs::File>* F,
+                         vfs::FileSystem& FS) override {
+      if (m_Cache.isKnownMissing(Path))
+        return CacheMissing;
+      LookupResult Result = statChained(Path, Data, isFile, F, FS);
+      if (Result == CacheMissing)
+        m_Cache.noteMissing(Path);
+      return Result;
+    }
+  };
+}
+
+namespace cling {
+
+  StatCache::StatCache(llvm::StringRef File)
+    : m_File(File), m_NumLoaded(0), m_NumInvalidated(0), m_NumAvoided(0),
+      m_NumRecorded(0) {
+    load();
+  }
+
+  StatCache::~StatCache() {
+    save();
+  }
+
+  bool StatCache::getMTime(llvm::StringRef Path, unsigned long long& MTime) {
+    llvm::sys::fs::file_status Status;
+    if (llvm::sys::fs::status(Path, Status)
+        || !llvm::sys::fs::exists(Status)) {
+      MTime = 0;
+      return false;
+    }
+    llvm::sys::TimeValue TV = Status.getLastModificationTime();
+    MTime = TV.toEpochTime() * 1000000000ULL + TV.nanoseconds();
+    return true;
+  }
+
+  void StatCache::load() {
+    llvm::ErrorOr<std::unique_ptr<llvm::MemoryBuffer>> MB
+      = llvm::MemoryBuffer::getFile(m_File);
+    if (!MB)
+      return;
+
+    llvm::SmallVector<llvm::StringRef, 128> Lines;
+    (*MB)->getBuffer().split(Lines, '\n', -1, /*KeepEmpty*/false);
+    if (Lines.empty() || Lines[0] != Signature)
+      return;
+
+    // Maps the directory numbers of the file to ours; ~0U if invalidated.
+    std::vector<unsigned> DirMap;
+    for (size_t I = 1, E = Lines.size(); I != E; ++I) {
+      llvm::StringRef Kind, Rest;
+      std::tie(Kind, Rest) = Lines[I].split(' ');
+      if (Kind == "D") {
+        // D <exists> <mtime> <path>
+        llvm::StringRef Exists, MTimeStr, Path;
+        std::tie(Exists, Rest) = Rest.split(' ');
+        std::tie(MTimeStr, Path) = Rest.split(' ');
+        unsigned long long MTime, CurMTime;
+        bool CurExists = getMTime(Path, CurMTime);
+        if (MTimeStr.getAsInteger(10, MTime) || Path.empty()
+            || CurExists != (Exists == "1") || CurMTime != MTime) {
+          DirMap.push_back(~0U);
+          continue;
+        }
+        DirMap.push_back(m_Directories.size());
+        m_DirectoryIndex[Path] = m_Directories.size();
+        m_Directories.push_back(Directory{Path, MTime, CurExists});
+      } else if (Kind == "M") {
+        // M <directory number> <path>
+        llvm::StringRef DirStr, Path;
+        std::tie(DirStr, Path) = Rest.split(' ');
+        unsigned Dir;
+        if (DirStr.getAsInteger(10, Dir) || Dir >= DirMap.size()
+            || Path.empty())
+          continue;
+        if (DirMap[Dir] == ~0U) {
+          ++m_NumInvalidated;
+          continue;
+        }
+        m_Missing[Path] = DirMap[Dir];
+        ++m_NumLoaded;
+      }
+    }
+  }
+
+  bool StatCache::isKnownMissing(llvm::StringRef Path) {
+    if (!m_Missing.count(Path))
+      return false;
+    ++m_NumAvoided;
+    return true;
+  }
+
+  void StatCache::noteMissing(llvm::StringRef Path) {
+    if (!llvm::sys::path::is_absolute(Path) || m_Missing.count(Path))
+      return;
+    llvm::StringRef Parent = llvm::sys::path::parent_path(Path);
+    if (Parent.empty())
+      return;
+
+    auto Pos = m_DirectoryIndex.find(Parent);
+    unsigned Dir;
+    if (Pos != m_DirectoryIndex.end())
+      Dir = Pos->second;
+    else {
+      Directory D;
+      D.Path = Parent;
+      D.Exists = getMTime(Parent, D.MTime);
+      Dir = m_Directories.size();
+      m_DirectoryIndex[Parent] = Dir;
+      m_Directories.push_back(D);
+    }
+    m_Missing[Path] = Dir;
+    ++m_NumRecorded;
+  }
+
+  bool StatCache::save() const {
+    if (m_File.empty() || (!m_NumRecorded && !m_NumInvalidated))
+      return true;
+
+    // A directory modified within the time stamp granularity of the file
+    // system could change again without a new time stamp; do not trust it.
+    const unsigned long long Racy
+      = (llvm::sys::TimeValue::now().toEpochTime() - 2) * 1000000000ULL;
+
+    std::string TmpFile = m_File + ".tmp";
+    {
+      std::error_code EC;
+      llvm::raw_fd_ostream Out(TmpFile, EC, llvm::sys::fs::F_Text);
+      if (EC)
+        return false;
+      Out << Signature << '\n';
+      std::vector<bool> Saved(m_Directories.size());
+      for (size_t I = 0, E = m_Directories.size(); I != E; ++I) {
+        const Directory& D = m_Directories[I];
+        Saved[I] = !D.Exists || D.MTime < Racy;
+        // Keep the numbering: unsaved directories get an invalid record.
+        Out << "D " << (D.Exists ? '1' : '0') << ' '
+            << (Saved[I] ? D.MTime : 0) << ' ' << D.Path << '\n';
+      }
+      for (const auto& M : m_Missing)
+        if (Saved[M.getValue()])
+          Out << "M " << M.getValue() << ' ' << M.getKey() << '\n';
+      if (Out.has_error()) {
+        Out.clear_error();
+        llvm::sys::fs::remove(TmpFile);
+        return false;
+      }
+    }
+    return !llvm::sys::fs::rename(TmpFile, m_File);
+  }
+
+  std::unique_ptr<FileSystemStatCache> StatCache::createFileSystemStatCache() {
+    return std::unique_ptr<FileSystemStatCache>(new ClingStatCache(*this));
+  }
+
+  void StatCache::print(llvm::raw_ostream& Out) const {
+    Out << "Stat cache: " << m_File << '\n'
+        << "  missing paths loaded:      " << m_NumLoaded << '\n'
+        << "  missing paths invalidated: " << m_NumInvalidated << '\n'
+        << "  missing paths recorded:    " << m_NumRecorded << '\n'
+        << "  stat calls avoided:        " << m_NumAvoided << '\n';
+  }
+} // namespace cling
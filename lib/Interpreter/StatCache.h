@@ -0,0 +1,102 @@
+//--------------------------------------------------------------------*- C++ -*-
+// CLING - the C++ LLVM-based InterpreterG :)
+//
+// This file is dual-licensed: you can choose to license it under the University
+// of Illinois Open Source License or the GNU Lesser General Public License. See
+// LICENSE.TXT for details.
+//------------------------------------------------------------------------------
+
+#ifndef CLING_STAT_CACHE_H
+#define CLING_STAT_CACHE_H
+
+#include "llvm/ADT/StringMap.h"
+#include "llvm/ADT/StringRef.h"
+
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace clang {
+  class FileSystemStatCache;
+}
+
+namespace llvm {
+  class raw_ostream;
+}
+
+namespace cling {
+
+  ///\brief Remembers, across sessions, which files do not exist.
+  ///
+  /// Resolving an #include or a library stats the candidate file in every
+  /// directory of the search path until one exists; on network file systems
+  /// these misses dominate the startup. The cache records each missing path
+  /// with the modification time of its directory. It is written when the
+  /// interpreter shuts down; when it is read back, each directory is stat'ed
+  /// once and the misses of directories that changed are dropped. Existing
+  /// files are never cached, so their size and time stamps stay accurate.
+  ///
+  /// Like clang's FileManager, which remembers misses for the whole session,
+  /// the cache does not notice files created while the interpreter runs.
+  ///
+  class StatCache {
+  private:
+    struct Directory {
+      std::string Path;
+      unsigned long long MTime;
+      bool Exists;
+    };
+
+    ///\brief The file the cache is loaded from and saved to.
+    ///
+    std::string m_File;
+
+    ///\brief The parent directories of the missing paths.
+    ///
+    std::vector<Directory> m_Directories;
+    llvm::StringMap<unsigned> m_DirectoryIndex;
+
+    ///\brief Missing paths and the index of their directory.
+    ///
+    llvm::StringMap<unsigned> m_Missing;
+
+    unsigned m_NumLoaded;
+    unsigned m_NumInvalidated;
+    unsigned m_NumAvoided;
+    unsigned m_NumRecorded;
+
+    ///\brief Stats a directory; returns false if it does not exist.
+    ///
+    static bool getMTime(llvm::StringRef Path, unsigned long long& MTime);
+
+    void load();
+
+  public:
+    StatCache(llvm::StringRef File);
+    ~StatCache();
+
+    ///\brief Returns true if Path is known not to exist, sparing a stat.
+    ///
+    bool isKnownMissing(llvm::StringRef Path);
+
+    ///\brief Records that the absolute Path does not exist.
+    ///
+    void noteMissing(llvm::StringRef Path);
+
+    ///\brief Writes the cache file.
+    ///
+    ///\returns false if the file could not be written.
+    ///
+    bool save() const;
+
+    ///\brief Creates the cache to plug into clang's FileManager.
+    ///
+    std::unique_ptr<clang::FileSystemStatCache> createFileSystemStatCache();
+
+    ///\brief Prints how many stat calls the cache spared.
+    ///
+    void print(llvm::raw_ostream& Out) const;
+  };
+} // namespace cling
+
+#endif // CLING_STAT_CACHE_H
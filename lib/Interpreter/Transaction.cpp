@@ -39,12 +39,16 @@ namespace cling {
   void Transaction::Initialize(Sema& S) {
     m_NestedTransactions.reset(0);
     m_Parent = 0;
+    m_Arena.reset();
+    m_ArenaOwner = 0;
+    m_FreeNested.clear();
     m_State = kCollecting;
     m_IssuedDiags = kNone;
     m_Opts = CompilationOptions();
     m_Module = 0;
     m_ExeUnload = {(void*)(size_t)-1};
     m_WrapperFD = 0;
+    m_DirectResultType = 0;
     m_Next = 0;
     //m_Sema = S;
     m_BufferFID = FileID(); // sets it to invalid.
@@ -57,10 +61,71 @@ namespace cling {
         assert(((*m_NestedTransactions)[i]->getState() == kCommitted
                 || (*m_NestedTransactions)[i]->getState() == kRolledBack)
                && "All nested transactions must be committed!");
-        delete (*m_NestedTransactions)[i];
+        destroyNested((*m_NestedTransactions)[i]);
       }
   }
 
+  Transaction::AllocationStats& Transaction::getAllocationStats() {
+    static AllocationStats Stats = AllocationStats();
+    return Stats;
+  }
+
+  void Transaction::DeclQueue::grow() {
+    unsigned NewCapacity = std::max(2 * m_Capacity, 2u * kInlineSize);
+    DelayCallInfo* NewBegin
+      = (DelayCallInfo*)malloc(NewCapacity * sizeof(DelayCallInfo));
+    std::uninitialized_copy(begin(), end(), NewBegin);
+    if (m_OnHeap)
+      free(m_Begin);
+    m_Begin = NewBegin;
+    m_Capacity = NewCapacity;
+    m_OnHeap = true;
+    ++getAllocationStats().m_QueueHeapAllocations;
+  }
+
+  void Transaction::DeclQueue::compact(llvm::BumpPtrAllocator& Arena) {
+    // Inline queues and the ones already in an arena are as small as it gets.
+    if (!m_OnHeap)
+      return;
+    DelayCallInfo* NewBegin = getInline();
+    if (m_Size > kInlineSize) {
+      NewBegin = Arena.Allocate<DelayCallInfo>(m_Size);
+      ++getAllocationStats().m_QueueCompactions;
+    }
+    std::uninitialized_copy(begin(), end(), NewBegin);
+    free(m_Begin);
+    m_Begin = NewBegin;
+    m_Capacity = std::max(m_Size, (unsigned)kInlineSize);
+    m_OnHeap = false;
+  }
+
+  llvm::BumpPtrAllocator& Transaction::getArena() {
+    Transaction* Owner = m_ArenaOwner ? m_ArenaOwner : getTopmostParent();
+    if (!Owner->m_Arena)
+      Owner->m_Arena.reset(new llvm::BumpPtrAllocator());
+    return *Owner->m_Arena;
+  }
+
+  void Transaction::destroyNested(Transaction* T) {
+    Transaction* Owner = T->m_ArenaOwner;
+    T->~Transaction();
+    // The memory goes away together with the owner's arena; until then it can
+    // hold another nested transaction.
+    if (Owner)
+      Owner->m_FreeNested.push_back(T);
+    else
+      ::operator delete(T);
+  }
+
+  void Transaction::compact() {
+    assert(getState() == kCommitted && "Compacting a transaction in flight!");
+    if (!m_DeclQueue.isOnHeap() && !m_DeserializedDeclQueue.isOnHeap())
+      return;
+    llvm::BumpPtrAllocator& Arena = getArena();
+    m_DeclQueue.compact(Arena);
+    m_DeserializedDeclQueue.compact(Arena);
+  }
+
   NamedDecl* Transaction::containsNamedDecl(llvm::StringRef name) const {
     for (auto I = decls_begin(), E = decls_end(); I != E; ++I) {
       for (auto DI : I->m_DGR) {
@@ -0,0 +1,403 @@
+//------------------------------------------------------------------------------
+// CLING - the C++ LLVM-based InterpreterG :)
+//
+// This file is dual-licensed: you can choose to license it under the University
+// of Illinois Open Source License or the GNU Lesser General Public License. See
+// LICENSE.TXT for details.
+//------------------------------------------------------------------------------
+
+#include "TransactionHeap.h"
+
+#include "AllocationFunctions.h"
+
+#include "llvm/Support/Compiler.h"
+#include "llvm/Support/MathExtras.h"
+#include "llvm/Support/Process.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+
+#ifdef LLVM_ON_UNIX
+#include <sys/mman.h>
+#endif
+
+using namespace llvm;
+
+namespace {
+  ///\brief The heap the hooks allocate from, if any.
+  ///
+  static std::atomic<cling::TransactionHeap*> s_Heap(nullptr);
+
+  static const size_t kAlignment = 16;
+  static const size_t kFirstSlabSize = 64 * 1024;
+  static const size_t kMaxSlabSize = 16 * 1024 * 1024;
+
+  ///\brief Precedes each block, keeping it aligned like malloc's.
+  ///
+  struct alignas(16) BlockHeader {
+    size_t Size;
+  };
+
+  static uintptr_t mapSlab(size_t Size) {
+#ifdef LLVM_ON_UNIX
+    void* Addr = mmap(0, Size, PROT_READ | PROT_WRITE,
+                      MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (Addr != MAP_FAILED)
+      return (uintptr_t)Addr;
+#endif
+    return 0;
+  }
+
+  static void unmapSlab(uintptr_t Start, size_t Size) {
+#ifdef LLVM_ON_UNIX
+    munmap((void*)Start, Size);
+#endif
+  }
+
+  ///\brief Returns a slab's memory to the system, keeping its addresses
+  /// reserved: any later access faults.
+  ///
+  static void protectSlab(uintptr_t Start, size_t Size) {
+#ifdef LLVM_ON_UNIX
+    madvise((void*)Start, Size, MADV_DONTNEED);
+    mprotect((void*)Start, Size, PROT_NONE);
+#endif
+  }
+
+  static void* heapAllocate(size_t Size) {
+    if (cling::TransactionHeap* Heap = s_Heap.load(std::memory_order_acquire))
+      return Heap->allocate(Size);
+    return 0;
+  }
+
+  static bool heapDeallocate(void* Ptr) {
+    cling::TransactionHeap* Heap = s_Heap.load(std::memory_order_acquire);
+    return Ptr && Heap && Heap->deallocate(Ptr);
+  }
+
+  static void* hookMalloc(size_t Size) {
+    if (void* Ptr = heapAllocate(Size))
+      return Ptr;
+    return ::malloc(Size);
+  }
+
+  static void* hookCalloc(size_t N, size_t Size) {
+    // Let the runtime handle the overflow.
+    if (Size && N > SIZE_MAX / Size)
+      return ::calloc(N, Size);
+    // Slabs are fresh mappings and their memory is never reused: it is zero.
+    if (void* Ptr = heapAllocate(N * Size))
+      return Ptr;
+    return ::calloc(N, Size);
+  }
+
+  static void* hookRealloc(void* Old, size_t Size) {
+    cling::TransactionHeap* Heap = s_Heap.load(std::memory_order_acquire);
+    size_t OldSize = 0;
+    if (!Old)
+      return hookMalloc(Size);
+    if (!Heap || !Heap->getSize(Old, OldSize))
+      return ::realloc(Old, Size);
+    // Releasing the old block is a no-op.
+    if (!Size)
+      return 0;
+    void* New = Heap->allocate(Size);
+    if (!New)
+      New = ::malloc(Size);
+    if (New)
+      memcpy(New, Old, std::min(OldSize, Size));
+    return New;
+  }
+
+  static void hookFree(void* Ptr) {
+    if (!heapDeallocate(Ptr))
+      ::free(Ptr);
+  }
+
+  static void* hookNew(size_t Size) {
+    if (void* Ptr = heapAllocate(Size))
+      return Ptr;
+    return ::operator new(Size);
+  }
+
+  static void* hookNewArray(size_t Size) {
+    if (void* Ptr = heapAllocate(Size))
+      return Ptr;
+    return ::operator new[](Size);
+  }
+
+  static void* hookNewNothrow(size_t Size, const std::nothrow_t& NT) {
+    if (void* Ptr = heapAllocate(Size))
+      return Ptr;
+    return ::operator new(Size, NT);
+  }
+
+  static void* hookNewArrayNothrow(size_t Size, const std::nothrow_t& NT) {
+    if (void* Ptr = heapAllocate(Size))
+      return Ptr;
+    return ::operator new[](Size, NT);
+  }
+
+  static void hookDelete(void* Ptr) {
+    if (!heapDeallocate(Ptr))
+      ::operator delete(Ptr);
+  }
+
+  static void hookDeleteArray(void* Ptr) {
+    if (!heapDeallocate(Ptr))
+      ::operator delete[](Ptr);
+  }
+
+  static void hookDeleteSized(void* Ptr, size_t) {
+    hookDelete(Ptr);
+  }
+
+  static void hookDeleteArraySized(void* Ptr, size_t) {
+    hookDeleteArray(Ptr);
+  }
+
+  ///\brief The hooks, indexed by cling::AllocationFunction.
+  ///
+  static void* const kHooks[cling::kNumAllocationFunctions] = {
+    (void*)&hookMalloc,
+    (void*)&hookCalloc,
+    (void*)&hookRealloc,
+    (void*)&hookFree,
+    (void*)&hookNew,
+    (void*)&hookNewArray,
+    (void*)&hookNewNothrow,
+    (void*)&hookNewArrayNothrow,
+    (void*)&hookDelete,
+    (void*)&hookDeleteArray,
+    (void*)&hookDeleteSized,
+    (void*)&hookDeleteArraySized
+  };
+} // unnamed namespace
+
+namespace cling {
+
+  TransactionHeap::Scope::Scope(TransactionHeap* Heap,
+                                unsigned TransactionID):
+    m_Heap(Heap), m_Prev(0) {
+    if (!m_Heap)
+      return;
+    std::lock_guard<std::mutex> Lock(m_Heap->m_Mutex);
+    m_Prev = m_Heap->m_CurrentTransaction;
+    m_Heap->m_CurrentTransaction = TransactionID;
+  }
+
+  TransactionHeap::Scope::~Scope() {
+    if (!m_Heap)
+      return;
+    std::lock_guard<std::mutex> Lock(m_Heap->m_Mutex);
+    m_Heap->m_CurrentTransaction = m_Prev;
+  }
+
+  TransactionHeap::TransactionHeap(bool Debug):
+    m_Debug(Debug), m_CurrentTransaction(0) {
+    s_Heap.store(this, std::memory_order_release);
+  }
+
+  TransactionHeap::~TransactionHeap() {
+    TransactionHeap* Self = this;
+    s_Heap.compare_exchange_strong(Self, nullptr);
+    for (auto&& I: m_Slabs)
+      unmapSlab(I.first, I.second.End - I.first);
+  }
+
+  const TransactionHeap::Slab*
+  TransactionHeap::findSlab(uintptr_t Addr, uintptr_t* Start) const {
+    auto I = m_Slabs.upper_bound(Addr);
+    if (I == m_Slabs.begin())
+      return 0;
+    --I;
+    if (Addr >= I->second.End)
+      return 0;
+    if (Start)
+      *Start = I->first;
+    return &I->second;
+  }
+
+  void* TransactionHeap::allocate(size_t Size) {
+    if (Size > SIZE_MAX / 2)
+      return 0;
+    const size_t Need = sizeof(BlockHeader) + alignTo(Size, kAlignment);
+
+    std::lock_guard<std::mutex> Lock(m_Mutex);
+    if (!m_CurrentTransaction)
+      return 0;
+    Arena& A = m_Arenas[m_CurrentTransaction];
+    if (A.End - A.Cur < Need) {
+      if (!A.NextSlabSize)
+        A.NextSlabSize = kFirstSlabSize;
+      const size_t SlabSize
+        = std::max(A.NextSlabSize,
+                   (size_t)alignTo(Need, sys::Process::getPageSize()));
+      const uintptr_t Start = mapSlab(SlabSize);
+      if (!Start)
+        return 0;
+      m_Slabs[Start] = Slab{Start + SlabSize, m_CurrentTransaction, false};
+      A.Slabs.push_back(Start);
+      A.Cur = Start;
+      A.End = Start + SlabSize;
+      A.NextSlabSize = std::min(A.NextSlabSize * 2, kMaxSlabSize);
+    }
+    BlockHeader* Header = reinterpret_cast<BlockHeader*>(A.Cur);
+    Header->Size = Size;
+    A.Cur += Need;
+    ++A.NumBlocks;
+    A.Bytes += Size;
+    return Header + 1;
+  }
+
+  bool TransactionHeap::deallocate(void* Ptr) {
+    std::lock_guard<std::mutex> Lock(m_Mutex);
+    const Slab* S = findSlab((uintptr_t)Ptr);
+    if (!S)
+      return false;
+    if (S->Released)
+      errs() << "cling: releasing " << Ptr << " from the heap of unloaded "
+                "transaction " << S->TransactionID << '\n';
+    return true;
+  }
+
+  bool TransactionHeap::getSize(void* Ptr, size_t& Size) const {
+    std::lock_guard<std::mutex> Lock(m_Mutex);
+    const Slab* S = findSlab((uintptr_t)Ptr);
+    if (!S)
+      return false;
+    if (S->Released) {
+      errs() << "cling: reallocating " << Ptr << " from the heap of unloaded "
+                "transaction " << S->TransactionID << '\n';
+      Size = 0;
+      return true;
+    }
+    Size = (reinterpret_cast<const BlockHeader*>(Ptr) - 1)->Size;
+    return true;
+  }
+
+  size_t
+  TransactionHeap::findEscapes(unsigned TransactionID,
+                               ArrayRef<std::pair<uintptr_t, uintptr_t>> Roots,
+                               raw_ostream* Out) const {
+    const Arena& Released = m_Arenas.find(TransactionID)->second;
+    if (Released.Slabs.empty())
+      return 0;
+    const uintptr_t Lowest = *std::min_element(Released.Slabs.begin(),
+                                               Released.Slabs.end());
+    uintptr_t Highest = 0;
+    for (uintptr_t Start: Released.Slabs)
+      Highest = std::max(Highest, m_Slabs.find(Start)->second.End);
+
+    // The JITted globals' sections need not end on a word.
+    auto count = [&](uintptr_t Start, uintptr_t End) -> size_t {
+      size_t N = 0;
+      for (uintptr_t Addr = alignTo(Start, sizeof(uintptr_t));
+           Addr + sizeof(uintptr_t) <= End; Addr += sizeof(uintptr_t)) {
+        const uintptr_t Word = *(const uintptr_t*)Addr;
+        if (Word < Lowest || Word >= Highest)
+          continue;
+        const Slab* S = findSlab(Word);
+        if (S && S->TransactionID == TransactionID)
+          ++N;
+      }
+      return N;
+    };
+
+    // Pointers to the released heap, by the transaction holding them.
+    DenseMap<unsigned, size_t> Escapes;
+    size_t NumEscapes = 0;
+    for (auto&& A: m_Arenas) {
+      if (A.first == TransactionID)
+        continue;
+      for (uintptr_t Start: A.second.Slabs) {
+        // Only the newest slab is partially used.
+        const uintptr_t End = Start == A.second.Slabs.back() ? A.second.Cur
+                              : m_Slabs.find(Start)->second.End;
+        if (size_t N = count(Start, End)) {
+          Escapes[A.first] += N;
+          NumEscapes += N;
+        }
+      }
+    }
+    size_t InKept = 0;
+    for (auto&& K: m_Kept)
+      InKept += count(K.first, K.second);
+    size_t InRoots = 0;
+    for (auto&& R: Roots)
+      InRoots += count(R.first, R.second);
+    NumEscapes += InKept + InRoots;
+
+    if (!Out)
+      return NumEscapes;
+    for (auto&& E: Escapes)
+      *Out << "cling: " << E.second << " pointers into the heap of unloaded "
+              "transaction " << TransactionID << " remain in the heap of "
+              "transaction " << E.first << '\n';
+    if (InKept)
+      *Out << "cling: " << InKept << " pointers into the heap of unloaded "
+              "transaction " << TransactionID << " remain in the heaps kept "
+              "for the session\n";
+    if (InRoots)
+      *Out << "cling: " << InRoots << " pointers into the heap of unloaded "
+              "transaction " << TransactionID << " remain in the JITted "
+              "globals\n";
+    return NumEscapes;
+  }
+
+  void TransactionHeap::release(
+                     unsigned TransactionID,
+                     ArrayRef<std::pair<uintptr_t, uintptr_t>> Roots) {
+    std::lock_guard<std::mutex> Lock(m_Mutex);
+    auto A = m_Arenas.find(TransactionID);
+    if (A == m_Arenas.end())
+      return;
+    if (m_Debug)
+      errs() << "cling: releasing the heap of transaction " << TransactionID
+             << ": " << A->second.NumBlocks << " blocks of "
+             << A->second.Bytes << " bytes\n";
+
+    if (findEscapes(TransactionID, Roots, m_Debug ? &errs() : nullptr)) {
+      // Still in use; the blocks cannot be told apart, keep them all.
+      if (m_Debug)
+        errs() << "cling: keeping the heap of transaction " << TransactionID
+               << " for the session\n";
+      for (uintptr_t Start: A->second.Slabs) {
+        Slab& S = m_Slabs.find(Start)->second;
+        S.TransactionID = 0;
+        m_Kept.push_back(std::make_pair(Start,
+                         Start == A->second.Slabs.back() ? A->second.Cur
+                                                         : S.End));
+      }
+      m_Arenas.erase(A);
+      return;
+    }
+
+    for (uintptr_t Start: A->second.Slabs) {
+      auto S = m_Slabs.find(Start);
+      const size_t Size = S->second.End - Start;
+      if (m_Debug) {
+        protectSlab(Start, Size);
+        S->second.Released = true;
+      } else {
+        unmapSlab(Start, Size);
+        m_Slabs.erase(S);
+      }
+    }
+    m_Arenas.erase(A);
+  }
+
+  uint64_t TransactionHeap::getHook(StringRef Name) {
+    if (!s_Heap.load(std::memory_order_acquire))
+      return 0;
+    AllocationFunction F = getAllocationFunction(Name);
+    if (F == kNumAllocationFunctions)
+      return 0;
+    return (uint64_t)(uintptr_t)kHooks[F];
+  }
+
+} // namespace cling
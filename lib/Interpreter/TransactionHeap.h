@@ -0,0 +1,166 @@
+//--------------------------------------------------------------------*- C++ -*-
+// CLING - the C++ LLVM-based InterpreterG :)
+//
+// This file is dual-licensed: you can choose to license it under the University
+// of Illinois Open Source License or the GNU Lesser General Public License. See
+// LICENSE.TXT for details.
+//------------------------------------------------------------------------------
+
+#ifndef CLING_TRANSACTION_HEAP_H
+#define CLING_TRANSACTION_HEAP_H
+
+#include "llvm/ADT/ArrayRef.h"
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/StringRef.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <vector>
+
+namespace llvm {
+  class raw_ostream;
+}
+
+namespace cling {
+
+  ///\brief Per-transaction bump heaps for the JITted code.
+  ///
+  /// The IncrementalJIT resolves malloc, calloc, realloc, free and the
+  /// global operators new and delete of the code it links to hooks that
+  /// allocate from the heap of the transaction whose wrapper or static
+  /// initializers run, by bumping a pointer. Releasing a block does nothing;
+  /// unloading the transaction releases its heap at once. Allocations
+  /// outside of a transaction's code and blocks not from a heap go to the
+  /// C runtime.
+  ///
+  /// The heap of an unloading transaction is searched for in the remaining
+  /// heaps and in the JITted globals: a block stored in an object of an
+  /// earlier transaction, e.g. the buffer of a vector defined by an earlier
+  /// input, keeps the whole heap until the end of the session. Memory used
+  /// by a thread outliving the transaction's code, only referred to from the
+  /// stack or the C runtime's heap, or released by a compiled library still
+  /// becomes invalid or corrupts the C runtime's heap. In debug mode
+  /// released heaps stay reserved but inaccessible, so that any later use
+  /// faults, releasing their blocks is reported, and so are the pointers
+  /// keeping a heap.
+  ///
+  /// Only available on Unix.
+  ///
+  class TransactionHeap {
+  public:
+    ///\brief Makes the code in the enclosing scope allocate from the heap of
+    /// a transaction.
+    ///
+    class Scope {
+    private:
+      TransactionHeap* m_Heap;
+      unsigned m_Prev;
+    public:
+      Scope(TransactionHeap* Heap, unsigned TransactionID);
+      ~Scope();
+    };
+
+  private:
+    ///\brief A mapping holding blocks of one transaction.
+    ///
+    struct Slab {
+      uintptr_t End;
+      ///\brief The transaction; 0 once it is kept for the session.
+      unsigned TransactionID;
+      ///\brief Whether the transaction was unloaded; only kept in debug mode.
+      bool Released;
+    };
+
+    ///\brief The heap of a transaction.
+    ///
+    struct Arena {
+      ///\brief Free part of the newest slab.
+      uintptr_t Cur = 0;
+      uintptr_t End = 0;
+      ///\brief Size of the next slab; grows with each slab.
+      size_t NextSlabSize = 0;
+      std::vector<uintptr_t> Slabs;
+      size_t NumBlocks = 0;
+      size_t Bytes = 0;
+    };
+
+    const bool m_Debug;
+
+    ///\brief Protects everything below; the JITted code may allocate from
+    /// several threads.
+    ///
+    mutable std::mutex m_Mutex;
+
+    ///\brief The transaction whose code runs, or 0.
+    ///
+    unsigned m_CurrentTransaction;
+
+    ///\brief The slabs of all heaps by their start.
+    ///
+    std::map<uintptr_t, Slab> m_Slabs;
+
+    llvm::DenseMap<unsigned, Arena> m_Arenas;
+
+    ///\brief The used parts of the slabs kept for the session.
+    ///
+    std::vector<std::pair<uintptr_t, uintptr_t>> m_Kept;
+
+    ///\brief Returns the slab containing Addr, or null.
+    ///
+    const Slab* findSlab(uintptr_t Addr, uintptr_t* Start = 0) const;
+
+    ///\brief Counts the pointers into the slabs of a transaction that
+    /// remain in the heaps of the others, the kept slabs or the given
+    /// ranges.
+    ///
+    ///\param [in] Out - Gets where the pointers are, if set.
+    ///
+    size_t findEscapes(unsigned TransactionID,
+                       llvm::ArrayRef<std::pair<uintptr_t, uintptr_t>> Roots,
+                       llvm::raw_ostream* Out) const;
+
+  public:
+    ///\param [in] Debug - Catch uses of released heaps.
+    ///
+    TransactionHeap(bool Debug);
+    ~TransactionHeap();
+
+    ///\brief Allocates from the heap of the running transaction.
+    ///
+    ///\returns null if no transaction's code runs or memory is exhausted.
+    ///
+    void* allocate(size_t Size);
+
+    ///\brief Releases a block of any heap, which is a no-op.
+    ///
+    ///\returns false if Ptr is not from a heap.
+    ///
+    bool deallocate(void* Ptr);
+
+    ///\brief Returns the size a block of a heap was allocated with in Size.
+    ///
+    ///\returns false if Ptr is not from a heap.
+    ///
+    bool getSize(void* Ptr, size_t& Size) const;
+
+    ///\brief Releases the heap of an unloaded transaction, unless pointers
+    /// into it remain.
+    ///
+    ///\param [in] Roots - Where else to look for pointers, e.g. the JITted
+    ///   globals; start and end.
+    ///
+    void release(unsigned TransactionID,
+                 llvm::ArrayRef<std::pair<uintptr_t, uintptr_t>> Roots);
+
+    ///\brief Returns the address of the hook interposing the given C or
+    /// C++ runtime function, by its linkage name without the platform's
+    /// global prefix; 0 if the function is not interposed or there is no
+    /// heap.
+    ///
+    static uint64_t getHook(llvm::StringRef Name);
+  };
+} // namespace cling
+
+#endif // CLING_TRANSACTION_HEAP_H
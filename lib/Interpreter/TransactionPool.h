@@ -46,13 +46,29 @@ namespace cling {
         ::operator delete(T);
     }
 
-    Transaction* takeTransaction(clang::Sema& S) {
+    Transaction* takeTransaction(clang::Sema& S, Transaction* Parent = 0) {
+      Transaction::AllocationStats& Stats = Transaction::getAllocationStats();
       Transaction *T;
-      if (kDebugMode || m_Transactions.empty()) {
+      if (Parent) {
+        // Nested transactions live in the arena of their topmost transaction
+        // and die with it at the latest.
+        Transaction* Owner = Parent->getTopmostParent();
+        if (kDebugMode || Owner->m_FreeNested.empty()) {
+          T = new (Owner->getArena().Allocate<Transaction>()) Transaction(S);
+          ++Stats.m_ArenaTransactions;
+        } else {
+          T = new (Owner->m_FreeNested.pop_back_val()) Transaction(S);
+          ++Stats.m_ArenaReusedTransactions;
+        }
+        T->m_ArenaOwner = Owner;
+      } else if (kDebugMode || m_Transactions.empty()) {
         T = (Transaction*) ::operator new(sizeof(Transaction));
         new(T) Transaction(S);
-      } else
+        ++Stats.m_HeapTransactions;
+      } else {
         T = new (m_Transactions.pop_back_val()) Transaction(S);
+        ++Stats.m_PooledTransactions;
+      }
 
       return T;
     }
@@ -73,6 +89,11 @@ namespace cling {
       if (T->getParent())
         T->getParent()->removeNestedTransaction(T);
 
+      if (T->m_ArenaOwner) {
+        Transaction::destroyNested(T);
+        return;
+      }
+
       T->~Transaction();
 
       // don't overflow the pool
@@ -48,6 +48,11 @@ namespace {
     ///\brief The destructor function.
     DtorFunc_t m_DtorFunc;
 
+    ///\brief The record whose destructor call was requested but not compiled
+    /// yet at allocation, and the interpreter compiling it.
+    const clang::RecordDecl* m_Record;
+    cling::Interpreter* m_Interp;
+
     ///\brief The size of the allocation (for arrays)
     unsigned long m_AllocSize;
 
@@ -71,15 +76,19 @@ namespace {
     ///\brief Initialize the storage management part of the allocated object.
     ///  The allocator is referencing it, thus initialize m_RefCnt with 1.
     ///\param [in] dtorFunc - the function to be called before deallocation.
-    AllocatedValue(void* dtorFunc, size_t allocSize, size_t nElements):
-      m_RefCnt(1), m_DtorFunc(PtrToFunc(dtorFunc)), m_AllocSize(allocSize),
-      m_NElements(nElements)
+    ///\param [in] RD, Interp - where to get dtorFunc from once compiled, if
+    ///   it is 0 but the record needs a destructor call.
+    AllocatedValue(void* dtorFunc, const clang::RecordDecl* RD,
+                   cling::Interpreter* Interp, size_t allocSize,
+                   size_t nElements):
+      m_RefCnt(1), m_DtorFunc(PtrToFunc(dtorFunc)), m_Record(RD),
+      m_Interp(Interp), m_AllocSize(allocSize), m_NElements(nElements)
     {}
 
     char* getPayload() { return m_Payload; }
 
     static unsigned getPayloadOffset() {
-      static const AllocatedValue Dummy(0,0,0);
+      static const AllocatedValue Dummy(0,0,0,0,0);
       return Dummy.m_Payload - (const char*)&Dummy;
     }
 
@@ -95,6 +104,9 @@ namespace {
     void Release() {
       assert (m_RefCnt > 0 && "Reference count is already zero.");
       if (--m_RefCnt == 0) {
+        // Usually compiled before the next execution, else now.
+        if (!m_DtorFunc && m_Record)
+          m_DtorFunc = PtrToFunc(m_Interp->compileDtorCallFor(m_Record));
         if (m_DtorFunc) {
           char* payload = getPayload();
           for (size_t el = 0; el < m_NElements; ++el)
@@ -221,13 +233,23 @@ namespace cling {
         = llvm::dyn_cast<clang::ConstantArrayType>(DtorType.getTypePtr())) {
       DtorType = ArrTy->getElementType();
     }
-    if (const clang::RecordType* RTy = DtorType->getAs<clang::RecordType>())
-      dtorFunc = m_Interpreter->compileDtorCallFor(RTy->getDecl());
+    // The destructor calls of new record types get compiled together, see
+    // Interpreter::requestDtorCallFor().
+    const clang::CXXRecordDecl* RD = 0;
+    if (const clang::RecordType* RTy = DtorType->getAs<clang::RecordType>()) {
+      RD = llvm::dyn_cast<clang::CXXRecordDecl>(RTy->getDecl());
+      if (RD && (!RD->hasDefinition() || RD->hasTrivialDestructor()))
+        RD = 0;
+      if (RD)
+        dtorFunc = m_Interpreter->requestDtorCallFor(RD);
+    }
 
     const clang::ASTContext& ctx = getASTContext();
     unsigned payloadSize = ctx.getTypeSizeInChars(getType()).getQuantity();
     char* alloc = new char[AllocatedValue::getPayloadOffset() + payloadSize];
-    AllocatedValue* allocVal = new (alloc) AllocatedValue(dtorFunc, payloadSize,
+    AllocatedValue* allocVal = new (alloc) AllocatedValue(dtorFunc, RD,
+                                                          m_Interpreter,
+                                                          payloadSize,
                                                           GetNumberOfElements());
     m_Storage.m_Ptr = allocVal->getPayload();
   }
@@ -8,6 +8,7 @@
 //------------------------------------------------------------------------------
 
 #include "ValueExtractionSynthesizer.h"
+#include "ExecutorProcess.h"
 
 #include "cling/Interpreter/Interpreter.h"
 #include "cling/Interpreter/Transaction.h"
@@ -82,6 +83,11 @@ namespace cling {
     if (isa<Expr>(*(CS->body_begin() + foundAtPos)))
       returnStmts.push_back(CS->body_begin() + foundAtPos);
 
+    // When only evaluating a single result of builtin or pointer type, the
+    // wrapper can store it straight into the Value's storage; the interpreter
+    // then types the Value itself, saving the runtime call.
+    const bool directResult = !CO.ValuePrinting && returnStmts.size() == 1;
+
     // We want to support cases such as:
     // gCling->evaluate("if() return 'A' else return 12", V), that puts in V,
     // either A or 12.
@@ -164,7 +170,14 @@ namespace cling {
         // case 2.1):
         //   copyArray(src, placement, size)
 
-        Expr* SVRInit = SynthesizeSVRInit(lastExpr);
+        Expr* SVRInit = 0;
+        if (directResult) {
+          if ((SVRInit = SynthesizeDirectStore(lastExpr)))
+            getTransaction()->setDirectResultType(
+                                     lastExpr->getType().getAsOpaquePtr());
+        }
+        if (!SVRInit)
+          SVRInit = SynthesizeSVRInit(lastExpr);
         // if we had return stmt update to execute the SVR init, even if the
         // wrapper returns void.
         if (RS) {
@@ -198,6 +211,57 @@ namespace {
   }
 }
 
+  Expr* ValueExtractionSynthesizer::SynthesizeDirectStore(Expr* E) {
+    ExprWithCleanups* Cleanups = dyn_cast<ExprWithCleanups>(E);
+    if (Cleanups)
+      E = Cleanups->getSubExpr();
+
+    // Pick the member of Value's storage union, like setValueNoAlloc does.
+    QualType desugaredTy = E->getType().getDesugaredType(*m_Context);
+    QualType SlotTy;
+    if (desugaredTy->isIntegralOrEnumerationType())
+      SlotTy = m_Context->UnsignedLongLongTy;
+    else if (desugaredTy->isAnyPointerType() || desugaredTy->isNullPtrType())
+      SlotTy = m_Context->VoidPtrTy;
+    else if (const BuiltinType* BT = desugaredTy->getAs<BuiltinType>()) {
+      if (BT->getKind() == BuiltinType::Float
+          || BT->getKind() == BuiltinType::Double
+          || BT->getKind() == BuiltinType::LongDouble)
+        SlotTy = desugaredTy.getUnqualifiedType();
+    }
+    if (SlotTy.isNull())
+      return 0;
+
+    // *(SlotTy*)vpSVR = (SlotTy)E
+    FunctionDecl* FD = cast<FunctionDecl>(m_Sema->CurContext);
+    SourceLocation Loc = E->getLocStart();
+    ExprResult SlotDRE
+      = m_Sema->BuildDeclRefExpr(FD->getParamDecl(0), m_Context->VoidPtrTy,
+                                 VK_RValue, Loc);
+    Expr* SlotPtr
+      = utils::Synthesize::CStyleCastPtrExpr(m_Sema,
+                                             m_Context->getPointerType(SlotTy),
+                                             SlotDRE.get());
+    ExprResult Slot = m_Sema->BuildUnaryOp(/*Scope*/0, Loc, UO_Deref, SlotPtr);
+    TypeSourceInfo* TSI = m_Context->getTrivialTypeSourceInfo(SlotTy, Loc);
+    ExprResult CastedE = m_Sema->BuildCStyleCastExpr(Loc, TSI, Loc, E);
+    if (Slot.isInvalid() || CastedE.isInvalid())
+      return 0;
+    ExprResult Store = m_Sema->BuildBinOp(/*Scope*/0, Loc, BO_Assign,
+                                          Slot.get(), CastedE.get());
+    if (Store.isInvalid())
+      return 0;
+
+    // Extend the scope of the temporary cleaner if applicable.
+    if (Cleanups) {
+      Cleanups->setSubExpr(Store.get());
+      Cleanups->setValueKind(Store.get()->getValueKind());
+      Cleanups->setType(Store.get()->getType());
+      return Cleanups;
+    }
+    return Store.get();
+  }
+
   Expr* ValueExtractionSynthesizer::SynthesizeSVRInit(Expr* E) {
     if (!m_gClingVD)
       FindAndCacheRuntimeDecls();
@@ -459,7 +523,8 @@ namespace {
     assert(!V.needsManagedAllocation() && "Must contain non managed temporary");
     assert(vpOn != (char)cling::CompilationOptions::VPAuto
            && "VPAuto must have been expanded earlier.");
-    if (vpOn == (char)cling::CompilationOptions::VPEnabled)
+    if (vpOn == (char)cling::CompilationOptions::VPEnabled
+        && !cling::ExecutorProcess::deferDump())
       V.dump();
   }
 
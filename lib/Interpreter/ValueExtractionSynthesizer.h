@@ -58,6 +58,9 @@ public:
 
     virtual ~ValueExtractionSynthesizer();
 
+    const char* getName() const override {
+      return "ValueExtractionSynthesizer";
+    }
     Result Transform(clang::Decl* D) override;
 
   private:
@@ -88,6 +91,14 @@ public:
     ///
     clang::Expr* SynthesizeSVRInit(clang::Expr* E);
 
+    ///\brief Synthesizes *(T*)vpSVR = (T)E for builtin and pointer results,
+    /// with T the member of Value's storage that holds E's type. The wrapper
+    /// then gets the storage instead of the Value itself.
+    ///
+    ///\returns the store, or 0 if E's type needs the runtime call.
+    ///
+    clang::Expr* SynthesizeDirectStore(clang::Expr* E);
+
     // Find and cache cling::runtime::gCling, setValueNoAlloc,
     // setValueWithAlloc on first request.
     void FindAndCacheRuntimeDecls();
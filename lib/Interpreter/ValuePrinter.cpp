@@ -14,6 +14,7 @@
 #include "cling/Interpreter/Transaction.h"
 #include "cling/Interpreter/Value.h"
 #include "cling/Utils/AST.h"
+#include "cling/Utils/Trace.h"
 #include "cling/Utils/Validation.h"
 
 #include "clang/AST/ASTContext.h"
@@ -176,8 +177,72 @@ static std::string printQualType(clang::ASTContext& Ctx, clang::QualType QT) {
 
 } // anonymous namespace
 
+///\brief Whether an object of a type may point to memory outside of it, e.g.
+/// to a heap buffer.
+static bool mayPointOutside(clang::ASTContext &C, clang::QualType QT) {
+  QT = C.getBaseElementType(QT.getNonReferenceType()).getCanonicalType();
+  if (QT->isPointerType() || QT->isReferenceType()
+      || QT->isMemberPointerType() || QT->isObjCObjectPointerType()
+      || QT->isBlockPointerType())
+    return true;
+  const clang::RecordType *RT = QT->getAs<clang::RecordType>();
+  if (!RT)
+    return false;
+  const clang::RecordDecl *RD = RT->getDecl()->getDefinition();
+  if (!RD)
+    return true;
+  if (const clang::CXXRecordDecl *CXXRD
+      = llvm::dyn_cast<clang::CXXRecordDecl>(RD)) {
+    for (const clang::CXXBaseSpecifier &Base : CXXRD->bases())
+      if (mayPointOutside(C, Base.getType()))
+        return true;
+  }
+  for (const clang::FieldDecl *FD : RD->fields())
+    if (mayPointOutside(C, FD->getType()))
+      return true;
+  return false;
+}
+
+///\brief Prints an object in the executor process if its printer might read
+/// the executor's heap, which this process does not see.
+///
+///\param [in] V - The value referring to the object.
+///\param [out] Result - The printed object, or why it is not.
+///\returns false if the object is printed here.
+static bool printInExecutor(const Value &V, std::string &Result) {
+  Interpreter *Interp = V.getInterpreter();
+  if (!Interp->isRunningInExecutorProcess())
+    return false;
+  clang::ASTContext &C = V.getASTContext();
+  clang::QualType Ty = V.getType().getDesugaredType(C).getNonReferenceType();
+  if ((!Ty->isRecordType() && !Ty->isArrayType()) || !mayPointOutside(C, Ty))
+    return false;
+
+  // The object lives in the executor; so must the printer's argument.
+  std::string expr;
+  llvm::raw_string_ostream exprSS(expr);
+  exprSS << "[]{ const void* val = (const void*)" << V.getPtr() << "; "
+         << "return cling::printValue(" << getTypeString(V) << "&val); }()";
+  switch (Interp->evaluateStringInExecutor(exprSS.str(), Result)) {
+  case Interpreter::kExeSuccess:
+    break;
+  case Interpreter::kExeExecutorCrashed:
+    Result = "<printing crashed the executor process>";
+    break;
+  default:
+    Result = "ERROR in cling::executePrintValue(): cannot print in the "
+             "executor process.";
+    break;
+  }
+  return true;
+}
+
 template<typename T>
 static std::string executePrintValue(const Value &V, const T &val) {
+  std::string exeval;
+  if (printInExecutor(V, exeval))
+    return exeval;
+
   // don't use std::stringstream, since it doesn't prepend '0x'
   // in front of hexadecimal values when streaming pointer values
   std::string strval;
@@ -193,11 +258,7 @@ static std::string executePrintValue(const Value &V, const T &val) {
   {
     // We really don't care about protected types here (ROOT-7426)
     AccessCtrlRAII_t AccessCtrlRAII(*Interp);
-    clang::DiagnosticsEngine& Diag = Interp->getCI()->getDiagnostics();
-    bool oldSuppDiags = Diag.getSuppressAllDiagnostics();
-    Diag.setSuppressAllDiagnostics(true);
-    Interp->evaluate(printValueSS.str(), printValueV);
-    Diag.setSuppressAllDiagnostics(oldSuppDiags);
+    Interp->probe(printValueSS.str(), &printValueV);
   }
 
   if (!printValueV.isValid() || printValueV.getPtr() == nullptr) {
@@ -618,13 +679,11 @@ namespace cling {
     }
 
     std::string printValueInternal(const Value &V) {
-      static bool includedRuntimePrintValue = false; // initialized only once as a static function variable
-      // Include "RuntimePrintValue.h" only on the first printing.
-      // This keeps the interpreter lightweight and reduces the startup time.
-      if (!includedRuntimePrintValue) {
-        V.getInterpreter()->declare("#include \"cling/Interpreter/RuntimePrintValue.h\"");
-        includedRuntimePrintValue = true;
-      }
+      utils::Trace::Span S("printValue", "value");
+      // Include "RuntimePrintValue.h" only on the first printing, once per
+      // interpreter. This keeps the interpreter lightweight and reduces the
+      // startup time.
+      V.getInterpreter()->declareRuntimeTier(Interpreter::kRuntimeValuePrinting);
       return printUnpackedClingValue(V);
     }
   } // end namespace valuePrinterInternal
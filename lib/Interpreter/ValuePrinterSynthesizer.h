@@ -49,6 +49,7 @@ public:
 
     virtual ~ValuePrinterSynthesizer();
 
+    const char* getName() const override { return "ValuePrinterSynthesizer"; }
     Result Transform(clang::Decl* D) override;
 
   private:
@@ -0,0 +1,92 @@
+#!/usr/bin/env python
+#------------------------------------------------------------------------------
+# CLING - the C++ LLVM-based InterpreterG :)
+#
+# This file is dual-licensed: you can choose to license it under the University
+# of Illinois Open Source License or the GNU Lesser General Public License. See
+# LICENSE.TXT for details.
+#------------------------------------------------------------------------------
+
+"""Pack header trees into a C++ array that EmbeddedHeaders.cpp serves as an
+in-memory file system.
+
+  embed-headers.py --output FILE [--compress] MOUNT=DIR...
+
+Every regular file below DIR is stored as MOUNT/<path relative to DIR>. Each
+record is "<path>\\0<size>\\0<contents>\\0"; with --compress the whole blob is
+deflated with zlib. The output is only rewritten if it changed, so touching a
+header that does not change the blob does not rebuild libcling.
+"""
+
+import argparse
+import os
+import sys
+import zlib
+
+
+def collect(mounts):
+    records = []
+    for mount in mounts:
+        if '=' not in mount:
+            sys.exit('embed-headers.py: expected MOUNT=DIR, got ' + mount)
+        prefix, root = mount.split('=', 1)
+        if not os.path.isdir(root):
+            sys.exit('embed-headers.py: not a directory: ' + root)
+        for dirpath, dirnames, filenames in os.walk(root):
+            dirnames.sort()
+            for name in sorted(filenames):
+                path = os.path.join(dirpath, name)
+                rel = os.path.relpath(path, root).replace(os.sep, '/')
+                with open(path, 'rb') as f:
+                    records.append((prefix + '/' + rel, f.read()))
+    return records
+
+
+def serialize(records):
+    blob = bytearray()
+    for name, data in records:
+        blob += name.encode('utf-8') + b'\0'
+        blob += str(len(data)).encode('ascii') + b'\0'
+        blob += data + b'\0'
+    return bytes(blob)
+
+
+def render(blob, expanded, compressed):
+    out = ['// Generated by embed-headers.py; do not edit.',
+           'static const unsigned char EmbeddedHeadersBlob[] = {']
+    data = bytearray(blob)
+    for i in range(0, len(data), 16):
+        out.append('  ' + ''.join('%d,' % b for b in data[i:i + 16]))
+    out.append('};')
+    out.append('static const size_t EmbeddedHeadersBlobSize = %d;' % len(blob))
+    out.append('static const size_t EmbeddedHeadersExpandedSize = %d;'
+               % expanded)
+    out.append('static const bool EmbeddedHeadersCompressed = %s;'
+               % ('true' if compressed else 'false'))
+    return '\n'.join(out) + '\n'
+
+
+def main():
+    parser = argparse.ArgumentParser()
+    parser.add_argument('--output', required=True)
+    parser.add_argument('--compress', action='store_true')
+    parser.add_argument('mounts', nargs='+')
+    args = parser.parse_args()
+
+    blob = serialize(collect(args.mounts))
+    expanded = len(blob)
+    if args.compress:
+        blob = zlib.compress(blob, 9)
+    text = render(blob, expanded, args.compress)
+
+    if os.path.exists(args.output):
+        with open(args.output, 'r') as f:
+            if f.read() == text:
+                return 0
+    with open(args.output, 'w') as f:
+        f.write(text)
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
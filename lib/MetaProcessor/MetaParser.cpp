@@ -130,7 +130,10 @@ namespace cling {
       || isfilesCommand() || isClassCommand() || isNamespaceCommand() || isgCommand()
       || isTypedefCommand()
       || isShellCommand(actionResult, resultValue) || isstoreStateCommand()
-      || iscompareStateCommand() || isstatsCommand() || isundoCommand()
+      || iscompareStateCommand() || isstatsCommand() || istraceCommand()
+      || isprofileCommand() || ismemprofCommand()
+      || isundoCommand() || isexportCommand(actionResult)
+      || isperfstatCommand(actionResult, resultValue)
       || isRedirectCommand(actionResult);
   }
 
@@ -176,6 +179,39 @@ namespace cling {
     return result;
   }
 
+  // export := 'export' FilePath
+  // FilePath := AnyString
+  // AnyString := .*^(EOF)
+  bool MetaParser::isexportCommand(MetaSema::ActionResult& actionResult) {
+    bool result = false;
+    if (getCurTok().is(tok::ident) && getCurTok().getIdent().equals("export")) {
+      consumeAnyStringToken(tok::eof);
+      if (getCurTok().is(tok::raw_ident)) {
+        result = true;
+        actionResult = m_Actions->actOnexportCommand(getCurTok().getIdent());
+      }
+    }
+    // TODO: Some fine grained diagnostics
+    return result;
+  }
+
+  // perfstat := 'perfstat' Statement
+  // Statement := AnyString
+  bool MetaParser::isperfstatCommand(MetaSema::ActionResult& actionResult,
+                                     Value* resultValue) {
+    if (getCurTok().is(tok::ident)
+        && getCurTok().getIdent().equals("perfstat")) {
+      consumeAnyStringToken(tok::eof);
+      if (getCurTok().is(tok::raw_ident)) {
+        actionResult = m_Actions->actOnperfstatCommand(getCurTok().getIdent(),
+                                                       resultValue);
+        return true;
+      }
+    }
+    // TODO: Some fine grained diagnostics
+    return false;
+  }
+
   // >RedirectCommand := '>' FilePath
   // FilePath := AnyString
   // AnyString := .*^(' ' | '\t')
@@ -455,6 +491,56 @@ namespace cling {
     return false;
   }
 
+  bool MetaParser::istraceCommand() {
+    if (getCurTok().is(tok::ident) &&
+        getCurTok().getIdent().equals("trace")) {
+      consumeToken();
+      skipWhitespace();
+      if (getCurTok().is(tok::stringlit)) {
+        std::string file = getCurTok().getIdentNoQuotes();
+        consumeToken();
+        m_Actions->actOntraceCommand(file);
+        return true;
+      }
+      MetaSema::SwitchMode mode = MetaSema::kToggle;
+      if (getCurTok().is(tok::constant))
+        mode = (MetaSema::SwitchMode)getCurTok().getConstantAsBool();
+      m_Actions->actOntraceCommand(mode);
+      return true;
+    }
+    return false;
+  }
+
+  bool MetaParser::isprofileCommand() {
+    if (getCurTok().is(tok::ident) &&
+        getCurTok().getIdent().equals("profile")) {
+      consumeToken();
+      skipWhitespace();
+      if (!getCurTok().is(tok::ident))
+        return false; // FIXME: Issue proper diagnostics
+      std::string action = getCurTok().getIdent();
+      consumeToken();
+      m_Actions->actOnprofileCommand(action);
+      return true;
+    }
+    return false;
+  }
+
+  bool MetaParser::ismemprofCommand() {
+    if (getCurTok().is(tok::ident) &&
+        getCurTok().getIdent().equals("memprof")) {
+      consumeToken();
+      skipWhitespace();
+      if (!getCurTok().is(tok::ident))
+        return false; // FIXME: Issue proper diagnostics
+      std::string action = getCurTok().getIdent();
+      consumeToken();
+      m_Actions->actOnmemprofCommand(action);
+      return true;
+    }
+    return false;
+  }
+
   bool MetaParser::isundoCommand() {
     if (getCurTok().is(tok::ident) &&
         getCurTok().getIdent().equals("undo")) {
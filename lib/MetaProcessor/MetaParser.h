@@ -32,7 +32,8 @@ namespace cling {
   //                            PrintDebugCommand | DynamicExtensionsCommand |
   //                            HelpCommand | FileExCommand | FilesCommand |
   //                            ClassCommand | GCommand | StoreStateCommand |
-  //                            CompareStateCommand | StatsCommand | undoCommand
+  //                            CompareStateCommand | StatsCommand | undoCommand |
+  //                            TraceCommand
   //                 LCommand := 'L' FilePath
   //                 TCommand := 'T' FilePath FilePath
   //                 >Command := '>' FilePath
@@ -47,6 +48,7 @@ namespace cling {
   //                 StoreStateCommand := 'storeState' "Ident"
   //                 CompareStateCommand := 'compareState' "Ident"
   //                 StatsCommand := 'stats' ['ast']
+  //                 TraceCommand := 'trace' [Constant | "Ident"]
   //                 undoCommand := 'undo' [Constant]
   //                 DynamicExtensionsCommand := 'dynamicExtensions' [Constant]
   //                 HelpCommand := 'help'
@@ -84,6 +86,9 @@ namespace cling {
                    Value* resultValue);
     bool isLCommand(MetaSema::ActionResult& actionResult);
     bool isTCommand(MetaSema::ActionResult& actionResult);
+    bool isexportCommand(MetaSema::ActionResult& actionResult);
+    bool isperfstatCommand(MetaSema::ActionResult& actionResult,
+                           Value* resultValue);
     bool isRedirectCommand(MetaSema::ActionResult& actionResult);
     bool isExtraArgList();
     bool isXCommand(MetaSema::ActionResult& actionResult,
@@ -99,6 +104,9 @@ namespace cling {
     bool isstoreStateCommand();
     bool iscompareStateCommand();
     bool isstatsCommand();
+    bool istraceCommand();
+    bool isprofileCommand();
+    bool ismemprofCommand();
     bool isundoCommand();
     bool isdynamicExtensionsCommand();
     bool ishelpCommand();
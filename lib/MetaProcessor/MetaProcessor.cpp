@@ -15,6 +15,7 @@
 #include "MetaSema.h"
 #include "cling/Interpreter/Interpreter.h"
 #include "cling/Interpreter/Value.h"
+#include "cling/MetaProcessor/SessionRecorder.h"
 
 #include "clang/Basic/FileManager.h"
 #include "clang/Basic/TargetInfo.h"
@@ -131,6 +132,27 @@ namespace cling {
   int MetaProcessor::process(const char* input_text,
                              Interpreter::CompilationResult& compRes,
                              Value* result) {
+    if (!m_SessionRecorder || !input_text)
+      return processInternal(input_text, compRes, result);
+
+    SessionRecorder::Measurement M(*m_SessionRecorder, input_text);
+    int ret = processInternal(input_text, compRes, result);
+    M.done(ret == -1 ? -1 : (int)compRes);
+    return ret;
+  }
+
+  bool MetaProcessor::recordSession(llvm::StringRef filename) {
+    std::unique_ptr<SessionRecorder> Recorder(new SessionRecorder());
+    if (!Recorder->open(filename))
+      return false;
+    Recorder->attach(m_Interp);
+    m_SessionRecorder = std::move(Recorder);
+    return true;
+  }
+
+  int MetaProcessor::processInternal(const char* input_text,
+                                     Interpreter::CompilationResult& compRes,
+                                     Value* result) {
     if (result)
       *result = Value();
     compRes = Interpreter::kSuccess;
@@ -16,6 +16,7 @@
 #include "cling/Interpreter/Transaction.h"
 #include "cling/Interpreter/Value.h"
 #include "cling/MetaProcessor/MetaProcessor.h"
+#include "cling/Utils/Trace.h"
 
 #include "../lib/Interpreter/IncrementalParser.h"
 
@@ -71,6 +72,20 @@ namespace cling {
     return AR_Success;
   }
 
+  MetaSema::ActionResult MetaSema::actOnexportCommand(llvm::StringRef file) {
+    if (m_Interpreter.exportSession(file) == Interpreter::kSuccess)
+      return AR_Success;
+    return AR_Failure;
+  }
+
+  MetaSema::ActionResult
+  MetaSema::actOnperfstatCommand(llvm::StringRef statement, Value* result) {
+    if (m_Interpreter.perfstat(statement, m_MetaProcessor.getOuts(), result)
+        == Interpreter::kSuccess)
+      return AR_Success;
+    return AR_Failure;
+  }
+
   MetaSema::ActionResult MetaSema::actOnRedirectCommand(llvm::StringRef file,
                          MetaProcessor::RedirectionScope stream,
                          bool append) {
@@ -154,17 +169,7 @@ namespace cling {
         // Search for the transaction, i.e. verify that is has not already
         // been unloaded ; This can be removed once all transaction unload
         // properly information MetaSema that it has been unloaded.
-        bool found = false;
-        //for (auto t : m_Interpreter.m_IncrParser->getAllTransactions()) {
-        for(const Transaction *t = m_Interpreter.getFirstTransaction();
-            t != 0; t = t->getNext()) {
-           //fprintf(stderr,"DEBUG: On unload check For %s unloadPoint is %p are t == %p\n",file.str().c_str(),unloadPoint, t);
-          if (t == unloadPoint ) {
-            found = true;
-            break;
-          }
-        }
-        if (!found) {
+        if (!m_Interpreter.isCommitted(unloadPoint)) {
           m_MetaProcessor.getOuts() << "!!!ERROR: Transaction for file: " << file << " has already been unloaded\n";
         } else {
            //fprintf(stderr,"DEBUG: On Unload For %s unloadPoint is %p\n",file.str().c_str(),unloadPoint);
@@ -211,7 +216,12 @@ namespace cling {
 
   void MetaSema::actOndebugCommand(llvm::Optional<int> mode) const {
     clang::CodeGenOptions& CGO = m_Interpreter.getCI()->getCodeGenOpts();
-    if (!mode) {
+    if (!mode && m_Interpreter.hasLazyDebugInfo()) {
+      m_MetaProcessor.getOuts() << "Generated the debug info of "
+                                << m_Interpreter.loadDebugInfo()
+                                << " functions\n";
+    }
+    else if (!mode) {
       bool flag = CGO.getDebugInfo() == clang::codegenoptions::NoDebugInfo;
       if (flag)
         CGO.setDebugInfo(clang::codegenoptions::LimitedDebugInfo);
@@ -267,6 +277,71 @@ namespace cling {
     if (name.equals("ast")) {
       m_Interpreter.getCI()->getSema().getASTContext().PrintStats();
     }
+    else if (name.equals("transactions")) {
+      m_Interpreter.printTransactionStats(m_MetaProcessor.getOuts());
+    }
+    else if (name.equals("statcache")) {
+      m_Interpreter.printStatCacheStats(m_MetaProcessor.getOuts());
+    }
+    else if (name.equals("jitcache")) {
+      m_Interpreter.printJITCacheStats(m_MetaProcessor.getOuts());
+    }
+    else if (name.equals("lazycodegen")) {
+      m_Interpreter.printLazyCodeGenStats(m_MetaProcessor.getOuts());
+    }
+    else if (name.equals("prefetch")) {
+      m_Interpreter.printPrefetchStats(m_MetaProcessor.getOuts());
+    }
+  }
+
+  void MetaSema::actOntraceCommand(SwitchMode mode/* = kToggle*/) const {
+    if (mode == kToggle) {
+      bool flag = !utils::Trace::isEnabled();
+      utils::Trace::setEnabled(flag);
+      m_MetaProcessor.getOuts() << (flag ? "T" : "Not t") << "racing\n";
+    }
+    else
+      utils::Trace::setEnabled(mode);
+  }
+
+  void MetaSema::actOntraceCommand(llvm::StringRef file) const {
+    if (!utils::Trace::writeChromeTrace(file))
+      m_MetaProcessor.getOuts() << "!!!ERROR: Cannot write trace to file: "
+                                << file << "\n";
+  }
+
+  void MetaSema::actOnprofileCommand(llvm::StringRef action) const {
+    llvm::raw_ostream& Outs = m_MetaProcessor.getOuts();
+    if (action.equals("start")) {
+      if (!m_Interpreter.startProfiling())
+        Outs << "!!!ERROR: Cannot start profiling\n";
+    }
+    else if (action.equals("stop")) {
+      if (!m_Interpreter.stopProfiling())
+        Outs << "!!!ERROR: Not profiling\n";
+    }
+    else if (action.equals("report")) {
+      m_Interpreter.printProfile(Outs);
+    }
+    else
+      Outs << "!!!ERROR: Unknown profile action: " << action << "\n";
+  }
+
+  void MetaSema::actOnmemprofCommand(llvm::StringRef action) const {
+    llvm::raw_ostream& Outs = m_MetaProcessor.getOuts();
+    if (action.equals("start")) {
+      if (!m_Interpreter.startMemoryProfiling())
+        Outs << "!!!ERROR: Cannot start memory profiling\n";
+    }
+    else if (action.equals("stop")) {
+      if (!m_Interpreter.stopMemoryProfiling())
+        Outs << "!!!ERROR: Not profiling memory\n";
+    }
+    else if (action.equals("report")) {
+      m_Interpreter.printMemoryProfile(Outs);
+    }
+    else
+      Outs << "!!!ERROR: Unknown memprof action: " << action << "\n";
   }
 
   void MetaSema::actOndynamicExtensionsCommand(SwitchMode mode/* = kToggle*/)
@@ -332,13 +407,41 @@ namespace cling {
       "   " << metaString << "printDebug [0|1]\t\t- Toggles the printing of input's corresponding"
                              "\n\t\t\t\t  state changes\n"
       "\n"
+      "   " << metaString << "debug [level]\t\t- Sets or toggles the debug info of the code"
+                             "\n\t\t\t\t  compiled from then on; with"
+                             "\n\t\t\t\t  --lazy-debug-info and no level, generates"
+                             "\n\t\t\t\t  it for the code compiled so far\n"
+      "\n"
       "   " << metaString << "storeState <filename>\t- Store the interpreter's state to a given file\n"
       "\n"
       "   " << metaString << "compareState <filename>\t- Compare the interpreter's state with the one"
                              "\n\t\t\t\t  saved in a given file\n"
       "\n"
       "   " << metaString << "stats [name]\t\t- Show stats for various internal data"
-                             "\n\t\t\t\t  structures (only 'ast' for the time being)\n"
+                             "\n\t\t\t\t  structures ('ast', 'transactions',"
+                             "\n\t\t\t\t  'statcache', 'jitcache',"
+                             "\n\t\t\t\t  'lazycodegen' or 'prefetch')\n"
+      "\n"
+      "   " << metaString << "trace [0|1]\t\t\t- Toggles recording the timeline of the"
+                             "\n\t\t\t\t  interpreter\n"
+      "\n"
+      "   " << metaString << "trace <filename>\t\t- Writes the recorded timeline as Chrome"
+                             "\n\t\t\t\t  trace to a given file\n"
+      "\n"
+      "   " << metaString << "export <filename>\t\t- Compiles the session's declarations"
+                             "\n\t\t\t\t  into a shared library, with a header\n"
+      "\n"
+      "   " << metaString << "profile (start|stop|report)\t- Samples where the executed code"
+                             "\n\t\t\t\t  spends its time and reports the hot"
+                             "\n\t\t\t\t  functions and lines\n"
+      "\n"
+      "   " << metaString << "memprof (start|stop|report)\t- Records the allocations of the code"
+                             "\n\t\t\t\t  compiled from then on and reports the"
+                             "\n\t\t\t\t  top allocators and what is still allocated\n"
+      "\n"
+      "   " << metaString << "perfstat <statement>\t- Runs a statement, reporting the time"
+                             "\n\t\t\t\t  and hardware events of its compilation"
+                             "\n\t\t\t\t  and execution\n"
       "\n"
       "   " << metaString << "help\t\t\t- Shows this information\n"
       "\n"
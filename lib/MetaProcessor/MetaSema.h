@@ -75,6 +75,22 @@ namespace cling {
     ActionResult actOnTCommand(llvm::StringRef inputFile,
                                llvm::StringRef outputFile);
 
+    ///\brief export command compiles the session into a shared library.
+    ///
+    ///\param[in] file - The library to write; its header and autoload
+    ///   declarations are written next to it.
+    ///
+    ActionResult actOnexportCommand(llvm::StringRef file);
+
+    ///\brief perfstat command processes a statement and reports the time
+    /// and the hardware events of its compilation and execution.
+    ///
+    ///\param[in] statement - The statement to measure.
+    ///\param[out] result - The value of the statement.
+    ///
+    ActionResult actOnperfstatCommand(llvm::StringRef statement,
+                                      Value* result);
+
     ///\brief < Redirect command.
     ///
     ///\param[in] file - The file where the output is redirected
@@ -142,7 +158,8 @@ namespace cling {
     ///
     void actOnrawInputCommand(SwitchMode mode = kToggle) const;
 
-    ///\brief Generates debug info for the JIT.
+    ///\brief Generates debug info for the JIT. Without mode and with lazy
+    /// debug info, generates it for the code compiled so far.
     ///
     ///\param[in] mode - either on/off or toggle.
     ///
@@ -172,6 +189,32 @@ namespace cling {
     ///
     void actOnstatsCommand(llvm::StringRef name) const;
 
+    ///\brief Starts or stops recording the timeline of the interpreter.
+    ///
+    ///\param[in] mode - either on/off or toggle.
+    ///
+    void actOntraceCommand(SwitchMode mode = kToggle) const;
+
+    ///\brief Writes the recorded timeline as Chrome trace.
+    ///
+    ///\param[in] file - Name of the file to write to.
+    ///
+    void actOntraceCommand(llvm::StringRef file) const;
+
+    ///\brief Starts or stops sampling the executed code, or reports where
+    /// the samples were taken.
+    ///
+    ///\param[in] action - One of start, stop and report.
+    ///
+    void actOnprofileCommand(llvm::StringRef action) const;
+
+    ///\brief Starts or stops recording the allocations of the code compiled
+    /// from then on, or reports where the memory was allocated.
+    ///
+    ///\param[in] action - One of start, stop and report.
+    ///
+    void actOnmemprofCommand(llvm::StringRef action) const;
+
     ///\brief Switches on/off the experimental dynamic extensions (dynamic
     /// scopes) and late binding.
     ///
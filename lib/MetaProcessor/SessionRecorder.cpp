@@ -0,0 +1,338 @@
+//------------------------------------------------------------------------------
+// CLING - the C++ LLVM-based InterpreterG :)
+//
+// This file is dual-licensed: you can choose to license it under the University
+// of Illinois Open Source License or the GNU Lesser General Public License. See
+// LICENSE.TXT for details.
+//------------------------------------------------------------------------------
+
+#include "cling/MetaProcessor/SessionRecorder.h"
+
+#include "cling/Interpreter/Interpreter.h"
+#include "cling/Interpreter/InterpreterCallbacks.h"
+#include "cling/Interpreter/Value.h"
+#include "cling/MetaProcessor/MetaProcessor.h"
+
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/Format.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/raw_ostream.h"
+
+#if defined(LLVM_ON_UNIX)
+#include <sys/resource.h>
+#endif
+
+namespace {
+  static unsigned long long toMicroseconds(double Seconds) {
+    return (unsigned long long)(Seconds * 1e6);
+  }
+
+  ///\brief Returns the peak resident set size of the process in kB, or -1.
+  ///
+  static long getMaxRSS() {
+#if defined(LLVM_ON_UNIX)
+    struct rusage Usage;
+    if (!getrusage(RUSAGE_SELF, &Usage))
+#ifdef __APPLE__
+      return Usage.ru_maxrss / 1024; // In bytes.
+#else
+      return Usage.ru_maxrss;
+#endif
+#endif
+    return -1;
+  }
+
+  static void escape(llvm::raw_ostream& Out, llvm::StringRef Str) {
+    for (char C : Str) {
+      switch (C) {
+      case '\\': Out << "\\\\"; break;
+      case '\n': Out << "\\n"; break;
+      case '\r': Out << "\\r"; break;
+      default: Out << C;
+      }
+    }
+  }
+
+  static std::string unescape(llvm::StringRef Str) {
+    std::string Result;
+    Result.reserve(Str.size());
+    for (size_t I = 0, N = Str.size(); I < N; ++I) {
+      if (Str[I] != '\\' || I + 1 == N) {
+        Result += Str[I];
+        continue;
+      }
+      switch (Str[++I]) {
+      case 'n': Result += '\n'; break;
+      case 'r': Result += '\r'; break;
+      default: Result += Str[I];
+      }
+    }
+    return Result;
+  }
+
+  ///\brief Splits off the next space separated field of Line.
+  static llvm::StringRef nextField(llvm::StringRef& Line) {
+    std::pair<llvm::StringRef, llvm::StringRef> Split = Line.split(' ');
+    Line = Split.second;
+    return Split.first;
+  }
+
+  static bool parseEntry(llvm::StringRef Line,
+                         cling::SessionRecorder::Entry& E) {
+    if (nextField(Line).getAsInteger(10, E.Start)
+        || nextField(Line).getAsInteger(10, E.Wall)
+        || nextField(Line).getAsInteger(10, E.CPU)
+        || nextField(Line).getAsInteger(10, E.MaxRSS)
+        || nextField(Line).getAsInteger(10, E.Result))
+      return false;
+    llvm::StringRef Phases = nextField(Line);
+    if (Phases != "-") {
+      llvm::SmallVector<llvm::StringRef, 8> Items;
+      Phases.split(Items, ',');
+      for (llvm::StringRef Item : Items) {
+        std::pair<llvm::StringRef, llvm::StringRef> NameVal = Item.split('=');
+        unsigned long long Duration;
+        if (NameVal.second.getAsInteger(10, Duration))
+          return false;
+        E.Phases.push_back(std::make_pair(NameVal.first.str(), Duration));
+      }
+    }
+    llvm::StringRef Origin = nextField(Line);
+    E.Nested = Origin.startswith("+");
+    E.Origin = Origin.ltrim("+");
+    if (E.Origin.empty())
+      return false;
+    E.Input = unescape(Line);
+    return true;
+  }
+} // unnamed namespace
+
+namespace cling {
+
+  ///\brief Measures the inputs passed to the Interpreter.
+  ///
+  class SessionRecorder::Callbacks: public InterpreterCallbacks {
+    SessionRecorder* m_Recorder;
+  public:
+    Callbacks(Interpreter* Interp, SessionRecorder& Recorder):
+      InterpreterCallbacks(Interp), m_Recorder(&Recorder) {}
+
+    ///\brief Stops measuring, the recorder is gone.
+    ///
+    void detach() { m_Recorder = 0; }
+
+    void InputStarted(llvm::StringRef Function,
+                      llvm::StringRef Input) override {
+      if (!m_Recorder)
+        return;
+      std::vector<std::unique_ptr<Measurement>>& Inputs
+        = m_Recorder->m_APIInputs;
+      // The prompt input's own cost.
+      if (m_Recorder->m_InPrompt && Inputs.empty())
+        Inputs.emplace_back(nullptr);
+      else
+        Inputs.emplace_back(new Measurement(*m_Recorder, Input, Function));
+    }
+
+    void InputFinished(int Result) override {
+      if (!m_Recorder || m_Recorder->m_APIInputs.empty())
+        return;
+      if (Measurement* M = m_Recorder->m_APIInputs.back().get())
+        M->done(Result);
+      m_Recorder->m_APIInputs.pop_back();
+    }
+  };
+
+  SessionRecorder::Measurement::Measurement(SessionRecorder& Recorder,
+                                            llvm::StringRef Input,
+                                            llvm::StringRef Origin):
+    m_Recorder(Recorder), m_Input(Input.str()), m_Origin(Origin.str()),
+    m_Nested(Recorder.m_Depth++ != 0),
+    m_Begin(llvm::TimeRecord::getCurrentTime(/*Start*/ true)),
+    m_BeginMaxRSS(getMaxRSS()) {
+    if (m_Origin == "prompt")
+      Recorder.m_InPrompt = true;
+  }
+
+  void SessionRecorder::Measurement::done(int Result) {
+    llvm::TimeRecord Elapsed
+      = llvm::TimeRecord::getCurrentTime(/*Start*/ false);
+    Elapsed -= m_Begin;
+
+    Entry E;
+    E.Start = toMicroseconds(m_Begin.getWallTime()
+                             - m_Recorder.m_Origin.getWallTime());
+    E.Wall = toMicroseconds(Elapsed.getWallTime());
+    E.CPU = toMicroseconds(Elapsed.getProcessTime());
+    const long MaxRSS = getMaxRSS();
+    if (MaxRSS >= 0 && m_BeginMaxRSS >= 0)
+      E.MaxRSS = MaxRSS - m_BeginMaxRSS;
+    E.Result = Result;
+    for (const auto& Phase : m_Phases.getDurations())
+      E.Phases.push_back(std::make_pair(Phase.getKey().str(),
+                                        Phase.getValue()));
+    E.Origin.swap(m_Origin);
+    E.Nested = m_Nested;
+    E.Input.swap(m_Input);
+    --m_Recorder.m_Depth;
+    if (E.Origin == "prompt")
+      m_Recorder.m_InPrompt = false;
+    m_Recorder.record(E);
+  }
+
+  SessionRecorder::SessionRecorder():
+    m_Origin(llvm::TimeRecord::getCurrentTime()), m_Depth(0),
+    m_InPrompt(false), m_Callbacks(0) {}
+
+  SessionRecorder::~SessionRecorder() {
+    if (m_Callbacks)
+      m_Callbacks->detach();
+  }
+
+  void SessionRecorder::attach(Interpreter& Interp) {
+    if (m_Callbacks)
+      return;
+    std::unique_ptr<Callbacks> CB(new Callbacks(&Interp, *this));
+    m_Callbacks = CB.get();
+    Interp.setCallbacks(std::move(CB));
+  }
+
+  bool SessionRecorder::open(llvm::StringRef FileName) {
+    std::error_code EC;
+    std::unique_ptr<llvm::raw_fd_ostream>
+      Out(new llvm::raw_fd_ostream(FileName, EC, llvm::sys::fs::F_Text));
+    if (EC)
+      return false;
+    m_Out = std::move(Out);
+    m_Origin = llvm::TimeRecord::getCurrentTime();
+    return true;
+  }
+
+  void SessionRecorder::record(const Entry& E) {
+    if (!m_Out)
+      return;
+    print(*m_Out, E);
+    // Keep the log usable if the session crashes.
+    m_Out->flush();
+  }
+
+  void SessionRecorder::print(llvm::raw_ostream& Out, const Entry& E) {
+    Out << E.Start << ' ' << E.Wall << ' ' << E.CPU << ' ' << E.MaxRSS << ' '
+        << E.Result << ' ';
+    if (E.Phases.empty())
+      Out << '-';
+    for (size_t I = 0, N = E.Phases.size(); I < N; ++I) {
+      if (I)
+        Out << ',';
+      // Span names must not contain the separators.
+      Out << E.Phases[I].first << '=' << E.Phases[I].second;
+    }
+    Out << ' ' << (E.Nested ? "+" : "") << E.Origin << ' ';
+    escape(Out, E.Input);
+    Out << '\n';
+  }
+
+  bool SessionRecorder::read(llvm::StringRef FileName,
+                             std::vector<Entry>& Entries) {
+    llvm::ErrorOr<std::unique_ptr<llvm::MemoryBuffer>> Buffer
+      = llvm::MemoryBuffer::getFile(FileName);
+    if (!Buffer)
+      return false;
+
+    llvm::SmallVector<llvm::StringRef, 64> Lines;
+    (*Buffer)->getBuffer().split(Lines, '\n', /*MaxSplit*/ -1,
+                                 /*KeepEmpty*/ false);
+    for (llvm::StringRef Line : Lines) {
+      Entry E;
+      if (!parseEntry(Line, E))
+        return false;
+      Entries.push_back(E);
+    }
+    return true;
+  }
+
+  bool SessionRecorder::replayInput(MetaProcessor& MP, const Entry& E,
+                                    int& Result) {
+    if (E.Origin == "prompt") {
+      Interpreter::CompilationResult CompRes;
+      Result = MP.process(E.Input.c_str(), CompRes, 0);
+      if (Result != -1)
+        Result = CompRes;
+      return true;
+    }
+    Interpreter& Interp = MP.getInterpreter();
+    if (E.Origin == "declare")
+      Result = Interp.declare(E.Input);
+    else if (E.Origin == "process")
+      Result = Interp.process(E.Input);
+    else if (E.Origin == "evaluate") {
+      Value V;
+      Result = Interp.evaluate(E.Input, V);
+    }
+    else if (E.Origin == "echo")
+      Result = Interp.echo(E.Input);
+    else if (E.Origin == "execute")
+      Result = Interp.execute(E.Input);
+    else
+      return false;
+    return true;
+  }
+
+  bool SessionRecorder::replay(MetaProcessor& MP, llvm::StringRef FileName,
+                               llvm::raw_ostream& Report) {
+    std::vector<Entry> Entries;
+    if (!read(FileName, Entries)) {
+      Report << "cling: cannot read session log '" << FileName << "'\n";
+      return false;
+    }
+
+    bool Success = true;
+    double OldTotal = 0, NewTotal = 0;
+    for (size_t I = 0, N = Entries.size(); I < N; ++I) {
+      const Entry& Old = Entries[I];
+      // The enclosing input runs it again.
+      if (Old.Nested)
+        continue;
+      const long BeginMaxRSS = getMaxRSS();
+      llvm::TimeRecord Begin = llvm::TimeRecord::getCurrentTime(true);
+      int Result;
+      if (!replayInput(MP, Old, Result)) {
+        Report << "cling: unknown origin '" << Old.Origin << "' of input #"
+               << I + 1 << '\n';
+        return false;
+      }
+      llvm::TimeRecord Elapsed = llvm::TimeRecord::getCurrentTime(false);
+      Elapsed -= Begin;
+      const long MaxRSS = getMaxRSS();
+      const long long NewMaxRSS
+        = MaxRSS >= 0 && BeginMaxRSS >= 0 ? MaxRSS - BeginMaxRSS : -1;
+
+      const double OldWall = Old.Wall / 1e3;
+      const double NewWall = Elapsed.getWallTime() * 1e3;
+      OldTotal += OldWall;
+      NewTotal += NewWall;
+      const bool Mismatch = Result != Old.Result;
+      Success &= !Mismatch;
+
+      Report << llvm::format("#%-5u %10.3fms -> %10.3fms", (unsigned)I + 1,
+                             OldWall, NewWall);
+      if (OldWall > 0)
+        Report << llvm::format(" (%6.2fx)", NewWall / OldWall);
+      else
+        Report << "          ";
+      Report << llvm::format(" rss %8lldkB -> %8lldkB ", Old.MaxRSS,
+                             NewMaxRSS);
+      Report << (Mismatch ? "! " : "  ");
+      escape(Report, llvm::StringRef(Old.Input).substr(0, 40));
+      Report << '\n';
+
+      if (Result == -1)
+        break;
+    }
+    Report << llvm::format("total  %10.3fms -> %10.3fms\n", OldTotal,
+                           NewTotal);
+    return Success;
+  }
+
+} // namespace cling
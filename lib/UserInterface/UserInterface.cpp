@@ -136,6 +136,8 @@ namespace cling {
       }
       catch(InvalidDerefException& e) {
         e.diagnose();
+        // Whoever debugs the code next needs its line tables.
+        m_MetaProcessor->getInterpreter().loadDebugInfo();
       }
       catch(InterpreterException& e) {
         llvm::errs() << ">>> Caught an interpreter exception!\n"
@@ -144,9 +146,11 @@ namespace cling {
       catch(std::exception& e) {
         llvm::errs() << ">>> Caught a std::exception!\n"
                      << ">>> " << e.what() << '\n';
+        m_MetaProcessor->getInterpreter().loadDebugInfo();
       }
       catch(...) {
         llvm::errs() << "Exception occurred. Recovering...\n";
+        m_MetaProcessor->getInterpreter().loadDebugInfo();
       }
     }
   }
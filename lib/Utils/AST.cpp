@@ -11,6 +11,7 @@
 
 #include "clang/AST/ASTContext.h"
 #include "clang/AST/DeclarationName.h"
+#include "clang/AST/ExprCXX.h"
 #include "clang/AST/GlobalDecl.h"
 #include "clang/Sema/Sema.h"
 #include "clang/Sema/Lookup.h"
@@ -184,6 +185,57 @@ namespace utils {
     return Result;
   }
 
+  FunctionDecl* Synthesize::DestructorThunk(Sema* S, CXXRecordDecl* RD,
+                                            llvm::StringRef Name) {
+    ASTContext& Ctx = S->getASTContext();
+    if (RD->isInvalidDecl() || !RD->hasDefinition())
+      return 0;
+    CXXDestructorDecl* Dtor = S->LookupDestructor(RD);
+    if (!Dtor || Dtor->isDeleted())
+      return 0;
+
+    SourceLocation Loc;
+    QualType VoidPtrTy = Ctx.VoidPtrTy;
+    QualType FnTy = Ctx.getFunctionType(Ctx.VoidTy, VoidPtrTy,
+                                        FunctionProtoType::ExtProtoInfo());
+    // extern "C", such that the symbol is the plain name.
+    LinkageSpecDecl* ExternC
+      = LinkageSpecDecl::Create(Ctx, Ctx.getTranslationUnitDecl(), Loc, Loc,
+                                LinkageSpecDecl::lang_c, /*HasBraces*/false);
+    FunctionDecl* FD
+      = FunctionDecl::Create(Ctx, ExternC, Loc, Loc,
+                             DeclarationName(&Ctx.Idents.get(Name)), FnTy,
+                             Ctx.getTrivialTypeSourceInfo(FnTy, Loc),
+                             SC_None);
+    ParmVarDecl* Obj
+      = ParmVarDecl::Create(Ctx, FD, Loc, Loc, &Ctx.Idents.get("obj"),
+                            VoidPtrTy, Ctx.getTrivialTypeSourceInfo(VoidPtrTy,
+                                                                    Loc),
+                            SC_None, /*DefaultArg*/0);
+    FD->setParams(Obj);
+
+    // ((RD*)obj)->~RD(); access control does not apply to synthesized code.
+    Expr* ObjRef = new (Ctx) DeclRefExpr(Obj, /*RefersToEnclosing*/false,
+                                         VoidPtrTy, VK_LValue, Loc);
+    Expr* This = CStyleCastPtrExpr(S, Ctx.getRecordType(RD), ObjRef);
+    MemberExpr* ME
+      = new (Ctx) MemberExpr(This, /*isArrow*/true, Loc, Dtor,
+                             DeclarationNameInfo(Dtor->getDeclName(), Loc),
+                             Ctx.BoundMemberTy, VK_RValue, OK_Ordinary);
+    Stmt* Body[] = {
+      new (Ctx) CXXMemberCallExpr(Ctx, ME, llvm::None, Ctx.VoidTy, VK_RValue,
+                                  Loc)
+    };
+    FD->setBody(new (Ctx) CompoundStmt(Ctx, Body, Loc, Loc));
+
+    // Make sure the destructor (implicit or a template member) gets defined;
+    // the caller performs the pending instantiations.
+    S->MarkFunctionReferenced(Loc, Dtor);
+    ExternC->addDecl(FD);
+    Ctx.getTranslationUnitDecl()->addDecl(ExternC);
+    return FD;
+  }
+
   static bool
   GetFullyQualifiedTemplateName(const ASTContext& Ctx, TemplateName &tname) {
 
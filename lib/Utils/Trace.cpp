@@ -0,0 +1,218 @@
+//------------------------------------------------------------------------------
+// CLING - the C++ LLVM-based InterpreterG :)
+//
+// This file is dual-licensed: you can choose to license it under the University
+// of Illinois Open Source License or the GNU Lesser General Public License. See
+// LICENSE.TXT for details.
+//------------------------------------------------------------------------------
+
+#include "cling/Utils/Trace.h"
+
+#include "llvm/Support/Compiler.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/Format.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include <chrono>
+#include <cstdlib>
+
+namespace {
+  ///\brief Maximal length of the detail text kept for a span.
+  enum { kMaxDetailLength = 80 };
+
+  struct Event {
+    const char* Name;
+    const char* Category;
+    unsigned long long Start;
+    unsigned long long Duration;
+    unsigned TransactionID;
+    std::string Detail;
+  };
+
+  ///\brief A block of events, filled by the owning thread only. Readers see
+  /// the first Size events, which are never modified once published.
+  struct Chunk {
+    enum { kNumEvents = 256 };
+    Event Events[kNumEvents];
+    std::atomic<unsigned> Size;
+    std::atomic<Chunk*> Next;
+    Chunk(): Size(0), Next(nullptr) {}
+  };
+
+  struct ThreadBuffer {
+    unsigned TID;
+    Chunk* First;
+    Chunk* Last;
+    ThreadBuffer* Next;
+  };
+
+  ///\brief All thread buffers ever created; they are never freed, a thread
+  /// might have finished while its events are still to be written.
+  static std::atomic<ThreadBuffer*> gBuffers(nullptr);
+  static std::atomic<unsigned> gNumThreads(0);
+  static LLVM_THREAD_LOCAL ThreadBuffer* gThreadBuffer = nullptr;
+  static LLVM_THREAD_LOCAL cling::utils::Trace::Summary* gSummary = nullptr;
+
+  ///\brief Whether spans go into the Chrome trace buffers.
+  static std::atomic<bool> gRecording(false);
+
+  static ThreadBuffer& getThreadBuffer() {
+    if (!gThreadBuffer) {
+      ThreadBuffer* TB = new ThreadBuffer();
+      TB->TID = ++gNumThreads;
+      TB->First = TB->Last = new Chunk();
+      TB->Next = gBuffers.load();
+      while (!gBuffers.compare_exchange_weak(TB->Next, TB))
+        ;
+      gThreadBuffer = TB;
+    }
+    return *gThreadBuffer;
+  }
+
+  static unsigned long long getMicroseconds() {
+    using namespace std::chrono;
+    static const steady_clock::time_point Origin = steady_clock::now();
+    return duration_cast<microseconds>(steady_clock::now() - Origin).count();
+  }
+
+  static std::string& getOutputFileName() {
+    static std::string FileName;
+    return FileName;
+  }
+} // unnamed namespace
+
+namespace cling {
+namespace utils {
+namespace Trace {
+  namespace internal {
+    std::atomic<unsigned> gNumConsumers(0);
+  }
+
+  bool isEnabled() {
+    return gRecording.load();
+  }
+
+  void setEnabled(bool Enabled) {
+    if (gRecording.exchange(Enabled) == Enabled)
+      return;
+    if (Enabled)
+      ++internal::gNumConsumers;
+    else
+      --internal::gNumConsumers;
+  }
+
+  void initFromEnvironment() {
+    const char* FileName = ::getenv("CLING_TRACE");
+    if (!FileName || !FileName[0])
+      return;
+    getOutputFileName() = FileName;
+    setEnabled(true);
+  }
+
+  void writeOutputFile() {
+    const std::string& FileName = getOutputFileName();
+    if (!FileName.empty() && !writeChromeTrace(FileName))
+      llvm::errs() << "cling::utils::Trace: cannot write '" << FileName
+                   << "'\n";
+  }
+
+  void printJSONString(llvm::raw_ostream& Out, llvm::StringRef Str) {
+    Out << '"';
+    for (char C : Str) {
+      switch (C) {
+      case '"': Out << "\\\""; break;
+      case '\\': Out << "\\\\"; break;
+      case '\n': Out << "\\n"; break;
+      case '\t': Out << "\\t"; break;
+      default:
+        if ((unsigned char)C < 0x20)
+          Out << llvm::format("\\u%04x", (unsigned)C);
+        else
+          Out << C;
+      }
+    }
+    Out << '"';
+  }
+
+  void writeChromeTrace(llvm::raw_ostream& Out) {
+    Out << "{\"traceEvents\": [\n";
+    bool First = true;
+    for (ThreadBuffer* TB = gBuffers.load(); TB; TB = TB->Next) {
+      for (Chunk* C = TB->First; C; C = C->Next.load()) {
+        for (unsigned I = 0, N = C->Size.load(); I < N; ++I) {
+          const Event& E = C->Events[I];
+          if (!First)
+            Out << ",\n";
+          First = false;
+          Out << "  {\"name\": ";
+          printJSONString(Out, E.Name);
+          Out << ", \"cat\": ";
+          printJSONString(Out, E.Category);
+          Out << ", \"ph\": \"X\", \"pid\": 1, \"tid\": " << TB->TID
+              << ", \"ts\": " << E.Start << ", \"dur\": " << E.Duration
+              << ", \"args\": {\"transaction\": " << E.TransactionID;
+          if (!E.Detail.empty()) {
+            Out << ", \"detail\": ";
+            printJSONString(Out, E.Detail);
+          }
+          Out << "}}";
+        }
+      }
+    }
+    Out << "\n], \"displayTimeUnit\": \"ms\"}\n";
+  }
+
+  bool writeChromeTrace(llvm::StringRef FileName) {
+    std::error_code EC;
+    llvm::raw_fd_ostream Out(FileName, EC, llvm::sys::fs::F_Text);
+    if (EC)
+      return false;
+    writeChromeTrace(Out);
+    return true;
+  }
+
+  void Span::begin(llvm::StringRef Detail) {
+    m_Recording = true;
+    if (!Detail.empty())
+      m_Detail = Detail.substr(0, kMaxDetailLength).str();
+    m_Start = getMicroseconds();
+  }
+
+  void Span::end() {
+    unsigned long long End = getMicroseconds();
+    if (gSummary)
+      gSummary->add(m_Name, End - m_Start);
+    if (!gRecording.load(std::memory_order_relaxed))
+      return;
+
+    ThreadBuffer& TB = getThreadBuffer();
+    unsigned Size = TB.Last->Size.load(std::memory_order_relaxed);
+    if (Size == Chunk::kNumEvents) {
+      Chunk* C = new Chunk();
+      TB.Last->Next.store(C);
+      TB.Last = C;
+      Size = 0;
+    }
+    Event& E = TB.Last->Events[Size];
+    E.Name = m_Name;
+    E.Category = m_Category;
+    E.Start = m_Start;
+    E.Duration = End - m_Start;
+    E.TransactionID = m_TransactionID;
+    E.Detail.swap(m_Detail);
+    // Publish the event to writeChromeTrace().
+    TB.Last->Size.store(Size + 1, std::memory_order_release);
+  }
+
+  Summary::Summary(): m_Prev(gSummary) {
+    gSummary = this;
+    ++internal::gNumConsumers;
+  }
+
+  Summary::~Summary() {
+    gSummary = m_Prev;
+    --internal::gNumConsumers;
+  }
+} // end namespace Trace
+} // end namespace utils
+} // end namespace cling
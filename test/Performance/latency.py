@@ -0,0 +1,72 @@
+#!/usr/bin/env python
+#------------------------------------------------------------------------------
+# CLING - the C++ LLVM-based InterpreterG :)
+#
+# This file is dual-licensed: you can choose to license it under the University
+# of Illinois Open Source License or the GNU Lesser General Public License. See
+# LICENSE.TXT for details.
+#------------------------------------------------------------------------------
+
+"""Compare the per-call latency of running input lines in-process and in the
+executor process.
+
+  latency.py --calls N --input FILE --empty FILE -- COMMAND...
+
+FILE holds N calls; the empty input is the same session without them, and its
+time is subtracted as the startup cost. Each input is run with COMMAND and
+with COMMAND --executor-process, and the time per call is printed as
+
+  in-process: <us> us per call
+  executor process: <us> us per call (<ratio>x)
+"""
+
+import argparse
+import os
+import subprocess
+import sys
+import time
+
+
+def timeRun(command, inputPath):
+    with open(inputPath) as f, open(os.devnull, 'w') as out:
+        start = time.time()
+        status = subprocess.call(command, stdin=f, stdout=out)
+        wall = time.time() - start
+    if status != 0:
+        sys.stderr.write('%s failed with status %d\n'
+                         % (' '.join(command), status))
+        sys.exit(status)
+    return wall
+
+
+def perCall(command, args):
+    # Subtract the session without the calls: startup, parsing the runtime
+    # and shutting down.
+    wall = timeRun(command, args.input) - timeRun(command, args.empty)
+    return max(wall, 0.0) * 1e6 / args.calls
+
+
+def main():
+    parser = argparse.ArgumentParser()
+    parser.add_argument('--calls', type=int, required=True)
+    parser.add_argument('--input', required=True)
+    parser.add_argument('--empty', required=True)
+    parser.add_argument('command', nargs=argparse.REMAINDER)
+    args = parser.parse_args()
+
+    command = args.command
+    if command and command[0] == '--':
+        command = command[1:]
+    if not command or args.calls <= 0:
+        parser.error('no command or calls given')
+
+    inProcess = perCall(command, args)
+    executor = perCall(command + ['--executor-process'], args)
+    print('in-process: %.1f us per call' % inProcess)
+    print('executor process: %.1f us per call (%.1fx)'
+          % (executor, executor / inProcess if inProcess else 0.0))
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
@@ -0,0 +1,95 @@
+#!/usr/bin/env python
+#------------------------------------------------------------------------------
+# CLING - the C++ LLVM-based InterpreterG :)
+#
+# This file is dual-licensed: you can choose to license it under the University
+# of Illinois Open Source License or the GNU Lesser General Public License. See
+# LICENSE.TXT for details.
+#------------------------------------------------------------------------------
+
+"""Run a command, record its wall time and peak RSS and compare them against a
+baseline.
+
+  perfrun.py --name TEST --results FILE [--baseline FILE]
+             [--time-tolerance X] [--rss-tolerance X] -- COMMAND...
+
+The command inherits stdin, stdout and stderr so it can sit in the middle of a
+lit pipeline. One line "<name> <wall seconds> <peak RSS KiB>" is appended to the
+results file; the last line for <name> in the baseline file is the reference.
+"""
+
+import argparse
+import os
+import resource
+import subprocess
+import sys
+import time
+
+
+def readBaseline(path, name):
+    if not path or not os.path.exists(path):
+        return None
+    found = None
+    with open(path) as f:
+        for line in f:
+            fields = line.split()
+            if len(fields) == 3 and fields[0] == name:
+                found = (float(fields[1]), int(fields[2]))
+    return found
+
+
+def main():
+    parser = argparse.ArgumentParser()
+    parser.add_argument('--name', required=True)
+    parser.add_argument('--results', required=True)
+    parser.add_argument('--baseline')
+    parser.add_argument('--time-tolerance', type=float, default=0.25)
+    parser.add_argument('--rss-tolerance', type=float, default=0.10)
+    parser.add_argument('command', nargs=argparse.REMAINDER)
+    args = parser.parse_args()
+
+    command = args.command
+    if command and command[0] == '--':
+        command = command[1:]
+    if not command:
+        parser.error('no command given')
+
+    name = os.path.basename(args.name)
+    start = time.time()
+    status = subprocess.call(command)
+    wall = time.time() - start
+    # ru_maxrss is in KiB on Linux and in bytes on macOS.
+    rss = resource.getrusage(resource.RUSAGE_CHILDREN).ru_maxrss
+    if sys.platform == 'darwin':
+        rss //= 1024
+
+    resultsDir = os.path.dirname(args.results)
+    if resultsDir and not os.path.isdir(resultsDir):
+        os.makedirs(resultsDir)
+    with open(args.results, 'a') as f:
+        f.write('%s %.3f %d\n' % (name, wall, rss))
+
+    if status != 0:
+        return status
+
+    baseline = readBaseline(args.baseline, name)
+    if baseline is None:
+        return 0
+
+    failed = False
+    baseWall, baseRSS = baseline
+    if wall > baseWall * (1 + args.time_tolerance):
+        sys.stderr.write('%s: wall time %.3fs exceeds baseline %.3fs by more'
+                         ' than %d%%\n' % (name, wall, baseWall,
+                                           args.time_tolerance * 100))
+        failed = True
+    if rss > baseRSS * (1 + args.rss_tolerance):
+        sys.stderr.write('%s: peak RSS %dKiB exceeds baseline %dKiB by more'
+                         ' than %d%%\n' % (name, rss, baseRSS,
+                                           args.rss_tolerance * 100))
+        failed = True
+    return 1 if failed else 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
@@ -8,15 +8,19 @@
 //------------------------------------------------------------------------------
 
 #include "cling/Interpreter/Interpreter.h"
+#include "cling/Interpreter/StartupProfile.h"
 #include "cling/MetaProcessor/MetaProcessor.h"
+#include "cling/MetaProcessor/SessionRecorder.h"
 #include "cling/UserInterface/UserInterface.h"
 
 #include "clang/Basic/LangOptions.h"
 #include "clang/Frontend/CompilerInstance.h"
 
+#include "llvm/Support/FileSystem.h"
 #include "llvm/Support/Signals.h"
 #include "llvm/Support/PrettyStackTrace.h"
 #include "llvm/Support/ManagedStatic.h"
+#include "llvm/Support/raw_ostream.h"
 
 #include <iostream>
 #include <fstream>
@@ -59,6 +63,23 @@ int main( int argc, char **argv )
 		return 0;
 	}
 
+	if (const cling::StartupProfile* Profile = interp.getStartupProfile())
+	{
+		const std::string& Out = interp.getOptions().StartupProfile;
+		if (Out == "-")
+			Profile->printJSON(llvm::errs());
+		else
+		{
+			std::error_code EC;
+			llvm::raw_fd_ostream OS(Out, EC, llvm::sys::fs::F_Text);
+			if (EC)
+				llvm::errs() << "cling: cannot write startup profile to '" << Out
+				             << "': " << EC.message() << "\n";
+			else
+				Profile->printChromeTrace(OS);
+		}
+	}
+
 	clang::CompilerInstance* CI = interp.getCI();
 	interp.AddIncludePath(".");
 
@@ -69,10 +90,19 @@ int main( int argc, char **argv )
 
 	// Interactive means no input (or one input that's "-")
 	std::vector<std::string>& Inputs = interp.getOptions().Inputs;
-	bool Int:eractive = Inputs.empty() || (Inputs.size() == 1
+	bool Interactive = Inputs.empty() || (Inputs.size() == 1
 			&& Inputs[0] == "-");
 
 	cling::UserInterface ui(interp);
+	const std::string& RecordFile = interp.getOptions().RecordSession;
+	if (!RecordFile.empty() && !ui.getMetaProcessor()->recordSession(RecordFile))
+		llvm::errs() << "cling: cannot record the session into '" << RecordFile
+		             << "'\n";
+
+	const std::string& ReplayFile = interp.getOptions().ReplaySession;
+	if (!ReplayFile.empty())
+		return !cling::SessionRecorder::replay(*ui.getMetaProcessor(), ReplayFile,
+		                                       llvm::errs());
 	// If we are not interactive we're supposed to parse files
 	if (!Interactive)
 	{